@@ -5,10 +5,51 @@
 #define WIREFRAME false			
 #define FULLSCREEN false
 
+#define PIPELINED_FRAMES true				// Simulate two frames and cull one frame ahead of recording
+#define LATE_LATCH true						// Sample input and write camera data right before submit, culling uses the camera of an earlier frame
+#define FRAMES_IN_FLIGHT 2					// Frames the CPU can record ahead of the GPU (1-4), change at runtime with F1-F4
+
 #define SIMULATED_JOB_COUNT 1				// Secondary command buffer record repeats
 #define SIMULATED_JOB_SIZE 0				// Sleep time (microseconds)
 
-#define TREE_COUNT 10000
+#define TREE_COUNT 10000					// Placement slots of the whole map, the same number in every heightmap region
+#define TREE_PLACEMENT_SEED 1				// Trees are placed on the GPU, the same seed gives the same forest
+#define TREE_MIN_HEIGHT 1.f					// Terrain heights where trees grow
+#define TREE_MAX_HEIGHT 17.f
+#define TREE_MAX_SLOPE 0.6f					// Rise over run above which a slot is left empty
+#define TREE_MIN_SCALE 0.8f					// Range of the random uniform scale of a tree
+#define TREE_MAX_SCALE 1.2f
+#define IMPOSTOR_DISTANCE 80.f				// Trees further away are drawn as billboards baked from the mesh
+#define IMPOSTOR_CROSS_FADE 10.f			// Distance before IMPOSTOR_DISTANCE where mesh and billboard are dithered into each other, 0 switches at once
+#define IMPOSTOR_VIEW_COUNT 8				// Directions around the up axis in the billboard atlas
+#define IMPOSTOR_VIEW_SIZE 256				// Pixels in each direction of one view
+#define MESH_LOD_COUNT 4					// Levels of detail simplified from every primitive at load, the first is the full mesh
+#define MESH_LOD_REDUCTION 0.5f				// Index count of a level relative to the level before it
+#define MESH_LOD_SCREEN_SIZE 0.5f			// Screen height share of a tree's bounds below which the second level is used, halves for each further level
+#define CLUSTER_TRIANGLE_COUNT 64			// Largest triangle count of a cluster, the full detail level is split into clusters at load
+#define CLUSTER_CULLING 1					// Cull the clusters of full detail trees in a compute pass, needs VK_KHR_draw_indirect_count
+#define CLUSTER_MAX_DRAWS 16384				// Cluster draws the compute pass may write in one frame, full detail trees past it are drawn whole
+
+#define BINDLESS_MAX_BUFFERS 64				// Array sizes of the bindless table, must match the bindless shaders
+#define BINDLESS_MAX_IMAGES 256
+#define BINDLESS_MAX_SAMPLERS 16
+
+#define GEOMETRY_ARENA_VERTICES (1 << 19)	// Capacity of the shared model geometry buffers
+#define GEOMETRY_ARENA_INDICES (1 << 21)
+
+#define SCENE_GRAPH_JOB_SIZE 256			// Minimum nodes per world transform job
+
+#define DECODE_BENCHMARK 0					// Time the glTF accessor decoding at startup, the result is added to the frame report
+#define DECODE_BENCHMARK_MODEL "..\\assets\\Models\\Sponza\\glTF\\Sponza.gltf"
+#define DECODE_BENCHMARK_ITERATIONS 20
+#define MODEL_CACHE 1						// Load models from and write them to <model>.cache next to the source file
+#define TEXTURE_MIPMAPS 1					// Generate full mip chains for model and skybox textures, compare the GPU timings in the frame report
+#define TEXTURE_COMPRESSION 1				// Transcode textures to BC1/BC3/BC5/BC7 with mips, RGBA8 when the device lacks them
+#define TEXTURE_CACHE_FOLDER "..\\assets\\TextureCache\\"	// Transcoded textures from earlier runs
+#define TEXTURE_STREAMING 1					// Only the mip tail of compressed textures is loaded, finer levels stream in by screen footprint
+#define TEXTURE_STREAMING_BUDGET (64ull << 20)	// Bytes of streamed levels on top of the tails
+#define TEXTURE_STREAMING_TAIL_SIZE 128		// Largest level which is always resident
+#define TEXTURE_STREAMING_IDLE_FRAMES 120	// Streamed levels not requested for this many frames are evicted
 
 #define CAMERA_SPEED 40
 #define CAMERA_SPRINT_SPEED_MULTIPLIER 2
@@ -21,4 +62,6 @@
 #define PROXIMITY_SIZE 30					// Number of loaded regions equals PROXIMITY_SIZE * 2 + 1
 #define TRANSFER_PROXIMITY_THRESHOLD 10
 
-#define PROFILER_JSON_FILE_NAME "Result.json"
\ No newline at end of file
+#define PROFILER_JSON_FILE_NAME "Result.json"
+#define FRAME_REPORT_FILE_NAME "FrameReport.txt"	// Latency and throughput for each frames in flight setting, and startup time
+#define PIPELINE_CACHE_FILE_NAME "PipelineCache.bin"
\ No newline at end of file
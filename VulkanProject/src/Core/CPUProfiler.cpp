@@ -34,6 +34,9 @@ void InstrumentationTimer::stop()
 
 		size_t tid = std::hash<std::thread::id>{}(std::this_thread::get_id());
 		Instrumentation::get().write({ this->name, (uint64_t)start, (uint64_t)end, tid });
+
+		// Only write once if stopped before the destructor
+		this->active = false;
 	}
 }
 
@@ -91,6 +94,19 @@ void Instrumentation::write(ProfileData data)
 	this->file.flush();
 }
 
+void Instrumentation::writeSpan(const std::string& name, uint64_t startTime)
+{
+	// The span can have started before the session did
+	uint64_t start = startTime < this->startTime ? this->startTime : startTime;
+	size_t tid = std::hash<std::thread::id>{}(std::this_thread::get_id());
+	write({ name, start, getTime(), tid });
+}
+
+uint64_t Instrumentation::getTime()
+{
+	return std::chrono::time_point_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now()).time_since_epoch().count();
+}
+
 void Instrumentation::setStartTime(uint64_t time)
 {
 	this->startTime = time;
@@ -15,6 +15,8 @@
 	#define JAS_PROFILER_SAMPLE_END_SESSION() {if(Instrumentation::g_runProfilingSample) { Instrumentation::get().endSession(); Instrumentation::g_runProfilingSample = false; } }
 	#define JAS_PROFILER_SAMPLE_SCOPE(name) InstrumentationTimer instrumentationTimerRendering##__LINE__(name, Instrumentation::g_runProfilingSample)
 	#define JAS_PROFILER_SAMPLE_FUNCTION() JAS_PROFILER_SAMPLE_SCOPE(__FUNCTION__ )
+	// Span from a time taken with Instrumentation::getTime() until now, for spans that do not follow a scope
+	#define JAS_PROFILER_SAMPLE_SPAN(name, startTime) {if(Instrumentation::g_runProfilingSample) Instrumentation::get().writeSpan(name, startTime);}
 
 	#define JAS_PROFILER_TOGGLE_SAMPLE(key, frameCount) Instrumentation::get().toggleSample(key, frameCount)
 	#define JAS_PROFILER_TOGGLE_SAMPLE_POOL(pool, key, frameCount) Instrumentation::get().toggleSample(pool, key, frameCount)
@@ -30,6 +32,7 @@
 	#define JAS_PROFILER_SAMPLE_END_SESSION()
 	#define JAS_PROFILER_SAMPLE_SCOPE(name)
 	#define JAS_PROFILER_SAMPLE_FUNCTION()
+	#define JAS_PROFILER_SAMPLE_SPAN(name, startTime)
 
 	#define JAS_PROFILER_TOGGLE_SAMPLE(key, frameCount)
 	#define JAS_PROFILER_TOGGLE_SAMPLE_POOL(pool, key, frameCount)
@@ -70,6 +73,10 @@ public:
 	void beginSession(const std::string& name, const std::string& filePath = "result.json");
 
 	void write(ProfileData data);
+	void writeSpan(const std::string& name, uint64_t startTime);
+
+	// Current time in microseconds, same clock as the samples
+	static uint64_t getTime();
 
 	void setStartTime(uint64_t time);
 
@@ -22,8 +22,9 @@ glm::vec2 Input::getCursorDelta()
 
 void Input::updateCursor(double deltaX, double deltaY)
 {
-	this->deltaX = deltaX;
-	this->deltaY = deltaY;
+	// Accumulate until read, events can be polled more than once per frame
+	this->deltaX += deltaX;
+	this->deltaY += deltaY;
 }
 
 void Input::setKeyPressed(int key)
@@ -0,0 +1,97 @@
+#include "jaspch.h"
+#include "MappedFile.h"
+
+#ifdef _WIN32
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <Windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile() : data(nullptr), size(0), fileHandle(INVALID_HANDLE_VALUE), mappingHandle(nullptr)
+{
+}
+#else
+MappedFile::MappedFile() : data(nullptr), size(0), fileDescriptor(-1)
+{
+}
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const std::string& filePath)
+{
+	close();
+#ifdef _WIN32
+	this->fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (this->fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(this->fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+		close();
+		return false;
+	}
+	this->size = static_cast<uint64_t>(fileSize.QuadPart);
+
+	this->mappingHandle = CreateFileMappingA(this->fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (this->mappingHandle == nullptr) {
+		close();
+		return false;
+	}
+	this->data = static_cast<const uint8_t*>(MapViewOfFile(this->mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+	this->fileDescriptor = ::open(filePath.c_str(), O_RDONLY);
+	if (this->fileDescriptor < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(this->fileDescriptor, &info) != 0 || info.st_size == 0) {
+		close();
+		return false;
+	}
+	this->size = static_cast<uint64_t>(info.st_size);
+
+	void* mapped = mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE, this->fileDescriptor, 0);
+	this->data = mapped != MAP_FAILED ? static_cast<const uint8_t*>(mapped) : nullptr;
+#endif
+	if (this->data == nullptr) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (this->data != nullptr)
+		UnmapViewOfFile(this->data);
+	if (this->mappingHandle != nullptr)
+		CloseHandle(this->mappingHandle);
+	if (this->fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(this->fileHandle);
+	this->mappingHandle = nullptr;
+	this->fileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (this->data != nullptr)
+		munmap(const_cast<uint8_t*>(this->data), this->size);
+	if (this->fileDescriptor >= 0)
+		::close(this->fileDescriptor);
+	this->fileDescriptor = -1;
+#endif
+	this->data = nullptr;
+	this->size = 0;
+}
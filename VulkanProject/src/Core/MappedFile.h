@@ -0,0 +1,34 @@
+#pragma once
+#include "jaspch.h"
+
+/*
+	Read only memory mapping of a whole file. The data is paged in by the OS when it is touched,
+	so reading a large file only costs the parts that are used.
+*/
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	// Returns false if the file could not be opened or is empty
+	bool open(const std::string& filePath);
+	void close();
+
+	const uint8_t* getData() const { return this->data; }
+	uint64_t getSize() const { return this->size; }
+	bool isOpen() const { return this->data != nullptr; }
+
+	MappedFile(const MappedFile& other) = delete;
+	MappedFile& operator=(const MappedFile& other) = delete;
+
+private:
+	const uint8_t* data;
+	uint64_t size;
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fileDescriptor;
+#endif
+};
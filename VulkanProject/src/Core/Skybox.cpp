@@ -6,10 +6,18 @@
 #include "Vulkan/CommandBuffer.h"
 #include "Vulkan/SwapChain.h"
 #include "Vulkan/Instance.h"
-#include "Core/Camera.h"
+#include "Core/MappedFile.h"
+#include "Models/AssetCache.h"
+#include "Models/TextureCompressor.h"
+#include "Models/TextureContainer.h"
+#include "Threading/ThreadManager.h"
 
 #include "stb/stb_image.h"
 
+#include <algorithm>
+#include <memory>
+#include <cstring>
+
 Skybox::Skybox()
 {
 
@@ -19,26 +27,20 @@ Skybox::~Skybox()
 {
 }
 
-void Skybox::init(float scale, const std::string& texturePath, SwapChain* swapChain, CommandPool* pool, RenderPass* renderPass)
+void Skybox::init(const std::string& texturePath, SwapChain* swapChain, CommandPool* pool, RenderPass* renderPass)
 {
-	for (int i = 0; i < 36; i++)
-	{
-		this->cube[i] *= scale;
-	}
-
 	// Uniform data
-	CubemapUboData cubemapUboData;
-	cubemapUboData.proj = glm::mat4(1.0f);
-	cubemapUboData.view = glm::mat4(1.0f);
+	CubemapUboData cubemapUboData = getUboData(glm::mat4(1.0f), glm::mat4(1.0f));
 	uint32_t cubemapUboDataSize = sizeof(CubemapUboData);
 
 	// Create the buffer and memory
 	std::vector<uint32_t> queueIndices = { findQueueIndex(VK_QUEUE_GRAPHICS_BIT, Instance::get().getPhysicalDevice()) };
-	this->cubemapUniformBuffer.init(cubemapUboDataSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, queueIndices);
-	this->uniformMemory.bindBuffer(&this->cubemapUniformBuffer);
+	this->cubemapUniformBuffer.init(swapChain->getNumImages(), cubemapUboDataSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, queueIndices);
+	this->cubemapUniformBuffer.bind(&this->uniformMemory);
 	this->uniformMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	// Transfer the data to the buffer.
-	this->uniformMemory.directTransfer(&this->cubemapUniformBuffer, (void*)& cubemapUboData, cubemapUboDataSize, 0);
+	// Transfer the data to the buffers.
+	for (uint32_t i = 0; i < this->cubemapUniformBuffer.getCopyCount(); i++)
+		this->uniformMemory.directTransfer(this->cubemapUniformBuffer.get(i), (void*)& cubemapUboData, cubemapUboDataSize, 0);
 
 	std::vector<std::string> faces = {
 		"right.jpg",
@@ -49,64 +51,62 @@ void Skybox::init(float scale, const std::string& texturePath, SwapChain* swapCh
 		"back.jpg"
 	};
 
-	// Fetch each face of the cubemap.
-	VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
-	int32_t width = 0, height = 0;
-	std::vector<stbi_uc*> data;
 	JAS_INFO("Loading cubemap: {0}", texturePath.c_str());
-	for (std::string& face : faces)
-	{
-		std::string finalFilePath = texturePath;
-		finalFilePath += face;
-
-		int channels;
-		stbi_uc* img = stbi_load(finalFilePath.c_str(), &width, &height, &channels, 4);
-		data.push_back(img);
-		JAS_INFO(" ->Loaded face: {0}", face.c_str());
-	}
+	uint32_t width = 0, height = 0, levelCount = 1;
+	std::vector<uint8_t> chain;
+	VkFormat format = loadFaces(texturePath, faces, width, height, levelCount, chain);
+	const bool isCompressed = TextureCompressor::isCompressed(format);
 
 	{
 		Buffer cubemapStagingBuffer;
 		Memory cubemapStagingMemory;
 
-		// Create staging buffer.
-		uint32_t numFaces = (uint32_t)data.size();
-		uint32_t size = (uint32_t)(width * height * 4);
-		std::vector<uint32_t> queueIndices = { findQueueIndex(VK_QUEUE_GRAPHICS_BIT, Instance::get().getPhysicalDevice()) };
-		cubemapStagingBuffer.init(size * numFaces, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, queueIndices);
+		// Create staging buffer, compressed faces come with their mips while RGBA8 faces only have the first level.
+		uint32_t numFaces = (uint32_t)faces.size();
+		uint64_t stagingSize = (uint64_t)chain.size();
+		cubemapStagingBuffer.init(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, queueIndices);
 		cubemapStagingMemory.bindBuffer(&cubemapStagingBuffer);
 		cubemapStagingMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
 		// Transfer the data to the buffer.
-		for (uint32_t f = 0; f < numFaces; f++)
-		{
-			stbi_uc* img = data[f];
-			cubemapStagingMemory.directTransfer(&cubemapStagingBuffer, (void*)img, size, (Offset)f * size);
-			delete img;
-		}
-
-		// Create texture.
-		this->cubemapTexture.init((uint32_t)width, (uint32_t)height, format, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, queueIndices, VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT, numFaces);
+		cubemapStagingMemory.directTransfer(&cubemapStagingBuffer, (void*)chain.data(), stagingSize, 0);
+
+		// Create texture, the mips of RGBA8 faces are generated from the first level after the copy.
+		uint32_t mipLevels = 1;
+#if TEXTURE_MIPMAPS
+		if (isCompressed || Image::supportsLinearBlit(format))
+			mipLevels = Image::getMipLevelCount(width, height);
+#endif
+		VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		if (!isCompressed)
+			usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		this->cubemapTexture.init(width, height, format, usage, queueIndices, VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT, numFaces, mipLevels);
 		this->cubemapMemory.bindTexture(&this->cubemapTexture);
 		this->cubemapMemory.init(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		this->cubemapTexture.getImageView().init(this->cubemapTexture.getVkImage(), VK_IMAGE_VIEW_TYPE_CUBE, format, VK_IMAGE_ASPECT_COLOR_BIT, numFaces);
+		this->cubemapTexture.getImageView().init(this->cubemapTexture.getVkImage(), VK_IMAGE_VIEW_TYPE_CUBE, format, VK_IMAGE_ASPECT_COLOR_BIT, numFaces, mipLevels);
 
-		// Setup buffer copy regions for each face including all of its miplevels. In this case only 1 miplevel is used.
+		// Setup buffer copy regions for each uploaded miplevel of each face, the faces of a level are after each other.
 		std::vector<VkBufferImageCopy> bufferCopyRegions;
-		for (uint32_t face = 0; face < numFaces; face++)
+		const uint32_t uploadedLevels = std::min(levelCount, mipLevels);
+		VkDeviceSize offset = 0;
+		for (uint32_t level = 0; level < uploadedLevels; level++)
 		{
-			for (uint32_t level = 0; level < 1; level++)
+			uint32_t levelWidth = std::max(width >> level, 1u);
+			uint32_t levelHeight = std::max(height >> level, 1u);
+			VkDeviceSize faceSize = (VkDeviceSize)TextureCompressor::getLevelSize(format, levelWidth, levelHeight);
+			for (uint32_t face = 0; face < numFaces; face++)
 			{
 				VkBufferImageCopy bufferCopyRegion = {};
 				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 				bufferCopyRegion.imageSubresource.mipLevel = level;
 				bufferCopyRegion.imageSubresource.baseArrayLayer = face;
 				bufferCopyRegion.imageSubresource.layerCount = 1;
-				bufferCopyRegion.imageExtent.width = width >> level;
-				bufferCopyRegion.imageExtent.height = height >> level;
+				bufferCopyRegion.imageExtent.width = levelWidth;
+				bufferCopyRegion.imageExtent.height = levelHeight;
 				bufferCopyRegion.imageExtent.depth = 1;
-				bufferCopyRegion.bufferOffset = (VkDeviceSize)(face * size);
+				bufferCopyRegion.bufferOffset = offset;
 				bufferCopyRegions.push_back(bufferCopyRegion);
+				offset += faceSize;
 			}
 		}
 
@@ -120,47 +120,30 @@ void Skybox::init(float scale, const std::string& texturePath, SwapChain* swapCh
 		Image& image = this->cubemapTexture.getImage();
 		image.transistionLayout(desc);
 		image.copyBufferToImage(&cubemapStagingBuffer, pool, bufferCopyRegions);
-		desc.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		desc.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		image.transistionLayout(desc);
+		if (isCompressed)
+		{
+			desc.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			desc.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			image.transistionLayout(desc);
+		}
+		else
+		{
+			CommandBuffer* cmdBuff = pool->beginSingleTimeCommand();
+			image.generateMipmaps(cmdBuff);
+			pool->endSingleTimeCommand(cmdBuff);
+		}
 
 		// Staging buffer and memory are not used anymore, can be destroyed.
 		cubemapStagingBuffer.cleanup();
 		cubemapStagingMemory.cleanup();
 	}
 
-	// Stage and transfer cube to device
-	{
-		Buffer stagingBuffer;
-		Memory stagingMemory;
-		stagingBuffer.init(sizeof(this->cube), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, { Instance::get().getTransferQueue().queueIndex });
-		stagingMemory.bindBuffer(&stagingBuffer);
-		stagingMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		stagingMemory.directTransfer(&stagingBuffer, this->cube, sizeof(this->cube), 0);
-
-		this->cubeBuffer.init(sizeof(this->cube), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, { Instance::get().getGraphicsQueue().queueIndex, Instance::get().getTransferQueue().queueIndex });
-		this->cubeMemory.bindBuffer(&this->cubeBuffer);
-		this->cubeMemory.init(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-		CommandBuffer* cmdBuff = pool->beginSingleTimeCommand();
-
-		VkBufferCopy region = {};
-		region.srcOffset = 0;
-		region.dstOffset = 0;
-		region.size = sizeof(this->cube);
-		cmdBuff->cmdCopyBuffer(stagingBuffer.getBuffer(), this->cubeBuffer.getBuffer(), 1, &region);
-
-		pool->endSingleTimeCommand(cmdBuff);
-		stagingBuffer.cleanup();
-		stagingMemory.cleanup();
-	}
 	// Create sampler
 	// TODO: This needs more control, should be compareOp=VK_COMPARE_OP_NEVER!
 	this->cubemapSampler.init(VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
 
 	// Initialize the descriptor manager.
 	DescriptorLayout descLayoutCubemap;
-	descLayoutCubemap.add(new SSBO(VK_SHADER_STAGE_VERTEX_BIT, 1, nullptr));	// Vertices
 	descLayoutCubemap.add(new UBO(VK_SHADER_STAGE_VERTEX_BIT, 1, nullptr));		// Uniforms (Only vp)
 	descLayoutCubemap.init();
 	DescriptorLayout descLayoutCubemap2;
@@ -173,8 +156,7 @@ void Skybox::init(float scale, const std::string& texturePath, SwapChain* swapCh
 	// Set data for the descriptor manager.
 	for (uint32_t i = 0; i < static_cast<uint32_t>(swapChain->getNumImages()); i++)
 	{
-		this->cubemapDescManager.updateBufferDesc(0, 0, this->cubeBuffer.getBuffer(), 0, sizeof(this->cube));
-		this->cubemapDescManager.updateBufferDesc(0, 1, this->cubemapUniformBuffer.getBuffer(), 0, sizeof(CubemapUboData));
+		this->cubemapDescManager.updateBufferDesc(0, 0, this->cubemapUniformBuffer.get(i)->getBuffer(), 0, sizeof(CubemapUboData));
 		this->cubemapDescManager.updateImageDesc(1, 0, this->cubemapTexture.getImage().getLayout(), this->cubemapTexture.getVkImageView(), this->cubemapSampler.getSampler());
 		this->cubemapDescManager.updateSets({ 0, 1 }, i);
 	}
@@ -184,44 +166,58 @@ void Skybox::init(float scale, const std::string& texturePath, SwapChain* swapCh
 	this->shader.addStage(Shader::Type::FRAGMENT, "CubemapTest\\skyboxFrag.spv");
 	this->shader.init();
 
-	// Initialize the cubemap pipeline.
+	// Initialize the cubemap pipeline. The triangle is at depth 1.0, which equals the cleared depth, and it is only
+	// shaded where nothing was drawn before. The depth is not written since nothing is drawn behind the sky.
 	PipelineInfo pipelineInfo;
 	pipelineInfo.rasterizer = {};
 	pipelineInfo.rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
 	pipelineInfo.rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
 	pipelineInfo.rasterizer.lineWidth = 1.0f;
-	pipelineInfo.rasterizer.cullMode = VK_CULL_MODE_FRONT_BIT;
+	pipelineInfo.rasterizer.cullMode = VK_CULL_MODE_NONE;
 	pipelineInfo.rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-	this->pipeline.setPipelineInfo(PipelineInfoFlag::RASTERIZATION, pipelineInfo);
+	pipelineInfo.depthStencil = {};
+	pipelineInfo.depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	pipelineInfo.depthStencil.depthTestEnable = VK_TRUE;
+	pipelineInfo.depthStencil.depthWriteEnable = VK_FALSE;
+	pipelineInfo.depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+	pipelineInfo.depthStencil.minDepthBounds = 0.0f;
+	pipelineInfo.depthStencil.maxDepthBounds = 1.0f;
+	this->pipeline.setPipelineInfo(PipelineInfoFlag::RASTERIZATION | PipelineInfoFlag::DEAPTH_STENCIL, pipelineInfo);
 	this->pipeline.setDescriptorLayouts(this->cubemapDescManager.getLayouts());
 	this->pipeline.setGraphicsPipelineInfo(swapChain->getExtent(), renderPass);
 	this->pipeline.init(Pipeline::Type::GRAPHICS, &this->shader);
 }
 
-void Skybox::update(Camera* camera)
+Skybox::CubemapUboData Skybox::getUboData(const glm::mat4& proj, const glm::mat4& view)
 {
-	CubemapUboData cubemapUboData;
-	cubemapUboData.proj = camera->getProjection();
-	cubemapUboData.view = camera->getView();
 	// Disable translation
-	cubemapUboData.view[3][0] = 0.0f;
-	cubemapUboData.view[3][1] = 0.0f;
-	cubemapUboData.view[3][2] = 0.0f;
-	//this->uniformMemory.directTransfer(&this->cubemapUniformBuffer, (void*)& cubemapUboData, sizeof(cubemapUboData), 0);
+	glm::mat4 rotation = view;
+	rotation[3][0] = 0.0f;
+	rotation[3][1] = 0.0f;
+	rotation[3][2] = 0.0f;
+
+	CubemapUboData cubemapUboData;
+	cubemapUboData.invViewProj = glm::inverse(proj * rotation);
+	return cubemapUboData;
+}
+
+void Skybox::update(const glm::mat4& proj, const glm::mat4& view, uint32_t frameIndex)
+{
+	CubemapUboData cubemapUboData = getUboData(proj, view);
+	this->uniformMemory.directTransfer(this->cubemapUniformBuffer.get(frameIndex), (void*)& cubemapUboData, sizeof(cubemapUboData), 0);
 }
 
 void Skybox::draw(CommandBuffer* cmdBuff, uint32_t frameIndex)
 {
-	std::vector<VkDescriptorSet> sets = { this->cubemapDescManager.getSet(frameIndex, 0), this->cubemapDescManager.getSet(frameIndex, 1) };
-	std::vector<unsigned int> offsets;
+	VkDescriptorSet sets[] = { this->cubemapDescManager.getSet(frameIndex, 0), this->cubemapDescManager.getSet(frameIndex, 1) };
 	cmdBuff->cmdBindPipeline(&this->pipeline);
-	cmdBuff->cmdBindDescriptorSets(&this->pipeline, 0, sets, offsets);
-	cmdBuff->cmdDraw(36, 1, 0, 0);
+	cmdBuff->cmdBindDescriptorSets(&this->pipeline, 0, sets, {});
+	cmdBuff->cmdDraw(3, 1, 0, 0);
 }
 
-Buffer* Skybox::getBuffer()
+Buffer* Skybox::getBuffer(uint32_t frameIndex)
 {
-	return &this->cubemapUniformBuffer;
+	return this->cubemapUniformBuffer.get(frameIndex);
 }
 
 void Skybox::cleanup()
@@ -232,8 +228,6 @@ void Skybox::cleanup()
 	this->cubemapDescManager.cleanup();
 	this->cubemapUniformBuffer.cleanup();
 	this->uniformMemory.cleanup();
-	this->cubeBuffer.cleanup();
-	this->cubeMemory.cleanup();
 
 	this->shader.cleanup();
 	this->pipeline.cleanup();
@@ -243,3 +237,93 @@ Pipeline& Skybox::getPipeline()
 {
 	return this->pipeline;
 }
+
+VkFormat Skybox::loadFaces(const std::string& texturePath, const std::vector<std::string>& faces, uint32_t& width, uint32_t& height, uint32_t& levelCount, std::vector<uint8_t>& chain)
+{
+	// The faces are compressed like the model textures, keyed by the bytes of all six files. Only the headers are
+	// read before the cache is checked, the JPEG decode is skipped when there is a container.
+	std::vector<std::unique_ptr<MappedFile>> files;
+	uint64_t sourceHash = AssetCache::HASH_SEED;
+	bool hasAlpha = false;
+	for (const std::string& face : faces)
+	{
+		files.push_back(std::make_unique<MappedFile>());
+		MappedFile& file = *files.back();
+		bool opened = file.open(texturePath + face);
+		JAS_ASSERT(opened, "Could not open cubemap face {}", face);
+		sourceHash = AssetCache::hash(file.getData(), (size_t)file.getSize(), sourceHash);
+
+		int w = 0, h = 0, channels = 0;
+		stbi_info_from_memory(file.getData(), (int)file.getSize(), &w, &h, &channels);
+		width = (uint32_t)w;
+		height = (uint32_t)h;
+		hasAlpha |= channels == 2 || channels == 4;
+	}
+
+	// Without compression the decoded RGBA8 faces are kept instead, the mips are blitted after the upload.
+	std::vector<VkFormat> candidates;
+#if TEXTURE_COMPRESSION
+	// transcode chooses the format from the texels, faces with an alpha channel may still be opaque
+	candidates.push_back(TextureCompressor::chooseFormat(TextureCompressor::Usage::COLOR, false));
+	if (hasAlpha)
+		candidates.push_back(TextureCompressor::chooseFormat(TextureCompressor::Usage::COLOR, true));
+	candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [](VkFormat format) { return !TextureCompressor::isSupported(format); }), candidates.end());
+#endif
+	if (candidates.empty())
+		candidates.push_back(VK_FORMAT_R8G8B8A8_UNORM);
+	for (VkFormat format : candidates)
+	{
+		levelCount = TextureCompressor::isCompressed(format) ? Image::getMipLevelCount(width, height) : 1;
+		TextureContainer::Desc desc = { format, width, height, (uint32_t)faces.size(), levelCount, sourceHash };
+		if (TextureContainer::read(TextureContainer::getPath(sourceHash, format), desc, chain))
+		{
+			JAS_INFO(" ->Read cached faces");
+			return format;
+		}
+	}
+
+	// Decode the faces in parallel, each face is one job
+	std::vector<stbi_uc*> data(faces.size(), nullptr);
+	auto decode = [&](uint32_t f) {
+		int w = 0, h = 0, channels = 0;
+		data[f] = stbi_load_from_memory(files[f]->getData(), (int)files[f]->getSize(), &w, &h, &channels, 4);
+	};
+	uint32_t threadCount = ThreadManager::threadCount();
+	if (threadCount < 2)
+	{
+		for (uint32_t f = 0; f < (uint32_t)faces.size(); f++)
+			decode(f);
+	}
+	else
+	{
+		for (uint32_t f = 0; f < (uint32_t)faces.size(); f++)
+			ThreadManager::addWork(f % threadCount, [&decode, f]() { decode(f); });
+		ThreadManager::wait();
+	}
+	for (uint32_t f = 0; f < (uint32_t)faces.size(); f++)
+	{
+		JAS_ASSERT(data[f] != nullptr, "Could not decode cubemap face {}", faces[f]);
+		JAS_INFO(" ->Loaded face: {0}", faces[f].c_str());
+	}
+
+	std::vector<const uint8_t*> layers(data.begin(), data.end());
+	VkFormat format = TextureCompressor::transcode(sourceHash, TextureCompressor::Usage::COLOR, layers, width, height, chain);
+	if (TextureCompressor::isCompressed(format))
+	{
+		levelCount = Image::getMipLevelCount(width, height);
+	}
+	else
+	{
+		levelCount = 1;
+		uint64_t faceSize = (uint64_t)width * height * 4;
+		chain.resize(faceSize * faces.size());
+		for (uint32_t f = 0; f < (uint32_t)faces.size(); f++)
+			std::memcpy(chain.data() + f * faceSize, data[f], faceSize);
+		TextureContainer::Desc desc = { format, width, height, (uint32_t)faces.size(), levelCount, sourceHash };
+		TextureContainer::write(TextureContainer::getPath(sourceHash, format), desc, chain);
+	}
+
+	for (stbi_uc* img : data)
+		stbi_image_free(img);
+	return format;
+}
@@ -5,6 +5,7 @@
 #include "Vulkan/Pipeline/DescriptorManager.h"
 #include "Vulkan/Buffers/Buffer.h"
 #include "Vulkan/Buffers/Memory.h"
+#include "Vulkan/Buffers/PerFrameBuffer.h"
 #include "Vulkan/Texture.h"
 #include "Vulkan/Sampler.h"
 #include "Models/Model/Model.h"
@@ -12,7 +13,6 @@
 
 class CommandBuffer;
 class SwapChain;
-class Camera;
 class RenderPass;
 
 class Skybox
@@ -20,78 +20,41 @@ class Skybox
 public:
 	struct CubemapUboData
 	{
-		glm::mat4 proj;
-		glm::mat4 view;
+		glm::mat4 invViewProj; // Clip space to world space directions, the view has no translation
 	};
 public:
 	Skybox();
 	~Skybox();
 
-	void init(float scale, const std::string& texturePath, SwapChain* swapChain, CommandPool* pool, RenderPass* renderPass);
+	// The skybox is drawn as a fullscreen triangle at far depth, record it after the opaque geometry so only uncovered pixels are shaded
+	void init(const std::string& texturePath, SwapChain* swapChain, CommandPool* pool, RenderPass* renderPass);
 
-	void update(Camera* camera);
+	static CubemapUboData getUboData(const glm::mat4& proj, const glm::mat4& view);
+	// Writes the camera to the uniform buffer of the given swap chain image
+	void update(const glm::mat4& proj, const glm::mat4& view, uint32_t frameIndex);
 	void draw(CommandBuffer* cmdBuff, uint32_t frameIndex);
 
-	Buffer* getBuffer();
+	// Uniform buffer used by the given swap chain image
+	Buffer* getBuffer(uint32_t frameIndex);
 
 	void cleanup();
 
 	Pipeline& getPipeline();
 
+private:
+	// The six faces as a chain of levelCount levels with the faces of a level after each other. Read from a TextureContainer,
+	// compressed or pre-decoded RGBA8, and only decoded from the source images when there is none for their hash
+	VkFormat loadFaces(const std::string& texturePath, const std::vector<std::string>& faces, uint32_t& width, uint32_t& height, uint32_t& levelCount, std::vector<uint8_t>& chain);
+
 private:
 	Pipeline pipeline;
 	Shader shader;
 
-	Buffer cubeBuffer;
-	Memory cubeMemory;
-
 	// ----------- Cubemap -----------
 	Memory cubemapMemory;
 	Texture cubemapTexture;
 	Sampler cubemapSampler;
 	DescriptorManager cubemapDescManager;
-	Buffer cubemapUniformBuffer;
+	PerFrameBuffer cubemapUniformBuffer;
 	Memory uniformMemory;
-
-private:
-	// Cube verticies
-	glm::vec4 cube[36] = {
-		{-1.0f,-1.0f,-1.0f, 1.0f},
-		{-1.0f,-1.0f, 1.0f,	1.0f},
-		{-1.0f, 1.0f, 1.0f, 1.0f},
-		{ 1.0f, 1.0f,-1.0f, 1.0f},
-		{-1.0f,-1.0f,-1.0f,	1.0f},
-		{-1.0f, 1.0f,-1.0f, 1.0f},
-		{ 1.0f,-1.0f, 1.0f,	1.0f},
-		{-1.0f,-1.0f,-1.0f,	1.0f},
-		{ 1.0f,-1.0f,-1.0f,	1.0f},
-		{ 1.0f, 1.0f,-1.0f,	1.0f},
-		{ 1.0f,-1.0f,-1.0f,	1.0f},
-		{-1.0f,-1.0f,-1.0f,	1.0f},
-		{-1.0f,-1.0f,-1.0f,	1.0f},
-		{-1.0f, 1.0f, 1.0f,	1.0f},
-		{-1.0f, 1.0f,-1.0f,	1.0f},
-		{ 1.0f,-1.0f, 1.0f,	1.0f},
-		{-1.0f,-1.0f, 1.0f,	1.0f},
-		{-1.0f,-1.0f,-1.0f,	1.0f},
-		{-1.0f, 1.0f, 1.0f,	1.0f},
-		{-1.0f,-1.0f, 1.0f,	1.0f},
-		{ 1.0f,-1.0f, 1.0f,	1.0f},
-		{ 1.0f, 1.0f, 1.0f,	1.0f},
-		{ 1.0f,-1.0f,-1.0f,	1.0f},
-		{ 1.0f, 1.0f,-1.0f,	1.0f},
-		{ 1.0f,-1.0f,-1.0f, 1.0f},
-		{ 1.0f, 1.0f, 1.0f, 1.0f},
-		{ 1.0f,-1.0f, 1.0f, 1.0f},
-		{ 1.0f, 1.0f, 1.0f, 1.0f},
-		{ 1.0f, 1.0f,-1.0f, 1.0f},
-		{-1.0f, 1.0f,-1.0f,	1.0f},
-		{ 1.0f, 1.0f, 1.0f, 1.0f},
-		{-1.0f, 1.0f,-1.0f,	1.0f},
-		{-1.0f, 1.0f, 1.0f,	1.0f},
-		{ 1.0f, 1.0f, 1.0f, 1.0f},
-		{-1.0f, 1.0f, 1.0f,	1.0f},
-		{ 1.0f,-1.0f, 1.0f, 1.0f}
-	};
 };
-
@@ -0,0 +1,33 @@
+#pragma once
+#include "jaspch.h"
+
+#include <array>
+
+/*
+	Non owning view of a contiguous array, a small stand in for std::span (C++20).
+	Can be made from a pointer and count, a std::vector, a std::array or a C array.
+*/
+template<typename T>
+class Span
+{
+public:
+	Span() : ptr(nullptr), count(0) {}
+	Span(const T* data, size_t size) : ptr(data), count(size) {}
+	Span(const std::vector<T>& vec) : ptr(vec.data()), count(vec.size()) {}
+	template<size_t N>
+	Span(const T(&arr)[N]) : ptr(arr), count(N) {}
+	template<size_t N>
+	Span(const std::array<T, N>& arr) : ptr(arr.data()), count(N) {}
+
+	const T* data() const { return this->ptr; }
+	uint32_t size() const { return static_cast<uint32_t>(this->count); }
+	bool empty() const { return this->count == 0; }
+
+	const T* begin() const { return this->ptr; }
+	const T* end() const { return this->ptr + this->count; }
+	const T& operator[](size_t index) const { return this->ptr[index]; }
+
+private:
+	const T* ptr;
+	size_t count;
+};
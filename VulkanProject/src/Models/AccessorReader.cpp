@@ -0,0 +1,332 @@
+#include "jaspch.h"
+#include "AccessorReader.h"
+
+#include "glTF/tiny_gltf.h"
+
+#include <emmintrin.h>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+namespace
+{
+	// Stores the lowest count lanes, count is 1 to 4
+	inline void storeLanes(float* out, __m128 value, uint32_t count)
+	{
+		switch (count)
+		{
+		case 4: _mm_storeu_ps(out, value); break;
+		case 3: _mm_storel_pi(reinterpret_cast<__m64*>(out), value); _mm_store_ss(out + 2, _mm_movehl_ps(value, value)); break;
+		case 2: _mm_storel_pi(reinterpret_cast<__m64*>(out), value); break;
+		default: _mm_store_ss(out, value); break;
+		}
+	}
+
+	// Loads one element as four lanes, reads past the element so it can not be used on the last one of a buffer
+	template<typename T>
+	inline __m128 loadWide(const uint8_t* src);
+
+	template<>
+	inline __m128 loadWide<float>(const uint8_t* src)
+	{
+		return _mm_loadu_ps(reinterpret_cast<const float*>(src));
+	}
+
+	template<>
+	inline __m128 loadWide<uint8_t>(const uint8_t* src)
+	{
+		int32_t bytes;
+		memcpy(&bytes, src, sizeof(bytes));
+		__m128i zero = _mm_setzero_si128();
+		__m128i words = _mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero);
+		return _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero));
+	}
+
+	template<>
+	inline __m128 loadWide<int8_t>(const uint8_t* src)
+	{
+		int32_t bytes;
+		memcpy(&bytes, src, sizeof(bytes));
+		// Sign extend by putting the bytes in the top of each lane and shifting them down
+		__m128i value = _mm_cvtsi32_si128(bytes);
+		value = _mm_unpacklo_epi8(value, value);
+		value = _mm_unpacklo_epi16(value, value);
+		return _mm_cvtepi32_ps(_mm_srai_epi32(value, 24));
+	}
+
+	template<>
+	inline __m128 loadWide<uint16_t>(const uint8_t* src)
+	{
+		__m128i value = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+		return _mm_cvtepi32_ps(_mm_unpacklo_epi16(value, _mm_setzero_si128()));
+	}
+
+	template<>
+	inline __m128 loadWide<int16_t>(const uint8_t* src)
+	{
+		__m128i value = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+		return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(value, value), 16));
+	}
+
+	template<typename T>
+	inline float loadComponent(const uint8_t* src, uint32_t component)
+	{
+		T value;
+		memcpy(&value, src + component * sizeof(T), sizeof(T));
+		return static_cast<float>(value);
+	}
+
+	/*
+		scale is 1 / max value for normalized integers, signed ones are clamped to -1 as the spec requires.
+		Every element but the last is converted with one wide load, with two or more components the
+		over read stays inside the next element, so only the last element and single component accessors need the scalar path.
+	*/
+	template<typename T>
+	void decodeLoop(const uint8_t* src, size_t stride, size_t count, uint32_t componentCount, float scale, bool clampNegative, float* out, size_t outStride)
+	{
+		uint8_t* dst = reinterpret_cast<uint8_t*>(out);
+		size_t wideCount = componentCount >= 2 && count > 0 ? count - 1 : 0;
+
+		const __m128 wideScale = _mm_set1_ps(scale);
+		const __m128 minusOne = _mm_set1_ps(-1.0f);
+		for (size_t i = 0; i < wideCount; i++)
+		{
+			__m128 value = _mm_mul_ps(loadWide<T>(src + i * stride), wideScale);
+			if (clampNegative)
+				value = _mm_max_ps(value, minusOne);
+			storeLanes(reinterpret_cast<float*>(dst + i * outStride), value, componentCount);
+		}
+
+		for (size_t i = wideCount; i < count; i++)
+		{
+			float* element = reinterpret_cast<float*>(dst + i * outStride);
+			for (uint32_t c = 0; c < componentCount; c++)
+			{
+				float value = loadComponent<T>(src + i * stride, c) * scale;
+				element[c] = clampNegative ? std::max(value, -1.0f) : value;
+			}
+		}
+	}
+}
+
+void AccessorReader::readIndices(const tinygltf::Model& model, const tinygltf::Accessor& accessor, uint32_t baseVertex, std::vector<uint32_t>& out)
+{
+	size_t first = out.size();
+	out.resize(first + accessor.count);
+	uint32_t* dst = out.data() + first;
+
+	size_t stride = 0;
+	const uint8_t* src = getData(model, accessor, stride);
+	if (src != nullptr)
+		decodeIndices(src, stride, accessor.count, accessor.componentType, baseVertex, dst);
+	else
+		std::fill(dst, dst + accessor.count, baseVertex);
+
+	if (accessor.sparse.isSparse)
+	{
+		std::vector<uint32_t> sparseIndices;
+		const uint8_t* values = nullptr;
+		size_t valueStride = 0;
+		readSparse(model, accessor, sparseIndices, values, valueStride);
+		for (size_t i = 0; i < sparseIndices.size(); i++)
+			if (sparseIndices[i] < accessor.count)
+				decodeIndices(values + i * valueStride, valueStride, 1, accessor.componentType, baseVertex, dst + sparseIndices[i]);
+	}
+}
+
+bool AccessorReader::readFloats(const tinygltf::Model& model, const tinygltf::Accessor& accessor, uint32_t componentCount, float* out, size_t outStride)
+{
+	int32_t accessorComponents = tinygltf::GetNumComponentsInType(static_cast<uint32_t>(accessor.type));
+	if (accessorComponents < (int32_t)componentCount || componentCount == 0 || componentCount > 4 || accessor.componentType == TINYGLTF_COMPONENT_TYPE_DOUBLE
+		|| accessor.componentType == TINYGLTF_COMPONENT_TYPE_INT || accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT)
+		return false;
+
+	size_t stride = 0;
+	const uint8_t* src = getData(model, accessor, stride);
+	if (src != nullptr)
+		decodeFloats(src, stride, accessor.count, accessor.componentType, accessor.normalized, componentCount, out, outStride);
+	else
+	{
+		uint8_t* dst = reinterpret_cast<uint8_t*>(out);
+		for (size_t i = 0; i < accessor.count; i++)
+			memset(dst + i * outStride, 0, componentCount * sizeof(float));
+	}
+
+	if (accessor.sparse.isSparse)
+	{
+		std::vector<uint32_t> sparseIndices;
+		const uint8_t* values = nullptr;
+		size_t valueStride = 0;
+		readSparse(model, accessor, sparseIndices, values, valueStride);
+		uint8_t* dst = reinterpret_cast<uint8_t*>(out);
+		for (size_t i = 0; i < sparseIndices.size(); i++)
+			if (sparseIndices[i] < accessor.count)
+				decodeFloats(values + i * valueStride, valueStride, 1, accessor.componentType, accessor.normalized, componentCount, reinterpret_cast<float*>(dst + sparseIndices[i] * outStride), outStride);
+	}
+	return true;
+}
+
+void AccessorReader::normalizeVec3(float* data, size_t count, size_t stride)
+{
+	uint8_t* bytes = reinterpret_cast<uint8_t*>(data);
+	auto at = [&](size_t i) { return reinterpret_cast<float*>(bytes + i * stride); };
+
+	// Four vectors at a time, reciprocal square root refined with one Newton-Raphson step
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 threeHalves = _mm_set1_ps(1.5f);
+	const __m128 epsilon = _mm_set1_ps(1e-20f);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		float* v0 = at(i);
+		float* v1 = at(i + 1);
+		float* v2 = at(i + 2);
+		float* v3 = at(i + 3);
+		__m128 x = _mm_setr_ps(v0[0], v1[0], v2[0], v3[0]);
+		__m128 y = _mm_setr_ps(v0[1], v1[1], v2[1], v3[1]);
+		__m128 z = _mm_setr_ps(v0[2], v1[2], v2[2], v3[2]);
+
+		__m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+		__m128 nonZero = _mm_cmpgt_ps(lengthSquared, epsilon);
+		__m128 r = _mm_rsqrt_ps(_mm_max_ps(lengthSquared, epsilon));
+		r = _mm_mul_ps(r, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, lengthSquared), _mm_mul_ps(r, r))));
+		r = _mm_and_ps(r, nonZero);
+
+		alignas(16) float xs[4], ys[4], zs[4];
+		_mm_store_ps(xs, _mm_mul_ps(x, r));
+		_mm_store_ps(ys, _mm_mul_ps(y, r));
+		_mm_store_ps(zs, _mm_mul_ps(z, r));
+		float* vectors[4] = { v0, v1, v2, v3 };
+		for (uint32_t k = 0; k < 4; k++)
+		{
+			vectors[k][0] = xs[k];
+			vectors[k][1] = ys[k];
+			vectors[k][2] = zs[k];
+		}
+	}
+
+	for (; i < count; i++)
+	{
+		float* v = at(i);
+		float lengthSquared = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+		float r = lengthSquared > 1e-20f ? 1.0f / std::sqrt(lengthSquared) : 0.0f;
+		v[0] *= r;
+		v[1] *= r;
+		v[2] *= r;
+	}
+}
+
+uint64_t AccessorReader::getSourceSize(const tinygltf::Accessor& accessor)
+{
+	uint64_t elementSize = (uint64_t)tinygltf::GetComponentSizeInBytes(static_cast<uint32_t>(accessor.componentType)) * tinygltf::GetNumComponentsInType(static_cast<uint32_t>(accessor.type));
+	return elementSize * accessor.count;
+}
+
+const uint8_t* AccessorReader::getData(const tinygltf::Model& model, const tinygltf::Accessor& accessor, size_t& stride)
+{
+	// Sparse accessors without a buffer view start out as zeros
+	if (accessor.bufferView < 0)
+		return nullptr;
+
+	const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
+	const tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
+	int byteStride = accessor.ByteStride(bufferView);
+	if (byteStride <= 0 || buffer.data.empty())
+		return nullptr;
+
+	stride = static_cast<size_t>(byteStride);
+	return buffer.data.data() + bufferView.byteOffset + accessor.byteOffset;
+}
+
+void AccessorReader::decodeIndices(const uint8_t* src, size_t stride, size_t count, int componentType, uint32_t baseVertex, uint32_t* out)
+{
+	const __m128i base = _mm_set1_epi32((int)baseVertex);
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+	switch (componentType)
+	{
+	case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+		// Indices are tightly packed unless they come from a sparse accessor, which decodes one at a time
+		for (; stride == 1 && i + 16 <= count; i += 16)
+		{
+			__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			__m128i low = _mm_unpacklo_epi8(bytes, zero);
+			__m128i high = _mm_unpackhi_epi8(bytes, zero);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_add_epi32(_mm_unpacklo_epi16(low, zero), base));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 4), _mm_add_epi32(_mm_unpackhi_epi16(low, zero), base));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8), _mm_add_epi32(_mm_unpacklo_epi16(high, zero), base));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 12), _mm_add_epi32(_mm_unpackhi_epi16(high, zero), base));
+		}
+		for (; i < count; i++)
+			out[i] = src[i * stride] + baseVertex;
+		break;
+	case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+		for (; stride == 2 && i + 8 <= count; i += 8)
+		{
+			__m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_add_epi32(_mm_unpacklo_epi16(words, zero), base));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 4), _mm_add_epi32(_mm_unpackhi_epi16(words, zero), base));
+		}
+		for (; i < count; i++)
+		{
+			uint16_t index;
+			memcpy(&index, src + i * stride, sizeof(index));
+			out[i] = index + baseVertex;
+		}
+		break;
+	case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+		for (; stride == 4 && i + 4 <= count; i += 4)
+		{
+			__m128i indices = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_add_epi32(indices, base));
+		}
+		for (; i < count; i++)
+		{
+			uint32_t index;
+			memcpy(&index, src + i * stride, sizeof(index));
+			out[i] = index + baseVertex;
+		}
+		break;
+	default:
+		JAS_WARN("Unsupported index component type {}", componentType);
+		std::fill(out, out + count, baseVertex);
+		break;
+	}
+}
+
+void AccessorReader::decodeFloats(const uint8_t* src, size_t stride, size_t count, int componentType, bool normalized, uint32_t componentCount, float* out, size_t outStride)
+{
+	switch (componentType)
+	{
+	case TINYGLTF_COMPONENT_TYPE_FLOAT:
+		decodeLoop<float>(src, stride, count, componentCount, 1.0f, false, out, outStride);
+		break;
+	case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+		decodeLoop<uint8_t>(src, stride, count, componentCount, normalized ? 1.0f / 255.0f : 1.0f, false, out, outStride);
+		break;
+	case TINYGLTF_COMPONENT_TYPE_BYTE:
+		decodeLoop<int8_t>(src, stride, count, componentCount, normalized ? 1.0f / 127.0f : 1.0f, normalized, out, outStride);
+		break;
+	case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+		decodeLoop<uint16_t>(src, stride, count, componentCount, normalized ? 1.0f / 65535.0f : 1.0f, false, out, outStride);
+		break;
+	case TINYGLTF_COMPONENT_TYPE_SHORT:
+		decodeLoop<int16_t>(src, stride, count, componentCount, normalized ? 1.0f / 32767.0f : 1.0f, normalized, out, outStride);
+		break;
+	}
+}
+
+void AccessorReader::readSparse(const tinygltf::Model& model, const tinygltf::Accessor& accessor, std::vector<uint32_t>& indices, const uint8_t*& values, size_t& valueStride)
+{
+	const auto& sparse = accessor.sparse;
+	const tinygltf::BufferView& indexView = model.bufferViews[sparse.indices.bufferView];
+	const uint8_t* indexData = model.buffers[indexView.buffer].data.data() + indexView.byteOffset + sparse.indices.byteOffset;
+	size_t indexStride = (size_t)tinygltf::GetComponentSizeInBytes(static_cast<uint32_t>(sparse.indices.componentType));
+	indices.resize(sparse.count);
+	decodeIndices(indexData, indexStride, sparse.count, sparse.indices.componentType, 0, indices.data());
+
+	// Values are tightly packed elements of the accessor's type
+	const tinygltf::BufferView& valueView = model.bufferViews[sparse.values.bufferView];
+	values = model.buffers[valueView.buffer].data.data() + valueView.byteOffset + sparse.values.byteOffset;
+	valueStride = (size_t)tinygltf::GetComponentSizeInBytes(static_cast<uint32_t>(accessor.componentType)) * tinygltf::GetNumComponentsInType(static_cast<uint32_t>(accessor.type));
+}
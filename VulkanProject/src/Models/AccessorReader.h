@@ -0,0 +1,39 @@
+#pragma once
+#include "jaspch.h"
+
+// tiny_gltf.h is only included in the translation units, its implementation is compiled where GLTFLoader.cpp includes it
+namespace tinygltf
+{
+	class Model;
+	struct Accessor;
+}
+
+/*
+	Typed decoding of glTF accessors into the loader's arrays. The component type, normalization and stride are resolved
+	once per accessor and a loop specialized for them runs over all elements, with SSE2 kernels for the index widening
+	and normal normalization. Sparse accessors are applied on top of the dense data (or zeros when they have no buffer view).
+	Output strides are in bytes so attributes can be written straight into an array of Vertex.
+*/
+class AccessorReader
+{
+public:
+	// Appends the indices of the accessor with baseVertex added to each
+	static void readIndices(const tinygltf::Model& model, const tinygltf::Accessor& accessor, uint32_t baseVertex, std::vector<uint32_t>& out);
+
+	// Writes componentCount floats of each element to out, outStride bytes apart. Normalized integers become [0, 1] or [-1, 1].
+	// Returns false if the accessor has fewer components or a type that can not be read as floats
+	static bool readFloats(const tinygltf::Model& model, const tinygltf::Accessor& accessor, uint32_t componentCount, float* out, size_t outStride);
+
+	// Normalizes count vec3, stride bytes apart. Zero length vectors stay zero
+	static void normalizeVec3(float* data, size_t count, size_t stride);
+
+	// Bytes the accessor covers in its buffer, what the decode throughput is measured against
+	static uint64_t getSourceSize(const tinygltf::Accessor& accessor);
+
+private:
+	static const uint8_t* getData(const tinygltf::Model& model, const tinygltf::Accessor& accessor, size_t& stride);
+	static void decodeIndices(const uint8_t* src, size_t stride, size_t count, int componentType, uint32_t baseVertex, uint32_t* out);
+	static void decodeFloats(const uint8_t* src, size_t stride, size_t count, int componentType, bool normalized, uint32_t componentCount, float* out, size_t outStride);
+	// Decodes the sparse element indices, values points to their tightly packed elements of the accessor's type
+	static void readSparse(const tinygltf::Model& model, const tinygltf::Accessor& accessor, std::vector<uint32_t>& indices, const uint8_t*& values, size_t& valueStride);
+};
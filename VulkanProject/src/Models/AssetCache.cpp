@@ -0,0 +1,262 @@
+#include "jaspch.h"
+#include "AssetCache.h"
+#include "Vulkan/Instance.h"
+#include "Models/TextureCompressor.h"
+#include "Models/TextureStreamer.h"
+
+#include <algorithm>
+
+AssetCache::AssetCache() : textureStats{ 0, 0 }, samplerStats{ 0, 0 }, geometryStats{ 0, 0 }
+{
+}
+
+AssetCache::~AssetCache()
+{
+}
+
+AssetCache& AssetCache::get()
+{
+	static AssetCache assetCache;
+	return assetCache;
+}
+
+Texture* AssetCache::acquireTexture(uint64_t hash, uint32_t width, uint32_t height, VkFormat format, bool& created)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	uint64_t key = getTextureKey(hash, width, height, format);
+	this->textureStats.acquires++;
+
+	auto it = this->textures.find(key);
+	if (it != this->textures.end())
+	{
+		this->textureStats.hits++;
+		it->second->refCount++;
+		created = false;
+		return &it->second->texture;
+	}
+
+	// Each shared texture owns its memory so it can be destroyed on its own
+	std::unique_ptr<TextureEntry> entry = std::make_unique<TextureEntry>();
+	entry->hash = hash;
+	entry->width = width;
+	entry->height = height;
+	entry->refCount = 1;
+	entry->uploaded = false;
+	Texture& texture = entry->texture;
+	// The loader uploads every level of a block compressed texture and fills the mips of the others with a blit chain,
+	// formats that can not be blitted keep one level
+	bool compressed = TextureCompressor::isCompressed(format);
+	uint32_t mipLevels = 1;
+#if TEXTURE_MIPMAPS
+	if (compressed || Image::supportsLinearBlit(format))
+		mipLevels = Image::getMipLevelCount(width, height);
+	else
+		JAS_WARN("Format {} can not be blitted, the texture is created without mips!", (uint32_t)format);
+#endif
+	// Large block compressed textures only get their mip tail, the TextureStreamer adds the finer levels
+	uint32_t tailLevel = compressed ? TextureStreamer::getTailLevel(width, height) : 0;
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	if (!compressed)
+		usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	texture.init(std::max(width >> tailLevel, 1u), std::max(height >> tailLevel, 1u), format, usage, { Instance::get().getGraphicsQueue().queueIndex }, 0, 1, mipLevels - tailLevel);
+	entry->memory.bindTexture(&texture);
+	entry->memory.init(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	texture.getImageView().init(texture.getVkImage(), VK_IMAGE_VIEW_TYPE_2D, format, VK_IMAGE_ASPECT_COLOR_BIT, 1, mipLevels - tailLevel);
+	if (tailLevel > 0)
+		TextureStreamer::get().addTexture(&texture, hash, width, height);
+
+	Texture* result = &entry->texture;
+	this->textureKeys[result] = key;
+	this->textures[key] = std::move(entry);
+	created = true;
+	return result;
+}
+
+void AssetCache::releaseTexture(Texture* texture)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	auto keyIt = this->textureKeys.find(texture);
+	if (keyIt == this->textureKeys.end()) {
+		JAS_WARN("Released a texture which is not in the asset cache!");
+		return;
+	}
+
+	auto it = this->textures.find(keyIt->second);
+	if (--it->second->refCount > 0)
+		return;
+
+	TextureStreamer::get().removeTexture(texture);
+	it->second->texture.cleanup();
+	it->second->memory.cleanup();
+	this->textures.erase(it);
+	this->textureKeys.erase(keyIt);
+}
+
+bool AssetCache::isResident(uint64_t hash, uint32_t width, uint32_t height, VkFormat format)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	auto it = this->textures.find(getTextureKey(hash, width, height, format));
+	return it != this->textures.end() && it->second->uploaded;
+}
+
+bool AssetCache::isUploaded(Texture* texture)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	TextureEntry* entry = findTexture(texture);
+	return entry != nullptr && entry->uploaded;
+}
+
+void AssetCache::setUploaded(Texture* texture)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	TextureEntry* entry = findTexture(texture);
+	if (entry != nullptr)
+		entry->uploaded = true;
+}
+
+uint64_t AssetCache::getTextureHash(Texture* texture)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	TextureEntry* entry = findTexture(texture);
+	return entry != nullptr ? entry->hash : 0;
+}
+
+VkExtent2D AssetCache::getTextureExtent(Texture* texture)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	TextureEntry* entry = findTexture(texture);
+	return entry != nullptr ? VkExtent2D{ entry->width, entry->height } : VkExtent2D{ 0, 0 };
+}
+
+Sampler* AssetCache::acquireSampler(VkFilter minFilter, VkFilter magFilter, VkSamplerAddressMode uWrap, VkSamplerAddressMode vWrap)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	// The enums are small, 16 bits each is plenty
+	uint64_t key = (uint64_t)minFilter | ((uint64_t)magFilter << 16) | ((uint64_t)uWrap << 32) | ((uint64_t)vWrap << 48);
+	this->samplerStats.acquires++;
+
+	auto it = this->samplers.find(key);
+	if (it != this->samplers.end())
+	{
+		this->samplerStats.hits++;
+		it->second->refCount++;
+		return &it->second->sampler;
+	}
+
+	std::unique_ptr<SamplerEntry> entry = std::make_unique<SamplerEntry>();
+	entry->refCount = 1;
+	entry->sampler.init(minFilter, magFilter, uWrap, vWrap);
+	Sampler* result = &entry->sampler;
+	this->samplerKeys[result] = key;
+	this->samplers[key] = std::move(entry);
+	return result;
+}
+
+void AssetCache::releaseSampler(Sampler* sampler)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	auto keyIt = this->samplerKeys.find(sampler);
+	if (keyIt == this->samplerKeys.end()) {
+		JAS_WARN("Released a sampler which is not in the asset cache!");
+		return;
+	}
+
+	auto it = this->samplers.find(keyIt->second);
+	if (--it->second->refCount > 0)
+		return;
+
+	it->second->sampler.cleanup();
+	this->samplers.erase(it);
+	this->samplerKeys.erase(keyIt);
+}
+
+bool AssetCache::acquireGeometry(uint64_t hash, GeometryArena* arena, GeometryArena::Handle& handle)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->geometryStats.acquires++;
+	auto it = this->geometries.find(getGeometryKey(hash, arena));
+	if (it == this->geometries.end())
+		return false;
+
+	this->geometryStats.hits++;
+	it->second.refCount++;
+	handle = it->second.handle;
+	return true;
+}
+
+void AssetCache::addGeometry(uint64_t hash, GeometryArena* arena, GeometryArena::Handle handle)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->geometries[getGeometryKey(hash, arena)] = { handle, 1 };
+}
+
+bool AssetCache::releaseGeometry(uint64_t hash, GeometryArena* arena)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	auto it = this->geometries.find(getGeometryKey(hash, arena));
+	if (it == this->geometries.end())
+		return true;
+
+	if (--it->second.refCount > 0)
+		return false;
+	this->geometries.erase(it);
+	return true;
+}
+
+std::string AssetCache::getReport()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	std::stringstream ss;
+	ss << "Asset cache: textures " << this->textureStats.hits << "/" << this->textureStats.acquires << " shared"
+		<< ", samplers " << this->samplerStats.hits << "/" << this->samplerStats.acquires << " shared"
+		<< ", geometry " << this->geometryStats.hits << "/" << this->geometryStats.acquires << " shared";
+	return ss.str();
+}
+
+void AssetCache::cleanup()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (!this->textures.empty() || !this->samplers.empty() || !this->geometries.empty())
+		JAS_WARN("Asset cache still has {} textures, {} samplers and {} geometries referenced at cleanup!", this->textures.size(), this->samplers.size(), this->geometries.size());
+
+	for (auto& texture : this->textures) {
+		TextureStreamer::get().removeTexture(&texture.second->texture);
+		texture.second->texture.cleanup();
+		texture.second->memory.cleanup();
+	}
+	for (auto& sampler : this->samplers)
+		sampler.second->sampler.cleanup();
+	this->textures.clear();
+	this->textureKeys.clear();
+	this->samplers.clear();
+	this->samplerKeys.clear();
+	this->geometries.clear();
+}
+
+uint64_t AssetCache::hash(const void* data, size_t size, uint64_t seed)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t result = seed;
+	for (size_t i = 0; i < size; i++)
+		result = (result ^ bytes[i]) * 1099511628211ull;
+	return result;
+}
+
+uint64_t AssetCache::getTextureKey(uint64_t hash, uint32_t width, uint32_t height, VkFormat format)
+{
+	uint32_t desc[3] = { width, height, (uint32_t)format };
+	return AssetCache::hash(desc, sizeof(desc), hash);
+}
+
+uint64_t AssetCache::getGeometryKey(uint64_t hash, GeometryArena* arena)
+{
+	return AssetCache::hash(&arena, sizeof(arena), hash);
+}
+
+AssetCache::TextureEntry* AssetCache::findTexture(Texture* texture)
+{
+	auto keyIt = this->textureKeys.find(texture);
+	if (keyIt == this->textureKeys.end())
+		return nullptr;
+	return this->textures[keyIt->second].get();
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include "jaspch.h"
+
+#include "Vulkan/Texture.h"
+#include "Vulkan/Sampler.h"
+#include "Vulkan/Buffers/Memory.h"
+#include "Vulkan/Buffers/GeometryArena.h"
+
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+
+/*
+	Content addressed store for the GPU resources of models, shared by every model and node that uses the same data.
+	Textures are keyed by a hash of their source bytes and size, samplers by their filters and wrap modes and arena
+	geometry by a hash of the packed vertices and indices. Every acquire adds a reference and has to be matched by a release,
+	a resource is destroyed when its last reference is released.
+	A texture is only uploaded once, isUploaded tells the loader whether a shared texture still needs its data.
+	Textures get a full mip chain when TEXTURE_MIPMAPS is set. Block compressed textures have every level uploaded,
+	for the others only level 0 is uploaded and the rest is generated on the GPU. Block compressed textures larger than
+	TEXTURE_STREAMING_TAIL_SIZE are created with only their mip tail and registered with the TextureStreamer.
+*/
+class AssetCache
+{
+public:
+	static const uint64_t HASH_SEED = 14695981039346656037ull;
+
+public:
+	~AssetCache();
+
+	static AssetCache& get();
+
+	// Creates the texture if it is not in the cache, created is then true and the data has to be uploaded before use
+	Texture* acquireTexture(uint64_t hash, uint32_t width, uint32_t height, VkFormat format, bool& created);
+	void releaseTexture(Texture* texture);
+	// True if a texture with the hash and size is in the cache and its data is on the GPU
+	bool isResident(uint64_t hash, uint32_t width, uint32_t height, VkFormat format);
+	bool isUploaded(Texture* texture);
+	void setUploaded(Texture* texture);
+	// The hash the texture was acquired with
+	uint64_t getTextureHash(Texture* texture);
+	// The size the texture was acquired with, larger than the texture when only its mip tail is created
+	VkExtent2D getTextureExtent(Texture* texture);
+
+	Sampler* acquireSampler(VkFilter minFilter, VkFilter magFilter, VkSamplerAddressMode uWrap, VkSamplerAddressMode vWrap);
+	void releaseSampler(Sampler* sampler);
+
+	// Returns true and the allocation if the geometry is already in the arena, a reference is added
+	bool acquireGeometry(uint64_t hash, GeometryArena* arena, GeometryArena::Handle& handle);
+	// Registers a new allocation with one reference
+	void addGeometry(uint64_t hash, GeometryArena* arena, GeometryArena::Handle handle);
+	// Returns true when the last reference was released, the caller frees the allocation in the arena
+	bool releaseGeometry(uint64_t hash, GeometryArena* arena);
+
+	// Acquires and how many of them were shared, per resource type
+	std::string getReport();
+
+	// Destroys what is left, resources that were never released are reported
+	void cleanup();
+
+	// 64 bit FNV-1a, chain calls by passing the previous hash as seed
+	static uint64_t hash(const void* data, size_t size, uint64_t seed = HASH_SEED);
+
+private:
+	AssetCache();
+	AssetCache(AssetCache& other) = delete;
+
+	struct TextureEntry
+	{
+		Texture texture;
+		Memory memory;
+		uint64_t hash;
+		uint32_t width;
+		uint32_t height;
+		uint32_t refCount;
+		bool uploaded;
+	};
+
+	struct SamplerEntry
+	{
+		Sampler sampler;
+		uint32_t refCount;
+	};
+
+	struct GeometryEntry
+	{
+		GeometryArena::Handle handle;
+		uint32_t refCount;
+	};
+
+	struct Stats
+	{
+		uint32_t acquires;
+		uint32_t hits;
+	};
+
+	static uint64_t getTextureKey(uint64_t hash, uint32_t width, uint32_t height, VkFormat format);
+	static uint64_t getGeometryKey(uint64_t hash, GeometryArena* arena);
+	TextureEntry* findTexture(Texture* texture);
+
+	std::mutex mutex;
+	std::unordered_map<uint64_t, std::unique_ptr<TextureEntry>> textures;
+	std::unordered_map<Texture*, uint64_t> textureKeys;
+	std::unordered_map<uint64_t, std::unique_ptr<SamplerEntry>> samplers;
+	std::unordered_map<Sampler*, uint64_t> samplerKeys;
+	std::unordered_map<uint64_t, GeometryEntry> geometries;
+	Stats textureStats;
+	Stats samplerStats;
+	Stats geometryStats;
+};
@@ -0,0 +1,175 @@
+#include "jaspch.h"
+#include "DrawList.h"
+#include "Core/CPUProfiler.h"
+
+#include <algorithm>
+
+DrawList::DrawList() : primitiveCount(0)
+{
+}
+
+DrawList::~DrawList()
+{
+}
+
+void DrawList::add(Model* model, const glm::mat4& transform, Pipeline* pipeline)
+{
+	// Pipelines are keyed in the order they were first added
+	auto it = std::find(this->pipelines.begin(), this->pipelines.end(), pipeline);
+	uint32_t pipelineKey = static_cast<uint32_t>(it - this->pipelines.begin());
+	if (it == this->pipelines.end())
+		this->pipelines.push_back(pipeline);
+
+	for (Mesh& mesh : model->meshes)
+		addMesh(model, mesh, transform, pipelineKey, pipeline);
+}
+
+void DrawList::compile()
+{
+	JAS_PROFILER_SAMPLE_FUNCTION();
+	std::stable_sort(this->draws.begin(), this->draws.end(), [](const Draw& a, const Draw& b) { return a.key < b.key; });
+
+	// Merge neighbours which only differ in their indices, they have to follow each other in the index buffer in every level of detail
+	std::vector<Draw> merged;
+	merged.reserve(this->draws.size());
+	for (const Draw& draw : this->draws)
+	{
+		if (!merged.empty())
+		{
+			Draw& last = merged.back();
+			if (last.pipeline == draw.pipeline && last.model == draw.model && last.material == draw.material && last.transformIndex == draw.transformIndex &&
+				last.hasIndices && draw.hasIndices && areContiguous(last, draw))
+			{
+				for (uint32_t level = 0; level < MESH_LOD_COUNT; level++)
+					last.lods[level].indexCount += draw.lods[level].indexCount;
+				last.clusterCount += draw.clusterCount;
+				last.indexCount += draw.indexCount;
+				continue;
+			}
+		}
+		merged.push_back(draw);
+	}
+	this->draws = std::move(merged);
+
+	for (size_t i = 0; i < this->draws.size(); i++)
+	{
+		Draw& draw = this->draws[i];
+		if (i == 0) {
+			draw.changes = CHANGE_ALL;
+			continue;
+		}
+		const Draw& prev = this->draws[i - 1];
+		draw.changes = 0;
+		draw.changes |= prev.pipeline != draw.pipeline ? (uint32_t)CHANGE_PIPELINE : 0u;
+		draw.changes |= prev.material != draw.material ? (uint32_t)CHANGE_MATERIAL : 0u;
+		draw.changes |= prev.transformIndex != draw.transformIndex ? (uint32_t)CHANGE_TRANSFORM : 0u;
+	}
+
+	JAS_INFO("Compiled draw list: {} primitives into {} draws", this->primitiveCount, this->draws.size());
+}
+
+void DrawList::clear()
+{
+	this->draws.clear();
+	this->transforms.clear();
+	this->pipelines.clear();
+	this->primitiveCount = 0;
+}
+
+DrawList::Range DrawList::getRange(uint32_t partIndex, uint32_t partCount) const
+{
+	uint32_t drawCount = static_cast<uint32_t>(this->draws.size());
+	Range range;
+	range.first = drawCount * partIndex / partCount;
+	range.count = drawCount * (partIndex + 1) / partCount - range.first;
+	return range;
+}
+
+void DrawList::writeIndirectCommands(VkDrawIndexedIndirectCommand* commands, uint32_t instanceCount, uint32_t firstInstance, uint32_t lod) const
+{
+	lod = std::min(lod, (uint32_t)MESH_LOD_COUNT - 1);
+	for (size_t i = 0; i < this->draws.size(); i++)
+	{
+		const Draw& draw = this->draws[i];
+		commands[i].indexCount = draw.hasIndices ? draw.lods[lod].indexCount : 0;
+		commands[i].instanceCount = instanceCount;
+		commands[i].firstIndex = draw.model->getFirstIndex() + draw.lods[lod].firstIndex;
+		commands[i].vertexOffset = draw.model->getVertexOffset();
+		commands[i].firstInstance = firstInstance;
+	}
+}
+
+std::vector<DrawList::IndirectData> DrawList::getIndirectData() const
+{
+	std::vector<IndirectData> data(this->draws.size());
+	for (size_t i = 0; i < this->draws.size(); i++)
+	{
+		data[i].transformIndex = this->draws[i].transformIndex;
+		data[i].materialIndex = this->draws[i].material->index;
+	}
+	return data;
+}
+
+std::vector<DrawList::IndirectCluster> DrawList::getClusterData() const
+{
+	std::vector<IndirectCluster> data;
+	for (size_t i = 0; i < this->draws.size(); i++)
+	{
+		const Draw& draw = this->draws[i];
+		if (!draw.hasIndices)
+			continue;
+		if (draw.clusterCount == 0)
+			return {};
+		const std::vector<Cluster>& clusters = draw.model->clusters;
+		for (uint32_t c = draw.firstCluster; c < draw.firstCluster + draw.clusterCount; c++)
+		{
+			IndirectCluster cluster;
+			cluster.sphere = clusters[c].sphere;
+			cluster.cone = clusters[c].cone;
+			cluster.firstIndex = draw.model->getFirstIndex() + clusters[c].firstIndex;
+			cluster.indexCount = clusters[c].indexCount;
+			cluster.drawIndex = static_cast<uint32_t>(i);
+			cluster.vertexOffset = draw.model->getVertexOffset();
+			data.push_back(cluster);
+		}
+	}
+	return data;
+}
+
+bool DrawList::areContiguous(const Draw& first, const Draw& second)
+{
+	if (first.firstCluster + first.clusterCount != second.firstCluster)
+		return false;
+	for (uint32_t level = 0; level < MESH_LOD_COUNT; level++)
+		if (first.lods[level].firstIndex + first.lods[level].indexCount != second.lods[level].firstIndex)
+			return false;
+	return true;
+}
+
+void DrawList::addMesh(Model* model, Mesh& mesh, const glm::mat4& transform, uint32_t pipelineKey, Pipeline* pipeline)
+{
+	// Same transform as ModelRenderer::drawMesh
+	uint32_t transformIndex = static_cast<uint32_t>(this->transforms.size());
+	this->transforms.push_back(transform * model->sceneGraph.getWorldMatrix(mesh.node) * model->dequantization);
+
+	for (Primitive& primitive : mesh.primitives)
+	{
+		Draw draw = {};
+		// Every added mesh has its own transform index, so it is the mesh part of the key. The stable sort keeps the primitives of a mesh in order
+		draw.key = ((uint64_t)(pipelineKey & 0xFFFF) << 48) | ((uint64_t)(primitive.material->index & 0xFFFF) << 32) | transformIndex;
+		draw.pipeline = pipeline;
+		draw.model = model;
+		draw.material = primitive.material;
+		draw.transformIndex = transformIndex;
+		draw.firstIndex = primitive.firstIndex;
+		draw.indexCount = primitive.indexCount;
+		draw.vertexCount = primitive.vertexCount;
+		draw.hasIndices = primitive.hasIndices;
+		for (uint32_t level = 0; level < MESH_LOD_COUNT; level++)
+			draw.lods[level] = primitive.getLod(level);
+		draw.firstCluster = primitive.firstCluster;
+		draw.clusterCount = primitive.clusterCount;
+		this->draws.push_back(draw);
+		this->primitiveCount++;
+	}
+}
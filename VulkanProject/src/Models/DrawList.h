@@ -0,0 +1,103 @@
+#pragma once
+
+#include "jaspch.h"
+#include "Models/Model/Model.h"
+
+#include <array>
+
+class Pipeline;
+
+/*
+	Models flattened into a sorted array of draws, built once and replayed every frame with ModelRenderer::recordDrawList.
+	Draws are sorted on pipeline, material and mesh, where the mesh is its transform index since every added mesh gets its own. Neighbouring primitives with the same state and
+	contiguous indices are merged into one draw, and each draw stores which state differs from the draw before it.
+	The list is read only after compile, threads can record disjoint ranges of it at the same time.
+	For multi draw indirect the draws are written as indirect commands, with per draw data indexed by gl_DrawIDARB.
+	Only indexed draws can be drawn indirectly, other draws get an empty command.
+	Every draw keeps the index range of each level of detail of its primitives, so one level of the whole list can be written as commands.
+	The full detail level of a draw is also covered by the clusters of its primitives, which a culling pass can draw one by one.
+*/
+class DrawList
+{
+public:
+	enum Change : uint32_t
+	{
+		CHANGE_PIPELINE = 1,
+		CHANGE_MATERIAL = 2,
+		CHANGE_TRANSFORM = 4,
+		CHANGE_ALL = CHANGE_PIPELINE | CHANGE_MATERIAL | CHANGE_TRANSFORM
+	};
+
+	struct Draw
+	{
+		uint64_t key;
+		Pipeline* pipeline;
+		Model* model;
+		Material* material;
+		uint32_t transformIndex;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		uint32_t vertexCount;
+		bool hasIndices;
+		uint32_t changes;
+		std::array<PrimitiveLod, MESH_LOD_COUNT> lods; // Level 0 is firstIndex and indexCount, levels the primitive lacks repeat its coarsest
+		uint32_t firstCluster; // Clusters in the model's clusters, zero when the primitives have none
+		uint32_t clusterCount;
+	};
+
+	// Per draw data for indirect drawing, matches DrawData in modelIndirectVertex.glsl
+	struct IndirectData
+	{
+		uint32_t transformIndex;
+		uint32_t materialIndex;
+	};
+
+	// One cluster of a draw for the culling pass, matches Cluster in clusterCull.glsl
+	struct IndirectCluster
+	{
+		glm::vec4 sphere;
+		glm::vec4 cone;
+		uint32_t firstIndex; // In the index buffer the model is drawn from
+		uint32_t indexCount;
+		uint32_t drawIndex;
+		int32_t vertexOffset;
+	};
+
+	struct Range
+	{
+		uint32_t first;
+		uint32_t count;
+	};
+
+public:
+	DrawList();
+	~DrawList();
+
+	// Adds every primitive of the model, the list needs to be compiled again after this
+	void add(Model* model, const glm::mat4& transform, Pipeline* pipeline);
+	void compile();
+	void clear();
+
+	// Part partIndex of partCount roughly equal ranges, used to split the recording over threads
+	Range getRange(uint32_t partIndex, uint32_t partCount) const;
+
+	// Writes one command per draw, in draw order, drawing level of detail lod of instances [firstInstance, firstInstance + instanceCount)
+	void writeIndirectCommands(VkDrawIndexedIndirectCommand* commands, uint32_t instanceCount, uint32_t firstInstance = 0, uint32_t lod = 0) const;
+	std::vector<IndirectData> getIndirectData() const;
+	// Clusters of every draw in draw order, empty when a draw with indices has no clusters
+	std::vector<IndirectCluster> getClusterData() const;
+
+	const std::vector<Draw>& getDraws() const { return this->draws; }
+	const std::vector<glm::mat4>& getTransforms() const { return this->transforms; }
+	uint32_t getPrimitiveCount() const { return this->primitiveCount; }
+
+private:
+	// second follows first in the index buffer in every level of detail and in the clusters
+	static bool areContiguous(const Draw& first, const Draw& second);
+	void addMesh(Model* model, Mesh& mesh, const glm::mat4& transform, uint32_t pipelineKey, Pipeline* pipeline);
+
+	std::vector<Draw> draws;
+	std::vector<glm::mat4> transforms;
+	std::vector<Pipeline*> pipelines;
+	uint32_t primitiveCount;
+};
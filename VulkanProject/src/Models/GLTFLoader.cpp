@@ -14,11 +14,21 @@
 #include "Vulkan/Pipeline/DescriptorManager.h"
 
 #include "Vulkan/Instance.h"
+#include "Models/MeshOptimizer.h"
+#include "Models/ModelCache.h"
+#include "Models/AccessorReader.h"
+#include "Models/AssetCache.h"
+#include "Models/TextureCompressor.h"
+#include "Core/MappedFile.h"
+#include "Core/CPUProfiler.h"
 
 #include <glm/gtc/matrix_transform.hpp> // translate() and scale()
 #include <glm/gtx/quaternion.hpp>		// toMat4()
 #include <glm/gtx/rotate_vector.hpp>
 #include <glm/gtc/type_ptr.hpp>			// make_vec3(), make_mat4()
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
 
 Model GLTFLoader::model = Model();
 tinygltf::TinyGLTF GLTFLoader::loader = tinygltf::TinyGLTF();
@@ -26,20 +36,20 @@ GLTFLoader::DefaultData GLTFLoader::defaultData;
 
 void GLTFLoader::initDefaultData(CommandPool* transferCommandPool)
 {
-	// Default 1x1 white texture
-	{
-		Texture& texture = defaultData.texture;
-		Memory& memory = defaultData.memory;
+	// Sampler
+	defaultData.sampler = AssetCache::get().acquireSampler(VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_SAMPLER_ADDRESS_MODE_REPEAT);
 
+	// Default 1x1 white texture, in the asset cache like the model textures
+	{
 		uint32_t w = 1, h = 1;
 		uint8_t pixel[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
 		VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
 
-		// Setup the device texture.
-		texture.init(w, h, format, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, { Instance::get().getGraphicsQueue().queueIndex }, 0, 1);
-		memory.bindTexture(&texture);
-		memory.init(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		texture.getImageView().init(texture.getVkImage(), VK_IMAGE_VIEW_TYPE_2D, format, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+		bool created = false;
+		defaultData.texture = AssetCache::get().acquireTexture(AssetCache::hash(pixel, sizeof(pixel)), w, h, format, created);
+		Texture& texture = *defaultData.texture;
+		if (!created)
+			return;
 
 		// Setup staging buffer and memory.
 		Buffer stagingBuffer;
@@ -72,26 +82,22 @@ void GLTFLoader::initDefaultData(CommandPool* transferCommandPool)
 		Image& image = texture.getImage();
 		image.transistionLayout(desc);
 		image.copyBufferToImage(&stagingBuffer, transferCommandPool, bufferCopyRegions);
-		desc.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		desc.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		image.transistionLayout(desc);
+		CommandBuffer* cbuff = transferCommandPool->beginSingleTimeCommand();
+		image.generateMipmaps(cbuff);
+		transferCommandPool->endSingleTimeCommand(cbuff);
+		AssetCache::get().setUploaded(&texture);
 
 		stagingBuffer.cleanup();
 		stagingMemory.cleanup();
 	}
-
-	// Sampler
-	{
-		Sampler& sampler = defaultData.sampler;
-		sampler.init(VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_SAMPLER_ADDRESS_MODE_REPEAT);
-	}
 }
 
 void GLTFLoader::cleanupDefaultData()
 {
-	defaultData.texture.cleanup();
-	defaultData.sampler.cleanup();
-	defaultData.memory.cleanup();
+	AssetCache::get().releaseTexture(defaultData.texture);
+	AssetCache::get().releaseSampler(defaultData.sampler);
+	defaultData.texture = nullptr;
+	defaultData.sampler = nullptr;
 }
 
 void GLTFLoader::load(const std::string& filePath, Model* model)
@@ -106,57 +112,12 @@ void GLTFLoader::prepareStagingBuffer(const std::string& filePath, Model* model,
 
 void GLTFLoader::transferToModel(CommandPool* transferCommandPool, Model* model, StagingBuffers* stagingBuffers)
 {
-	// Transfer all images their coresponding textures
-	uint32_t totalTextureSize = 0;
-	for(uint32_t textureIndex = 0; textureIndex < model->textures.size(); textureIndex++)
-	{
-		Texture& texture = model->textures[textureIndex];
-		const uint32_t wh = texture.getWidth() * texture.getHeight();
-		const uint64_t size = wh * 4;
-		totalTextureSize += size;
-
-		// Transfer the data to the buffer.
-		std::vector<uint8_t> data = model->imageData[textureIndex];
-		uint8_t * img = data.data();
-		stagingBuffers->imageMemory.directTransfer(&stagingBuffers->imageBuffer, (void*)img, size, textureIndex * size);
-
-		// Setup a buffer copy region for the transfer.
-		std::vector<VkBufferImageCopy> bufferCopyRegions;
-		VkBufferImageCopy bufferCopyRegion = {};
-		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		bufferCopyRegion.imageSubresource.mipLevel = 0;
-		bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-		bufferCopyRegion.imageSubresource.layerCount = 1;
-		bufferCopyRegion.imageExtent.width = texture.getWidth();
-		bufferCopyRegion.imageExtent.height = texture.getHeight();
-		bufferCopyRegion.imageExtent.depth = 1;
-		bufferCopyRegion.bufferOffset = textureIndex * size;
-		bufferCopyRegions.push_back(bufferCopyRegion);
-
-		// Transfer data to texture memory.
-		Image::TransistionDesc desc;
-		desc.format = texture.getFormat();
-		desc.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		desc.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		desc.pool = transferCommandPool;
-		desc.layerCount = 1;
-		Image& image = texture.getImage();
-		image.transistionLayout(desc);
-		image.copyBufferToImage(&stagingBuffers->imageBuffer, transferCommandPool, bufferCopyRegions);
-		desc.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		desc.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		image.transistionLayout(desc);
-	}
-	model->imageData.clear();
-
-	// Transfer data to buffers
-	uint32_t indicesSize = (uint32_t)(model->indices.size() * sizeof(uint32_t));
-	uint32_t verticesSize = (uint32_t)(model->vertices.size() * sizeof(Vertex));
-	if (indicesSize > 0)
-		stagingBuffers->geometryMemory.directTransfer(&stagingBuffers->geometryBuffer, (const void*)model->indices.data(), indicesSize, (Offset)0);
-	stagingBuffers->geometryMemory.directTransfer(&stagingBuffers->imageBuffer, (const void*)model->vertices.data(), verticesSize, (Offset)indicesSize);
+	transferTextures(transferCommandPool, model, stagingBuffers);
+	stageGeometry(model, stagingBuffers);
 
 	// Create memory and buffers.
+	uint32_t indicesSize = (uint32_t)(model->indices.size() * sizeof(uint32_t));
+	uint32_t verticesSize = (uint32_t)(model->packedVertices.size() * sizeof(PackedVertex));
 	std::vector<uint32_t> queueIndices = { findQueueIndex(VK_QUEUE_TRANSFER_BIT, Instance::get().getPhysicalDevice()) };
 	if (indicesSize > 0)
 	{
@@ -193,7 +154,118 @@ void GLTFLoader::transferToModel(CommandPool* transferCommandPool, Model* model,
 	transferCommandPool->endSingleTimeCommand(cbuff);
 }
 
-void GLTFLoader::recordDraw(Model* model, CommandBuffer* commandBuffer, Pipeline* pipeline, const std::vector<VkDescriptorSet>& sets, const std::vector<uint32_t>& offsets)
+void GLTFLoader::transferToArena(CommandPool* transferCommandPool, Model* model, StagingBuffers* stagingBuffers, GeometryArena* arena)
+{
+	transferTextures(transferCommandPool, model, stagingBuffers);
+
+	// Models with the same packed geometry share one allocation
+	uint32_t indexCount = static_cast<uint32_t>(model->indices.size());
+	uint32_t vertexCount = static_cast<uint32_t>(model->packedVertices.size());
+	model->geometryHash = AssetCache::hash(model->indices.data(), model->indices.size() * sizeof(uint32_t));
+	model->geometryHash = AssetCache::hash(model->packedVertices.data(), model->packedVertices.size() * sizeof(PackedVertex), model->geometryHash);
+	model->arena = arena;
+	if (AssetCache::get().acquireGeometry(model->geometryHash, arena, model->geometry))
+		return;
+
+	stageGeometry(model, stagingBuffers);
+	if (!arena->allocate(vertexCount, indexCount, model->geometry))
+		throw std::runtime_error("Geometry arena is full!");
+	AssetCache::get().addGeometry(model->geometryHash, arena, model->geometry);
+
+	// Indices are first in the staging buffer, followed by the vertices
+	arena->upload(transferCommandPool, model->geometry, stagingBuffers->geometryBuffer.getBuffer(), (VkDeviceSize)indexCount * sizeof(uint32_t), 0);
+}
+
+void GLTFLoader::transferTextures(CommandPool* transferCommandPool, Model* model, StagingBuffers* stagingBuffers)
+{
+	// Shared textures are uploaded by the first model using them, the rest only reference them
+	std::vector<Texture*> uploads;
+	std::vector<VkBufferImageCopy> bufferCopyRegions;
+	std::vector<size_t> firstRegions;
+	uint64_t offset = 0;
+	for(uint32_t textureIndex = 0; textureIndex < model->textures.size(); textureIndex++)
+	{
+		Texture* texture = model->textures[textureIndex];
+		const std::vector<uint8_t>& data = model->imageData[textureIndex];
+		if (data.empty() || AssetCache::get().isUploaded(texture) || std::find(uploads.begin(), uploads.end(), texture) != uploads.end())
+			continue;
+		const uint64_t size = getStagingSize(texture);
+
+		// Transfer the data to the buffer. A streamed texture only has its mip tail, the last levels of the chain
+		const uint64_t stagedSize = std::min(size, (uint64_t)data.size());
+		stagingBuffers->imageMemory.directTransfer(&stagingBuffers->imageBuffer, (const void*)(data.data() + data.size() - stagedSize), stagedSize, offset);
+
+		// Setup a buffer copy region for each staged level.
+		const bool compressed = TextureCompressor::isCompressed(texture->getFormat());
+		const uint32_t levelCount = compressed ? texture->getMipLevels() : 1;
+		firstRegions.push_back(bufferCopyRegions.size());
+		uint64_t levelOffset = offset;
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			uint32_t width = std::max(texture->getWidth() >> level, 1u);
+			uint32_t height = std::max(texture->getHeight() >> level, 1u);
+			VkBufferImageCopy bufferCopyRegion = {};
+			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			bufferCopyRegion.imageSubresource.mipLevel = level;
+			bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+			bufferCopyRegion.imageSubresource.layerCount = 1;
+			bufferCopyRegion.imageExtent.width = width;
+			bufferCopyRegion.imageExtent.height = height;
+			bufferCopyRegion.imageExtent.depth = 1;
+			bufferCopyRegion.bufferOffset = levelOffset;
+			bufferCopyRegions.push_back(bufferCopyRegion);
+			levelOffset += TextureCompressor::getLevelSize(texture->getFormat(), width, height);
+		}
+		uploads.push_back(texture);
+		offset += size;
+	}
+	firstRegions.push_back(bufferCopyRegions.size());
+
+	if (!uploads.empty())
+	{
+		// Stage every image after each other, then record all transitions and copies in one submit
+		CommandBuffer* cbuff = transferCommandPool->beginSingleTimeCommand();
+		Image::TransistionDesc desc;
+		desc.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		desc.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		desc.pool = transferCommandPool;
+		desc.layerCount = 1;
+		for (Texture* texture : uploads) {
+			desc.format = texture->getFormat();
+			texture->getImage().transistionLayout(cbuff, desc);
+		}
+		for (size_t i = 0; i < uploads.size(); i++)
+			uploads[i]->getImage().copyBufferToImage(cbuff, &stagingBuffers->imageBuffer, Span<VkBufferImageCopy>(&bufferCopyRegions[firstRegions[i]], firstRegions[i + 1] - firstRegions[i]));
+		// Block compressed textures have every level staged, for the others the blit chains fill the levels after the first
+		desc.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		desc.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		for (Texture* texture : uploads) {
+			desc.format = texture->getFormat();
+			if (TextureCompressor::isCompressed(texture->getFormat()))
+				texture->getImage().transistionLayout(cbuff, desc);
+			else
+				texture->getImage().generateMipmaps(cbuff);
+		}
+		transferCommandPool->endSingleTimeCommand(cbuff);
+
+		for (Texture* texture : uploads)
+			AssetCache::get().setUploaded(texture);
+	}
+
+	model->imageData.clear();
+}
+
+void GLTFLoader::stageGeometry(Model* model, StagingBuffers* stagingBuffers)
+{
+	// Transfer data to buffers
+	uint32_t indicesSize = (uint32_t)(model->indices.size() * sizeof(uint32_t));
+	uint32_t verticesSize = (uint32_t)(model->packedVertices.size() * sizeof(PackedVertex));
+	if (indicesSize > 0)
+		stagingBuffers->geometryMemory.directTransfer(&stagingBuffers->geometryBuffer, (const void*)model->indices.data(), indicesSize, (Offset)0);
+	stagingBuffers->geometryMemory.directTransfer(&stagingBuffers->geometryBuffer, (const void*)model->packedVertices.data(), verticesSize, (Offset)indicesSize);
+}
+
+void GLTFLoader::recordDraw(Model* model, CommandBuffer* commandBuffer, Pipeline* pipeline, Span<VkDescriptorSet> sets, Span<uint32_t> offsets)
 {
 	// TODO: Use different materials, can still use same pipeline if all meshes uses same type of material (i.e. PBR)!
 	if (model->vertexBuffer.getBuffer() == VK_NULL_HANDLE)
@@ -206,8 +278,8 @@ void GLTFLoader::recordDraw(Model* model, CommandBuffer* commandBuffer, Pipeline
 		commandBuffer->cmdBindIndexBuffer(model->indexBuffer.getBuffer(), 0, VK_INDEX_TYPE_UINT32);
 
 	commandBuffer->cmdBindDescriptorSets(pipeline, 0, sets, offsets);
-	for (Model::Node& node : model->nodes)
-		drawNode(pipeline, commandBuffer, node);
+	for (Mesh& mesh : model->meshes)
+		drawMesh(commandBuffer, mesh);
 }
 
 void GLTFLoader::loadModel(Model& model, const std::string& filePath)
@@ -244,35 +316,32 @@ void GLTFLoader::loadTextures(std::string& folderPath, Model& model, tinygltf::M
 {
 	JAS_INFO("Textures:");
 	if (gltfModel.textures.empty()) JAS_INFO(" ->No textures");
-	else model.hasImageMemory = true;
 
 	model.imageData.resize(gltfModel.textures.size());
-	model.textures.resize(gltfModel.textures.size());
-	VkFormat format = VK_FORMAT_R8G8B8A8_UNORM; // Assume all have the same layout. (loadImageData will force them to have 4 components, each being one byte)
+	std::vector<VkExtent2D> extents(gltfModel.textures.size());
+	std::vector<VkFormat> formats(gltfModel.textures.size());
+	std::vector<uint64_t> hashes(gltfModel.textures.size());
+	std::vector<TextureCompressor::Usage> usages = getTextureUsages(gltfModel);
 	for (size_t textureIndex = 0; textureIndex < gltfModel.textures.size(); textureIndex++)
 	{
 		tinygltf::Texture& textureGltf = gltfModel.textures[textureIndex];
 		tinygltf::Image& image = gltfModel.images[textureGltf.source];
 		JAS_INFO(" ->[{0}] name: {1} uri: {2} bits: {3} comp: {4} w: {5} h: {6}", textureIndex, textureGltf.name.c_str(), image.uri.c_str(), image.bits, image.component, image.width, image.height);
 
-		loadImageData(folderPath, image, gltfModel, model.imageData[textureIndex]);
-
-		Texture& texture = model.textures[textureIndex];
-		texture.init(image.width, image.height, format, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, { Instance::get().getGraphicsQueue().queueIndex }, 0, 1);
-		model.imageMemory.bindTexture(&texture);
-
+		// Still decoded when the texture is shared, the model cache file needs every image
+		std::vector<uint8_t>& data = model.imageData[textureIndex];
+		loadImageData(folderPath, image, gltfModel, data);
+		extents[textureIndex] = { (uint32_t)image.width, (uint32_t)image.height };
+		hashes[textureIndex] = hashImageSource(folderPath, image, gltfModel);
+
+		// The block compressed chain replaces the decoded image, it stays RGBA8 when the device can not sample it
+		std::vector<uint8_t> compressed;
+		formats[textureIndex] = TextureCompressor::transcode(hashes[textureIndex], usages[textureIndex], { data.data() }, extents[textureIndex].width, extents[textureIndex].height, compressed);
+		if (TextureCompressor::isCompressed(formats[textureIndex]))
+			data.swap(compressed);
 	}
-	model.imageMemory.init(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	for (Texture& texture : model.textures)
-		texture.getImageView().init(texture.getVkImage(), VK_IMAGE_VIEW_TYPE_2D, format, VK_IMAGE_ASPECT_COLOR_BIT, 1);
-
-	uint64_t textureSize = 0;
-	for (Texture& texture : model.textures)
-		textureSize += texture.getWidth() * texture.getHeight() * 4;
-	stagingBuffers->imageBuffer.init(textureSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, {Instance::get().getGraphicsQueue().queueIndex });
-	stagingBuffers->imageMemory.bindBuffer(&stagingBuffers->imageBuffer);
+	createTextures(model, extents, formats, hashes, stagingBuffers);
 
-	// TODO: Load all samplers into memory and index them when needed.
 	JAS_INFO("Samplers:");
 	if (gltfModel.samplers.empty()) JAS_INFO(" ->No samplers");
 	model.samplers.resize(gltfModel.samplers.size());
@@ -280,10 +349,76 @@ void GLTFLoader::loadTextures(std::string& folderPath, Model& model, tinygltf::M
 	{
 		tinygltf::Sampler& samplerGltf = gltfModel.samplers[samplerIndex];
 		JAS_INFO(" ->[{0}] name: {1} magFilter: {2}, minFilter: {3}", samplerIndex, samplerGltf.name.c_str(), samplerGltf.magFilter, samplerGltf.minFilter);
-		
-		Sampler& sampler = model.samplers[samplerIndex];
-		loadSamplerData(samplerGltf, sampler);
+		model.samplers[samplerIndex] = loadSamplerData(samplerGltf);
+	}
+}
+
+void GLTFLoader::createTextures(Model& model, const std::vector<VkExtent2D>& extents, const std::vector<VkFormat>& formats, const std::vector<uint64_t>& hashes, StagingBuffers* stagingBuffers)
+{
+	model.textures.resize(extents.size());
+	for (size_t textureIndex = 0; textureIndex < extents.size(); textureIndex++)
+	{
+		bool created = false;
+		model.textures[textureIndex] = AssetCache::get().acquireTexture(hashes[textureIndex], extents[textureIndex].width, extents[textureIndex].height, formats[textureIndex], created);
 	}
+	createImageStaging(model, stagingBuffers);
+}
+
+std::vector<TextureCompressor::Usage> GLTFLoader::getTextureUsages(const tinygltf::Model& gltfModel)
+{
+	// Normal maps take precedence, they suffer most from a color format. Textures no material uses stay color
+	std::vector<TextureCompressor::Usage> usages(gltfModel.textures.size(), TextureCompressor::Usage::COLOR);
+	auto setUsage = [&usages](int index, TextureCompressor::Usage usage) {
+		if (index >= 0 && index < (int)usages.size() && usages[index] != TextureCompressor::Usage::NORMAL)
+			usages[index] = usage;
+	};
+	for (const tinygltf::Material& material : gltfModel.materials)
+	{
+		setUsage(material.normalTexture.index, TextureCompressor::Usage::NORMAL);
+		setUsage(material.pbrMetallicRoughness.metallicRoughnessTexture.index, TextureCompressor::Usage::DATA);
+		setUsage(material.occlusionTexture.index, TextureCompressor::Usage::DATA);
+	}
+	return usages;
+}
+
+void GLTFLoader::createImageStaging(Model& model, StagingBuffers* stagingBuffers)
+{
+	// Only textures that are not on the GPU yet need staging space, once even if the model uses them twice
+	uint64_t textureSize = 0;
+	std::vector<Texture*> staged;
+	for (Texture* texture : model.textures)
+		if (!AssetCache::get().isUploaded(texture) && std::find(staged.begin(), staged.end(), texture) == staged.end()) {
+			staged.push_back(texture);
+			textureSize += getStagingSize(texture);
+		}
+
+	if (stagingBuffers == nullptr || textureSize == 0)
+		return;
+	stagingBuffers->imageBuffer.init(textureSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, {Instance::get().getGraphicsQueue().queueIndex });
+	stagingBuffers->imageMemory.bindBuffer(&stagingBuffers->imageBuffer);
+}
+
+uint64_t GLTFLoader::getStagingSize(Texture* texture)
+{
+	if (TextureCompressor::isCompressed(texture->getFormat()))
+		return TextureCompressor::getChainSize(texture->getFormat(), texture->getWidth(), texture->getHeight(), 1, texture->getMipLevels());
+	return (uint64_t)texture->getWidth() * texture->getHeight() * 4;
+}
+
+uint64_t GLTFLoader::hashImageSource(std::string& folderPath, tinygltf::Image& image, tinygltf::Model& gltfModel)
+{
+	// The encoded bytes are the identity, the same file used by several models or under several names is one texture
+	if (!image.uri.empty())
+	{
+		MappedFile file;
+		if (file.open(folderPath + image.uri))
+			return AssetCache::hash(file.getData(), (size_t)file.getSize());
+		return AssetCache::hash(image.uri.data(), image.uri.size());
+	}
+
+	tinygltf::BufferView& view = gltfModel.bufferViews[image.bufferView];
+	tinygltf::Buffer& buffer = gltfModel.buffers[view.buffer];
+	return AssetCache::hash(buffer.data.data() + view.byteOffset, view.byteLength);
 }
 
 void GLTFLoader::loadImageData(std::string& folderPath, tinygltf::Image& image, tinygltf::Model& gltfModel, std::vector<uint8_t>& data)
@@ -331,9 +466,13 @@ void GLTFLoader::loadImageData(std::string& folderPath, tinygltf::Image& image,
 			delete[] imgData;
 		}
 	}
+
+	// A texture that failed to load is white instead of undefined
+	if (data.empty())
+		data.assign(size, 0xFF);
 }
 
-void GLTFLoader::loadSamplerData(tinygltf::Sampler& samplerGltf, Sampler& sampler)
+Sampler* GLTFLoader::loadSamplerData(tinygltf::Sampler& samplerGltf)
 {
 	VkFilter minFilter = VK_FILTER_NEAREST;
 	switch (samplerGltf.minFilter)
@@ -385,7 +524,7 @@ void GLTFLoader::loadSamplerData(tinygltf::Sampler& samplerGltf, Sampler& sample
 		vWrap = VK_SAMPLER_ADDRESS_MODE_REPEAT;
 		break;
 	}
-	sampler.init(minFilter, magFilter, uWrap, vWrap);
+	return AssetCache::get().acquireSampler(minFilter, magFilter, uWrap, vWrap);
 }
 
 void GLTFLoader::loadMaterials(Model& model, tinygltf::Model& gltfModel)
@@ -420,6 +559,7 @@ void GLTFLoader::loadMaterials(Model& model, tinygltf::Model& gltfModel)
 		// Construct material structure.
 		Material& material = model.materials[materialIndex];
 		material.index = materialIndex;
+		material.pushData.materialIndex = (int)materialIndex;
 		/*material.pbrMR.metallicFactor = (float)pbrMR.metallicFactor;
 		material.pbrMR.roughnessFactor = (float)pbrMR.roughnessFactor;
 		material.pbrMR.baseColorTexture.index = baseColorTexture.index;
@@ -439,8 +579,8 @@ void GLTFLoader::loadMaterials(Model& model, tinygltf::Model& gltfModel)
 		*/
 
 		auto getTex = [&](int index)->Material::Tex {
-			Texture* texture = index != -1 ? &model.textures[index] : &defaultData.texture;
-			Sampler* sampler = (index != -1 && gltfModel.textures[index].sampler != -1) ? &model.samplers[gltfModel.textures[index].sampler] : &defaultData.sampler;
+			Texture* texture = index != -1 ? model.textures[index] : defaultData.texture;
+			Sampler* sampler = (index != -1 && gltfModel.textures[index].sampler != -1) ? model.samplers[gltfModel.textures[index].sampler] : defaultData.sampler;
 			return {texture, sampler};
 		};
 		material.baseColorTexture = getTex(baseColorTexture.index);
@@ -464,17 +604,20 @@ void GLTFLoader::loadMaterials(Model& model, tinygltf::Model& gltfModel)
 
 void GLTFLoader::loadScenes(Model& model, tinygltf::Model& gltfModel)
 {
+	reserveGeometry(model, gltfModel);
+	std::unordered_map<int, uint32_t> loadedMeshes;
 	for (auto& scene : gltfModel.scenes)
 	{
 		//JAS_INFO("Scene: {0}", scene.name.c_str());
 		// Load each node in the scene
-		model.nodes.resize(scene.nodes.size());
 		for (size_t nodeIndex = 0; nodeIndex < scene.nodes.size(); nodeIndex++)
 		{
 			tinygltf::Node& node = gltfModel.nodes[scene.nodes[nodeIndex]];
-			loadNode(model, &model.nodes[nodeIndex], gltfModel, node, " ");
+			loadNode(model, SceneGraph::NO_PARENT, gltfModel, node, loadedMeshes, " ");
 		}
 	}
+	model.sceneGraph.update();
+	optimizeGeometry(model);
 
 	// Create vertex and index buffers
 	std::vector<uint32_t> queueIndices = { findQueueIndex(VK_QUEUE_GRAPHICS_BIT, Instance::get().getPhysicalDevice()) };
@@ -485,7 +628,7 @@ void GLTFLoader::loadScenes(Model& model, tinygltf::Model& gltfModel)
 		model.bufferMemory.bindBuffer(&model.indexBuffer);
 	}
 
-	uint32_t verticesSize = (uint32_t)(model.vertices.size() * sizeof(Vertex));
+	uint32_t verticesSize = (uint32_t)(model.packedVertices.size() * sizeof(PackedVertex));
 	model.vertexBuffer.init(verticesSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, queueIndices);
 	model.bufferMemory.bindBuffer(&model.vertexBuffer);
 
@@ -495,59 +638,58 @@ void GLTFLoader::loadScenes(Model& model, tinygltf::Model& gltfModel)
 	// Transfer data to buffers
 	if (indicesSize > 0)
 		model.bufferMemory.directTransfer(&model.indexBuffer, (const void*)model.indices.data(), indicesSize, 0);
-	model.bufferMemory.directTransfer(&model.vertexBuffer, (const void*)model.vertices.data(), verticesSize, 0);
+	model.bufferMemory.directTransfer(&model.vertexBuffer, (const void*)model.packedVertices.data(), verticesSize, 0);
 }
 
-void GLTFLoader::loadNode(Model& model, Model::Node* node, tinygltf::Model& gltfModel, tinygltf::Node& gltfNode, std::string indents)
+void GLTFLoader::loadNode(Model& model, uint32_t parent, tinygltf::Model& gltfModel, tinygltf::Node& gltfNode, std::unordered_map<int, uint32_t>& loadedMeshes, std::string indents)
 {
 	//JAS_INFO("{0}->Node [{1}]", indents.c_str(), gltfNode.name.c_str());
 
-	// Set scale
-	node->model = &model;
-	if (!gltfNode.scale.empty())
-		node->scale = glm::vec3((float)gltfNode.scale[0], (float)gltfNode.scale[1], (float)gltfNode.scale[2]);
-	else node->scale = glm::vec3(1.0f);
-
-	// Set translation
-	if (!gltfNode.translation.empty())
-		node->translation = glm::vec3((float)gltfNode.translation[0], (float)gltfNode.translation[1], (float)gltfNode.translation[2]);
-	else node->translation = glm::vec3(0.0f);
-
-	// Set rotation
-	if (!gltfNode.rotation.empty())
-		node->rotation = glm::quat((float)gltfNode.rotation[3], (float)gltfNode.rotation[0], (float)gltfNode.rotation[1], (float)gltfNode.rotation[2]);
-	else node->rotation = glm::quat();
-	
-	// Compute the matrix
+	// Add the node before its children to keep the scene graph in depth first order
+	uint32_t node;
 	if (!gltfNode.matrix.empty())
-		node->matrix = glm::make_mat4(gltfNode.matrix.data());
-	else 
+		node = model.sceneGraph.addNode(parent, glm::make_mat4(gltfNode.matrix.data()));
+	else
 	{
-		glm::mat4 t = glm::translate(node->translation);
-		glm::mat4 s = glm::scale(node->scale);
-		glm::mat4 r = glm::mat4(node->rotation);
-		node->matrix = t * r * s;
+		glm::vec3 scale = glm::vec3(1.0f);
+		if (!gltfNode.scale.empty())
+			scale = glm::vec3((float)gltfNode.scale[0], (float)gltfNode.scale[1], (float)gltfNode.scale[2]);
+
+		glm::vec3 translation = glm::vec3(0.0f);
+		if (!gltfNode.translation.empty())
+			translation = glm::vec3((float)gltfNode.translation[0], (float)gltfNode.translation[1], (float)gltfNode.translation[2]);
+
+		glm::quat rotation = glm::quat();
+		if (!gltfNode.rotation.empty())
+			rotation = glm::quat((float)gltfNode.rotation[3], (float)gltfNode.rotation[0], (float)gltfNode.rotation[1], (float)gltfNode.rotation[2]);
+
+		node = model.sceneGraph.addNode(parent, translation, rotation, scale);
 	}
 
 	//if (!gltfNode.children.empty())
 	//	JAS_INFO("{0} ->Children:", indents.c_str());
-	node->children.resize(gltfNode.children.size());
 	for (size_t childIndex = 0; childIndex < gltfNode.children.size(); childIndex++)
 	{
-		// Set parent
-		node->children[childIndex].parent = node;
-		// Load child node
 		tinygltf::Node& child = gltfModel.nodes[gltfNode.children[childIndex]];
-		loadNode(model, &node->children[childIndex], gltfModel, child, indents + "  ");
+		loadNode(model, node, gltfModel, child, loadedMeshes, indents + "  ");
 	}
 
-	// Check if it has a mesh
-	node->hasMesh = gltfNode.mesh != -1;
-	if (node->hasMesh)
+	// A mesh used by several nodes is decoded once, the other nodes draw the same index ranges
+	auto loaded = gltfNode.mesh != -1 ? loadedMeshes.find(gltfNode.mesh) : loadedMeshes.end();
+	if (loaded != loadedMeshes.end())
+	{
+		Mesh mesh = model.meshes[loaded->second];
+		mesh.node = node;
+		model.meshes.push_back(std::move(mesh));
+	}
+	else if (gltfNode.mesh != -1)
 	{
-		tinygltf::Mesh gltfMesh = gltfModel.meshes[gltfNode.mesh];
-		Mesh& mesh = node->mesh;
+		loadedMeshes[gltfNode.mesh] = static_cast<uint32_t>(model.meshes.size());
+		const tinygltf::Mesh& gltfMesh = gltfModel.meshes[gltfNode.mesh];
+		model.meshes.emplace_back();
+		Mesh& mesh = model.meshes.back();
 		mesh.name = gltfMesh.name;
+		mesh.node = node;
 		//JAS_INFO("{0} ->Has mesh: {1}", indents.c_str(), mesh.name.c_str());
 
 		mesh.primitives.resize(gltfMesh.primitives.size());
@@ -557,7 +699,7 @@ void GLTFLoader::loadNode(Model& model, Model::Node* node, tinygltf::Model& gltf
 			primitive.firstIndex = static_cast<uint32_t>(model.indices.size());
 			uint32_t vertexStart = static_cast<uint32_t>(model.vertices.size()); // Used for indices.
 
-			tinygltf::Primitive& gltfPrimitive = gltfMesh.primitives[i];
+			const tinygltf::Primitive& gltfPrimitive = gltfMesh.primitives[i];
 			
 			// Material
 			primitive.material = &model.materials[gltfPrimitive.material];
@@ -567,114 +709,291 @@ void GLTFLoader::loadNode(Model& model, Model::Node* node, tinygltf::Model& gltf
 			if(primitive.hasIndices)
 			{
 				//JAS_INFO("{0}  ->Has indices", indents.c_str());
-				tinygltf::Accessor& indAccessor = gltfModel.accessors[gltfPrimitive.indices];
-				tinygltf::BufferView& indBufferView = gltfModel.bufferViews[indAccessor.bufferView];
-				tinygltf::Buffer& indBuffer = gltfModel.buffers[indBufferView.buffer];
-
+				const tinygltf::Accessor& indAccessor = gltfModel.accessors[gltfPrimitive.indices];
 				primitive.indexCount = static_cast<uint32_t>(indAccessor.count);
-				const void* dataPtr = &indBuffer.data.at(0) + indBufferView.byteOffset;
-				for (size_t c = 0; c < indAccessor.count; c++)
-				{
-					switch (indAccessor.componentType)
-					{
-					case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
-					{
-						const uint8_t* data = static_cast<const uint8_t*>(dataPtr);
-						model.indices.push_back(data[c] + vertexStart);
-					}
-					break;
-					case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
-					{
-						const uint16_t* data = static_cast<const uint16_t*>(dataPtr);
-						model.indices.push_back(data[c] + vertexStart);
-					}
-					break;
-					case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
-					{
-						const uint32_t* data = static_cast<const uint32_t*>(dataPtr);
-						model.indices.push_back(data[c] + vertexStart);
-					}
-					break;
-					}
-				}
+				AccessorReader::readIndices(gltfModel, indAccessor, vertexStart, model.indices);
 			}
 
-			// Begin to fetch attributes and construct the vertices.
-			unsigned char* posData = nullptr; // Assume to be vec3
-			unsigned char* norData = nullptr; // Assume to be vec3
-			unsigned char* uv0Data = nullptr; // Assume to be vec2
-			size_t posByteStride = 0;
-			size_t norByteStride = 0;
-			size_t uv0ByteStride = 0;
-
-			auto& attributes = gltfPrimitive.attributes;
+			// Attributes are decoded straight into the vertices, missing ones are zero
+			const auto& attributes = gltfPrimitive.attributes;
+			auto position = attributes.find("POSITION");
+			auto normal = attributes.find("NORMAL");
+			auto uv0 = attributes.find("TEXCOORD_0");
 
 			// POSITION
-			//JAS_ASSERT(attributes.find("POSITION") != attributes.end(), "Primitive need to have one POSITION attribute!");
-			//JAS_INFO("{0}  ->Has POSITION", indents.c_str());
-			tinygltf::Accessor& posAccessor = gltfModel.accessors[attributes["POSITION"]];
-			tinygltf::BufferView& posBufferView = gltfModel.bufferViews[posAccessor.bufferView];
-			tinygltf::Buffer& posBuffer = gltfModel.buffers[posBufferView.buffer];
-			posData = &posBuffer.data.at(0) + posBufferView.byteOffset;
+			//JAS_ASSERT(position != attributes.end(), "Primitive need to have one POSITION attribute!");
+			const tinygltf::Accessor& posAccessor = gltfModel.accessors[position->second];
 			primitive.vertexCount = static_cast<uint32_t>(posAccessor.count);
-			posByteStride = posAccessor.ByteStride(posBufferView);
+			model.vertices.resize(vertexStart + posAccessor.count);
+			Vertex* vertices = model.vertices.data() + vertexStart;
+			std::fill(vertices, vertices + posAccessor.count, Vertex{});
+			if (!AccessorReader::readFloats(gltfModel, posAccessor, 3, &vertices->pos.x, sizeof(Vertex)))
+				JAS_WARN("Unsupported POSITION accessor in mesh {}", mesh.name.c_str());
 
 			// NORMAL
-			if (attributes.find("NORMAL") != attributes.end())
+			if (normal != attributes.end())
 			{
-				//JAS_INFO("{0}  ->Has NORMAL", indents.c_str());
-				tinygltf::Accessor& accessor = gltfModel.accessors[attributes["NORMAL"]];
-				tinygltf::BufferView& bufferView = gltfModel.bufferViews[accessor.bufferView];
-				tinygltf::Buffer& buffer = gltfModel.buffers[bufferView.buffer];
-				norData = &buffer.data.at(0) + bufferView.byteOffset;
-				norByteStride = accessor.ByteStride(bufferView);
+				if (AccessorReader::readFloats(gltfModel, gltfModel.accessors[normal->second], 3, &vertices->nor.x, sizeof(Vertex)))
+					AccessorReader::normalizeVec3(&vertices->nor.x, posAccessor.count, sizeof(Vertex));
+				else
+					JAS_WARN("Unsupported NORMAL accessor in mesh {}", mesh.name.c_str());
 			}
 
 			// TEXCOORD_0
-			if (attributes.find("TEXCOORD_0") != attributes.end())
+			if (uv0 != attributes.end())
+				if (!AccessorReader::readFloats(gltfModel, gltfModel.accessors[uv0->second], 2, &vertices->uv0.x, sizeof(Vertex)))
+					JAS_WARN("Unsupported TEXCOORD_0 accessor in mesh {}", mesh.name.c_str());
+		}
+	}
+}
+
+void GLTFLoader::reserveGeometry(Model& model, const tinygltf::Model& gltfModel)
+{
+	// Counts each mesh once, meshes used by several nodes grow the arrays past this
+	size_t indexCount = 0;
+	size_t vertexCount = 0;
+	for (const tinygltf::Mesh& mesh : gltfModel.meshes)
+		for (const tinygltf::Primitive& primitive : mesh.primitives)
+		{
+			if (primitive.indices != -1)
+				indexCount += gltfModel.accessors[primitive.indices].count;
+			auto position = primitive.attributes.find("POSITION");
+			if (position != primitive.attributes.end())
+				vertexCount += gltfModel.accessors[position->second].count;
+		}
+	model.indices.reserve(model.indices.size() + indexCount);
+	model.vertices.reserve(model.vertices.size() + vertexCount);
+}
+
+std::string GLTFLoader::benchmarkDecode(const std::string& filePath, uint32_t iterations)
+{
+	tinygltf::Model gltfModel;
+	std::string err;
+	std::string warn;
+	if (!loader.LoadASCIIFromFile(&gltfModel, &err, &warn, filePath)) {
+		JAS_ERROR("Decode benchmark could not load {}: {}", filePath.c_str(), err.c_str());
+		return "";
+	}
+
+	// Same work as loadNode for every primitive once, without the scene traversal. The arrays keep their capacity between iterations
+	uint64_t sourceBytes = 0;
+	Model model;
+	reserveGeometry(model, gltfModel);
+	std::vector<uint32_t>& indices = model.indices;
+	std::vector<Vertex>& vertices = model.vertices;
+	auto startTime = std::chrono::high_resolution_clock::now();
+	for (uint32_t iteration = 0; iteration < iterations; iteration++)
+	{
+		indices.clear();
+		vertices.clear();
+		for (const tinygltf::Mesh& mesh : gltfModel.meshes)
+			for (const tinygltf::Primitive& primitive : mesh.primitives)
 			{
-				//JAS_INFO("{0}  ->Has TEXCOORD_0", indents.c_str());
-				tinygltf::Accessor& accessor = gltfModel.accessors[attributes["TEXCOORD_0"]];
-				tinygltf::BufferView& bufferView = gltfModel.bufferViews[accessor.bufferView];
-				tinygltf::Buffer& buffer = gltfModel.buffers[bufferView.buffer];
-				uv0Data = &buffer.data.at(0) + bufferView.byteOffset;
-				uv0ByteStride = accessor.ByteStride(bufferView);
+				uint32_t vertexStart = static_cast<uint32_t>(vertices.size());
+				if (primitive.indices != -1)
+				{
+					const tinygltf::Accessor& accessor = gltfModel.accessors[primitive.indices];
+					AccessorReader::readIndices(gltfModel, accessor, vertexStart, indices);
+					sourceBytes += AccessorReader::getSourceSize(accessor);
+				}
+
+				const tinygltf::Accessor& posAccessor = gltfModel.accessors[primitive.attributes.at("POSITION")];
+				vertices.resize(vertexStart + posAccessor.count);
+				Vertex* out = vertices.data() + vertexStart;
+				AccessorReader::readFloats(gltfModel, posAccessor, 3, &out->pos.x, sizeof(Vertex));
+				sourceBytes += AccessorReader::getSourceSize(posAccessor);
+
+				auto normal = primitive.attributes.find("NORMAL");
+				if (normal != primitive.attributes.end())
+				{
+					const tinygltf::Accessor& accessor = gltfModel.accessors[normal->second];
+					AccessorReader::readFloats(gltfModel, accessor, 3, &out->nor.x, sizeof(Vertex));
+					AccessorReader::normalizeVec3(&out->nor.x, posAccessor.count, sizeof(Vertex));
+					sourceBytes += AccessorReader::getSourceSize(accessor);
+				}
+
+				auto uv0 = primitive.attributes.find("TEXCOORD_0");
+				if (uv0 != primitive.attributes.end())
+				{
+					const tinygltf::Accessor& accessor = gltfModel.accessors[uv0->second];
+					AccessorReader::readFloats(gltfModel, accessor, 2, &out->uv0.x, sizeof(Vertex));
+					sourceBytes += AccessorReader::getSourceSize(accessor);
+				}
 			}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+	std::stringstream ss;
+	ss << "Accessor decode: " << filePath << " | " << iterations << " iterations, " << (double)sourceBytes / iterations / (1024.0 * 1024.0) << " MB each, "
+		<< seconds * 1000.0 / iterations << " ms each, " << (double)sourceBytes / (1024.0 * 1024.0) / seconds << " MB/s";
+	JAS_INFO(ss.str());
+	return ss.str();
+}
+
+void GLTFLoader::optimizeGeometry(Model& model)
+{
+	JAS_PROFILER_SAMPLE_FUNCTION();
+	model.dequantization = MeshOptimizer::quantize(model.vertices, model.packedVertices);
+	model.boundingRadius = 0.f;
+	for (const Vertex& vertex : model.vertices)
+		model.boundingRadius = glm::max(model.boundingRadius, glm::length(vertex.pos));
+
+	// Reordering only keeps non indexed primitives intact if there are none
+	for (Mesh& mesh : model.meshes)
+		for (Primitive& primitive : mesh.primitives)
+			if (!primitive.hasIndices) {
+				JAS_WARN("Model has primitives without indices, skipping mesh optimization");
+				return;
+			}
+
+	const uint32_t acmrCacheSize = 16;
+	uint32_t vertexCountBefore = static_cast<uint32_t>(model.vertices.size());
+	uint32_t triangleCount = static_cast<uint32_t>(model.indices.size() / 3);
+	float acmrBefore = MeshOptimizer::getACMR(model.indices, 0, (uint32_t)model.indices.size(), vertexCountBefore, acmrCacheSize);
+
+	std::vector<uint32_t> remap = MeshOptimizer::weld(model.packedVertices, model.indices);
+	MeshOptimizer::remapVertices(model.vertices, remap, (uint32_t)model.packedVertices.size());
+
+	uint32_t fullIndexCount = static_cast<uint32_t>(model.indices.size());
+	generateLods(model);
+	generateClusters(model);
 
-			// Construct vertex data
-			for (size_t v = 0; v < posAccessor.count; v++)
+	// Instanced meshes share their ranges, each range is only reordered once. The full detail level is reordered within each cluster
+	std::unordered_set<uint32_t> optimizedRanges;
+	for (Mesh& mesh : model.meshes)
+		for (Primitive& primitive : mesh.primitives)
+		{
+			if (primitive.clusterCount > 0 && optimizedRanges.insert(primitive.firstIndex).second)
+				for (uint32_t c = primitive.firstCluster; c < primitive.firstCluster + primitive.clusterCount; c++)
+					MeshOptimizer::optimizeVertexCache(model.indices, model.clusters[c].firstIndex, model.clusters[c].indexCount, (uint32_t)model.packedVertices.size());
+			for (uint32_t level = 0; level <= primitive.lods.size(); level++)
 			{
-				Vertex vert;
-				vert.pos = glm::make_vec3((const float*)(posData + v*posByteStride));
-				vert.nor = norData ? glm::normalize(glm::make_vec3((const float*)(norData + v*norByteStride))) : glm::vec3(0.0f);
-				vert.uv0 = uv0Data ? glm::make_vec2((const float*)(uv0Data + v*uv0ByteStride)) : glm::vec2(0.0f);
-				model.vertices.push_back(vert);
+				PrimitiveLod lod = primitive.getLod(level);
+				if (optimizedRanges.insert(lod.firstIndex).second)
+					MeshOptimizer::optimizeVertexCache(model.indices, lod.firstIndex, lod.indexCount, (uint32_t)model.packedVertices.size());
 			}
 		}
-	}
+
+	remap = MeshOptimizer::optimizeVertexFetch(model.packedVertices, model.indices);
+	MeshOptimizer::remapVertices(model.vertices, remap, (uint32_t)model.packedVertices.size());
+
+	uint32_t vertexCountAfter = static_cast<uint32_t>(model.packedVertices.size());
+	float acmrAfter = MeshOptimizer::getACMR(model.indices, 0, fullIndexCount, vertexCountAfter, acmrCacheSize);
+	JAS_INFO("Mesh optimization: {} triangles, {} -> {} vertices, {} -> {} KB vertex data, ACMR {:.3f} -> {:.3f}",
+		triangleCount, vertexCountBefore, vertexCountAfter,
+		vertexCountBefore * sizeof(Vertex) / 1024, vertexCountAfter * sizeof(PackedVertex) / 1024, acmrBefore, acmrAfter);
 }
 
-void GLTFLoader::drawNode(Pipeline* pipeline, CommandBuffer* commandBuffer, Model::Node& node)
+void GLTFLoader::generateLods(Model& model)
 {
-	if (node.hasMesh)
+	JAS_PROFILER_SAMPLE_FUNCTION();
+	// Instanced meshes share their ranges, each range is simplified once
+	std::vector<Primitive*> ranges;
+	std::unordered_map<uint32_t, uint32_t> rangeIndices;
+	for (Mesh& mesh : model.meshes)
+		for (Primitive& primitive : mesh.primitives)
+			if (rangeIndices.emplace(primitive.firstIndex, (uint32_t)ranges.size()).second)
+				ranges.push_back(&primitive);
+
+	// Each level is simplified from the level before it, a range stops when it no longer gets smaller
+	std::vector<std::vector<uint32_t>> previous(ranges.size());
+	std::vector<bool> finished(ranges.size(), false);
+	std::vector<uint32_t> simplified;
+	for (uint32_t level = 1; level < MESH_LOD_COUNT; level++)
 	{
-		Mesh& mesh = node.mesh;
+		uint32_t triangleCount = 0;
+		float maxError = 0.f;
+		for (size_t r = 0; r < ranges.size(); r++)
+		{
+			if (finished[r])
+				continue;
+			Primitive& primitive = *ranges[r];
+			if (level == 1)
+				previous[r].assign(model.indices.begin() + primitive.firstIndex, model.indices.begin() + primitive.firstIndex + primitive.indexCount);
+			uint32_t indexCount = static_cast<uint32_t>(previous[r].size());
+			uint32_t targetCount = static_cast<uint32_t>(indexCount * MESH_LOD_REDUCTION) / 3 * 3;
+			float error = MeshOptimizer::simplify(model.vertices, previous[r], 0, indexCount, targetCount, simplified);
+			if (simplified.empty() || simplified.size() > indexCount - (indexCount - targetCount) / 2) {
+				finished[r] = true;
+				continue;
+			}
+
+			primitive.lods.push_back({ static_cast<uint32_t>(model.indices.size()), static_cast<uint32_t>(simplified.size()) });
+			model.indices.insert(model.indices.end(), simplified.begin(), simplified.end());
+			previous[r].swap(simplified);
+			triangleCount += primitive.lods.back().indexCount / 3;
+			maxError = std::max(maxError, error);
+		}
+		if (triangleCount > 0)
+			JAS_INFO("Mesh LOD {}: {} triangles, largest error {:.4f}", level, triangleCount, maxError);
+	}
+
+	model.lodCount = 1;
+	for (Mesh& mesh : model.meshes)
 		for (Primitive& primitive : mesh.primitives)
 		{
-			// TODO: Send node transformation as push constant per draw!
+			primitive.lods = ranges[rangeIndices[primitive.firstIndex]]->lods;
+			model.lodCount = std::max(model.lodCount, (uint32_t)primitive.lods.size() + 1);
+		}
+}
 
-			if (primitive.hasIndices)
-				commandBuffer->cmdDrawIndexed(primitive.indexCount, 1, primitive.firstIndex, 0, 0);
-			else
-				commandBuffer->cmdDraw(primitive.vertexCount, 1, 0, 0);
+void GLTFLoader::generateClusters(Model& model)
+{
+	JAS_PROFILER_SAMPLE_FUNCTION();
+	// The node transforms include the dequantization, so the bounds are moved into the quantized space. Its scale is uniform
+	glm::mat4 toQuantized = glm::inverse(model.dequantization);
+	model.clusters.clear();
+	std::unordered_map<uint32_t, Primitive*> ranges;
+	for (Mesh& mesh : model.meshes)
+		for (Primitive& primitive : mesh.primitives)
+		{
+			auto it = ranges.find(primitive.firstIndex);
+			if (it != ranges.end()) {
+				primitive.firstCluster = it->second->firstCluster;
+				primitive.clusterCount = it->second->clusterCount;
+				continue;
+			}
+			ranges[primitive.firstIndex] = &primitive;
+			primitive.firstCluster = static_cast<uint32_t>(model.clusters.size());
+			MeshOptimizer::buildClusters(model.vertices, model.indices, primitive.firstIndex, primitive.indexCount, CLUSTER_TRIANGLE_COUNT, model.clusters);
+			primitive.clusterCount = static_cast<uint32_t>(model.clusters.size()) - primitive.firstCluster;
+			for (uint32_t c = primitive.firstCluster; c < primitive.firstCluster + primitive.clusterCount; c++)
+			{
+				Cluster& cluster = model.clusters[c];
+				cluster.sphere = glm::vec4(glm::vec3(toQuantized * glm::vec4(glm::vec3(cluster.sphere), 1.0f)), cluster.sphere.w * toQuantized[0][0]);
+			}
 		}
+
+	uint32_t backfaceCullable = 0;
+	for (const Cluster& cluster : model.clusters)
+		backfaceCullable += cluster.cone.w < 1.0f ? 1 : 0;
+	JAS_INFO("Mesh clusters: {} of at most {} triangles, {} can be culled by their normal cone", model.clusters.size(), CLUSTER_TRIANGLE_COUNT, backfaceCullable);
+}
+
+void GLTFLoader::drawMesh(CommandBuffer* commandBuffer, Mesh& mesh)
+{
+	for (Primitive& primitive : mesh.primitives)
+	{
+		// TODO: Send node transformation as push constant per draw!
+
+		if (primitive.hasIndices)
+			commandBuffer->cmdDrawIndexed(primitive.indexCount, 1, primitive.firstIndex, 0, 0);
+		else
+			commandBuffer->cmdDraw(primitive.vertexCount, 1, 0, 0);
 	}
-	for (Model::Node& child : node.children)
-		drawNode(pipeline, commandBuffer, child);
 }
 
 void GLTFLoader::loadModel(Model& model, const std::string& filePath, StagingBuffers* stagingBuffers)
 {
+#if MODEL_CACHE
+	if (ModelCache::read(filePath, model, { defaultData.texture, defaultData.sampler }))
+	{
+		createImageStaging(model, stagingBuffers);
+		createGeometryStaging(model, stagingBuffers);
+		return;
+	}
+#endif
+
 	tinygltf::Model gltfModel;
 	bool ret = false;
 	size_t pos = filePath.rfind('.');
@@ -701,26 +1020,51 @@ void GLTFLoader::loadModel(Model& model, const std::string& filePath, StagingBuf
 	loadTextures(folderPath, model, gltfModel, stagingBuffers);
 	loadMaterials(model, gltfModel);
 	loadScenes(model, gltfModel, stagingBuffers);
+
+#if MODEL_CACHE
+	ModelCache::write(filePath, model, getExternalFiles(gltfModel));
+#endif
+}
+
+std::vector<std::string> GLTFLoader::getExternalFiles(const tinygltf::Model& gltfModel)
+{
+	std::vector<std::string> uris;
+	auto add = [&uris](const std::string& uri) {
+		if (!uri.empty() && !tinygltf::IsDataURI(uri) && std::find(uris.begin(), uris.end(), uri) == uris.end())
+			uris.push_back(uri);
+	};
+	for (const tinygltf::Buffer& buffer : gltfModel.buffers)
+		add(buffer.uri);
+	for (const tinygltf::Image& image : gltfModel.images)
+		add(image.uri);
+	return uris;
 }
 
 void GLTFLoader::loadScenes(Model& model, tinygltf::Model& gltfModel, StagingBuffers* stagingBuffers)
 {
+	reserveGeometry(model, gltfModel);
+	std::unordered_map<int, uint32_t> loadedMeshes;
 	for (auto& scene : gltfModel.scenes)
 	{
 		//JAS_INFO("Scene: {0}", scene.name.c_str());
 		// Load each node in the scene
-		model.nodes.resize(scene.nodes.size());
 		for (size_t nodeIndex = 0; nodeIndex < scene.nodes.size(); nodeIndex++)
 		{
 			tinygltf::Node& node = gltfModel.nodes[scene.nodes[nodeIndex]];
-			loadNode(model, &model.nodes[nodeIndex], gltfModel, node, " ");
+			loadNode(model, SceneGraph::NO_PARENT, gltfModel, node, loadedMeshes, " ");
 		}
 	}
+	model.sceneGraph.update();
+	optimizeGeometry(model);
+	createGeometryStaging(model, stagingBuffers);
+}
 
+void GLTFLoader::createGeometryStaging(Model& model, StagingBuffers* stagingBuffers)
+{
 	// Create vertex, index and texture buffer for staging. 
 	std::vector<uint32_t> queueIndices = { findQueueIndex(VK_QUEUE_TRANSFER_BIT, Instance::get().getPhysicalDevice()) };
 	uint32_t indicesSize = (uint32_t)(model.indices.size() * sizeof(uint32_t));
-	uint32_t verticesSize = (uint32_t)(model.vertices.size() * sizeof(Vertex));
+	uint32_t verticesSize = (uint32_t)(model.packedVertices.size() * sizeof(PackedVertex));
 
 	stagingBuffers->geometryBuffer.init(verticesSize + indicesSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, queueIndices);
 	stagingBuffers->geometryMemory.bindBuffer(&stagingBuffers->geometryBuffer);
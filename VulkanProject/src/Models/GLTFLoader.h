@@ -8,6 +8,10 @@
 #include "Vulkan/Buffers/Memory.h"
 #include "Vulkan/Texture.h"
 #include "Model/Model.h"
+#include "Models/TextureCompressor.h"
+#include "Core/Span.h"
+
+#include <unordered_map>
 
 class CommandPool;
 class CommandBuffer;
@@ -26,7 +30,9 @@ public:
 		void initMemory()
 		{
 			this->geometryMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-			this->imageMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			// No image staging when every texture of the model is already uploaded
+			if (this->imageBuffer.getBuffer() != VK_NULL_HANDLE)
+				this->imageMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 		}
 
 		void cleanup() 
@@ -46,34 +52,60 @@ public:
 	static void load(const std::string& filePath, Model* model);
 
 	// TODO: This should be in a renderer!
-	static void recordDraw(Model* model, CommandBuffer* commandBuffer, Pipeline* pipeline, const std::vector<VkDescriptorSet>& sets, const std::vector<uint32_t>& offsets);
+	static void recordDraw(Model* model, CommandBuffer* commandBuffer, Pipeline* pipeline, Span<VkDescriptorSet> sets, Span<uint32_t> offsets);
 
 	static void prepareStagingBuffer(const std::string& filePath, Model* model, StagingBuffers* stagingBuffers);
 	static void transferToModel(CommandPool* transferCommandPool, Model* model, StagingBuffers* stagingBuffers);
+	// Same as transferToModel but the geometry is allocated in the arena instead of buffers owned by the model
+	static void transferToArena(CommandPool* transferCommandPool, Model* model, StagingBuffers* stagingBuffers, GeometryArena* arena);
+
+	// Decodes the indices and vertex attributes of every primitive in the .gltf file iterations times, returns the throughput report
+	static std::string benchmarkDecode(const std::string& filePath, uint32_t iterations);
 
 private:
 	static void loadModel(Model& model, const std::string& filePath);
+	static void transferTextures(CommandPool* transferCommandPool, Model* model, StagingBuffers* stagingBuffers);
+	static void stageGeometry(Model* model, StagingBuffers* stagingBuffers);
 	static void loadTextures(std::string& folderPath, Model& model, tinygltf::Model& gltfModel, StagingBuffers* stagingBuffers);
+	// Acquires the textures from the AssetCache and creates the staging buffer for the ones that are not uploaded yet
+	static void createTextures(Model& model, const std::vector<VkExtent2D>& extents, const std::vector<VkFormat>& formats, const std::vector<uint64_t>& hashes, StagingBuffers* stagingBuffers);
+	// What each texture holds according to the materials, picks its block compression
+	static std::vector<TextureCompressor::Usage> getTextureUsages(const tinygltf::Model& gltfModel);
+	static void createImageStaging(Model& model, StagingBuffers* stagingBuffers);
+	// Every level of a block compressed texture, only level 0 of the others
+	static uint64_t getStagingSize(Texture* texture);
+	static uint64_t hashImageSource(std::string& folderPath, tinygltf::Image& image, tinygltf::Model& gltfModel);
 	static void loadImageData(std::string& folderPath, tinygltf::Image& image, tinygltf::Model& gltfModel, std::vector<uint8_t>& data);
-	static void loadSamplerData(tinygltf::Sampler& samplerGltf, Sampler& sampler);
+	static Sampler* loadSamplerData(tinygltf::Sampler& samplerGltf);
 	static void loadMaterials(Model& model, tinygltf::Model& gltfModel);
 	static void loadScenes(Model& model, tinygltf::Model& gltfModel);
-	static void loadNode(Model& model, Model::Node* node, tinygltf::Model& gltfModel, tinygltf::Node& gltfNode, std::string indents);
+	// loadedMeshes maps glTF meshes to the first model mesh decoded from them
+	static void loadNode(Model& model, uint32_t parent, tinygltf::Model& gltfModel, tinygltf::Node& gltfNode, std::unordered_map<int, uint32_t>& loadedMeshes, std::string indents);
+	static void reserveGeometry(Model& model, const tinygltf::Model& gltfModel);
+	// Welds, simplifies the levels of detail, reorders for the vertex cache and vertex fetch, and packs the vertices into PackedVertex
+	static void optimizeGeometry(Model& model);
+	// Appends the simplified levels of every primitive to the indices, level by level so contiguous primitives stay contiguous in each level
+	static void generateLods(Model& model);
+	// Splits the full detail range of every primitive into clusters, reordering its indices
+	static void generateClusters(Model& model);
 
-	static void drawNode(Pipeline* pipeline, CommandBuffer* commandBuffer, Model::Node& node);
+	static void drawMesh(CommandBuffer* commandBuffer, Mesh& mesh);
 
 	static void loadModel(Model& model, const std::string& filePath, StagingBuffers* stagingBuffers);
 	static void loadScenes(Model& model, tinygltf::Model& gltfModel, StagingBuffers* stagingBuffers);
+	static void createGeometryStaging(Model& model, StagingBuffers* stagingBuffers);
+	// Buffer and image files the model cache depends on, relative to the source folder
+	static std::vector<std::string> getExternalFiles(const tinygltf::Model& gltfModel);
 
 private:
 	static Model model;
 	static tinygltf::TinyGLTF loader;
 
+	// Owned by the AssetCache
 	struct DefaultData
 	{
-		Texture texture;
-		Sampler sampler;
-		Memory memory;
+		Texture* texture;
+		Sampler* sampler;
 	};
 	static DefaultData defaultData;
 };
\ No newline at end of file
@@ -0,0 +1,251 @@
+#include "jaspch.h"
+#include "Impostor.h"
+
+#include "Models/Model/Model.h"
+#include "Models/DrawList.h"
+#include "Models/ModelRenderer.h"
+#include "Vulkan/Pipeline/Pipeline.h"
+#include "Vulkan/Pipeline/Shader.h"
+#include "Vulkan/Pipeline/RenderPass.h"
+#include "Vulkan/Pipeline/DescriptorManager.h"
+#include "Vulkan/Buffers/Framebuffer.h"
+#include "Vulkan/Buffers/Buffer.h"
+#include "Vulkan/CommandPool.h"
+#include "Vulkan/CommandBuffer.h"
+#include "Vulkan/Instance.h"
+#include "Vulkan/VulkanCommon.h"
+#include "Core/CPUProfiler.h"
+
+#include <array>
+#include <algorithm>
+#include <cfloat>
+
+Impostor::Impostor() : desc()
+{
+}
+
+Impostor::~Impostor()
+{
+}
+
+void Impostor::bake(Model* model, Buffer* vertices, BindlessTable* bindless, CommandPool* pool)
+{
+	JAS_PROFILER_SAMPLE_FUNCTION();
+	std::vector<uint32_t> queueIndices = { Instance::get().getGraphicsQueue().queueIndex };
+
+	// Square views around the vertical extent of the model, wide enough for the model seen from any direction around y.
+	// Measured on the positions as they are drawn, dequantized and placed by their node. A model loaded from the cache has no Vertex data
+	float radius = 0.0f;
+	float minY = FLT_MAX, maxY = -FLT_MAX;
+	for (const Mesh& mesh : model->meshes)
+	{
+		glm::mat4 transform = model->sceneGraph.getWorldMatrix(mesh.node) * model->dequantization;
+		for (const Primitive& primitive : mesh.primitives)
+		{
+			uint32_t count = primitive.hasIndices ? primitive.indexCount : primitive.vertexCount;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				uint32_t index = primitive.hasIndices ? model->indices[primitive.firstIndex + i] : i;
+				if (index >= model->packedVertices.size())
+					continue;
+				glm::vec3 pos = glm::vec3(transform * glm::vec4(model->packedVertices[index].getPosition(), 1.0f));
+				radius = std::max(radius, glm::length(glm::vec2(pos.x, pos.z)));
+				minY = std::min(minY, pos.y);
+				maxY = std::max(maxY, pos.y);
+			}
+		}
+	}
+	if (minY > maxY) {
+		radius = model->boundingRadius;
+		minY = -radius;
+		maxY = radius;
+	}
+	this->desc.bounds = glm::vec4(0.0f, (minY + maxY) * 0.5f, 0.0f, std::max(radius, (maxY - minY) * 0.5f));
+	this->desc.viewCount = IMPOSTOR_VIEW_COUNT;
+
+	// The views are next to each other, mips stay inside their view down to a view of one texel
+	VkExtent2D extent = { IMPOSTOR_VIEW_SIZE * IMPOSTOR_VIEW_COUNT, IMPOSTOR_VIEW_SIZE };
+	const VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+	uint32_t mipLevels = Image::supportsLinearBlit(format) ? Image::getMipLevelCount(IMPOSTOR_VIEW_SIZE, IMPOSTOR_VIEW_SIZE) : 1;
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	this->albedoAtlas.init(extent.width, extent.height, format, usage, queueIndices, 0, 1, mipLevels);
+	this->normalAtlas.init(extent.width, extent.height, format, usage, queueIndices, 0, 1, mipLevels);
+	this->atlasMemory.bindTexture(&this->albedoAtlas);
+	this->atlasMemory.bindTexture(&this->normalAtlas);
+	this->atlasMemory.init(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	this->albedoAtlas.getImageView().init(this->albedoAtlas.getVkImage(), VK_IMAGE_VIEW_TYPE_2D, format, VK_IMAGE_ASPECT_COLOR_BIT, 1, mipLevels);
+	this->normalAtlas.getImageView().init(this->normalAtlas.getVkImage(), VK_IMAGE_VIEW_TYPE_2D, format, VK_IMAGE_ASPECT_COLOR_BIT, 1, mipLevels);
+
+	// Everything below is only used for the bake
+	ImageView albedoTarget, normalTarget;
+	albedoTarget.init(this->albedoAtlas.getVkImage(), VK_IMAGE_VIEW_TYPE_2D, format, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+	normalTarget.init(this->normalAtlas.getVkImage(), VK_IMAGE_VIEW_TYPE_2D, format, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+	VkFormat depthFormat = findDepthFormat(Instance::get().getPhysicalDevice());
+	Texture depthTexture;
+	Memory depthMemory;
+	depthTexture.init(extent.width, extent.height, depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, queueIndices, 0, 1);
+	depthMemory.bindTexture(&depthTexture);
+	depthMemory.init(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	depthTexture.getImageView().init(depthTexture.getVkImage(), VK_IMAGE_VIEW_TYPE_2D, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+
+	// Material table in the order of the model's materials, selected with materialIndex in the push constants
+	struct BakeView
+	{
+		glm::vec4 bounds;
+		uint32_t viewCount;
+		uint32_t _padding[3];
+	};
+	BakeView bakeView = { this->desc.bounds, this->desc.viewCount, { 0, 0, 0 } };
+	std::vector<Material::BindlessData> materialData;
+	for (const Material& material : model->materials)
+		materialData.push_back(material.addToBindless(*bindless));
+	Buffer materialBuffer, viewBuffer;
+	Memory hostMemory;
+	materialBuffer.init(sizeof(Material::BindlessData) * std::max(materialData.size(), (size_t)1), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, queueIndices);
+	viewBuffer.init(sizeof(BakeView), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, queueIndices);
+	hostMemory.bindBuffer(&materialBuffer);
+	hostMemory.bindBuffer(&viewBuffer);
+	hostMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	hostMemory.directTransfer(&materialBuffer, materialData.data(), materialData.size() * sizeof(Material::BindlessData), 0);
+	hostMemory.directTransfer(&viewBuffer, &bakeView, sizeof(BakeView), 0);
+
+	DescriptorManager descManager;
+	DescriptorLayout descLayout;
+	descLayout.add(new SSBO(VK_SHADER_STAGE_VERTEX_BIT, 1, nullptr)); // Vertices
+	descLayout.add(new SSBO(VK_SHADER_STAGE_FRAGMENT_BIT, 1, nullptr)); // Material table
+	descLayout.add(new UBO(VK_SHADER_STAGE_VERTEX_BIT, 1, nullptr)); // Bake view
+	descLayout.init();
+	descManager.addLayout(descLayout);
+	descManager.init(1);
+	descManager.updateBufferDesc(0, 0, vertices->getBuffer(), 0, vertices->getSize());
+	descManager.updateBufferDesc(0, 1, materialBuffer.getBuffer(), 0, materialBuffer.getSize());
+	descManager.updateBufferDesc(0, 2, viewBuffer.getBuffer(), 0, viewBuffer.getSize());
+	descManager.updateSets({ 0 }, 0);
+
+	// Level 0 of both atlases is left for the mip blits
+	RenderPass renderPass;
+	VkAttachmentDescription colorAttachment = {};
+	colorAttachment.format = format;
+	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	renderPass.addColorAttachment(colorAttachment);
+	renderPass.addColorAttachment(colorAttachment);
+	renderPass.addDefaultDepthAttachment();
+	RenderPass::SubpassInfo subpassInfo;
+	subpassInfo.colorAttachmentIndices = { 0, 1 };
+	subpassInfo.depthStencilAttachmentIndex = 2;
+	renderPass.addSubpass(subpassInfo);
+	VkSubpassDependency subpassDependency = {};
+	subpassDependency.srcSubpass = 0;
+	subpassDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+	subpassDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	subpassDependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	subpassDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	subpassDependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	renderPass.addSubpassDependency(subpassDependency);
+	renderPass.init();
+
+	Framebuffer framebuffer;
+	framebuffer.init(1, &renderPass, { albedoTarget.getImageView(), normalTarget.getImageView(), depthTexture.getVkImageView() }, extent);
+
+	// Leaves are single quads, both sides are baked
+	Shader shader;
+	shader.addStage(Shader::Type::VERTEX, "impostorBakeVertex.spv");
+	shader.addStage(Shader::Type::FRAGMENT, "impostorBakeFragment.spv");
+	shader.init();
+	std::array<VkPipelineColorBlendAttachmentState, 2> blendAttachments = {};
+	for (VkPipelineColorBlendAttachmentState& blendAttachment : blendAttachments)
+	{
+		blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		blendAttachment.blendEnable = VK_FALSE;
+	}
+	PipelineInfo pipelineInfo;
+	pipelineInfo.rasterizer = {};
+	pipelineInfo.rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	pipelineInfo.rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	pipelineInfo.rasterizer.lineWidth = 1.0f;
+	pipelineInfo.rasterizer.cullMode = VK_CULL_MODE_NONE;
+	pipelineInfo.rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	pipelineInfo.depthStencil = {};
+	pipelineInfo.depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	pipelineInfo.depthStencil.depthTestEnable = VK_TRUE;
+	pipelineInfo.depthStencil.depthWriteEnable = VK_TRUE;
+	pipelineInfo.depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+	pipelineInfo.depthStencil.minDepthBounds = 0.0f;
+	pipelineInfo.depthStencil.maxDepthBounds = 1.0f;
+	pipelineInfo.colorBlending = {};
+	pipelineInfo.colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	pipelineInfo.colorBlending.attachmentCount = static_cast<uint32_t>(blendAttachments.size());
+	pipelineInfo.colorBlending.pAttachments = blendAttachments.data();
+	Pipeline pipeline;
+	pipeline.setPipelineInfo(PipelineInfoFlag::RASTERIZATION | PipelineInfoFlag::DEAPTH_STENCIL | PipelineInfoFlag::COLOR_BLEND, pipelineInfo);
+	pipeline.setPushConstants(ModelRenderer::get().getPushConstants());
+	pipeline.setDescriptorLayouts({ bindless->getLayout() });
+	pipeline.setDescriptorLayouts(descManager.getLayouts());
+	pipeline.setGraphicsPipelineInfo(extent, &renderPass);
+	pipeline.init(Pipeline::Type::GRAPHICS, &shader);
+
+	// One instance for each view, the vertex shader moves the view into its place in the row
+	DrawList drawList;
+	drawList.add(model, glm::mat4(1.0f), &pipeline);
+	drawList.compile();
+
+	CommandBuffer* cmdBuff = pool->beginSingleTimeCommand();
+	std::array<VkClearValue, 3> clearValues = {};
+	clearValues[0].color = { 0.0f, 0.0f, 0.0f, 0.0f };
+	clearValues[1].color = { 0.5f, 0.5f, 0.5f, 0.0f };
+	clearValues[2].depthStencil = { 1.0f, 0 };
+	cmdBuff->cmdBeginRenderPass(&renderPass, framebuffer.getFramebuffer(), extent, clearValues, VK_SUBPASS_CONTENTS_INLINE);
+	if (model->getIndexBuffer() != VK_NULL_HANDLE)
+		cmdBuff->cmdBindIndexBuffer(model->getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+	VkDescriptorSet sets[] = { bindless->getSet(), descManager.getSet(0, 0) };
+	ModelRenderer::get().recordDrawList(drawList, cmdBuff, sets, {}, this->desc.viewCount, false);
+	cmdBuff->cmdEndRenderPass();
+
+	for (Texture* atlas : { &this->albedoAtlas, &this->normalAtlas })
+	{
+		if (mipLevels > 1)
+		{
+			Image::TransistionDesc transition;
+			transition.format = format;
+			transition.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			transition.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			transition.baseMipLevel = 1;
+			atlas->getImage().transistionLayout(cmdBuff, transition);
+		}
+		atlas->getImage().generateMipmaps(cmdBuff);
+	}
+	pool->endSingleTimeCommand(cmdBuff);
+
+	pipeline.cleanup();
+	shader.cleanup();
+	framebuffer.cleanup();
+	renderPass.cleanup();
+	descManager.cleanup();
+	materialBuffer.cleanup();
+	viewBuffer.cleanup();
+	hostMemory.cleanup();
+	depthTexture.cleanup();
+	depthMemory.cleanup();
+	albedoTarget.cleanup();
+	normalTarget.cleanup();
+
+	this->sampler.init(VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+	this->desc.albedo = bindless->addImage(this->albedoAtlas.getVkImageView(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	this->desc.normal = bindless->addImage(this->normalAtlas.getVkImageView(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	this->desc.sampler = bindless->addSampler(this->sampler.getSampler());
+	JAS_INFO("Baked impostor: {} views of {}x{} px, {} levels", this->desc.viewCount, IMPOSTOR_VIEW_SIZE, IMPOSTOR_VIEW_SIZE, mipLevels);
+}
+
+void Impostor::cleanup()
+{
+	this->sampler.cleanup();
+	this->albedoAtlas.cleanup();
+	this->normalAtlas.cleanup();
+	this->atlasMemory.cleanup();
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "jaspch.h"
+
+#include "Vulkan/Texture.h"
+#include "Vulkan/Sampler.h"
+#include "Vulkan/Buffers/Memory.h"
+#include "Vulkan/Pipeline/BindlessTable.h"
+
+class Model;
+class Buffer;
+class CommandPool;
+
+/*
+	Multi-view billboard of a model, drawn instead of the mesh for distant instances.
+	bake renders the model once from IMPOSTOR_VIEW_COUNT directions around the up axis into one row of views, the albedo with
+	coverage in alpha in one atlas and the model space normal in another. Each view is orthographic and fits the model's bounds,
+	so an instance is one quad facing the camera which samples the view closest to the camera direction, and the normals are
+	rotated with the instance so the billboards are lit like the meshes. The atlases are sampled through the bindless table.
+*/
+class Impostor
+{
+public:
+	// Push constants of the impostor shaders, matches ImpostorData in impostorVertex.glsl and impostorFragment.glsl
+	struct Desc
+	{
+		glm::vec4 bounds;		// Center of the views in model space, w is half the size of a view
+		uint32_t albedo;		// Bindless handles of the atlases and their sampler
+		uint32_t normal;
+		uint32_t sampler;
+		uint32_t viewCount;
+	};
+
+public:
+	Impostor();
+	~Impostor();
+
+	// Renders the views of the model with its geometry in vertices, the textures of its materials are added to the bindless table.
+	// Textures are sampled at the levels resident at the time of the bake
+	void bake(Model* model, Buffer* vertices, BindlessTable* bindless, CommandPool* pool);
+
+	const Desc& getDesc() const { return this->desc; }
+
+	void cleanup();
+
+private:
+	Texture albedoAtlas;
+	Texture normalAtlas;
+	Memory atlasMemory;
+	Sampler sampler;
+	Desc desc;
+};
@@ -0,0 +1,690 @@
+#include "jaspch.h"
+#include "MeshOptimizer.h"
+
+#include <glm/gtc/packing.hpp>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cfloat>
+
+namespace
+{
+	// Sum of weighted squared distances to planes as a symmetric 4x4 matrix, and the summed weight of the planes
+	struct Quadric
+	{
+		double a00, a01, a02, a03, a11, a12, a13, a22, a23, a33;
+		double weight;
+
+		void addPlane(const glm::dvec3& n, double d, double w)
+		{
+			a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z; a03 += w * n.x * d;
+			a11 += w * n.y * n.y; a12 += w * n.y * n.z; a13 += w * n.y * d;
+			a22 += w * n.z * n.z; a23 += w * n.z * d;
+			a33 += w * d * d;
+			weight += w;
+		}
+
+		void add(const Quadric& q)
+		{
+			a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+			a11 += q.a11; a12 += q.a12; a13 += q.a13;
+			a22 += q.a22; a23 += q.a23;
+			a33 += q.a33;
+			weight += q.weight;
+		}
+
+		// Weighted mean of the squared distances from p to the planes
+		double evaluate(const glm::dvec3& p) const
+		{
+			double e = a00 * p.x * p.x + 2.0 * a01 * p.x * p.y + 2.0 * a02 * p.x * p.z + 2.0 * a03 * p.x
+				+ a11 * p.y * p.y + 2.0 * a12 * p.y * p.z + 2.0 * a13 * p.y
+				+ a22 * p.z * p.z + 2.0 * a23 * p.z
+				+ a33;
+			return this->weight > 0.0 ? std::abs(e) / this->weight : 0.0;
+		}
+	};
+
+	// Every edge of the triangles once per triangle as (smaller site << 32 | larger site), sorted so shared edges follow each other
+	void collectEdges(const std::vector<uint32_t>& triangles, const std::vector<uint32_t>& sites, std::vector<uint64_t>& edges)
+	{
+		edges.clear();
+		for (size_t t = 0; t < triangles.size(); t += 3)
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				uint64_t a = sites[triangles[t + k]];
+				uint64_t b = sites[triangles[t + (k + 1) % 3]];
+				edges.push_back(a < b ? (a << 32) | b : (b << 32) | a);
+			}
+		std::sort(edges.begin(), edges.end());
+	}
+}
+
+glm::mat4 MeshOptimizer::quantize(const std::vector<Vertex>& vertices, std::vector<PackedVertex>& packed)
+{
+	packed.resize(vertices.size());
+	if (vertices.empty())
+		return glm::mat4(1.0f);
+
+	glm::vec3 boundsMin = vertices[0].pos;
+	glm::vec3 boundsMax = vertices[0].pos;
+	for (const Vertex& vertex : vertices) {
+		boundsMin = glm::min(boundsMin, vertex.pos);
+		boundsMax = glm::max(boundsMax, vertex.pos);
+	}
+
+	// One scale for all axes, a non uniform scale in the dequantization matrix would skew the normals
+	glm::vec3 extent = boundsMax - boundsMin;
+	float scale = glm::max(glm::max(extent.x, extent.y), glm::max(extent.z, 1e-6f));
+	float toUnorm = 65535.f / scale;
+
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		const Vertex& vertex = vertices[i];
+		glm::uvec3 pos = glm::uvec3(glm::clamp((vertex.pos - boundsMin) * toUnorm + 0.5f, glm::vec3(0.f), glm::vec3(65535.f)));
+
+		// Octahedral normal, the lower hemisphere is folded over the diagonals
+		glm::vec3 nor = vertex.nor / glm::max(glm::abs(vertex.nor.x) + glm::abs(vertex.nor.y) + glm::abs(vertex.nor.z), 1e-6f);
+		glm::vec2 oct = glm::vec2(nor.x, nor.y);
+		if (nor.z < 0.f)
+			oct = (1.f - glm::abs(glm::vec2(nor.y, nor.x))) * glm::vec2(nor.x >= 0.f ? 1.f : -1.f, nor.y >= 0.f ? 1.f : -1.f);
+
+		PackedVertex& out = packed[i];
+		out.data[0] = pos.x | (pos.y << 16);
+		out.data[1] = pos.z;
+		out.data[2] = glm::packHalf2x16(vertex.uv0);
+		out.data[3] = glm::packSnorm2x16(oct);
+	}
+
+	return glm::translate(glm::mat4(1.0f), boundsMin) * glm::scale(glm::mat4(1.0f), glm::vec3(scale / 65535.f));
+}
+
+std::vector<uint32_t> MeshOptimizer::weld(std::vector<PackedVertex>& vertices, std::vector<uint32_t>& indices)
+{
+	struct Hash
+	{
+		size_t operator()(const PackedVertex& v) const {
+			uint64_t h = 14695981039346656037ull;
+			for (uint32_t word : v.data)
+				h = (h ^ word) * 1099511628211ull;
+			return static_cast<size_t>(h);
+		}
+	};
+	struct Equal
+	{
+		bool operator()(const PackedVertex& a, const PackedVertex& b) const {
+			return memcmp(a.data, b.data, sizeof(a.data)) == 0;
+		}
+	};
+
+	std::unordered_map<PackedVertex, uint32_t, Hash, Equal> unique;
+	unique.reserve(vertices.size());
+	std::vector<uint32_t> remap(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		auto it = unique.emplace(vertices[i], static_cast<uint32_t>(unique.size())).first;
+		remap[i] = it->second;
+	}
+
+	for (uint32_t& index : indices)
+		index = remap[index];
+	remapVertices(vertices, remap, static_cast<uint32_t>(unique.size()));
+	return remap;
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t firstIndex, uint32_t indexCount, uint32_t vertexCount)
+{
+	uint32_t triangleCount = indexCount / 3;
+	if (triangleCount < 2)
+		return;
+	const uint32_t* triIndices = indices.data() + firstIndex;
+
+	// Triangles of each vertex, packed in one array. The first remaining[v] entries of a vertex are the triangles not yet emitted
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (uint32_t i = 0; i < triangleCount * 3; i++)
+		remaining[triIndices[i]]++;
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (uint32_t v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remaining[v];
+	std::vector<uint32_t> adjacency(adjacencyOffsets[vertexCount]);
+	std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (uint32_t t = 0; t < triangleCount; t++)
+		for (uint32_t k = 0; k < 3; k++)
+			adjacency[fill[triIndices[t * 3 + k]]++] = t;
+
+	std::vector<int32_t> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++)
+		vertexScores[v] = vertexScore(-1, remaining[v]);
+
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	for (uint32_t t = 0; t < triangleCount; t++)
+		triangleScores[t] = vertexScores[triIndices[t * 3]] + vertexScores[triIndices[t * 3 + 1]] + vertexScores[triIndices[t * 3 + 2]];
+
+	std::vector<uint32_t> result;
+	result.reserve(triangleCount * 3);
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> newCache;
+	cache.reserve(CACHE_SIZE + 3);
+	newCache.reserve(CACHE_SIZE + 3);
+
+	uint32_t best = static_cast<uint32_t>(std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin());
+	uint32_t scanCursor = 0;
+	for (uint32_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+	{
+		const uint32_t* tri = triIndices + best * 3;
+		emitted[best] = true;
+		result.insert(result.end(), tri, tri + 3);
+
+		// The triangle is no longer left for its vertices
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			uint32_t v = tri[k];
+			uint32_t* list = adjacency.data() + adjacencyOffsets[v];
+			for (uint32_t j = 0; j < remaining[v]; j++)
+				if (list[j] == best) {
+					list[j] = list[remaining[v] - 1];
+					break;
+				}
+			remaining[v]--;
+		}
+
+		// Most recently used first, the vertices of the triangle go to the front
+		newCache.assign(tri, tri + 3);
+		for (uint32_t v : cache)
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				newCache.push_back(v);
+		for (uint32_t i = 0; i < newCache.size(); i++)
+			cachePositions[newCache[i]] = i < CACHE_SIZE ? (int32_t)i : -1;
+
+		// Rescore everything that was in the cache, including what just fell out of it
+		float bestScore = -1.f;
+		for (uint32_t v : newCache)
+		{
+			vertexScores[v] = vertexScore(cachePositions[v], remaining[v]);
+			const uint32_t* list = adjacency.data() + adjacencyOffsets[v];
+			for (uint32_t j = 0; j < remaining[v]; j++)
+			{
+				uint32_t t = list[j];
+				const uint32_t* other = triIndices + t * 3;
+				triangleScores[t] = vertexScores[other[0]] + vertexScores[other[1]] + vertexScores[other[2]];
+				if (triangleScores[t] > bestScore) {
+					bestScore = triangleScores[t];
+					best = t;
+				}
+			}
+		}
+		if (newCache.size() > CACHE_SIZE)
+			newCache.resize(CACHE_SIZE);
+		std::swap(cache, newCache);
+
+		// Nothing connected to the cache, continue with the next triangle in the input order
+		if (bestScore < 0.f)
+		{
+			while (scanCursor < triangleCount && emitted[scanCursor])
+				scanCursor++;
+			best = scanCursor;
+		}
+	}
+
+	std::copy(result.begin(), result.end(), indices.begin() + firstIndex);
+}
+
+std::vector<uint32_t> MeshOptimizer::optimizeVertexFetch(std::vector<PackedVertex>& vertices, std::vector<uint32_t>& indices)
+{
+	std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+	uint32_t next = 0;
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == UINT32_MAX)
+			remap[index] = next++;
+		index = remap[index];
+	}
+	remapVertices(vertices, remap, next);
+	return remap;
+}
+
+float MeshOptimizer::simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t firstIndex, uint32_t indexCount, uint32_t targetIndexCount, std::vector<uint32_t>& result)
+{
+	result.assign(indices.begin() + firstIndex, indices.begin() + firstIndex + indexCount / 3 * 3);
+	if (result.size() <= targetIndexCount)
+		return 0.f;
+
+	// The range is simplified in local vertex ids, which are turned back into indices at the end
+	std::unordered_map<uint32_t, uint32_t> localIds;
+	std::vector<uint32_t> globalIds;
+	for (uint32_t& index : result)
+	{
+		auto it = localIds.emplace(index, static_cast<uint32_t>(globalIds.size()));
+		if (it.second)
+			globalIds.push_back(index);
+		index = it.first->second;
+	}
+	uint32_t vertexCount = static_cast<uint32_t>(globalIds.size());
+
+	// Vertices at the same position share a site, which is what collapses. Welded vertices only share a position on attribute seams
+	struct PositionHash
+	{
+		size_t operator()(const glm::vec3& p) const {
+			uint32_t words[3];
+			memcpy(words, &p.x, sizeof(words));
+			uint64_t h = 14695981039346656037ull;
+			for (uint32_t word : words)
+				h = (h ^ word) * 1099511628211ull;
+			return static_cast<size_t>(h);
+		}
+	};
+	std::unordered_map<glm::vec3, uint32_t, PositionHash> sitesByPosition;
+	std::vector<uint32_t> sites(vertexCount);
+	std::vector<glm::dvec3> sitePositions;
+	std::vector<uint32_t> siteVertices; // The first vertex of the site, the only one when the site can collapse
+	std::vector<uint32_t> siteVertexCounts;
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		const glm::vec3& position = vertices[globalIds[v]].pos;
+		auto it = sitesByPosition.emplace(position, static_cast<uint32_t>(sitePositions.size()));
+		if (it.second) {
+			sitePositions.push_back(glm::dvec3(position));
+			siteVertices.push_back(v);
+			siteVertexCounts.push_back(0);
+		}
+		sites[v] = it.first->second;
+		siteVertexCounts[sites[v]]++;
+	}
+	uint32_t siteCount = static_cast<uint32_t>(sitePositions.size());
+
+	// Planes of the triangles weighted by their area, the error of moving a site is measured against the surface it started on
+	std::vector<Quadric> quadrics(siteCount, Quadric{});
+	auto getNormal = [&](uint32_t s0, uint32_t s1, uint32_t s2) -> glm::dvec3 {
+		return glm::cross(sitePositions[s1] - sitePositions[s0], sitePositions[s2] - sitePositions[s0]);
+	};
+	for (size_t t = 0; t < result.size(); t += 3)
+	{
+		uint32_t s[3] = { sites[result[t]], sites[result[t + 1]], sites[result[t + 2]] };
+		glm::dvec3 n = getNormal(s[0], s[1], s[2]);
+		double length = glm::length(n);
+		if (length == 0.0)
+			continue;
+		n /= length;
+		for (uint32_t k = 0; k < 3; k++)
+			quadrics[s[k]].addPlane(n, -glm::dot(n, sitePositions[s[0]]), length * 0.5);
+	}
+
+	// Open borders get a plane through the edge perpendicular to the triangle, so the outline stays where it is
+	const double BORDER_WEIGHT = 10.0;
+	std::vector<uint64_t> edges;
+	collectEdges(result, sites, edges);
+	for (size_t t = 0; t < result.size(); t += 3)
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			uint32_t a = sites[result[t + k]];
+			uint32_t b = sites[result[t + (k + 1) % 3]];
+			uint64_t key = a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+			auto range = std::equal_range(edges.begin(), edges.end(), key);
+			if (range.second - range.first != 1)
+				continue;
+			uint32_t c = sites[result[t + (k + 2) % 3]];
+			glm::dvec3 edge = sitePositions[b] - sitePositions[a];
+			glm::dvec3 n = glm::cross(edge, getNormal(a, b, c));
+			double length = glm::length(n);
+			if (length == 0.0)
+				continue;
+			n /= length;
+			double weight = glm::dot(edge, edge) * BORDER_WEIGHT;
+			quadrics[a].addPlane(n, -glm::dot(n, sitePositions[a]), weight);
+			quadrics[b].addPlane(n, -glm::dot(n, sitePositions[a]), weight);
+		}
+
+	struct Collapse
+	{
+		double cost;
+		uint32_t from;
+		uint32_t to;
+	};
+	std::vector<Collapse> collapses;
+	std::vector<bool> border(siteCount);
+	std::vector<bool> touched(siteCount);
+	std::vector<uint32_t> adjacencyOffsets(siteCount + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<uint32_t> vertexRemap(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++)
+		vertexRemap[v] = v;
+
+	// Each pass collapses the cheapest edges which do not share a triangle with another collapse of the pass
+	double maxCost = 0.0;
+	uint32_t triangleCount = static_cast<uint32_t>(result.size() / 3);
+	uint32_t targetTriangleCount = targetIndexCount / 3;
+	while (triangleCount > targetTriangleCount)
+	{
+		collectEdges(result, sites, edges);
+		std::fill(border.begin(), border.end(), false);
+		collapses.clear();
+		for (size_t i = 0; i < edges.size();)
+		{
+			size_t end = i + 1;
+			while (end < edges.size() && edges[end] == edges[i])
+				end++;
+			bool borderEdge = end - i == 1;
+			uint32_t a = static_cast<uint32_t>(edges[i] >> 32);
+			uint32_t b = static_cast<uint32_t>(edges[i] & 0xFFFFFFFF);
+			if (borderEdge)
+				border[a] = border[b] = true;
+			i = end;
+		}
+		for (size_t i = 0; i < edges.size();)
+		{
+			size_t end = i + 1;
+			while (end < edges.size() && edges[end] == edges[i])
+				end++;
+			bool borderEdge = end - i == 1;
+			uint32_t ends[2] = { static_cast<uint32_t>(edges[i] >> 32), static_cast<uint32_t>(edges[i] & 0xFFFFFFFF) };
+			i = end;
+
+			Collapse best = { DBL_MAX, 0, 0 };
+			for (uint32_t k = 0; k < 2; k++)
+			{
+				uint32_t from = ends[k];
+				uint32_t to = ends[1 - k];
+				// Seams stay, and a border site moving inwards would open a hole
+				if (siteVertexCounts[from] != 1 || (border[from] && !borderEdge))
+					continue;
+				Quadric q = quadrics[from];
+				q.add(quadrics[to]);
+				double cost = q.evaluate(sitePositions[to]);
+				if (cost < best.cost)
+					best = { cost, from, to };
+			}
+			if (best.cost != DBL_MAX)
+				collapses.push_back(best);
+		}
+		if (collapses.empty())
+			break;
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		// Triangles of each site
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (uint32_t index : result)
+			adjacencyOffsets[sites[index] + 1]++;
+		for (uint32_t s = 0; s < siteCount; s++)
+			adjacencyOffsets[s + 1] += adjacencyOffsets[s];
+		adjacency.resize(result.size());
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < result.size(); i++)
+			adjacency[fill[sites[result[i]]]++] = static_cast<uint32_t>(i / 3);
+
+		std::fill(touched.begin(), touched.end(), false);
+		uint32_t collapsed = 0;
+		for (const Collapse& collapse : collapses)
+		{
+			if (triangleCount <= targetTriangleCount)
+				break;
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+
+			// The triangles on the edge disappear, the others around from must not turn over
+			uint32_t removed = 0;
+			uint32_t toVertex = UINT32_MAX;
+			bool flips = false;
+			for (uint32_t j = adjacencyOffsets[collapse.from]; j < adjacencyOffsets[collapse.from + 1] && !flips; j++)
+			{
+				const uint32_t* tri = result.data() + adjacency[j] * 3;
+				uint32_t s[3] = { sites[tri[0]], sites[tri[1]], sites[tri[2]] };
+				uint32_t onEdge = s[0] == collapse.to ? 0 : s[1] == collapse.to ? 1 : s[2] == collapse.to ? 2 : 3;
+				if (onEdge < 3) {
+					toVertex = tri[onEdge];
+					removed++;
+					continue;
+				}
+				glm::dvec3 before = getNormal(s[0], s[1], s[2]);
+				for (uint32_t k = 0; k < 3; k++)
+					s[k] = s[k] == collapse.from ? collapse.to : s[k];
+				glm::dvec3 after = getNormal(s[0], s[1], s[2]);
+				double lengths = glm::length(before) * glm::length(after);
+				flips = lengths > 0.0 && glm::dot(before, after) < 0.2 * lengths;
+			}
+			if (flips || toVertex == UINT32_MAX)
+				continue;
+
+			vertexRemap[siteVertices[collapse.from]] = toVertex;
+			quadrics[collapse.to].add(quadrics[collapse.from]);
+			maxCost = std::max(maxCost, collapse.cost);
+			triangleCount -= removed;
+			collapsed++;
+			// Everything around from changes its triangles, it waits for the next pass
+			for (uint32_t j = adjacencyOffsets[collapse.from]; j < adjacencyOffsets[collapse.from + 1]; j++)
+				for (uint32_t k = 0; k < 3; k++)
+					touched[sites[result[adjacency[j] * 3 + k]]] = true;
+		}
+		if (collapsed == 0)
+			break;
+
+		// Apply the collapses and remove the triangles which lost an edge
+		size_t write = 0;
+		for (size_t t = 0; t < result.size(); t += 3)
+		{
+			uint32_t tri[3] = { vertexRemap[result[t]], vertexRemap[result[t + 1]], vertexRemap[result[t + 2]] };
+			if (sites[tri[0]] == sites[tri[1]] || sites[tri[1]] == sites[tri[2]] || sites[tri[0]] == sites[tri[2]])
+				continue;
+			result[write++] = tri[0];
+			result[write++] = tri[1];
+			result[write++] = tri[2];
+		}
+		result.resize(write);
+		triangleCount = static_cast<uint32_t>(result.size() / 3);
+	}
+
+	for (uint32_t& index : result)
+		index = globalIds[index];
+	return static_cast<float>(std::sqrt(maxCost));
+}
+
+void MeshOptimizer::buildClusters(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t firstIndex, uint32_t indexCount, uint32_t maxTriangles, std::vector<Cluster>& clusters)
+{
+	uint32_t triangleCount = indexCount / 3;
+	if (triangleCount == 0 || maxTriangles == 0)
+		return;
+	const uint32_t* triIndices = indices.data() + firstIndex;
+
+	// Local vertex ids for the adjacency
+	std::unordered_map<uint32_t, uint32_t> localIds;
+	std::vector<uint32_t> localIndices(triangleCount * 3);
+	for (uint32_t i = 0; i < triangleCount * 3; i++)
+		localIndices[i] = localIds.emplace(triIndices[i], static_cast<uint32_t>(localIds.size())).first->second;
+	uint32_t vertexCount = static_cast<uint32_t>(localIds.size());
+
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (uint32_t index : localIndices)
+		adjacencyOffsets[index + 1]++;
+	for (uint32_t v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (uint32_t i = 0; i < triangleCount * 3; i++)
+		adjacency[fill[localIndices[i]]++] = i / 3;
+
+	// Unit normals and centers of the triangles, degenerate triangles have no normal
+	std::vector<glm::vec3> normals(triangleCount);
+	std::vector<glm::vec3> centers(triangleCount);
+	glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+	float edgeSum = 0.f;
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		const glm::vec3& p0 = vertices[triIndices[t * 3]].pos;
+		const glm::vec3& p1 = vertices[triIndices[t * 3 + 1]].pos;
+		const glm::vec3& p2 = vertices[triIndices[t * 3 + 2]].pos;
+		glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+		float length = glm::length(n);
+		normals[t] = length > 0.f ? n / length : glm::vec3(0.f);
+		edgeSum += std::sqrt(length);
+		centers[t] = (p0 + p1 + p2) / 3.f;
+		boundsMin = glm::min(boundsMin, centers[t]);
+		boundsMax = glm::max(boundsMax, centers[t]);
+	}
+
+	// 10 bits for each axis of the center, interleaved
+	auto spread = [](uint32_t x) -> uint32_t {
+		x &= 0x3FF;
+		x = (x | (x << 16)) & 0x030000FF;
+		x = (x | (x << 8)) & 0x0300F00F;
+		x = (x | (x << 4)) & 0x030C30C3;
+		x = (x | (x << 2)) & 0x09249249;
+		return x;
+	};
+	glm::vec3 toGrid = 1023.f / glm::max(boundsMax - boundsMin, glm::vec3(1e-6f));
+	std::vector<uint32_t> codes(triangleCount);
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		glm::uvec3 cell = glm::uvec3((centers[t] - boundsMin) * toGrid);
+		codes[t] = spread(cell.x) | (spread(cell.y) << 1) | (spread(cell.z) << 2);
+	}
+	std::vector<uint32_t> mortonOrder(triangleCount);
+	for (uint32_t t = 0; t < triangleCount; t++)
+		mortonOrder[t] = t;
+	std::stable_sort(mortonOrder.begin(), mortonOrder.end(), [&codes](uint32_t a, uint32_t b) { return codes[a] < codes[b]; });
+	std::vector<uint32_t> mortonRanks(triangleCount);
+	for (uint32_t i = 0; i < triangleCount; i++)
+		mortonRanks[mortonOrder[i]] = i;
+
+	// How far a cluster may continue at an unconnected triangle, about the size of a flat cluster of average triangles
+	float jumpDistance = edgeSum / triangleCount * std::sqrt((float)maxTriangles);
+
+	std::vector<uint32_t> triangleClusters(triangleCount, UINT32_MAX);
+	std::vector<uint32_t> vertexClusters(vertexCount, UINT32_MAX);
+	std::vector<uint32_t> frontierClusters(triangleCount, UINT32_MAX);
+	std::vector<uint32_t> frontier;
+	std::vector<uint32_t> order;
+	order.reserve(triangleCount);
+	uint32_t cursor = 0; // Every triangle before it in Morton order is in a cluster
+	while (order.size() < triangleCount)
+	{
+		uint32_t cluster = static_cast<uint32_t>(clusters.size());
+		size_t start = order.size();
+		glm::vec3 normalSum(0.f);
+		glm::vec3 centerSum(0.f);
+		frontier.clear();
+		uint32_t next = UINT32_MAX;
+		while (order.size() - start < maxTriangles && order.size() < triangleCount)
+		{
+			// New clusters start at the first free triangle, a cluster without connected triangles left continues after its last one
+			if (next == UINT32_MAX)
+			{
+				while (triangleClusters[mortonOrder[cursor]] != UINT32_MAX)
+					cursor++;
+				uint32_t rank = order.size() > start ? mortonRanks[order.back()] : cursor;
+				while (rank < triangleCount && triangleClusters[mortonOrder[rank]] != UINT32_MAX)
+					rank++;
+				next = mortonOrder[rank < triangleCount ? rank : cursor];
+				if (order.size() > start && glm::length(centers[next] - centerSum / (float)(order.size() - start)) > jumpDistance)
+					break;
+			}
+			triangleClusters[next] = cluster;
+			order.push_back(next);
+			normalSum += normals[next];
+			centerSum += centers[next];
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				uint32_t v = localIndices[next * 3 + k];
+				vertexClusters[v] = cluster;
+				for (uint32_t j = adjacencyOffsets[v]; j < adjacencyOffsets[v + 1]; j++)
+				{
+					uint32_t t = adjacency[j];
+					if (triangleClusters[t] == UINT32_MAX && frontierClusters[t] != cluster) {
+						frontierClusters[t] = cluster;
+						frontier.push_back(t);
+					}
+				}
+			}
+
+			// Most vertices already in the cluster first, then the normal closest to the cluster's
+			float axisLength = glm::length(normalSum);
+			glm::vec3 axis = axisLength > 0.f ? normalSum / axisLength : glm::vec3(0.f);
+			float bestScore = -FLT_MAX;
+			next = UINT32_MAX;
+			for (size_t i = 0; i < frontier.size();)
+			{
+				uint32_t t = frontier[i];
+				if (triangleClusters[t] != UINT32_MAX) {
+					frontier[i] = frontier.back();
+					frontier.pop_back();
+					continue;
+				}
+				uint32_t shared = 0;
+				for (uint32_t k = 0; k < 3; k++)
+					shared += vertexClusters[localIndices[t * 3 + k]] == cluster ? 1 : 0;
+				float score = (float)shared + glm::dot(normals[t], axis);
+				if (score > bestScore) {
+					bestScore = score;
+					next = t;
+				}
+				i++;
+			}
+		}
+
+		// Bounds of the cluster. The cone holds every normal, a spread past about 84 degrees can never face away as a whole
+		glm::vec3 center = centerSum / (float)(order.size() - start);
+		float radius = 0.f;
+		float axisLength = glm::length(normalSum);
+		glm::vec3 axis = axisLength > 0.f ? normalSum / axisLength : glm::vec3(0.f);
+		float minDot = axisLength > 0.f ? 1.f : -1.f;
+		for (size_t i = start; i < order.size(); i++)
+		{
+			for (uint32_t k = 0; k < 3; k++)
+				radius = std::max(radius, glm::length(vertices[triIndices[order[i] * 3 + k]].pos - center));
+			if (normals[order[i]] != glm::vec3(0.f))
+				minDot = std::min(minDot, glm::dot(normals[order[i]], axis));
+		}
+
+		Cluster result = {};
+		result.sphere = glm::vec4(center, radius);
+		result.cone = minDot < 0.1f ? glm::vec4(0.f, 0.f, 0.f, 1.f) : glm::vec4(axis, std::sqrt(1.f - minDot * minDot));
+		result.firstIndex = firstIndex + static_cast<uint32_t>(start) * 3;
+		result.indexCount = static_cast<uint32_t>(order.size() - start) * 3;
+		clusters.push_back(result);
+	}
+
+	std::vector<uint32_t> reordered(triangleCount * 3);
+	for (uint32_t i = 0; i < triangleCount; i++)
+		for (uint32_t k = 0; k < 3; k++)
+			reordered[i * 3 + k] = triIndices[order[i] * 3 + k];
+	std::copy(reordered.begin(), reordered.end(), indices.begin() + firstIndex);
+}
+
+float MeshOptimizer::getACMR(const std::vector<uint32_t>& indices, uint32_t firstIndex, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize)
+{
+	uint32_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return 0.f;
+
+	// Timestamp of when each vertex entered the FIFO, a vertex is a hit while fewer than cacheSize misses happened after it
+	std::vector<uint32_t> insertedAt(vertexCount, 0);
+	uint32_t misses = 0;
+	for (uint32_t i = firstIndex; i < firstIndex + triangleCount * 3; i++)
+	{
+		uint32_t v = indices[i];
+		if (insertedAt[v] == 0 || misses - insertedAt[v] >= cacheSize) {
+			misses++;
+			insertedAt[v] = misses;
+		}
+	}
+	return (float)misses / (float)triangleCount;
+}
+
+float MeshOptimizer::vertexScore(int32_t cachePosition, uint32_t remainingTriangles)
+{
+	if (remainingTriangles == 0)
+		return -1.f;
+
+	float score = 0.f;
+	if (cachePosition >= 0)
+	{
+		// The last triangle gets a fixed score so it is not reused directly, which would not help the cache
+		if (cachePosition < 3)
+			score = 0.75f;
+		else
+			score = std::pow(1.f - (float)(cachePosition - 3) / (float)(CACHE_SIZE - 3), 1.5f);
+	}
+	// Prefer vertices with few triangles left, so they are finished and leave the cache
+	score += 2.f * std::pow((float)remainingTriangles, -0.5f);
+	return score;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "jaspch.h"
+
+#include "Models/Model/Model.h"
+
+/*
+	Load time optimizations of indexed triangle lists, used by GLTFLoader before the geometry is uploaded.
+	The functions work on whole index and vertex arrays, an index range [firstIndex, firstIndex + indexCount) is one primitive.
+	Functions that move vertices return a remap table (old index -> new index, UINT32_MAX for removed vertices)
+	which is already applied to the indices, apply it to other per vertex arrays with remapVertices.
+*/
+class MeshOptimizer
+{
+public:
+	// Packs the vertices into PackedVertex, returns the matrix that turns the quantized positions back into model space
+	static glm::mat4 quantize(const std::vector<Vertex>& vertices, std::vector<PackedVertex>& packed);
+
+	// Merges vertices with identical packed data
+	static std::vector<uint32_t> weld(std::vector<PackedVertex>& vertices, std::vector<uint32_t>& indices);
+
+	// Reorders the triangles of the range for the post transform vertex cache (Forsyth, linear speed vertex cache optimisation)
+	static void optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t firstIndex, uint32_t indexCount, uint32_t vertexCount);
+
+	// Orders vertices by first use in the indices, vertices that are never used are removed
+	static std::vector<uint32_t> optimizeVertexFetch(std::vector<PackedVertex>& vertices, std::vector<uint32_t>& indices);
+
+	/*
+		Quadric error simplification (Garland and Heckbert) of the range into result, with at most targetIndexCount indices when the mesh allows it.
+		Edges are collapsed onto one of their vertices, so result only uses vertices of the range. Vertices on attribute seams are kept and
+		open borders only collapse along themselves. Returns the largest collapse error, as a distance in the space of the positions
+	*/
+	static float simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t firstIndex, uint32_t indexCount, uint32_t targetIndexCount, std::vector<uint32_t>& result);
+
+	/*
+		Reorders the triangles of the range into clusters of at most maxTriangles and appends them to clusters. A cluster grows over the triangles
+		sharing the most vertices with it and the closest normal, and continues at the next free triangle in Morton order when nothing
+		connected is left, unless that triangle is further than about a cluster away.
+		Bounds are in the space of the positions
+	*/
+	static void buildClusters(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t firstIndex, uint32_t indexCount, uint32_t maxTriangles, std::vector<Cluster>& clusters);
+
+	// Average cache miss ratio (transformed vertices per triangle) of the range with a FIFO cache of cacheSize vertices
+	static float getACMR(const std::vector<uint32_t>& indices, uint32_t firstIndex, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize);
+
+	template<typename T>
+	static void remapVertices(std::vector<T>& vertices, const std::vector<uint32_t>& remap, uint32_t newCount);
+
+private:
+	static const uint32_t CACHE_SIZE = 32;
+	static float vertexScore(int32_t cachePosition, uint32_t remainingTriangles);
+};
+
+template<typename T>
+inline void MeshOptimizer::remapVertices(std::vector<T>& vertices, const std::vector<uint32_t>& remap, uint32_t newCount)
+{
+	std::vector<T> result(newCount);
+	for (size_t i = 0; i < remap.size(); i++)
+		if (remap[i] != UINT32_MAX)
+			result[remap[i]] = vertices[i];
+	vertices = std::move(result);
+}
@@ -1,5 +1,9 @@
 #include "jaspch.h"
 #include "Material.h"
+#include "Vulkan/Texture.h"
+#include "Vulkan/Sampler.h"
+#include "Vulkan/Pipeline/BindlessTable.h"
+#include "Models/TextureStreamer.h"
 
 Material::Material()
 {
@@ -15,4 +19,19 @@ void Material::initializeDescriptor(DescriptorLayout& descriptorLayout)
 	descriptorLayout.add(new IMG(VK_SHADER_STAGE_FRAGMENT_BIT, 1, nullptr)); // OcclusionTexture
 	descriptorLayout.add(new IMG(VK_SHADER_STAGE_FRAGMENT_BIT, 1, nullptr)); // EmissiveTexture
 	descriptorLayout.init();
+}
+
+Material::BindlessData Material::addToBindless(BindlessTable& table) const
+{
+	const Tex* texs[5] = { &this->baseColorTexture, &this->metallicRoughnessTexture, &this->normalTexture, &this->occlusionTexture, &this->emissiveTexture };
+
+	BindlessData data = {};
+	for (uint32_t i = 0; i < 5; i++)
+	{
+		// Streamed textures use the image with their finest resident levels
+		Texture* texture = TextureStreamer::get().getResident(texs[i]->texture);
+		data.textures[i] = table.addImage(texture->getVkImageView(), texture->getImage().getLayout());
+		data.samplers[i] = table.addSampler(texs[i]->sampler->getSampler());
+	}
+	return data;
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 
 class Texture;
 class Sampler;
+class BindlessTable;
 struct Material
 {
 	struct Tex
@@ -74,9 +75,19 @@ struct Material
 		int normalTextureCoord = -1;
 		int occlusionTextureCoord = -1;
 		int emissiveTextureCoord = -1;
-		int _padding = 0;
+		int materialIndex = 0; // Index into the material table when bindless
 	} pushData;
 
+	// One element of the material table used by the bindless shaders, texture order as initializeDescriptor
+	struct BindlessData
+	{
+		uint32_t textures[5];
+		uint32_t samplers[5];
+		uint32_t _padding[2];
+	};
+
 	//static DescriptorLayout descriptorLayout;
 	static void initializeDescriptor(DescriptorLayout& descriptorLayout);
+	// Adds the textures and samplers to the table and returns their handles, called again when the TextureStreamer changed a texture
+	BindlessData addToBindless(BindlessTable& table) const;
 };
\ No newline at end of file
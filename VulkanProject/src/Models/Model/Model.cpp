@@ -1,5 +1,6 @@
 #include "jaspch.h"
 #include "Model.h"
+#include "Models/AssetCache.h"
 
 Model::Model()
 {
@@ -13,23 +14,52 @@ Model::~Model()
 
 void Model::cleanup()
 {
-	if(this->indices.empty() == false)
-		this->indexBuffer.cleanup();
-	if (this->vertices.empty() == false)
-		this->vertexBuffer.cleanup();
+	if (this->arena != nullptr)
+	{
+		if (AssetCache::get().releaseGeometry(this->geometryHash, this->arena))
+			this->arena->free(this->geometry);
+		this->arena = nullptr;
+	}
+	else
+	{
+		if(this->indices.empty() == false)
+			this->indexBuffer.cleanup();
+		if (this->packedVertices.empty() == false)
+			this->vertexBuffer.cleanup();
 
-	if(this->indices.empty() == false && this->vertices.empty() == false)
-		this->bufferMemory.cleanup();
+		if(this->indices.empty() == false && this->packedVertices.empty() == false)
+			this->bufferMemory.cleanup();
+	}
 
-	if (hasImageMemory)
-		this->imageMemory.cleanup();
 	if(hasMaterialMemory)
 		this->materialMemory.cleanup();
 
-	for (Texture& texture : this->textures)
-		texture.cleanup();
+	for (Texture* texture : this->textures)
+		AssetCache::get().releaseTexture(texture);
+	this->textures.clear();
 	imageData.clear();
 
-	for (Sampler& sampler : this->samplers)
-		sampler.cleanup();
-}
\ No newline at end of file
+	for (Sampler* sampler : this->samplers)
+		AssetCache::get().releaseSampler(sampler);
+	this->samplers.clear();
+}
+
+VkBuffer Model::getVertexBuffer() const
+{
+	return this->arena != nullptr ? this->arena->getVertexBuffer().getBuffer() : this->vertexBuffer.getBuffer();
+}
+
+VkBuffer Model::getIndexBuffer() const
+{
+	return this->arena != nullptr ? this->arena->getIndexBuffer().getBuffer() : this->indexBuffer.getBuffer();
+}
+
+uint32_t Model::getFirstIndex() const
+{
+	return this->arena != nullptr ? this->arena->getAllocation(this->geometry).firstIndex : 0;
+}
+
+int32_t Model::getVertexOffset() const
+{
+	return this->arena != nullptr ? static_cast<int32_t>(this->arena->getAllocation(this->geometry).firstVertex) : 0;
+}
@@ -2,12 +2,17 @@
 
 #include "Vulkan/Buffers/Memory.h"
 #include "Vulkan/Buffers/Buffer.h"
+#include "Vulkan/Buffers/GeometryArena.h"
 #include "Vulkan/Texture.h"
 #include "Vulkan/Sampler.h"
 #include "Material.h"
+#include "Models/SceneGraph.h"
 
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/quaternion.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
 
 struct Vertex
 {
@@ -44,6 +49,58 @@ struct Vertex
 	}
 };
 
+/*
+	Vertex as it is stored on the GPU, 16 bytes instead of the 48 of Vertex. Written by MeshOptimizer::quantize
+	and read with decodeVertex in the model vertex shaders.
+	data[0]: position x, y as 16 bit unorm in the model bounds. The model's dequantization matrix maps them back to model space
+	data[1]: position z, the upper 16 bits are unused
+	data[2]: uv0 as two half floats
+	data[3]: octahedral encoded normal as two 16 bit snorm
+*/
+struct PackedVertex
+{
+	uint32_t data[4];
+
+	// Quantized, the dequantization matrix maps it to model space
+	glm::vec3 getPosition() const { return glm::vec3(float(this->data[0] & 0xFFFFu), float(this->data[0] >> 16), float(this->data[1] & 0xFFFFu)); }
+};
+
+/*
+	Placement of one model instance, 16 bytes instead of a mat4. Read with decodeInstance in the model vertex shaders.
+	position: world space position of the model origin
+	yawScale: rotation around y in radians and uniform scale as two half floats
+*/
+struct PackedInstance
+{
+	glm::vec3 position;
+	uint32_t yawScale;
+
+	static PackedInstance pack(const glm::vec3& position, float yaw, float scale)
+	{
+		return { position, glm::packHalf2x16(glm::vec2(yaw, scale)) };
+	}
+
+	float getScale() const { return glm::unpackHalf2x16(this->yawScale).y; }
+};
+
+/*
+	Up to CLUSTER_TRIANGLE_COUNT connected triangles of a primitive's full detail range, which the GPU can cull on their own.
+	Built by MeshOptimizer::buildClusters, the loader stores the bounds in the quantized space of the packed positions.
+*/
+struct Cluster
+{
+	glm::vec4 sphere;	// Center and radius
+	glm::vec4 cone;		// Average normal, and the sine of the largest angle between it and a triangle normal. w is 1 when the cluster never faces away
+	uint32_t firstIndex;
+	uint32_t indexCount;
+};
+
+struct PrimitiveLod
+{
+	uint32_t firstIndex{0};
+	uint32_t indexCount{0};
+};
+
 struct Primitive
 {
 	uint32_t firstIndex{0};
@@ -51,6 +108,19 @@ struct Primitive
 	uint32_t vertexCount{0};
 	bool hasIndices{false};
 	Material* material;
+	// Simplified index ranges in the model's indices, each coarser than the one before. Level 0 is the range above
+	std::vector<PrimitiveLod> lods;
+	// Clusters in the model's clusters which cover level 0, in index order
+	uint32_t firstCluster{0};
+	uint32_t clusterCount{0};
+
+	// Levels past the last one give the coarsest level
+	PrimitiveLod getLod(uint32_t level) const
+	{
+		if (level == 0 || this->lods.empty())
+			return { this->firstIndex, this->indexCount };
+		return this->lods[std::min(level, (uint32_t)this->lods.size()) - 1];
+	}
 };
 
 class Mesh
@@ -58,46 +128,48 @@ class Mesh
 public:
 	std::string name{"Mesh"};
 	std::vector<Primitive> primitives;
+	uint32_t node{0}; // Scene graph node which places the mesh
 };
 
 class Model
 {
-public:
-	struct Node
-	{
-		bool hasMesh{false};
-		Mesh mesh;
-		glm::vec3 translation;
-		glm::quat rotation;
-		glm::vec3 scale;
-		glm::mat4 matrix; // Combination of rotation, translation and scale.
-		std::vector<Node> children;
-		Node* parent{ nullptr };
-		Model* model;
-	};
-
 public:
 	Model();
 	~Model();
 
 	void cleanup();
 
+	// The buffers to bind when drawing, the arena buffers when the model is in one
+	VkBuffer getVertexBuffer() const;
+	VkBuffer getIndexBuffer() const;
+	// Where the geometry starts in the bound buffers, zero when the model has its own buffers
+	uint32_t getFirstIndex() const;
+	int32_t getVertexOffset() const;
+
 	// Layout
-	std::vector<Node> nodes;
+	SceneGraph sceneGraph;
+	std::vector<Mesh> meshes;
 	
 	// Data
 	std::vector<uint32_t> indices;
 	std::vector<Vertex> vertices;
+	std::vector<PackedVertex> packedVertices; // What is uploaded, same order as vertices
+	glm::mat4 dequantization{ 1.0f }; // Applied before the node transform
+	float boundingRadius{ 0.0f }; // Around the model origin, of the untransformed vertices
+	uint32_t lodCount{ 1 }; // Levels of detail of the primitive with the most
+	std::vector<Cluster> clusters;
 	Buffer indexBuffer;
 	Buffer vertexBuffer;
 	Memory bufferMemory;
+	// Set instead of the buffers above when the geometry is in a shared arena
+	GeometryArena* arena{ nullptr };
+	GeometryArena::Handle geometry{ 0 };
+	uint64_t geometryHash{ 0 }; // Identity in the AssetCache, models with the same geometry share the allocation
 
-	bool hasImageMemory{false};
-	std::vector<std::vector<uint8_t>> imageData;
-	std::vector<Texture> textures;
-	Memory imageMemory;
-
-	std::vector<Sampler> samplers;
+	// Owned by the AssetCache, references are released in cleanup
+	std::vector<std::vector<uint8_t>> imageData; // Empty for textures that are already uploaded
+	std::vector<Texture*> textures;
+	std::vector<Sampler*> samplers;
 
 	bool hasMaterialMemory{ false };
 	Memory materialMemory;
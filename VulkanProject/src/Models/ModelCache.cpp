@@ -0,0 +1,524 @@
+#include "jaspch.h"
+#include "ModelCache.h"
+#include "Core/MappedFile.h"
+#include "Core/CPUProfiler.h"
+#include "Models/AssetCache.h"
+#include "Models/TextureCompressor.h"
+#include "Models/TextureStreamer.h"
+#include "Vulkan/Buffers/Image.h"
+
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	const uint32_t CACHE_MAGIC = 0x4D53414A; // "JASM"
+	// Increase when the layout below or PackedVertex changes
+	const uint32_t CACHE_VERSION = 6;
+
+	// Config.h settings the cached geometry and textures were built with
+	struct BuildConfig
+	{
+		uint32_t meshLodCount;
+		float meshLodReduction;
+		uint32_t clusterTriangleCount;
+		uint32_t textureCompression;
+	};
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		uint64_t sourceHash;
+		BuildConfig config;
+		uint32_t externalFileCount;
+
+		uint32_t nodeCount;
+		uint32_t meshCount;
+		uint32_t primitiveCount;
+		uint32_t lodCount;
+		uint32_t clusterCount;
+		uint32_t materialCount;
+		uint32_t samplerCount;
+		uint32_t textureCount;
+		uint32_t indexCount;
+		uint32_t vertexCount;
+
+		glm::mat4 dequantization;
+		float boundingRadius;
+		uint32_t modelLodCount;
+
+		// Byte offsets from the start of the file
+		uint64_t nodeOffset;
+		uint64_t meshOffset;
+		uint64_t primitiveOffset;
+		uint64_t lodOffset;
+		uint64_t clusterOffset;
+		uint64_t materialOffset;
+		uint64_t samplerOffset;
+		uint64_t textureOffset;
+		uint64_t indexOffset;
+		uint64_t vertexOffset;
+		uint64_t externalFileOffset;
+		uint64_t pathOffset;
+		uint64_t pathSize;
+	};
+
+	// Buffer or image the source refers to, the path is relative to the source folder and stored in the path block
+	struct ExternalFileEntry
+	{
+		uint64_t size;
+		int64_t time;
+		uint64_t hash;
+		uint32_t pathOffset;
+		uint32_t pathLength;
+	};
+
+	struct NodeEntry
+	{
+		glm::vec3 translation;
+		glm::quat rotation;
+		glm::vec3 scale;
+		uint32_t parent;
+	};
+
+	struct MeshEntry
+	{
+		uint32_t node;
+		uint32_t firstPrimitive;
+		uint32_t primitiveCount;
+	};
+
+	struct PrimitiveEntry
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		uint32_t vertexCount;
+		uint32_t hasIndices;
+		uint32_t material;
+		uint32_t firstLod;
+		uint32_t lodCount;
+		uint32_t firstCluster;
+		uint32_t clusterCount;
+	};
+
+	// Simplified index ranges of a primitive, coarsest last
+	struct LodEntry
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+	};
+
+	// Bounds in the quantized space of the positions
+	struct ClusterEntry
+	{
+		glm::vec4 sphere;
+		glm::vec4 cone;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+	};
+
+	// Texture order as Material::BindlessData, -1 is the default texture or sampler
+	struct MaterialEntry
+	{
+		int32_t textures[5];
+		int32_t samplers[5];
+		Material::PushData pushData;
+	};
+
+	struct SamplerEntry
+	{
+		int32_t minFilter;
+		int32_t magFilter;
+		int32_t wrapU;
+		int32_t wrapV;
+	};
+
+	// Mip levels follow each other from dataOffset, level 0 first. hash is the AssetCache identity
+	struct TextureEntry
+	{
+		uint64_t hash;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevels;
+		uint32_t format;
+		uint64_t dataOffset;
+		uint64_t dataSize;
+	};
+
+	BuildConfig getBuildConfig()
+	{
+		BuildConfig config = {};
+		config.meshLodCount = MESH_LOD_COUNT;
+		config.meshLodReduction = MESH_LOD_REDUCTION;
+		config.clusterTriangleCount = CLUSTER_TRIANGLE_COUNT;
+		config.textureCompression = TEXTURE_COMPRESSION;
+		return config;
+	}
+
+	std::string getFolderPath(const std::string& sourcePath)
+	{
+		size_t pos = sourcePath.find_last_of("/\\");
+		return pos != std::string::npos ? sourcePath.substr(0, pos + 1) : std::string();
+	}
+
+	template<typename T>
+	uint64_t writeArray(std::ofstream& file, const T* data, size_t count)
+	{
+		uint64_t offset = static_cast<uint64_t>(file.tellp());
+		if (count > 0)
+			file.write(reinterpret_cast<const char*>(data), sizeof(T) * count);
+		return offset;
+	}
+
+	template<typename T>
+	const T* readArray(const MappedFile& file, uint64_t offset, uint32_t count)
+	{
+		if (offset + sizeof(T) * (uint64_t)count > file.getSize())
+			return nullptr;
+		return reinterpret_cast<const T*>(file.getData() + offset);
+	}
+
+	template<typename T>
+	int32_t indexOf(const T* element, const std::vector<T*>& elements)
+	{
+		auto it = std::find(elements.begin(), elements.end(), element);
+		return it != elements.end() ? static_cast<int32_t>(it - elements.begin()) : -1;
+	}
+}
+
+bool ModelCache::write(const std::string& sourcePath, const Model& model, const std::vector<std::string>& externalFiles)
+{
+	JAS_PROFILER_SAMPLE_FUNCTION();
+	SourceInfo info;
+	if (!getSourceInfo(sourcePath, info))
+		return false;
+
+	// A missing file can not be checked later, the cache would be used no matter what replaces it
+	std::string folderPath = getFolderPath(sourcePath);
+	std::vector<ExternalFileEntry> files(externalFiles.size());
+	std::string paths;
+	for (size_t i = 0; i < externalFiles.size(); i++)
+	{
+		std::string filePath = folderPath + externalFiles[i];
+		SourceInfo fileInfo;
+		if (!getSourceInfo(filePath, fileInfo)) {
+			JAS_WARN("Model cache not written, {} is missing", filePath.c_str());
+			return false;
+		}
+		files[i] = { fileInfo.size, fileInfo.time, hashFile(filePath), (uint32_t)paths.size(), (uint32_t)externalFiles[i].size() };
+		paths += externalFiles[i];
+	}
+
+	std::string cachePath = getCachePath(sourcePath);
+	std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		JAS_WARN("Could not write model cache {}", cachePath.c_str());
+		return false;
+	}
+
+	// Flatten everything that holds pointers into indices
+	std::vector<NodeEntry> nodes(model.sceneGraph.size());
+	for (uint32_t i = 0; i < model.sceneGraph.size(); i++)
+		nodes[i] = { model.sceneGraph.getTranslation(i), model.sceneGraph.getRotation(i), model.sceneGraph.getScale(i), model.sceneGraph.getParent(i) };
+
+	std::vector<MeshEntry> meshes;
+	std::vector<PrimitiveEntry> primitives;
+	std::vector<LodEntry> lods;
+	for (const Mesh& mesh : model.meshes)
+	{
+		meshes.push_back({ mesh.node, (uint32_t)primitives.size(), (uint32_t)mesh.primitives.size() });
+		for (const Primitive& primitive : mesh.primitives)
+		{
+			primitives.push_back({ primitive.firstIndex, primitive.indexCount, primitive.vertexCount, primitive.hasIndices ? 1u : 0u, primitive.material->index,
+				(uint32_t)lods.size(), (uint32_t)primitive.lods.size(), primitive.firstCluster, primitive.clusterCount });
+			for (const PrimitiveLod& lod : primitive.lods)
+				lods.push_back({ lod.firstIndex, lod.indexCount });
+		}
+	}
+
+	std::vector<ClusterEntry> clusters;
+	for (const Cluster& cluster : model.clusters)
+		clusters.push_back({ cluster.sphere, cluster.cone, cluster.firstIndex, cluster.indexCount });
+
+	std::vector<MaterialEntry> materials(model.materials.size());
+	for (size_t i = 0; i < model.materials.size(); i++)
+	{
+		const Material& material = model.materials[i];
+		const Material::Tex* texs[5] = { &material.baseColorTexture, &material.metallicRoughnessTexture, &material.normalTexture, &material.occlusionTexture, &material.emissiveTexture };
+		for (uint32_t t = 0; t < 5; t++) {
+			materials[i].textures[t] = indexOf(texs[t]->texture, model.textures);
+			materials[i].samplers[t] = indexOf(texs[t]->sampler, model.samplers);
+		}
+		materials[i].pushData = material.pushData;
+	}
+
+	std::vector<SamplerEntry> samplers(model.samplers.size());
+	for (size_t i = 0; i < model.samplers.size(); i++)
+		samplers[i] = { model.samplers[i]->getMinFilter(), model.samplers[i]->getMagFilter(), model.samplers[i]->getWrapU(), model.samplers[i]->getWrapV() };
+
+	// The header is written last when all offsets are known
+	Header header = {};
+	header.magic = CACHE_MAGIC;
+	header.version = CACHE_VERSION;
+	header.sourceSize = info.size;
+	header.sourceTime = info.time;
+	header.sourceHash = hashFile(sourcePath);
+	header.config = getBuildConfig();
+	header.externalFileCount = (uint32_t)files.size();
+	header.pathSize = paths.size();
+	header.nodeCount = (uint32_t)nodes.size();
+	header.meshCount = (uint32_t)meshes.size();
+	header.primitiveCount = (uint32_t)primitives.size();
+	header.lodCount = (uint32_t)lods.size();
+	header.clusterCount = (uint32_t)clusters.size();
+	header.materialCount = (uint32_t)materials.size();
+	header.samplerCount = (uint32_t)samplers.size();
+	header.textureCount = (uint32_t)model.textures.size();
+	header.indexCount = (uint32_t)model.indices.size();
+	header.vertexCount = (uint32_t)model.packedVertices.size();
+	header.dequantization = model.dequantization;
+	header.boundingRadius = model.boundingRadius;
+	header.modelLodCount = model.lodCount;
+	file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+
+	header.nodeOffset = writeArray(file, nodes.data(), nodes.size());
+	header.meshOffset = writeArray(file, meshes.data(), meshes.size());
+	header.primitiveOffset = writeArray(file, primitives.data(), primitives.size());
+	header.lodOffset = writeArray(file, lods.data(), lods.size());
+	header.clusterOffset = writeArray(file, clusters.data(), clusters.size());
+	header.materialOffset = writeArray(file, materials.data(), materials.size());
+	header.samplerOffset = writeArray(file, samplers.data(), samplers.size());
+
+	// Texture table followed by the texture data
+	std::vector<TextureEntry> textures(model.textures.size());
+	header.textureOffset = writeArray(file, textures.data(), textures.size());
+	for (size_t i = 0; i < model.textures.size(); i++)
+	{
+		const std::vector<uint8_t>& data = model.imageData[i];
+		Texture* texture = model.textures[i];
+		// Block compressed textures keep their whole chain, RGBA8 only level 0. Streamed textures are smaller than their source
+		VkExtent2D extent = AssetCache::get().getTextureExtent(texture);
+		uint32_t mipLevels = TextureCompressor::isCompressed(texture->getFormat()) ? Image::getMipLevelCount(extent.width, extent.height) : 1;
+		textures[i] = { AssetCache::get().getTextureHash(texture), extent.width, extent.height, mipLevels, (uint32_t)texture->getFormat(), 0, data.size() };
+		textures[i].dataOffset = writeArray(file, data.data(), data.size());
+	}
+
+	header.indexOffset = writeArray(file, model.indices.data(), model.indices.size());
+	header.vertexOffset = writeArray(file, model.packedVertices.data(), model.packedVertices.size());
+	header.externalFileOffset = writeArray(file, files.data(), files.size());
+	header.pathOffset = writeArray(file, paths.data(), paths.size());
+
+	file.seekp(header.textureOffset);
+	writeArray(file, textures.data(), textures.size());
+	file.seekp(0);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+
+	if (!file.good()) {
+		JAS_WARN("Failed writing model cache {}", cachePath.c_str());
+		file.close();
+		std::error_code error;
+		std::filesystem::remove(cachePath, error);
+		return false;
+	}
+	JAS_INFO("Wrote model cache {}", cachePath.c_str());
+	return true;
+}
+
+bool ModelCache::read(const std::string& sourcePath, Model& model, const Material::Tex& defaultTex)
+{
+	JAS_PROFILER_SAMPLE_FUNCTION();
+	std::string cachePath = getCachePath(sourcePath);
+	MappedFile file;
+	if (!file.open(cachePath) || file.getSize() < sizeof(Header))
+		return false;
+
+	const Header& header = *reinterpret_cast<const Header*>(file.getData());
+	if (header.magic != CACHE_MAGIC || header.version != CACHE_VERSION) {
+		JAS_INFO("Model cache {} is from another version, rebuilding", cachePath.c_str());
+		return false;
+	}
+
+	// Time and size is enough when nothing changed, the hash saves a rebuild when only the time did
+	SourceInfo info;
+	if (!getSourceInfo(sourcePath, info) || info.size != header.sourceSize)
+		return false;
+	if (info.time != header.sourceTime && hashFile(sourcePath) != header.sourceHash) {
+		JAS_INFO("Model cache {} is out of date, rebuilding", cachePath.c_str());
+		return false;
+	}
+	BuildConfig config = getBuildConfig();
+	if (std::memcmp(&config, &header.config, sizeof(BuildConfig)) != 0) {
+		JAS_INFO("Model cache {} was built with other settings, rebuilding", cachePath.c_str());
+		return false;
+	}
+
+	// The buffers and images are checked the same way as the source
+	const ExternalFileEntry* files = readArray<ExternalFileEntry>(file, header.externalFileOffset, header.externalFileCount);
+	if (!files || header.pathOffset + header.pathSize > file.getSize())
+		return false;
+	const char* paths = reinterpret_cast<const char*>(file.getData() + header.pathOffset);
+	std::string folderPath = getFolderPath(sourcePath);
+	for (uint32_t i = 0; i < header.externalFileCount; i++)
+	{
+		if ((uint64_t)files[i].pathOffset + files[i].pathLength > header.pathSize)
+			return false;
+		std::string filePath = folderPath + std::string(paths + files[i].pathOffset, files[i].pathLength);
+		SourceInfo fileInfo;
+		if (!getSourceInfo(filePath, fileInfo) || fileInfo.size != files[i].size
+			|| (fileInfo.time != files[i].time && hashFile(filePath) != files[i].hash)) {
+			JAS_INFO("Model cache {} is out of date, {} changed, rebuilding", cachePath.c_str(), filePath.c_str());
+			return false;
+		}
+	}
+
+	const NodeEntry* nodes = readArray<NodeEntry>(file, header.nodeOffset, header.nodeCount);
+	const MeshEntry* meshes = readArray<MeshEntry>(file, header.meshOffset, header.meshCount);
+	const PrimitiveEntry* primitives = readArray<PrimitiveEntry>(file, header.primitiveOffset, header.primitiveCount);
+	const LodEntry* lods = readArray<LodEntry>(file, header.lodOffset, header.lodCount);
+	const ClusterEntry* clusters = readArray<ClusterEntry>(file, header.clusterOffset, header.clusterCount);
+	const MaterialEntry* materials = readArray<MaterialEntry>(file, header.materialOffset, header.materialCount);
+	const SamplerEntry* samplers = readArray<SamplerEntry>(file, header.samplerOffset, header.samplerCount);
+	const TextureEntry* textures = readArray<TextureEntry>(file, header.textureOffset, header.textureCount);
+	const uint32_t* indices = readArray<uint32_t>(file, header.indexOffset, header.indexCount);
+	const PackedVertex* vertices = readArray<PackedVertex>(file, header.vertexOffset, header.vertexCount);
+	if (!nodes || !meshes || !primitives || !lods || !clusters || !materials || !samplers || !textures || !indices || !vertices) {
+		JAS_WARN("Model cache {} is truncated, rebuilding", cachePath.c_str());
+		return false;
+	}
+	// Every primitive has a material, the indices into the tables are checked before anything is acquired
+	for (uint32_t i = 0; i < header.meshCount; i++)
+	{
+		if ((uint64_t)meshes[i].firstPrimitive + meshes[i].primitiveCount > header.primitiveCount) {
+			JAS_WARN("Model cache {} is corrupt, rebuilding", cachePath.c_str());
+			return false;
+		}
+		for (uint32_t p = 0; p < meshes[i].primitiveCount; p++)
+			if (primitives[meshes[i].firstPrimitive + p].material >= header.materialCount) {
+				JAS_WARN("Model cache {} is corrupt, rebuilding", cachePath.c_str());
+				return false;
+			}
+	}
+	for (uint32_t i = 0; i < header.textureCount; i++)
+	{
+		if (textures[i].dataOffset + textures[i].dataSize > file.getSize())
+			return false;
+		// Written on a device with block compression, the textures have to be decoded again
+		if (!TextureCompressor::isSupported((VkFormat)textures[i].format)) {
+			JAS_INFO("Model cache {} has textures in a format the device can not sample, rebuilding", cachePath.c_str());
+			return false;
+		}
+	}
+
+	// Samplers and textures first, the materials point to them
+	model.samplers.resize(header.samplerCount);
+	for (uint32_t i = 0; i < header.samplerCount; i++)
+		model.samplers[i] = AssetCache::get().acquireSampler((VkFilter)samplers[i].minFilter, (VkFilter)samplers[i].magFilter, (VkSamplerAddressMode)samplers[i].wrapU, (VkSamplerAddressMode)samplers[i].wrapV);
+
+	model.textures.resize(header.textureCount);
+	model.imageData.resize(header.textureCount);
+	for (uint32_t i = 0; i < header.textureCount; i++)
+	{
+		const TextureEntry& texture = textures[i];
+		bool created = false;
+		model.textures[i] = AssetCache::get().acquireTexture(texture.hash, texture.width, texture.height, (VkFormat)texture.format, created);
+		if (AssetCache::get().isUploaded(model.textures[i]))
+			continue;
+
+		// Only the levels the texture is created with: the mip tail of a streamed texture, as the TextureStreamer reads
+		// the finer levels itself, or level 0 of RGBA8 textures whose other levels the GPU generates at upload
+		VkFormat format = (VkFormat)texture.format;
+		bool compressed = TextureCompressor::isCompressed(format);
+		uint32_t tailLevel = compressed ? TextureStreamer::getTailLevel(texture.width, texture.height) : 0;
+		uint64_t tailOffset = std::min(TextureCompressor::getChainSize(format, texture.width, texture.height, 1, tailLevel), texture.dataSize);
+		uint64_t tailSize = TextureCompressor::getChainSize(format, model.textures[i]->getWidth(), model.textures[i]->getHeight(), 1, compressed ? model.textures[i]->getMipLevels() : 1);
+		const uint8_t* data = file.getData() + texture.dataOffset + tailOffset;
+		model.imageData[i].assign(data, data + std::min(tailSize, texture.dataSize - tailOffset));
+	}
+
+	model.hasMaterialMemory = header.materialCount > 0;
+	model.materials.resize(header.materialCount);
+	for (uint32_t i = 0; i < header.materialCount; i++)
+	{
+		Material& material = model.materials[i];
+		Material::Tex* texs[5] = { &material.baseColorTexture, &material.metallicRoughnessTexture, &material.normalTexture, &material.occlusionTexture, &material.emissiveTexture };
+		for (uint32_t t = 0; t < 5; t++)
+		{
+			int32_t texture = materials[i].textures[t];
+			int32_t sampler = materials[i].samplers[t];
+			texs[t]->texture = texture >= 0 && texture < (int32_t)header.textureCount ? model.textures[texture] : defaultTex.texture;
+			texs[t]->sampler = sampler >= 0 && sampler < (int32_t)header.samplerCount ? model.samplers[sampler] : defaultTex.sampler;
+		}
+		material.index = i;
+		material.pushData = materials[i].pushData;
+	}
+
+	model.sceneGraph.clear();
+	for (uint32_t i = 0; i < header.nodeCount; i++)
+		model.sceneGraph.addNode(nodes[i].parent, nodes[i].translation, nodes[i].rotation, nodes[i].scale);
+	model.sceneGraph.update();
+
+	model.meshes.resize(header.meshCount);
+	for (uint32_t i = 0; i < header.meshCount; i++)
+	{
+		Mesh& mesh = model.meshes[i];
+		mesh.node = meshes[i].node;
+		mesh.primitives.resize(meshes[i].primitiveCount);
+		for (uint32_t p = 0; p < meshes[i].primitiveCount; p++)
+		{
+			const PrimitiveEntry& entry = primitives[meshes[i].firstPrimitive + p];
+			Primitive& primitive = mesh.primitives[p];
+			primitive.firstIndex = entry.firstIndex;
+			primitive.indexCount = entry.indexCount;
+			primitive.vertexCount = entry.vertexCount;
+			primitive.hasIndices = entry.hasIndices != 0;
+			primitive.material = &model.materials[entry.material];
+			primitive.lods.clear();
+			for (uint32_t l = entry.firstLod; l < entry.firstLod + entry.lodCount && l < header.lodCount; l++)
+				primitive.lods.push_back({ lods[l].firstIndex, lods[l].indexCount });
+			bool clustersValid = entry.firstCluster + entry.clusterCount <= header.clusterCount;
+			primitive.firstCluster = clustersValid ? entry.firstCluster : 0;
+			primitive.clusterCount = clustersValid ? entry.clusterCount : 0;
+		}
+	}
+
+	model.clusters.resize(header.clusterCount);
+	for (uint32_t i = 0; i < header.clusterCount; i++)
+		model.clusters[i] = { clusters[i].sphere, clusters[i].cone, clusters[i].firstIndex, clusters[i].indexCount };
+
+	model.indices.assign(indices, indices + header.indexCount);
+	model.packedVertices.assign(vertices, vertices + header.vertexCount);
+	model.dequantization = header.dequantization;
+	model.boundingRadius = header.boundingRadius;
+	model.lodCount = std::max(header.modelLodCount, 1u);
+
+	JAS_INFO("Loaded model cache {}", cachePath.c_str());
+	return true;
+}
+
+std::string ModelCache::getCachePath(const std::string& sourcePath)
+{
+	return sourcePath + ".cache";
+}
+
+bool ModelCache::getSourceInfo(const std::string& sourcePath, SourceInfo& info)
+{
+	std::error_code error;
+	info.size = static_cast<uint64_t>(std::filesystem::file_size(sourcePath, error));
+	if (error)
+		return false;
+	info.time = static_cast<int64_t>(std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count());
+	return !error;
+}
+
+uint64_t ModelCache::hashFile(const std::string& filePath)
+{
+	MappedFile file;
+	if (!file.open(filePath))
+		return AssetCache::HASH_SEED;
+	return AssetCache::hash(file.getData(), (size_t)file.getSize());
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "jaspch.h"
+
+#include "Models/Model/Model.h"
+
+/*
+	Preprocessed binary copy of a loaded model, written next to the source file as <source>.cache.
+	It holds the flattened node table, meshes, materials, samplers, the packed vertex and index data ready to upload
+	and the texture data (block compressed mip chains, or level 0 in RGBA8), so a later load is a memory mapping and a few copies instead of glTF parsing,
+	mesh optimization and image decoding.
+	The cache is used if its version and the Config.h settings it was built with match, and the source file and every
+	buffer and image file it refers to have the same size and modification time, or the same content hash when only the time differs (e.g. after a checkout).
+*/
+class ModelCache
+{
+public:
+	// Needs the decoded images in model.imageData, write before the textures are transferred.
+	// externalFiles are the buffer and image paths relative to the source folder
+	static bool write(const std::string& sourcePath, const Model& model, const std::vector<std::string>& externalFiles);
+
+	// Fills the model and acquires its textures and samplers from the AssetCache, image data is only copied for textures
+	// that are not uploaded yet. Material textures and samplers that were not set in the source use defaultTex
+	static bool read(const std::string& sourcePath, Model& model, const Material::Tex& defaultTex);
+
+	static std::string getCachePath(const std::string& sourcePath);
+
+private:
+	struct SourceInfo
+	{
+		uint64_t size;
+		int64_t time;
+	};
+
+	static bool getSourceInfo(const std::string& sourcePath, SourceInfo& info);
+	static uint64_t hashFile(const std::string& filePath);
+};
@@ -13,20 +13,76 @@ ModelRenderer::~ModelRenderer()
 	this->pushConstants.cleanup();
 }
 
-void ModelRenderer::record(Model* model, glm::mat4 transform, CommandBuffer* commandBuffer, Pipeline* pipeline, const std::vector<VkDescriptorSet>& sets, const std::vector<uint32_t>& offsets, uint32_t instanceCount)
+void ModelRenderer::record(Model* model, glm::mat4 transform, CommandBuffer* commandBuffer, Pipeline* pipeline, Span<VkDescriptorSet> sets, Span<uint32_t> offsets, uint32_t instanceCount)
 {
 	// TODO: Use different materials, can still use same pipeline if all meshes uses same type of material (i.e. PBR)!
-	if (model->vertexBuffer.getBuffer() == VK_NULL_HANDLE)
+	if (model->getVertexBuffer() == VK_NULL_HANDLE)
 		return;
 
 	//VkBuffer vertexBuffers[] = { this->model.vertexBuffer.getBuffer() };
 	//VkDeviceSize vertOffsets[] = { 0 };
 	//this->cmdBuffs[i]->cmdBindVertexBuffers(0, 1, vertexBuffers, vertOffsets);
 	if (model->indices.empty() == false)
-		commandBuffer->cmdBindIndexBuffer(model->indexBuffer.getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+		commandBuffer->cmdBindIndexBuffer(model->getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
 
-	for (Model::Node& node : model->nodes)
-		drawNode(commandBuffer, pipeline, node, transform, sets, offsets, instanceCount);
+	for (Mesh& mesh : model->meshes)
+		drawMesh(commandBuffer, pipeline, model, mesh, transform, sets, offsets, instanceCount);
+}
+
+void ModelRenderer::recordDrawList(const DrawList& drawList, CommandBuffer* commandBuffer, Span<VkDescriptorSet> sets, Span<uint32_t> offsets, uint32_t instanceCount, bool bindMaterials)
+{
+	DrawList::Range range = { 0, static_cast<uint32_t>(drawList.getDraws().size()) };
+	recordDrawList(drawList, range, commandBuffer, sets, offsets, instanceCount, bindMaterials);
+}
+
+void ModelRenderer::recordDrawList(const DrawList& drawList, DrawList::Range range, CommandBuffer* commandBuffer, Span<VkDescriptorSet> sets, Span<uint32_t> offsets, uint32_t instanceCount, bool bindMaterials)
+{
+	const std::vector<DrawList::Draw>& draws = drawList.getDraws();
+	const std::vector<glm::mat4>& transforms = drawList.getTransforms();
+	for (uint32_t i = range.first; i < range.first + range.count; i++)
+	{
+		const DrawList::Draw& draw = draws[i];
+		// The first draw of a range has no previous state in this command buffer
+		uint32_t changes = i == range.first ? (uint32_t)DrawList::CHANGE_ALL : draw.changes;
+		changes = (changes & DrawList::CHANGE_PIPELINE) ? (uint32_t)DrawList::CHANGE_ALL : changes;
+
+		if (changes & DrawList::CHANGE_PIPELINE)
+		{
+			commandBuffer->cmdBindPipeline(draw.pipeline);
+			if (!bindMaterials)
+				commandBuffer->cmdBindDescriptorSets(draw.pipeline, 0, sets, offsets);
+		}
+
+		if (changes & DrawList::CHANGE_TRANSFORM)
+			commandBuffer->cmdPushConstants(draw.pipeline, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstantData), &transforms[draw.transformIndex]);
+
+		if (changes & DrawList::CHANGE_MATERIAL)
+		{
+			commandBuffer->cmdPushConstants(draw.pipeline, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(PushConstantData), sizeof(Material::PushData), &draw.material->pushData);
+			if (bindMaterials)
+				bindMaterialSets(commandBuffer, draw.pipeline, draw.model, draw.material, sets, offsets);
+		}
+
+		if (draw.hasIndices)
+			commandBuffer->cmdDrawIndexed(draw.indexCount, instanceCount, draw.model->getFirstIndex() + draw.firstIndex, draw.model->getVertexOffset(), 0);
+		else
+			commandBuffer->cmdDraw(draw.vertexCount, instanceCount, (uint32_t)draw.model->getVertexOffset(), 0);
+	}
+}
+
+void ModelRenderer::recordIndirect(Model* model, CommandBuffer* commandBuffer, Pipeline* pipeline, Span<VkDescriptorSet> sets, Span<uint32_t> offsets,
+	VkBuffer drawBuffer, VkDeviceSize drawOffset, uint32_t drawCount, VkBuffer countBuffer, VkDeviceSize countOffset)
+{
+	if (model->getIndexBuffer() == VK_NULL_HANDLE || drawCount == 0)
+		return;
+
+	commandBuffer->cmdBindPipeline(pipeline);
+	commandBuffer->cmdBindIndexBuffer(model->getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+	commandBuffer->cmdBindDescriptorSets(pipeline, 0, sets, offsets);
+	if (countBuffer != VK_NULL_HANDLE)
+		commandBuffer->cmdDrawIndexedIndirectCount(drawBuffer, drawOffset, countBuffer, countOffset, drawCount, sizeof(VkDrawIndexedIndirectCommand));
+	else
+		commandBuffer->cmdDrawIndexedIndirect(drawBuffer, drawOffset, drawCount, sizeof(VkDrawIndexedIndirectCommand));
 }
 
 void ModelRenderer::init()
@@ -57,37 +113,35 @@ ModelRenderer::ModelRenderer() : size(0)
 	this->size = this->pushConstants.getSize();
 }
 
-void ModelRenderer::drawNode(CommandBuffer* commandBuffer, Pipeline* pipeline, Model::Node& node, glm::mat4 transform, const std::vector<VkDescriptorSet>& sets, const std::vector<uint32_t>& offsets, uint32_t instanceCount)
+void ModelRenderer::bindMaterialSets(CommandBuffer* commandBuffer, Pipeline* pipeline, Model* model, const Material* material, Span<VkDescriptorSet> sets, Span<uint32_t> offsets)
+{
+	uint32_t numNonMaterialSets = sets.size() - (uint32_t)model->materials.size();
+	JAS_ASSERT(numNonMaterialSets < CMD_MAX_BOUND_SETS, "Too many descriptor sets for a model!");
+	VkDescriptorSet setsUsed[CMD_MAX_BOUND_SETS];
+	for (uint32_t i = 0; i < numNonMaterialSets; i++)
+		setsUsed[i] = sets[i];
+	setsUsed[numNonMaterialSets] = sets[numNonMaterialSets + material->index];
+	commandBuffer->cmdBindDescriptorSets(pipeline, 0, Span<VkDescriptorSet>(setsUsed, numNonMaterialSets + 1), offsets);
+}
+
+void ModelRenderer::drawMesh(CommandBuffer* commandBuffer, Pipeline* pipeline, Model* model, Mesh& mesh, glm::mat4 transform, Span<VkDescriptorSet> sets, Span<uint32_t> offsets, uint32_t instanceCount)
 {
-	if (node.hasMesh)
+	// Set transformation matrix, the world matrix of the node is kept up to date by the scene graph.
+	// Positions are quantized, the dequantization is applied first
+	PushConstantData pushConstantData;
+	pushConstantData.matrix = transform * model->sceneGraph.getWorldMatrix(mesh.node) * model->dequantization;
+	commandBuffer->cmdPushConstants(pipeline, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstantData), &pushConstantData);
+
+	for (Primitive& primitive : mesh.primitives)
 	{
-		// Set transformation matrix
-		PushConstantData pushConstantData;
-		pushConstantData.matrix = node.parent != nullptr ? (transform * node.parent->matrix * node.matrix) : (transform * node.matrix);
-		commandBuffer->cmdPushConstants(pipeline, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstantData), &pushConstantData);
+		Material::PushData& pushData = primitive.material->pushData;
+		commandBuffer->cmdPushConstants(pipeline, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(PushConstantData), sizeof(Material::PushData), &pushData);
 
-		Mesh& mesh = node.mesh;
-		for (Primitive& primitive : mesh.primitives)
-		{
-			Material::PushData& pushData = primitive.material->pushData;
-			commandBuffer->cmdPushConstants(pipeline, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(PushConstantData), sizeof(Material::PushData), &pushData);
-
-			uint32_t numNonMaterialSets = sets.size() - (uint32_t)node.model->materials.size();
-			std::vector<VkDescriptorSet> setsUsed(numNonMaterialSets + 1);
-			for(uint32_t i = 0; i < numNonMaterialSets; i++)
-				setsUsed[i] = sets[i];
-			uint32_t materialIndex = numNonMaterialSets + primitive.material->index;
-			setsUsed[numNonMaterialSets] = sets[materialIndex];
-			commandBuffer->cmdBindDescriptorSets(pipeline, 0, setsUsed, offsets);
-
-			if (primitive.hasIndices)
-				commandBuffer->cmdDrawIndexed(primitive.indexCount, instanceCount, primitive.firstIndex, 0, 0);
-			else
-				commandBuffer->cmdDraw(primitive.vertexCount, instanceCount, 0, 0);
-		}
-	}
+		bindMaterialSets(commandBuffer, pipeline, model, primitive.material, sets, offsets);
 
-	// Draw child nodes
-	for (Model::Node& child : node.children)
-		drawNode(commandBuffer, pipeline, child, transform, sets, offsets, instanceCount);
+		if (primitive.hasIndices)
+			commandBuffer->cmdDrawIndexed(primitive.indexCount, instanceCount, model->getFirstIndex() + primitive.firstIndex, model->getVertexOffset(), 0);
+		else
+			commandBuffer->cmdDraw(primitive.vertexCount, instanceCount, (uint32_t)model->getVertexOffset(), 0);
+	}
 }
@@ -1,7 +1,9 @@
 
 #include "Models/Model/Model.h"
+#include "Models/DrawList.h"
 #include "Vulkan/Pipeline/PushConstants.h"
 #include "Vulkan/Pipeline/Pipeline.h"
+#include "Core/Span.h"
 
 class CommandBuffer;
 class Pipeline;
@@ -16,7 +18,21 @@ public:
 		ModelRender has its own push constants at the start of the data. You need to offset your push constants with getPushConstantSize()!
 		sets must have all the material sets at the end, so the recording can choose from them when needed.
 	*/
-	void record(Model* model, glm::mat4 transform, CommandBuffer* commandBuffer, Pipeline* pipeline, const std::vector<VkDescriptorSet>& sets, const std::vector<uint32_t>& offsets, uint32_t instanceCount = 1);
+	void record(Model* model, glm::mat4 transform, CommandBuffer* commandBuffer, Pipeline* pipeline, Span<VkDescriptorSet> sets, Span<uint32_t> offsets, uint32_t instanceCount = 1);
+	/*
+		Replays a compiled draw list, or the range [first, first + count) of it. Push constants and pipelines are only
+		recorded when they change between draws. sets are bound after every pipeline change, the pipelines in the list must use the same set layouts.
+		With bindMaterials the material sets are expected at the end of sets like in record, otherwise materials are selected with materialIndex.
+	*/
+	void recordDrawList(const DrawList& drawList, CommandBuffer* commandBuffer, Span<VkDescriptorSet> sets, Span<uint32_t> offsets, uint32_t instanceCount, bool bindMaterials);
+	void recordDrawList(const DrawList& drawList, DrawList::Range range, CommandBuffer* commandBuffer, Span<VkDescriptorSet> sets, Span<uint32_t> offsets, uint32_t instanceCount, bool bindMaterials);
+	/*
+		Draws every primitive of the model with one indirect draw, drawBuffer holds one VkDrawIndexedIndirectCommand per draw from drawOffset.
+		With a countBuffer the draw count is read from it on the GPU (max drawCount), which needs VK_KHR_draw_indirect_count.
+		The pipeline reads transforms and material parameters per draw with gl_DrawIDARB, no push constants are used.
+	*/
+	void recordIndirect(Model* model, CommandBuffer* commandBuffer, Pipeline* pipeline, Span<VkDescriptorSet> sets, Span<uint32_t> offsets,
+		VkBuffer drawBuffer, VkDeviceSize drawOffset, uint32_t drawCount, VkBuffer countBuffer = VK_NULL_HANDLE, VkDeviceSize countOffset = 0);
 
 	void init();
 
@@ -32,7 +48,8 @@ private:
 	};
 
 	ModelRenderer();
-	void drawNode(CommandBuffer* commandBuffer, Pipeline* pipeline, Model::Node& node, glm::mat4 transform, const std::vector<VkDescriptorSet>& sets, const std::vector<uint32_t>& offsets, uint32_t instanceCount);
+	void bindMaterialSets(CommandBuffer* commandBuffer, Pipeline* pipeline, Model* model, const Material* material, Span<VkDescriptorSet> sets, Span<uint32_t> offsets);
+	void drawMesh(CommandBuffer* commandBuffer, Pipeline* pipeline, Model* model, Mesh& mesh, glm::mat4 transform, Span<VkDescriptorSet> sets, Span<uint32_t> offsets, uint32_t instanceCount);
 	
 private:
 	PushConstants pushConstants;
@@ -0,0 +1,198 @@
+#include "jaspch.h"
+#include "SceneGraph.h"
+#include "Threading/ThreadDispatcher.h"
+#include "Core/CPUProfiler.h"
+
+#include <glm/gtx/transform.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <glm/gtx/matrix_decompose.hpp>
+
+SceneGraph::SceneGraph() : dirtyCount(0)
+{
+}
+
+SceneGraph::~SceneGraph()
+{
+}
+
+uint32_t SceneGraph::addNode(uint32_t parent, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+{
+	uint32_t node = pushNode(parent);
+	this->translations[node] = translation;
+	this->rotations[node] = rotation;
+	this->scales[node] = scale;
+	composeLocal(node);
+	return node;
+}
+
+uint32_t SceneGraph::addNode(uint32_t parent, const glm::mat4& localMatrix)
+{
+	uint32_t node = pushNode(parent);
+	setLocalMatrix(node, localMatrix);
+	return node;
+}
+
+void SceneGraph::setTranslation(uint32_t node, const glm::vec3& translation)
+{
+	this->translations[node] = translation;
+	composeLocal(node);
+}
+
+void SceneGraph::setRotation(uint32_t node, const glm::quat& rotation)
+{
+	this->rotations[node] = rotation;
+	composeLocal(node);
+}
+
+void SceneGraph::setScale(uint32_t node, const glm::vec3& scale)
+{
+	this->scales[node] = scale;
+	composeLocal(node);
+}
+
+void SceneGraph::setLocalMatrix(uint32_t node, const glm::mat4& localMatrix)
+{
+	// Keep the TRS in sync so a later setTranslation does not lose the rest of the matrix
+	glm::vec3 skew;
+	glm::vec4 perspective;
+	glm::decompose(localMatrix, this->scales[node], this->rotations[node], this->translations[node], skew, perspective);
+	this->localMatrices[node] = localMatrix;
+	markDirty(node);
+}
+
+uint32_t SceneGraph::update()
+{
+	if (this->dirtyCount == 0)
+		return 0;
+
+	JAS_PROFILER_SAMPLE_FUNCTION();
+	std::vector<Range> ranges;
+	findDirtyRanges(ranges);
+
+	uint32_t updated = 0;
+	for (Range range : ranges)
+	{
+		updateRange(range);
+		updated += range.end - range.first;
+	}
+	// Every dirty node is inside one of the ranges
+	this->dirtyCount = 0;
+	return updated;
+}
+
+uint32_t SceneGraph::updateParallel(uint32_t minJobSize)
+{
+	if (this->dirtyCount == 0)
+		return 0;
+
+	JAS_PROFILER_SAMPLE_FUNCTION();
+	std::vector<Range> ranges;
+	findDirtyRanges(ranges);
+
+	// Group neighbouring subtrees into jobs, the last job is run on this thread
+	std::vector<std::vector<Range>> jobs(1);
+	uint32_t jobSize = 0;
+	uint32_t updated = 0;
+	for (Range range : ranges)
+	{
+		if (jobSize >= minJobSize) {
+			jobs.emplace_back();
+			jobSize = 0;
+		}
+		jobs.back().push_back(range);
+		jobSize += range.end - range.first;
+		updated += range.end - range.first;
+	}
+
+	std::vector<uint32_t> ids;
+	ids.reserve(jobs.size() - 1);
+	for (size_t i = 0; i + 1 < jobs.size(); i++)
+	{
+		const std::vector<Range>* job = &jobs[i];
+		ids.push_back(ThreadDispatcher::dispatch([this, job]() {
+			for (Range range : *job)
+				updateRange(range);
+		}));
+	}
+	for (Range range : jobs.back())
+		updateRange(range);
+
+	// The dispatcher also runs the cull, streaming and pipeline jobs, the wait sleeps under its mutex until these are done
+	if (!ids.empty())
+		ThreadDispatcher::wait(ids);
+	this->dirtyCount = 0;
+	return updated;
+}
+
+void SceneGraph::clear()
+{
+	this->translations.clear();
+	this->rotations.clear();
+	this->scales.clear();
+	this->localMatrices.clear();
+	this->worldMatrices.clear();
+	this->parents.clear();
+	this->subtreeEnds.clear();
+	this->dirty.clear();
+	this->dirtyCount = 0;
+}
+
+uint32_t SceneGraph::pushNode(uint32_t parent)
+{
+	uint32_t node = size();
+	JAS_ASSERT(parent == NO_PARENT || (parent < node && this->subtreeEnds[parent] == node), "Scene graph nodes must be added in depth first order!");
+
+	this->translations.push_back(glm::vec3(0.0f));
+	this->rotations.push_back(glm::quat());
+	this->scales.push_back(glm::vec3(1.0f));
+	this->localMatrices.push_back(glm::mat4(1.0f));
+	this->worldMatrices.push_back(glm::mat4(1.0f));
+	this->parents.push_back(parent);
+	this->subtreeEnds.push_back(node + 1);
+	this->dirty.push_back(0);
+
+	// Grow the subtree of every ancestor to include the new node
+	for (uint32_t ancestor = parent; ancestor != NO_PARENT; ancestor = this->parents[ancestor])
+		this->subtreeEnds[ancestor] = node + 1;
+	return node;
+}
+
+void SceneGraph::markDirty(uint32_t node)
+{
+	if (this->dirty[node] == 0) {
+		this->dirty[node] = 1;
+		this->dirtyCount++;
+	}
+}
+
+void SceneGraph::composeLocal(uint32_t node)
+{
+	this->localMatrices[node] = glm::translate(this->translations[node]) * glm::mat4(this->rotations[node]) * glm::scale(this->scales[node]);
+	markDirty(node);
+}
+
+void SceneGraph::findDirtyRanges(std::vector<Range>& ranges) const
+{
+	// A dirty node hides every dirty node below it, skip past its subtree
+	uint32_t node = 0;
+	while (node < size())
+	{
+		if (this->dirty[node]) {
+			ranges.push_back({ node, this->subtreeEnds[node] });
+			node = this->subtreeEnds[node];
+		}
+		else
+			node++;
+	}
+}
+
+void SceneGraph::updateRange(Range range)
+{
+	// Parents come first so their world matrix is always up to date when a child reads it
+	for (uint32_t node = range.first; node < range.end; node++)
+	{
+		uint32_t parent = this->parents[node];
+		this->worldMatrices[node] = parent != NO_PARENT ? this->worldMatrices[parent] * this->localMatrices[node] : this->localMatrices[node];
+		this->dirty[node] = 0;
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "jaspch.h"
+
+#include <glm/gtc/quaternion.hpp>
+
+/*
+	Node hierarchy stored as flat arrays in depth first order, a parent is always before its children and
+	the subtree of a node is the range [index, subtreeEnd). Changing a local transform marks the node dirty,
+	update recomputes the world matrices of every dirty subtree and nothing else.
+	updateParallel splits the dirty subtrees into jobs on the ThreadDispatcher, subtrees never overlap so the jobs share no data.
+	Its caller is woken by ThreadDispatcher::wait, which reads the finished work under the dispatcher's mutex.
+*/
+class SceneGraph
+{
+public:
+	static const uint32_t NO_PARENT = UINT32_MAX;
+
+public:
+	SceneGraph();
+	~SceneGraph();
+
+	// Nodes have to be added in depth first order, the parent has to be added and its subtree not closed by an added sibling
+	uint32_t addNode(uint32_t parent, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+	uint32_t addNode(uint32_t parent, const glm::mat4& localMatrix);
+
+	void setTranslation(uint32_t node, const glm::vec3& translation);
+	void setRotation(uint32_t node, const glm::quat& rotation);
+	void setScale(uint32_t node, const glm::vec3& scale);
+	void setLocalMatrix(uint32_t node, const glm::mat4& localMatrix);
+
+	// Returns the number of world matrices which were recomputed
+	uint32_t update();
+	// Same as update, subtrees are grouped into jobs of at least minJobSize nodes and run on the ThreadDispatcher
+	uint32_t updateParallel(uint32_t minJobSize);
+
+	const glm::mat4& getWorldMatrix(uint32_t node) const { return this->worldMatrices[node]; }
+	const glm::mat4& getLocalMatrix(uint32_t node) const { return this->localMatrices[node]; }
+	const glm::vec3& getTranslation(uint32_t node) const { return this->translations[node]; }
+	const glm::quat& getRotation(uint32_t node) const { return this->rotations[node]; }
+	const glm::vec3& getScale(uint32_t node) const { return this->scales[node]; }
+	uint32_t getParent(uint32_t node) const { return this->parents[node]; }
+	uint32_t getSubtreeEnd(uint32_t node) const { return this->subtreeEnds[node]; }
+	uint32_t size() const { return static_cast<uint32_t>(this->parents.size()); }
+	bool isDirty() const { return this->dirtyCount > 0; }
+
+	void clear();
+
+private:
+	struct Range
+	{
+		uint32_t first;
+		uint32_t end;
+	};
+
+	uint32_t pushNode(uint32_t parent);
+	void markDirty(uint32_t node);
+	void composeLocal(uint32_t node);
+	// Topmost dirty nodes, their subtrees are all that needs to be updated
+	void findDirtyRanges(std::vector<Range>& ranges) const;
+	void updateRange(Range range);
+
+	std::vector<glm::vec3> translations;
+	std::vector<glm::quat> rotations;
+	std::vector<glm::vec3> scales;
+	std::vector<glm::mat4> localMatrices;
+	std::vector<glm::mat4> worldMatrices;
+	std::vector<uint32_t> parents;
+	std::vector<uint32_t> subtreeEnds;
+	std::vector<uint8_t> dirty;
+	uint32_t dirtyCount;
+};
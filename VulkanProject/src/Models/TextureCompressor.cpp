@@ -0,0 +1,472 @@
+#include "jaspch.h"
+#include "TextureCompressor.h"
+#include "TextureContainer.h"
+#include "Vulkan/Instance.h"
+#include "Vulkan/Buffers/Image.h"
+#include "Threading/ThreadManager.h"
+#include "Core/CPUProfiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+	// Interpolation weights of the 4 bit BC7 indices, out of 64
+	const uint32_t BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// Writes bits from the least significant bit of the 128 bit block upwards
+	struct BitWriter
+	{
+		uint8_t* data;
+		uint32_t position;
+
+		void write(uint32_t value, uint32_t count)
+		{
+			for (uint32_t i = 0; i < count; i++, position++)
+				data[position >> 3] |= (uint8_t)(((value >> i) & 1) << (position & 7));
+		}
+	};
+
+	uint16_t toRGB565(const float* color)
+	{
+		uint32_t r = (uint32_t)std::min(std::max(color[0] * 31.f / 255.f + 0.5f, 0.f), 31.f);
+		uint32_t g = (uint32_t)std::min(std::max(color[1] * 63.f / 255.f + 0.5f, 0.f), 63.f);
+		uint32_t b = (uint32_t)std::min(std::max(color[2] * 31.f / 255.f + 0.5f, 0.f), 31.f);
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	void fromRGB565(uint16_t color, int32_t* out)
+	{
+		int32_t r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+		out[0] = (r << 3) | (r >> 2);
+		out[1] = (g << 2) | (g >> 4);
+		out[2] = (b << 3) | (b >> 2);
+	}
+}
+
+VkFormat TextureCompressor::transcode(uint64_t sourceHash, Usage usage, const std::vector<const uint8_t*>& layers, uint32_t width, uint32_t height, std::vector<uint8_t>& out)
+{
+#if TEXTURE_COMPRESSION
+	bool hasAlpha = false;
+	if (usage == Usage::COLOR)
+		for (const uint8_t* layer : layers)
+			for (uint64_t i = 3; i < (uint64_t)width * height * 4 && !hasAlpha; i += 4)
+				hasAlpha = layer[i] != 0xFF;
+
+	VkFormat format = chooseFormat(usage, hasAlpha);
+	if (!isSupported(format))
+		return VK_FORMAT_R8G8B8A8_UNORM;
+
+	TextureContainer::Desc desc = { format, width, height, (uint32_t)layers.size(), Image::getMipLevelCount(width, height), sourceHash };
+	std::string path = TextureContainer::getPath(sourceHash, format);
+	if (TextureContainer::read(path, desc, out))
+		return format;
+
+	JAS_PROFILER_SAMPLE_SCOPE("Texture transcode");
+	auto startTime = std::chrono::high_resolution_clock::now();
+	compress(format, layers, width, height, desc.levelCount, out);
+	TextureContainer::write(path, desc, out);
+	double time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	JAS_INFO(" ->Transcoded {}x{}x{} to format {} in {} ms, {} KB instead of {} KB", width, height, layers.size(), (uint32_t)format, time,
+		out.size() / 1024, getChainSize(VK_FORMAT_R8G8B8A8_UNORM, width, height, desc.layerCount, desc.levelCount) / 1024);
+	return format;
+#else
+	return VK_FORMAT_R8G8B8A8_UNORM;
+#endif
+}
+
+void TextureCompressor::compress(VkFormat format, const std::vector<const uint8_t*>& layers, uint32_t width, uint32_t height, uint32_t levelCount, std::vector<uint8_t>& out)
+{
+	JAS_PROFILER_SAMPLE_FUNCTION();
+	struct Level
+	{
+		const uint8_t* texels;
+		uint32_t width;
+		uint32_t height;
+		uint64_t offset;
+	};
+
+	// Every level of every layer in RGBA8 first, in the order they are stored
+	uint32_t layerCount = (uint32_t)layers.size();
+	std::vector<std::vector<uint8_t>> mips((size_t)levelCount * layerCount);
+	std::vector<Level> levels((size_t)levelCount * layerCount);
+	uint64_t offset = 0;
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		uint32_t levelWidth = std::max(width >> level, 1u);
+		uint32_t levelHeight = std::max(height >> level, 1u);
+		for (uint32_t layer = 0; layer < layerCount; layer++)
+		{
+			size_t index = (size_t)level * layerCount + layer;
+			if (level == 0)
+				levels[index].texels = layers[layer];
+			else {
+				const Level& previous = levels[index - layerCount];
+				mips[index].resize((size_t)levelWidth * levelHeight * 4);
+				downsample(previous.texels, previous.width, previous.height, mips[index].data());
+				levels[index].texels = mips[index].data();
+			}
+			levels[index].width = levelWidth;
+			levels[index].height = levelHeight;
+			levels[index].offset = offset;
+			offset += getLevelSize(format, levelWidth, levelHeight);
+		}
+	}
+	out.resize(offset);
+
+	// A row of blocks is the unit of work, edge blocks repeat the last texel
+	std::vector<std::pair<uint32_t, uint32_t>> rows;
+	for (uint32_t i = 0; i < (uint32_t)levels.size(); i++)
+		for (uint32_t y = 0; y < (levels[i].height + 3) / 4; y++)
+			rows.push_back({ i, y });
+
+	const uint64_t blockSize = getLevelSize(format, 4, 4);
+	auto encodeRows = [&](size_t begin, size_t end) {
+		uint8_t block[64];
+		for (size_t r = begin; r < end; r++)
+		{
+			const Level& level = levels[rows[r].first];
+			uint32_t by = rows[r].second;
+			uint32_t blocksX = (level.width + 3) / 4;
+			uint8_t* dst = out.data() + level.offset + (uint64_t)by * blocksX * blockSize;
+			for (uint32_t bx = 0; bx < blocksX; bx++)
+			{
+				for (uint32_t y = 0; y < 4; y++)
+					for (uint32_t x = 0; x < 4; x++) {
+						uint32_t sx = std::min(bx * 4 + x, level.width - 1);
+						uint32_t sy = std::min(by * 4 + y, level.height - 1);
+						std::memcpy(&block[(y * 4 + x) * 4], &level.texels[((uint64_t)sy * level.width + sx) * 4], 4);
+					}
+				encodeBlock(format, block, dst + bx * blockSize);
+			}
+		}
+	};
+
+	uint32_t threadCount = ThreadManager::threadCount();
+	if (threadCount < 2) {
+		encodeRows(0, rows.size());
+		return;
+	}
+	size_t rowsPerThread = (rows.size() + threadCount - 1) / threadCount;
+	for (uint32_t t = 0; t < threadCount; t++)
+	{
+		size_t begin = std::min(t * rowsPerThread, rows.size());
+		size_t end = std::min(begin + rowsPerThread, rows.size());
+		if (begin < end)
+			ThreadManager::addWork(t, [&encodeRows, begin, end]() { encodeRows(begin, end); });
+	}
+	ThreadManager::wait();
+}
+
+VkFormat TextureCompressor::chooseFormat(Usage usage, bool hasAlpha)
+{
+	switch (usage)
+	{
+	case Usage::NORMAL:
+		return VK_FORMAT_BC5_UNORM_BLOCK; // z is reconstructed from xy
+	case Usage::DATA:
+		return VK_FORMAT_BC7_UNORM_BLOCK;
+	default:
+		return hasAlpha ? VK_FORMAT_BC3_UNORM_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+	}
+}
+
+bool TextureCompressor::isSupported(VkFormat format)
+{
+	if (!isCompressed(format))
+		return true;
+	if (!Instance::get().getEnabledFeatures().textureCompressionBC)
+		return false;
+
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(Instance::get().getPhysicalDevice(), format, &properties);
+	VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	return (properties.optimalTilingFeatures & required) == required;
+}
+
+bool TextureCompressor::isCompressed(VkFormat format)
+{
+	return format == VK_FORMAT_BC1_RGB_UNORM_BLOCK || format == VK_FORMAT_BC3_UNORM_BLOCK
+		|| format == VK_FORMAT_BC5_UNORM_BLOCK || format == VK_FORMAT_BC7_UNORM_BLOCK;
+}
+
+uint64_t TextureCompressor::getLevelSize(VkFormat format, uint32_t width, uint32_t height)
+{
+	uint64_t blocks = (uint64_t)((width + 3) / 4) * ((height + 3) / 4);
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		return blocks * 8;
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+		return blocks * 16;
+	default:
+		return (uint64_t)width * height * 4;
+	}
+}
+
+uint64_t TextureCompressor::getChainSize(VkFormat format, uint32_t width, uint32_t height, uint32_t layerCount, uint32_t levelCount)
+{
+	uint64_t size = 0;
+	for (uint32_t level = 0; level < levelCount; level++)
+		size += getLevelSize(format, std::max(width >> level, 1u), std::max(height >> level, 1u)) * layerCount;
+	return size;
+}
+
+void TextureCompressor::encodeBlock(VkFormat format, const uint8_t* texels, uint8_t* out)
+{
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		encodeBC1(texels, out);
+		break;
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+		encodeBC4(texels, 3, out);
+		encodeBC1(texels, out + 8);
+		break;
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+		encodeBC4(texels, 0, out);
+		encodeBC4(texels, 1, out + 8);
+		break;
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+		encodeBC7(texels, out);
+		break;
+	default:
+		JAS_ASSERT(false, "Can not encode format {}!", (uint32_t)format);
+		break;
+	}
+}
+
+void TextureCompressor::encodeBC1(const uint8_t* texels, uint8_t* out)
+{
+	float low[4], high[4];
+	findEndpoints(texels, 3, low, high);
+	uint16_t color0 = toRGB565(high);
+	uint16_t color1 = toRGB565(low);
+	// color0 > color1 selects the four color mode, equal endpoints are a solid block
+	if (color0 < color1)
+		std::swap(color0, color1);
+
+	int32_t palette[4][3];
+	fromRGB565(color0, palette[0]);
+	fromRGB565(color1, palette[1]);
+	for (uint32_t c = 0; c < 3; c++) {
+		palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	}
+
+	uint32_t indices = 0;
+	if (color0 != color1)
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			uint32_t best = 0;
+			int32_t bestError = INT32_MAX;
+			for (uint32_t p = 0; p < 4; p++) {
+				int32_t error = 0;
+				for (uint32_t c = 0; c < 3; c++) {
+					int32_t d = (int32_t)texels[i * 4 + c] - palette[p][c];
+					error += d * d;
+				}
+				if (error < bestError) {
+					bestError = error;
+					best = p;
+				}
+			}
+			indices |= best << (i * 2);
+		}
+
+	out[0] = (uint8_t)(color0 & 0xFF);
+	out[1] = (uint8_t)(color0 >> 8);
+	out[2] = (uint8_t)(color1 & 0xFF);
+	out[3] = (uint8_t)(color1 >> 8);
+	std::memcpy(out + 4, &indices, 4);
+}
+
+void TextureCompressor::encodeBC4(const uint8_t* texels, uint32_t channel, uint8_t* out)
+{
+	int32_t low = 255, high = 0;
+	for (uint32_t i = 0; i < 16; i++) {
+		low = std::min(low, (int32_t)texels[i * 4 + channel]);
+		high = std::max(high, (int32_t)texels[i * 4 + channel]);
+	}
+
+	// Eight value mode, high first: index 0 and 1 are the endpoints and 2-7 step from high to low
+	uint64_t indices = 0;
+	int32_t range = high - low;
+	if (range > 0)
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			int32_t step = ((high - texels[i * 4 + channel]) * 14 + range) / (2 * range);
+			uint64_t index = step == 0 ? 0 : (step == 7 ? 1 : (uint64_t)step + 1);
+			indices |= index << (i * 3);
+		}
+
+	out[0] = (uint8_t)high;
+	out[1] = (uint8_t)low;
+	for (uint32_t b = 0; b < 6; b++)
+		out[2 + b] = (uint8_t)(indices >> (b * 8));
+}
+
+void TextureCompressor::encodeBC7(const uint8_t* texels, uint8_t* out)
+{
+	// Mode 6: one subset, RGBA endpoints of 7 bits and a p-bit each, 4 bit indices
+	float low[4], high[4];
+	findEndpoints(texels, 4, low, high);
+
+	uint32_t endpoints[2][4];
+	uint32_t pBits[2];
+	const float* sources[2] = { low, high };
+	for (uint32_t e = 0; e < 2; e++)
+	{
+		// The p-bit is the shared lowest bit of all channels, keep the one closest to the wanted color
+		float bestError = FLT_MAX;
+		for (uint32_t p = 0; p < 2; p++)
+		{
+			uint32_t quantized[4];
+			float error = 0.f;
+			for (uint32_t c = 0; c < 4; c++) {
+				quantized[c] = (uint32_t)std::min(std::max((sources[e][c] - p) * 0.5f + 0.5f, 0.f), 127.f);
+				float d = (float)((quantized[c] << 1) | p) - sources[e][c];
+				error += d * d;
+			}
+			if (error < bestError) {
+				bestError = error;
+				pBits[e] = p;
+				std::memcpy(endpoints[e], quantized, sizeof(quantized));
+			}
+		}
+	}
+
+	int32_t palette[16][4];
+	for (uint32_t i = 0; i < 16; i++)
+		for (uint32_t c = 0; c < 4; c++) {
+			int32_t e0 = (int32_t)((endpoints[0][c] << 1) | pBits[0]);
+			int32_t e1 = (int32_t)((endpoints[1][c] << 1) | pBits[1]);
+			palette[i][c] = ((64 - BC7_WEIGHTS[i]) * e0 + BC7_WEIGHTS[i] * e1 + 32) >> 6;
+		}
+
+	uint32_t indices[16];
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		int32_t bestError = INT32_MAX;
+		for (uint32_t p = 0; p < 16; p++) {
+			int32_t error = 0;
+			for (uint32_t c = 0; c < 4; c++) {
+				int32_t d = (int32_t)texels[i * 4 + c] - palette[p][c];
+				error += d * d;
+			}
+			if (error < bestError) {
+				bestError = error;
+				indices[i] = p;
+			}
+		}
+	}
+
+	// The first index is stored without its top bit, swap the endpoints when it would be set
+	if (indices[0] & 8)
+	{
+		std::swap(endpoints[0], endpoints[1]);
+		std::swap(pBits[0], pBits[1]);
+		for (uint32_t i = 0; i < 16; i++)
+			indices[i] = 15 - indices[i];
+	}
+
+	std::memset(out, 0, 16);
+	BitWriter writer = { out, 0 };
+	writer.write(1 << 6, 7);
+	for (uint32_t c = 0; c < 4; c++) {
+		writer.write(endpoints[0][c], 7);
+		writer.write(endpoints[1][c], 7);
+	}
+	writer.write(pBits[0], 1);
+	writer.write(pBits[1], 1);
+	writer.write(indices[0], 3);
+	for (uint32_t i = 1; i < 16; i++)
+		writer.write(indices[i], 4);
+}
+
+void TextureCompressor::findEndpoints(const uint8_t* texels, uint32_t channelCount, float* low, float* high)
+{
+	float mean[4] = { 0.f, 0.f, 0.f, 0.f };
+	float minimum[4] = { 255.f, 255.f, 255.f, 255.f };
+	float maximum[4] = { 0.f, 0.f, 0.f, 0.f };
+	for (uint32_t i = 0; i < 16; i++)
+		for (uint32_t c = 0; c < channelCount; c++) {
+			float v = texels[i * 4 + c];
+			mean[c] += v / 16.f;
+			minimum[c] = std::min(minimum[c], v);
+			maximum[c] = std::max(maximum[c], v);
+		}
+
+	float covariance[4][4] = {};
+	for (uint32_t i = 0; i < 16; i++)
+		for (uint32_t a = 0; a < channelCount; a++)
+			for (uint32_t b = 0; b < channelCount; b++)
+				covariance[a][b] += (texels[i * 4 + a] - mean[a]) * (texels[i * 4 + b] - mean[b]);
+
+	// A few power iterations from the bounding box diagonal find the principal axis
+	float axis[4] = { 0.f, 0.f, 0.f, 0.f };
+	for (uint32_t c = 0; c < channelCount; c++)
+		axis[c] = maximum[c] - minimum[c];
+	for (uint32_t iteration = 0; iteration < 4; iteration++)
+	{
+		float next[4] = { 0.f, 0.f, 0.f, 0.f };
+		float length = 0.f;
+		for (uint32_t a = 0; a < channelCount; a++) {
+			for (uint32_t b = 0; b < channelCount; b++)
+				next[a] += covariance[a][b] * axis[b];
+			length = std::max(length, std::abs(next[a]));
+		}
+		if (length == 0.f)
+			break;
+		for (uint32_t c = 0; c < channelCount; c++)
+			axis[c] = next[c] / length;
+	}
+
+	float lengthSquared = 0.f;
+	for (uint32_t c = 0; c < channelCount; c++)
+		lengthSquared += axis[c] * axis[c];
+	if (lengthSquared == 0.f) {
+		// Solid block
+		for (uint32_t c = 0; c < channelCount; c++)
+			low[c] = high[c] = mean[c];
+		return;
+	}
+
+	float lowT = FLT_MAX, highT = -FLT_MAX;
+	for (uint32_t i = 0; i < 16; i++) {
+		float t = 0.f;
+		for (uint32_t c = 0; c < channelCount; c++)
+			t += (texels[i * 4 + c] - mean[c]) * axis[c];
+		lowT = std::min(lowT, t);
+		highT = std::max(highT, t);
+	}
+	for (uint32_t c = 0; c < channelCount; c++) {
+		low[c] = std::min(std::max(mean[c] + axis[c] * lowT / lengthSquared, 0.f), 255.f);
+		high[c] = std::min(std::max(mean[c] + axis[c] * highT / lengthSquared, 0.f), 255.f);
+	}
+}
+
+void TextureCompressor::downsample(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst)
+{
+	// 2x2 box, the last row or column is repeated when the size is odd
+	uint32_t dstWidth = std::max(width >> 1, 1u);
+	uint32_t dstHeight = std::max(height >> 1, 1u);
+	for (uint32_t y = 0; y < dstHeight; y++)
+	{
+		uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+		for (uint32_t x = 0; x < dstWidth; x++)
+		{
+			uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				uint32_t sum = src[((uint64_t)y0 * width + x0) * 4 + c] + src[((uint64_t)y0 * width + x1) * 4 + c]
+					+ src[((uint64_t)y1 * width + x0) * 4 + c] + src[((uint64_t)y1 * width + x1) * 4 + c];
+				dst[((uint64_t)y * dstWidth + x) * 4 + c] = (uint8_t)((sum + 2) / 4);
+			}
+		}
+	}
+}
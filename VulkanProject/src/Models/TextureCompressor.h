@@ -0,0 +1,46 @@
+#pragma once
+#include "jaspch.h"
+
+/*
+	CPU block compression of RGBA8 images into BC1, BC3, BC5 or BC7 with a full mip chain.
+	The format follows what the texture holds: BC1 for opaque color, BC3 for color with alpha, BC5 for the xy of normal maps
+	and BC7 for packed data channels (metallic, roughness, occlusion) that do not share one color line.
+	The mips are box filtered on the CPU since block compressed images can not be blitted, and the blocks are encoded
+	on the ThreadManager threads. Results are kept in TextureContainer files so the encode is only done on the first load.
+*/
+class TextureCompressor
+{
+public:
+	enum class Usage
+	{
+		COLOR,
+		NORMAL,
+		DATA
+	};
+
+	// The compressed chain of the layers from its container, or encoded and written to one when there is none.
+	// Returns VK_FORMAT_R8G8B8A8_UNORM and leaves out untouched when compression is off or the device can not sample the format
+	static VkFormat transcode(uint64_t sourceHash, Usage usage, const std::vector<const uint8_t*>& layers, uint32_t width, uint32_t height, std::vector<uint8_t>& out);
+
+	// Encodes levelCount levels of each RGBA8 layer, level 0 first and the layers of a level after each other
+	static void compress(VkFormat format, const std::vector<const uint8_t*>& layers, uint32_t width, uint32_t height, uint32_t levelCount, std::vector<uint8_t>& out);
+
+	static VkFormat chooseFormat(Usage usage, bool hasAlpha);
+	// True if the BC feature is enabled and the format can be sampled with linear filtering
+	static bool isSupported(VkFormat format);
+	static bool isCompressed(VkFormat format);
+	// Bytes of one layer of a level, compressed levels are padded to whole 4x4 blocks
+	static uint64_t getLevelSize(VkFormat format, uint32_t width, uint32_t height);
+	// Bytes of the first levelCount levels of layerCount layers
+	static uint64_t getChainSize(VkFormat format, uint32_t width, uint32_t height, uint32_t layerCount, uint32_t levelCount);
+
+private:
+	// texels is a 4x4 block of RGBA8, row by row
+	static void encodeBlock(VkFormat format, const uint8_t* texels, uint8_t* out);
+	static void encodeBC1(const uint8_t* texels, uint8_t* out);
+	static void encodeBC4(const uint8_t* texels, uint32_t channel, uint8_t* out);
+	static void encodeBC7(const uint8_t* texels, uint8_t* out);
+	// Endpoints on the principal axis of the first channelCount channels
+	static void findEndpoints(const uint8_t* texels, uint32_t channelCount, float* low, float* high);
+	static void downsample(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst);
+};
@@ -0,0 +1,120 @@
+#include "jaspch.h"
+#include "TextureContainer.h"
+#include "Core/MappedFile.h"
+#include "Models/TextureCompressor.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	// Same length and purpose as the KTX2 identifier, but not a KTX2 file
+	const uint8_t IDENTIFIER[12] = { 0xAB, 'J', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	struct Header
+	{
+		uint8_t identifier[12];
+		uint32_t vkFormat;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t layerCount;
+		uint32_t levelCount;
+		uint64_t sourceHash;
+	};
+
+	struct LevelIndex
+	{
+		uint64_t byteOffset;
+		uint64_t byteLength;
+	};
+}
+
+bool TextureContainer::write(const std::string& filePath, const Desc& desc, const std::vector<uint8_t>& data)
+{
+	Header header = {};
+	std::memcpy(header.identifier, IDENTIFIER, sizeof(IDENTIFIER));
+	header.vkFormat = (uint32_t)desc.format;
+	header.pixelWidth = desc.width;
+	header.pixelHeight = desc.height;
+	header.layerCount = desc.layerCount;
+	header.levelCount = desc.levelCount;
+	header.sourceHash = desc.sourceHash;
+
+	// Level ranges as the format lays them out, the data has to cover all of them
+	std::vector<LevelIndex> levels(desc.levelCount);
+	uint64_t offset = sizeof(Header) + sizeof(LevelIndex) * levels.size();
+	for (uint32_t level = 0; level < desc.levelCount; level++) {
+		levels[level].byteOffset = offset;
+		levels[level].byteLength = TextureCompressor::getLevelSize(desc.format, std::max(desc.width >> level, 1u), std::max(desc.height >> level, 1u)) * desc.layerCount;
+		offset += levels[level].byteLength;
+	}
+	uint64_t dataSize = offset - (sizeof(Header) + sizeof(LevelIndex) * levels.size());
+	if (dataSize != data.size()) {
+		JAS_WARN("Texture container {} got {} bytes for levels of {} bytes!", filePath.c_str(), data.size(), dataSize);
+		return false;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(filePath).parent_path(), error);
+
+	std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		JAS_WARN("Could not write texture container {}", filePath.c_str());
+		return false;
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+	file.write(reinterpret_cast<const char*>(levels.data()), sizeof(LevelIndex) * levels.size());
+	file.write(reinterpret_cast<const char*>(data.data()), data.size());
+
+	if (!file.good()) {
+		JAS_WARN("Failed writing texture container {}", filePath.c_str());
+		file.close();
+		std::filesystem::remove(filePath, error);
+		return false;
+	}
+	return true;
+}
+
+bool TextureContainer::read(const std::string& filePath, const Desc& desc, std::vector<uint8_t>& data, uint32_t firstLevel)
+{
+	MappedFile file;
+	if (!file.open(filePath) || file.getSize() < sizeof(Header))
+		return false;
+
+	const Header& header = *reinterpret_cast<const Header*>(file.getData());
+	if (std::memcmp(header.identifier, IDENTIFIER, sizeof(IDENTIFIER)) != 0 || header.vkFormat != (uint32_t)desc.format
+		|| header.pixelWidth != desc.width || header.pixelHeight != desc.height || header.layerCount != desc.layerCount
+		|| header.levelCount != desc.levelCount || header.sourceHash != desc.sourceHash)
+		return false;
+
+	// Every level has to be where and as large as the format says, the levels are read as one range
+	const LevelIndex* levels = reinterpret_cast<const LevelIndex*>(file.getData() + sizeof(Header));
+	uint64_t offset = sizeof(Header) + sizeof(LevelIndex) * (uint64_t)header.levelCount;
+	if (firstLevel >= header.levelCount || offset > file.getSize())
+		return false;
+	uint64_t dataOffset = offset;
+	for (uint32_t level = 0; level < header.levelCount; level++) {
+		uint64_t size = TextureCompressor::getLevelSize(desc.format, std::max(desc.width >> level, 1u), std::max(desc.height >> level, 1u)) * desc.layerCount;
+		if (levels[level].byteOffset != offset || levels[level].byteLength != size)
+			return false;
+		if (level == firstLevel)
+			dataOffset = offset;
+		offset += size;
+	}
+	if (offset > file.getSize())
+		return false;
+
+	data.assign(file.getData() + dataOffset, file.getData() + offset);
+	return true;
+}
+
+std::string TextureContainer::getPath(uint64_t sourceHash, VkFormat format)
+{
+	std::stringstream ss;
+	ss << TEXTURE_CACHE_FOLDER << std::hex << std::setw(16) << std::setfill('0') << sourceHash << std::dec << "_" << (uint32_t)format << ".jtx";
+	return ss.str();
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "jaspch.h"
+
+/*
+	Texture file laid out like KTX2: a header with the Vulkan format, size, layer and level counts, a level index with the
+	byte range of every level and then the levels, level 0 first, with the layers of a level after each other.
+	The header also holds the hash of the source images so a container of a changed source is not used.
+	There is no data format descriptor or supercompression, the format is always one Vulkan can sample directly.
+*/
+class TextureContainer
+{
+public:
+	struct Desc
+	{
+		VkFormat format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t layerCount;
+		uint32_t levelCount;
+		uint64_t sourceHash;
+	};
+
+	// data holds every level as laid out in the file
+	static bool write(const std::string& filePath, const Desc& desc, const std::vector<uint8_t>& data);
+	// Returns false if the file is missing, truncated or was written for another desc. Only firstLevel and the levels
+	// after it are read, the texture streamer reads the finer levels when they are needed
+	static bool read(const std::string& filePath, const Desc& desc, std::vector<uint8_t>& data, uint32_t firstLevel = 0);
+
+	// Where the container of a source and format is kept, in TEXTURE_CACHE_FOLDER
+	static std::string getPath(uint64_t sourceHash, VkFormat format);
+};
@@ -0,0 +1,406 @@
+#include "jaspch.h"
+#include "TextureStreamer.h"
+#include "Models/TextureCompressor.h"
+#include "Vulkan/Instance.h"
+#include "Vulkan/CommandPool.h"
+#include "Vulkan/CommandBuffer.h"
+#include "Vulkan/Frame.h"
+#include "Vulkan/Pipeline/BindlessTable.h"
+#include "Threading/ThreadDispatcher.h"
+
+#include <algorithm>
+#include <cmath>
+
+TextureStreamer::TextureStreamer() :
+	transferPool(nullptr), bindless(nullptr), fence(VK_NULL_HANDLE),
+	budget(0), residentBytes(0), frameNumber(0), stats{ 0, 0, 0 }
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+}
+
+TextureStreamer& TextureStreamer::get()
+{
+	static TextureStreamer textureStreamer;
+	return textureStreamer;
+}
+
+void TextureStreamer::init(CommandPool* transferPool, BindlessTable* bindless, uint64_t budget)
+{
+	this->transferPool = transferPool;
+	this->bindless = bindless;
+	this->budget = budget;
+
+	VkFenceCreateInfo fenceCreateInfo = {};
+	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	ERROR_CHECK(vkCreateFence(Instance::get().getDevice(), &fenceCreateInfo, nullptr, &this->fence), "Failed to create texture streaming fence");
+}
+
+uint32_t TextureStreamer::getTailLevel(uint32_t width, uint32_t height)
+{
+	uint32_t level = 0;
+#if TEXTURE_STREAMING && TEXTURE_MIPMAPS
+	while ((std::max(width, height) >> level) > TEXTURE_STREAMING_TAIL_SIZE)
+		level++;
+#endif
+	return level;
+}
+
+void TextureStreamer::addTexture(Texture* tail, uint64_t sourceHash, uint32_t width, uint32_t height)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	std::unique_ptr<Entry> entry = std::make_unique<Entry>();
+	entry->tail = tail;
+	entry->desc = { tail->getFormat(), width, height, 1, Image::getMipLevelCount(width, height), sourceHash };
+	entry->path = TextureContainer::getPath(sourceHash, tail->getFormat());
+	entry->tailLevel = getTailLevel(width, height);
+	entry->wantedLevel = entry->tailLevel;
+	entry->lastRequest = 0;
+	entry->failed = false;
+	this->entries[tail] = std::move(entry);
+}
+
+void TextureStreamer::removeTexture(Texture* tail)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	auto it = this->entries.find(tail);
+	if (it == this->entries.end())
+		return;
+
+	Entry& entry = *it->second;
+	if (this->upload && this->upload->entry == &entry)
+		cancelUpload();
+	if (entry.resident) {
+		this->residentBytes -= entry.resident->size;
+		destroyLevel(*entry.resident);
+	}
+	this->entries.erase(it);
+}
+
+void TextureStreamer::requestFootprint(Texture* texture, float screenSize)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	auto it = this->entries.find(texture);
+	if (it == this->entries.end())
+		return;
+
+	// Each halving of the texture halves the texels per pixel, the finest request since the last update wins
+	Entry& entry = *it->second;
+	float texels = (float)std::max(entry.desc.width, entry.desc.height);
+	uint32_t level = entry.tailLevel;
+	if (screenSize > 0.f)
+		level = std::min((uint32_t)std::max(std::floor(std::log2(texels / screenSize)), 0.f), entry.tailLevel);
+	if (entry.lastRequest != this->frameNumber || level < entry.wantedLevel)
+		entry.wantedLevel = level;
+	entry.lastRequest = this->frameNumber;
+}
+
+bool TextureStreamer::update(uint64_t frameNumber)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->frameNumber = frameNumber;
+	bool changed = false;
+
+	if (this->upload)
+	{
+		if (this->upload->commandBuffer == nullptr) {
+			if (ThreadDispatcher::finished(this->upload->job)) {
+				ThreadDispatcher::wait(this->upload->job);
+				submitUpload();
+			}
+		}
+		else if (vkGetFenceStatus(Instance::get().getDevice(), this->fence) == VK_SUCCESS) {
+			finishUpload();
+			changed = true;
+		}
+	}
+
+	// Replaced images can go once the frames which could sample them are done
+	for (auto it = this->retired.begin(); it != this->retired.end();)
+	{
+		if (it->frame <= frameNumber) {
+			destroyLevel(*it->level);
+			it = this->retired.erase(it);
+		}
+		else
+			it++;
+	}
+
+	// Levels that are not asked for anymore are evicted, the texture falls back to its tail
+	for (auto& it : this->entries)
+	{
+		Entry& entry = *it.second;
+		bool uploading = this->upload && this->upload->entry == &entry;
+		if (entry.resident && !uploading && frameNumber > entry.lastRequest + TEXTURE_STREAMING_IDLE_FRAMES) {
+			retire(std::move(entry.resident));
+			this->stats.evictions++;
+			changed = true;
+		}
+	}
+
+	if (!this->upload) {
+		uint32_t evictions = this->stats.evictions;
+		startNext();
+		changed |= this->stats.evictions != evictions;
+	}
+	return changed;
+}
+
+Texture* TextureStreamer::getResident(Texture* texture)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	auto it = this->entries.find(texture);
+	if (it == this->entries.end() || !it->second->resident)
+		return texture;
+	return &it->second->resident->texture;
+}
+
+std::string TextureStreamer::getReport()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	std::stringstream ss;
+	ss << "Texture streaming: " << this->stats.uploads << " uploads, " << this->stats.evictions << " evictions"
+		<< ", peak " << (this->stats.peakBytes >> 10) << "/" << (this->budget >> 10) << " KiB";
+	return ss.str();
+}
+
+void TextureStreamer::cleanup()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (this->upload)
+		cancelUpload();
+	for (Retired& level : this->retired)
+		destroyLevel(*level.level);
+	for (auto& it : this->entries)
+		if (it.second->resident)
+			destroyLevel(*it.second->resident);
+	this->retired.clear();
+	this->entries.clear();
+	this->residentBytes = 0;
+
+	if (this->fence != VK_NULL_HANDLE)
+		vkDestroyFence(Instance::get().getDevice(), this->fence, nullptr);
+	this->fence = VK_NULL_HANDLE;
+}
+
+std::unique_ptr<TextureStreamer::Level> TextureStreamer::createLevel(const Entry& entry, uint32_t firstLevel)
+{
+	// Written on the transfer queue and sampled on the graphics queue
+	std::vector<uint32_t> queueIndices = { Instance::get().getGraphicsQueue().queueIndex };
+	if (Instance::get().getTransferQueue().queueIndex != queueIndices[0])
+		queueIndices.push_back(Instance::get().getTransferQueue().queueIndex);
+
+	std::unique_ptr<Level> level = std::make_unique<Level>();
+	uint32_t width = std::max(entry.desc.width >> firstLevel, 1u);
+	uint32_t height = std::max(entry.desc.height >> firstLevel, 1u);
+	uint32_t levelCount = entry.desc.levelCount - firstLevel;
+	Texture& texture = level->texture;
+	texture.init(width, height, entry.desc.format, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, queueIndices, 0, 1, levelCount);
+	level->memory.bindTexture(&texture);
+	level->memory.init(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	texture.getImageView().init(texture.getVkImage(), VK_IMAGE_VIEW_TYPE_2D, entry.desc.format, VK_IMAGE_ASPECT_COLOR_BIT, 1, levelCount);
+	level->firstLevel = firstLevel;
+	level->size = texture.getMemReq().size;
+	return level;
+}
+
+void TextureStreamer::destroyLevel(Level& level)
+{
+	if (this->bindless != nullptr)
+		this->bindless->removeImage(level.texture.getVkImageView());
+	level.texture.cleanup();
+	level.memory.cleanup();
+}
+
+void TextureStreamer::startNext()
+{
+	// The texture missing the most levels goes first, the most recently requested one on ties
+	Entry* next = nullptr;
+	uint32_t nextMissing = 0;
+	for (auto& it : this->entries)
+	{
+		Entry& entry = *it.second;
+		uint32_t residentLevel = getResidentLevel(entry);
+		if (entry.failed || entry.wantedLevel >= residentLevel)
+			continue;
+		uint32_t missing = residentLevel - entry.wantedLevel;
+		if (next == nullptr || missing > nextMissing || (missing == nextMissing && entry.lastRequest > next->lastRequest)) {
+			next = &entry;
+			nextMissing = missing;
+		}
+	}
+	if (next == nullptr)
+		return;
+
+	// Make room by evicting textures that were requested less recently, otherwise settle for a coarser level
+	const uint32_t residentLevel = getResidentLevel(*next);
+	uint32_t level = next->wantedLevel;
+	while (level < residentLevel)
+	{
+		uint32_t width = std::max(next->desc.width >> level, 1u);
+		uint32_t height = std::max(next->desc.height >> level, 1u);
+		uint64_t size = TextureCompressor::getChainSize(next->desc.format, width, height, 1, next->desc.levelCount - level);
+		uint64_t freed = next->resident ? next->resident->size : 0;
+		if (this->residentBytes - freed + size <= this->budget)
+			break;
+
+		Entry* victim = findEviction(*next);
+		if (victim != nullptr) {
+			retire(std::move(victim->resident));
+			this->stats.evictions++;
+		}
+		else
+			level++;
+	}
+	if (level < residentLevel)
+		startUpload(*next, level);
+}
+
+void TextureStreamer::startUpload(Entry& entry, uint32_t firstLevel)
+{
+	this->upload = std::make_unique<Upload>();
+	Upload& upload = *this->upload;
+	upload.entry = &entry;
+	upload.level = createLevel(entry, firstLevel);
+	upload.read = false;
+	upload.commandBuffer = nullptr;
+	this->residentBytes += upload.level->size;
+	this->stats.peakBytes = std::max(this->stats.peakBytes, this->residentBytes);
+
+	Texture& texture = upload.level->texture;
+	uint64_t size = TextureCompressor::getChainSize(texture.getFormat(), texture.getWidth(), texture.getHeight(), 1, texture.getMipLevels());
+	upload.stagingBuffer.init(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, { Instance::get().getTransferQueue().queueIndex });
+	upload.stagingMemory.bindBuffer(&upload.stagingBuffer);
+	upload.stagingMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	// The container is mapped and copied to the staging memory on a dispatcher thread, the copy is recorded once it is done
+	Upload* target = &upload;
+	std::string path = entry.path;
+	TextureContainer::Desc desc = entry.desc;
+	upload.job = ThreadDispatcher::dispatch([target, path, desc, firstLevel]() {
+		std::vector<uint8_t> data;
+		target->read = TextureContainer::read(path, desc, data, firstLevel);
+		if (target->read)
+			target->stagingMemory.directTransfer(&target->stagingBuffer, data.data(), data.size(), 0);
+	});
+}
+
+void TextureStreamer::submitUpload()
+{
+	Upload& upload = *this->upload;
+	if (!upload.read) {
+		JAS_WARN("Could not read {}, the texture keeps its mip tail!", upload.entry->path.c_str());
+		upload.entry->failed = true;
+		discardUpload();
+		return;
+	}
+
+	// Every level of the image is staged, level 0 first
+	Texture& texture = upload.level->texture;
+	std::vector<VkBufferImageCopy> regions(texture.getMipLevels());
+	uint64_t offset = 0;
+	for (uint32_t level = 0; level < texture.getMipLevels(); level++)
+	{
+		uint32_t width = std::max(texture.getWidth() >> level, 1u);
+		uint32_t height = std::max(texture.getHeight() >> level, 1u);
+		VkBufferImageCopy& region = regions[level];
+		region = {};
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = level;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent = { width, height, 1 };
+		region.bufferOffset = offset;
+		offset += TextureCompressor::getLevelSize(texture.getFormat(), width, height);
+	}
+
+	CommandBuffer* cbuff = this->transferPool->beginSingleTimeCommand();
+	Image::TransistionDesc desc;
+	desc.format = texture.getFormat();
+	desc.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	desc.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	desc.pool = this->transferPool;
+	desc.layerCount = 1;
+	texture.getImage().transistionLayout(cbuff, desc);
+	texture.getImage().copyBufferToImage(cbuff, &upload.stagingBuffer, regions);
+	desc.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	desc.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	desc.dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+	texture.getImage().transistionLayout(cbuff, desc);
+	this->transferPool->endSingleTimeCommand(cbuff, this->fence);
+	upload.commandBuffer = cbuff;
+}
+
+void TextureStreamer::finishUpload()
+{
+	Upload& upload = *this->upload;
+	VkCommandBuffer commandBuffer = upload.commandBuffer->getCommandBuffer();
+	vkFreeCommandBuffers(Instance::get().getDevice(), this->transferPool->getCommandPool(), 1, &commandBuffer);
+	this->transferPool->removeCommandBuffer(upload.commandBuffer);
+	vkResetFences(Instance::get().getDevice(), 1, &this->fence);
+	upload.stagingBuffer.cleanup();
+	upload.stagingMemory.cleanup();
+
+	// Frames in flight may still sample the old image, both stay valid until it is retired
+	Entry& entry = *upload.entry;
+	if (entry.resident)
+		retire(std::move(entry.resident));
+	entry.resident = std::move(upload.level);
+	this->stats.uploads++;
+	this->upload.reset();
+}
+
+void TextureStreamer::cancelUpload()
+{
+	Upload& upload = *this->upload;
+	if (upload.commandBuffer == nullptr)
+		ThreadDispatcher::wait(upload.job);
+	else {
+		vkWaitForFences(Instance::get().getDevice(), 1, &this->fence, VK_TRUE, UINT64_MAX);
+		VkCommandBuffer commandBuffer = upload.commandBuffer->getCommandBuffer();
+		vkFreeCommandBuffers(Instance::get().getDevice(), this->transferPool->getCommandPool(), 1, &commandBuffer);
+		this->transferPool->removeCommandBuffer(upload.commandBuffer);
+		vkResetFences(Instance::get().getDevice(), 1, &this->fence);
+	}
+	discardUpload();
+}
+
+void TextureStreamer::discardUpload()
+{
+	Upload& upload = *this->upload;
+	upload.stagingBuffer.cleanup();
+	upload.stagingMemory.cleanup();
+	this->residentBytes -= upload.level->size;
+	destroyLevel(*upload.level);
+	this->upload.reset();
+}
+
+void TextureStreamer::retire(std::unique_ptr<Level> level)
+{
+	this->residentBytes -= level->size;
+	this->retired.push_back({ std::move(level), this->frameNumber + MAX_FRAMES_IN_FLIGHT + 1 });
+}
+
+TextureStreamer::Entry* TextureStreamer::findEviction(const Entry& entry)
+{
+	Entry* victim = nullptr;
+	for (auto& it : this->entries)
+	{
+		Entry& other = *it.second;
+		if (&other == &entry || !other.resident)
+			continue;
+		bool unneeded = other.wantedLevel > other.resident->firstLevel;
+		if (!unneeded && other.lastRequest >= entry.lastRequest)
+			continue;
+		if (victim == nullptr || other.lastRequest < victim->lastRequest)
+			victim = &other;
+	}
+	return victim;
+}
+
+uint32_t TextureStreamer::getResidentLevel(const Entry& entry) const
+{
+	return entry.resident ? entry.resident->firstLevel : entry.tailLevel;
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include "jaspch.h"
+
+#include "Vulkan/Texture.h"
+#include "Vulkan/Buffers/Buffer.h"
+#include "Vulkan/Buffers/Memory.h"
+#include "Models/TextureContainer.h"
+
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+
+class CommandPool;
+class CommandBuffer;
+class BindlessTable;
+
+/*
+	Mip residency of block compressed textures under a memory budget. The AssetCache texture only holds the mip tail,
+	the levels no larger than TEXTURE_STREAMING_TAIL_SIZE, which is uploaded at load and always resident.
+	Finer levels are read from the texture's TextureContainer on a dispatcher thread and uploaded on the transfer queue into
+	a second image with the requested level and every level below it. Once the upload is done that image replaces the
+	previous one in the material table, the replaced image is destroyed when no frame in flight can sample it anymore.
+	Demand is the screen space footprint given to requestFootprint. Levels which are not asked for in
+	TEXTURE_STREAMING_IDLE_FRAMES are evicted, and when an upload does not fit the budget the least recently requested
+	textures are evicted first. One upload is in flight at a time.
+*/
+class TextureStreamer
+{
+public:
+	~TextureStreamer();
+
+	static TextureStreamer& get();
+
+	// Uploads are recorded in transferPool, replaced images are removed from bindless
+	void init(CommandPool* transferPool, BindlessTable* bindless, uint64_t budget);
+
+	// First level of a full chain of width x height which is always resident, zero when the texture is not streamed
+	static uint32_t getTailLevel(uint32_t width, uint32_t height);
+
+	// Called by the AssetCache for textures created with only the mip tail of a width x height source
+	void addTexture(Texture* tail, uint64_t sourceHash, uint32_t width, uint32_t height);
+	// Destroys the streamed levels right away, no frame may use them anymore. Waits for an upload of the texture
+	void removeTexture(Texture* tail);
+
+	// The texture covers screenSize pixels, asks for the level which has about one texel per pixel
+	void requestFootprint(Texture* texture, float screenSize);
+
+	// Publishes a finished upload, destroys replaced images, evicts idle levels and starts the next upload.
+	// Returns true when the resident image of a texture changed, the material table has to be written again
+	bool update(uint64_t frameNumber);
+
+	// The image with the finest resident levels, the texture itself when only its tail is resident or it is not streamed
+	Texture* getResident(Texture* texture);
+
+	// Uploads, evictions and the peak memory used against the budget
+	std::string getReport();
+
+	void cleanup();
+
+private:
+	TextureStreamer();
+	TextureStreamer(TextureStreamer& other) = delete;
+
+	struct Level
+	{
+		Texture texture;
+		Memory memory;
+		uint32_t firstLevel; // Level of the full chain which is level 0 of the image
+		uint64_t size;
+	};
+
+	struct Entry
+	{
+		Texture* tail;
+		TextureContainer::Desc desc;
+		std::string path;
+		uint32_t tailLevel;
+		std::unique_ptr<Level> resident; // Null when only the tail is resident
+		uint32_t wantedLevel;
+		uint64_t lastRequest;
+		bool failed; // The container could not be read, the texture keeps its tail
+	};
+
+	struct Upload
+	{
+		Entry* entry;
+		std::unique_ptr<Level> level;
+		Buffer stagingBuffer;
+		Memory stagingMemory;
+		uint32_t job;
+		bool read;
+		CommandBuffer* commandBuffer;
+	};
+
+	struct Retired
+	{
+		std::unique_ptr<Level> level;
+		uint64_t frame; // Destroyed when update is called with this frame number
+	};
+
+	struct Stats
+	{
+		uint32_t uploads;
+		uint32_t evictions;
+		uint64_t peakBytes;
+	};
+
+	std::unique_ptr<Level> createLevel(const Entry& entry, uint32_t firstLevel);
+	void destroyLevel(Level& level);
+	void startNext();
+	void startUpload(Entry& entry, uint32_t firstLevel);
+	void submitUpload();
+	void finishUpload();
+	// Blocks until the container read and the copy are done and throws the upload away
+	void cancelUpload();
+	void discardUpload();
+	void retire(std::unique_ptr<Level> level);
+	// Least recently requested texture with finer levels than what it asks for or requested before entry
+	Entry* findEviction(const Entry& entry);
+	uint32_t getResidentLevel(const Entry& entry) const;
+
+	std::mutex mutex;
+	std::unordered_map<Texture*, std::unique_ptr<Entry>> entries;
+	std::unique_ptr<Upload> upload;
+	std::vector<Retired> retired;
+
+	CommandPool* transferPool;
+	BindlessTable* bindless;
+	VkFence fence;
+	uint64_t budget;
+	uint64_t residentBytes;
+	uint64_t frameNumber;
+	Stats stats;
+};
@@ -10,15 +10,19 @@
 #include "Core/CPUProfiler.h"
 #include "Models/ModelRenderer.h"
 #include "Models/GLTFLoader.h"
+#include "Models/TextureStreamer.h"
 #include "Core/Input.h"
 
 #include <GLFW/glfw3.h>
+#include <fstream>
+#include <algorithm>
+#include <cfloat>
 
 #define MAIN_THREAD 0
 
 void ProjectFinal::init()
 {
-	getFrame()->queueUsage(VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT);
+	getFrame()->queueUsage(VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
 
 	// Initalize with maximum available threads
 	ThreadDispatcher::init(2);
@@ -37,16 +41,34 @@ void ProjectFinal::init()
 
 #ifdef JAS_DEBUG
 	VulkanProfiler::get().init(&this->graphicsPools[MAIN_THREAD], 10, 60, VulkanProfiler::TimeUnit::MICRO);
-	VulkanProfiler::get().createTimestamps(6 + (FUNC_COUNT_COMPUTE + FUNC_COUNT_GRAPHICS) * 3);
+	VulkanProfiler::get().createTimestamps(8 + (FUNC_COUNT_COMPUTE + FUNC_COUNT_GRAPHICS) * 3);
 	VulkanProfiler::get().addIndexedTimestamps("Graphics", 3, this->graphicsPrimary.data());
 	VulkanProfiler::get().addIndexedTimestamps("Models", 3, this->graphicsPrimary.data());
+	VulkanProfiler::get().addIndexedTimestamps("Impostors", 3, this->graphicsPrimary.data());
+	VulkanProfiler::get().addIndexedTimestamps("Clusters", 3, this->graphicsPrimary.data());
 	VulkanProfiler::get().addIndexedTimestamps("Compute", 3, this->computePrimary.data());
 	VulkanProfiler::get().addIndexedTimestamps("Skybox", 3, this->graphicsPrimary.data());
 	VulkanProfiler::get().addIndexedTimestamps("Heightmap", 3, this->graphicsPrimary.data());
 	VulkanProfiler::get().addIndexedTimestamps("Frustum", 3, this->computePrimary.data());
 #endif 
 
+	// The tree pages of the first window are placed with frame number 0
+	this->frameNumber = 0;
 	transferInitialData();
+
+	// Prime the frame pipeline, the first loop records packet 0 while packet 1 is culled
+	this->visibleTreeSum = 0;
+	this->impostorTreeSum = 0;
+	this->treeTriangleSum = 0;
+	this->streamPending = false;
+	for (FramePacket& packet : this->packets) {
+		for (std::vector<uint32_t>& trees : packet.visibleTrees)
+			trees.reserve(this->treeCount);
+		packet.impostorTrees.reserve(this->treeCount);
+	}
+	simulate(this->packets[0], 0.f);
+	cull(this->packets[0]);
+	simulate(this->packets[1], 0.f);
 }
 
 void ProjectFinal::loop(float dt)
@@ -54,40 +76,75 @@ void ProjectFinal::loop(float dt)
 	JAS_PROFILER_TOGGLE_SAMPLE_POOL(&this->graphicsPools[MAIN_THREAD], GLFW_KEY_R, 10);
 	JAS_PROFILER_SAMPLE_FUNCTION();
 
-	// Update view matrix
-	{
-		JAS_PROFILER_SAMPLE_SCOPE("Update camera");
-		this->camera->update(dt, this->heightmap.getTerrainHeight(this->camera->getPosition().x, this->camera->getPosition().z));
-	}
-	
-	// Transfer vertex data when proximity changes
-	transferVertexData();
+	// Before the next packet is culled, the cull stage reads the resident tree regions
+	pageTrees(false);
 
-	// Render
-	getFrame()->beginFrame(dt);
-	updateDescManagers();
-	record(getFrame()->getCurrentImageIndex());
-	getFrame()->submitTransfer(Instance::get().getTransferQueue().queue, this->transferPrimary[getFrame()->getCurrentImageIndex()]);
-	getFrame()->submitCompute(Instance::get().getComputeQueue().queue, this->computePrimary[getFrame()->getCurrentImageIndex()]);
-	getFrame()->submit(Instance::get().getGraphicsQueue().queue, this->graphicsPrimary.data());
-	getFrame()->endFrame();
+#if PIPELINED_FRAMES
+	FramePacket& current = this->packets[this->frameNumber % FRAME_PACKET_COUNT];
+	FramePacket& next = this->packets[(this->frameNumber + 1) % FRAME_PACKET_COUNT];
+	FramePacket& ahead = this->packets[(this->frameNumber + 2) % FRAME_PACKET_COUNT];
+
+	// Stage 1: Simulate two frames ahead. Input was polled right before this loop and is only safe to read on the main thread
+	simulate(ahead, dt);
+
+	// Stage 2: Cull the next frame on a dispatcher thread while this one is recorded
+	this->cullWork = ThreadDispatcher::dispatch([this, &next]() { cull(next); });
+
+	// Stage 3: Record and submit on the main and worker threads
+	render(current, dt);
+
+	ThreadDispatcher::wait(this->cullWork);
+#else
+	FramePacket& packet = this->packets[0];
+	simulate(packet, dt);
+	cull(packet);
+	render(packet, dt);
+#endif
+	this->frameNumber++;
 }
 
 void ProjectFinal::cleanup()
 {
+	getPipeline(PIPELINE_MODELS).wait();
+	getPipeline(PIPELINE_IMPOSTORS).wait();
+	getPipeline(PIPELINE_CLUSTERS).wait();
+	// Before the dispatcher stops, an upload may still be reading its container there
+	TextureStreamer::get().cleanup();
 	ThreadDispatcher::shutdown();
 	ThreadManager::cleanup();
+#ifdef JAS_DEBUG
+	// The model and skybox passes show what the sampled textures cost, compare runs with TEXTURE_MIPMAPS on and off
+	std::string gpuReport = "Texture mipmaps " + std::string(TEXTURE_MIPMAPS ? "on" : "off") + " | " + VulkanProfiler::get().getReport() + " | " + TextureStreamer::get().getReport();
+	// Per frame host to device traffic of the tree draw list, and what it was with one matrix per visible tree
+	uint64_t visiblePerFrame = this->visibleTreeSum / std::max(this->frameNumber, (uint64_t)1);
+	gpuReport += " | Tree instances: " + std::to_string(this->treeCount) + " resident of " + std::to_string(this->treeSlotsPerRegion * this->heightmap.getRegionCount()) + " x " + std::to_string(sizeof(PackedInstance)) + " B device local, "
+		+ std::to_string(visiblePerFrame * sizeof(uint32_t) / 1024) + " KiB visible indices per frame instead of " + std::to_string(visiblePerFrame * sizeof(glm::mat4) / 1024) + " KiB of matrices";
+	// Trees in the fade range are drawn twice, once in each list
+	uint64_t impostorsPerFrame = this->impostorTreeSum / std::max(this->frameNumber, (uint64_t)1);
+	uint64_t meshTrianglesPerFrame = this->treeTriangleSum / std::max(this->frameNumber, (uint64_t)1);
+	gpuReport += " | Tree triangles per frame: " + std::to_string(meshTrianglesPerFrame + impostorsPerFrame * 2) + " with " + std::to_string(this->models[MODEL_TREE].lodCount)
+		+ " levels of detail and " + std::to_string(impostorsPerFrame) + " impostors past " + std::to_string((int)IMPOSTOR_DISTANCE) + " m, "
+		+ std::to_string((visiblePerFrame + impostorsPerFrame) * this->treeLodTriangles[0]) + " with only full detail meshes"
+		+ (this->clusterCulling ? ", full detail counted before cluster culling" : "");
+	JAS_INFO(gpuReport);
+	std::ofstream reportFile(FRAME_REPORT_FILE_NAME, std::ios::app);
+	if (reportFile.is_open())
+		reportFile << gpuReport << std::endl;
+#endif
 	VulkanProfiler::get().cleanup();
 
 	GLTFLoader::cleanupDefaultData();
 
 	vkDestroyFence(Instance::get().getDevice(), this->transferFence, nullptr);
+	vkDestroyFence(Instance::get().getDevice(), this->treePlacementFence, nullptr);
 
 	for (auto& descManager : this->descManagers)
 		descManager.second.cleanup();
+	this->bindless.cleanup();
 
 	for (auto& model : this->models)
 		model.second.cleanup();
+	this->geometryArena.cleanup();
 
 	for (auto& pool : this->graphicsPools)
 		pool.cleanup();
@@ -101,12 +158,18 @@ void ProjectFinal::cleanup()
 	for (auto& buffer : this->buffers)
 		buffer.second.cleanup();
 
+	for (auto& buffer : this->frameBuffers)
+		buffer.second.cleanup();
+
+	this->uniformArena.cleanup();
+
 	for (auto& memory : this->memories)
 		memory.second.cleanup();
 
 	this->depthTexture.cleanup();
 	this->renderPass.cleanup();
 	this->skybox.cleanup();
+	this->treeImpostor.cleanup();
 	this->vertices.clear();
 
 	for (auto& pipeline : getPipelines())
@@ -152,6 +215,13 @@ void ProjectFinal::setupHeightmap()
 
 	this->vertices.resize(this->heightmap.getProximityVertexDim() * this->heightmap.getProximityVertexDim());
 	this->heightmap.getProximityVerticies(this->camera->getPosition(), this->vertices);
+
+	// Every region has the same number of tree slots. Twice the window in pages leaves room for the regions
+	// which left the window while packets and frames in flight may still draw them
+	uint32_t heightmapRegions = (uint32_t)this->heightmap.getRegionCount();
+	this->treeSlotsPerRegion = std::max((TREE_COUNT + heightmapRegions - 1) / heightmapRegions, 1u);
+	this->treePageCount = std::min(2 * (uint32_t)this->heightmap.getProximityRegionCount(), heightmapRegions);
+	this->treeCount = this->treeSlotsPerRegion * this->treePageCount;
 }
 
 void ProjectFinal::setupSyncObjects()
@@ -160,64 +230,95 @@ void ProjectFinal::setupSyncObjects()
 	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
 	// Transfer Fence
 	ERROR_CHECK(vkCreateFence(Instance::get().getDevice(), &fenceCreateInfo, nullptr, &this->transferFence), "Failed to create transfer fence");
+	// Tree placement fence
+	ERROR_CHECK(vkCreateFence(Instance::get().getDevice(), &fenceCreateInfo, nullptr, &this->treePlacementFence), "Failed to create tree placement fence");
 }
 
 void ProjectFinal::setupModels()
 {
 	GLTFLoader::initDefaultData(&this->graphicsPools[MAIN_THREAD]);
 
-	this->treeCount = TREE_COUNT;
-
 	const std::string filePath = "..\\assets\\Models\\Tree\\tree.glb";
 
+	this->geometryArena.init(GEOMETRY_ARENA_VERTICES, GEOMETRY_ARENA_INDICES, sizeof(PackedVertex), { Instance::get().getGraphicsQueue().queueIndex });
+
 	GLTFLoader::StagingBuffers stagingBuffers;
 	GLTFLoader::prepareStagingBuffer(filePath, &this->models[MODEL_TREE], &stagingBuffers);
 	stagingBuffers.initMemory();
-	GLTFLoader::transferToModel(&this->graphicsPools[MAIN_THREAD], &this->models[MODEL_TREE], &stagingBuffers);
+	GLTFLoader::transferToArena(&this->graphicsPools[MAIN_THREAD], &this->models[MODEL_TREE], &stagingBuffers, &this->geometryArena);
 	stagingBuffers.cleanup();
 	ModelRenderer::get().init();
+
+	// Bounding sphere used when culling the tree instances
+	this->treeRadius = this->models[MODEL_TREE].boundingRadius;
 }
 
 void ProjectFinal::setupDescLayouts()
 {
-	// Graphics: Set 0
+	// Bindless table: Set 0 of every pipeline except index compute
+	this->bindless.init(BINDLESS_MAX_BUFFERS, BINDLESS_MAX_IMAGES, BINDLESS_MAX_SAMPLERS);
+
+	// Graphics: Set 1
 	{
 		DescriptorLayout descLayout;
-		descLayout.add(new SSBO(VK_SHADER_STAGE_VERTEX_BIT, 1, nullptr)); // Vertices
-		descLayout.add(new UBO(VK_SHADER_STAGE_VERTEX_BIT, 1, nullptr)); // Camera
+		descLayout.add(new DynamicUBO(VK_SHADER_STAGE_VERTEX_BIT, 1, nullptr)); // Camera
 		descLayout.init();
 		this->descManagers[PIPELINE_GRAPHICS].addLayout(descLayout);
-		this->descManagers[PIPELINE_GRAPHICS].init(getSwapChain()->getNumImages());
+		this->descManagers[PIPELINE_GRAPHICS].init(1);
 	}
 
-	// Models: Set 0
+	// Models: Set 1
 	{
 		DescriptorLayout descLayout;
 		descLayout.add(new SSBO(VK_SHADER_STAGE_VERTEX_BIT, 1, nullptr)); // Vertices
-		descLayout.add(new SSBO(VK_SHADER_STAGE_VERTEX_BIT, 1, nullptr)); // Transforms
-		descLayout.add(new UBO(VK_SHADER_STAGE_VERTEX_BIT, 1, nullptr)); // World Vp
+		descLayout.add(new SSBO(VK_SHADER_STAGE_VERTEX_BIT, 1, nullptr)); // Visible instances
+		descLayout.add(new DynamicUBO(VK_SHADER_STAGE_VERTEX_BIT, 1, nullptr)); // World Vp
+		descLayout.add(new SSBO(VK_SHADER_STAGE_FRAGMENT_BIT, 1, nullptr)); // Material table
+		descLayout.add(new SSBO(VK_SHADER_STAGE_VERTEX_BIT, 1, nullptr)); // Node transforms
+		descLayout.add(new SSBO(VK_SHADER_STAGE_VERTEX_BIT, 1, nullptr)); // Draw data
+		descLayout.add(new SSBO(VK_SHADER_STAGE_FRAGMENT_BIT, 1, nullptr)); // Material parameters
+		descLayout.add(new SSBO(VK_SHADER_STAGE_VERTEX_BIT, 1, nullptr)); // Instances
 		descLayout.init();
 		this->descManagers[PIPELINE_MODELS].addLayout(descLayout);
-		std::vector<DescriptorLayout> descLayouts(this->models[MODEL_TREE].materials.size());
-		for (uint32_t i = 0; i < (uint32_t)this->models[MODEL_TREE].materials.size(); i++)
-		{
-			Material& material = this->models[MODEL_TREE].materials[i];
-			Material::initializeDescriptor(descLayouts[i]);
-			this->descManagers[PIPELINE_MODELS].addLayout(descLayouts[i]);
-		}
 		this->descManagers[PIPELINE_MODELS].init(getSwapChain()->getNumImages());
 	}
 
-	// Frustum compute: Set 0
+	// Impostors: Set 1
+	{
+		DescriptorLayout descLayout;
+		descLayout.add(new SSBO(VK_SHADER_STAGE_VERTEX_BIT, 1, nullptr)); // Visible impostors
+		descLayout.add(new DynamicUBO(VK_SHADER_STAGE_VERTEX_BIT, 1, nullptr)); // Camera
+		descLayout.add(new SSBO(VK_SHADER_STAGE_VERTEX_BIT, 1, nullptr)); // Instances
+		descLayout.init();
+		this->descManagers[PIPELINE_IMPOSTORS].addLayout(descLayout);
+		this->descManagers[PIPELINE_IMPOSTORS].init(getSwapChain()->getNumImages());
+	}
+
+	// Cluster culling compute: Set 0
+	{
+		DescriptorLayout descLayout;
+		descLayout.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT, 1, nullptr)); // Clusters
+		descLayout.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT, 1, nullptr)); // Visible instances
+		descLayout.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT, 1, nullptr)); // Instances
+		descLayout.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT, 1, nullptr)); // Node transforms
+		descLayout.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT, 1, nullptr)); // Draw data
+		descLayout.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT, 1, nullptr)); // Indirect commands
+		descLayout.add(new DynamicUBO(VK_SHADER_STAGE_COMPUTE_BIT, 1, nullptr)); // Camera
+		descLayout.add(new DynamicUBO(VK_SHADER_STAGE_COMPUTE_BIT, 1, nullptr)); // Planes
+		descLayout.init();
+		this->descManagers[PIPELINE_CLUSTERS].addLayout(descLayout);
+		this->descManagers[PIPELINE_CLUSTERS].init(getSwapChain()->getNumImages());
+	}
+
+	// Frustum compute: Set 1
 	{
 		DescriptorLayout descLayout;
 		descLayout.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT, 1, nullptr)); // Out
-		descLayout.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT, 1, nullptr)); // In
-		descLayout.add(new UBO(VK_SHADER_STAGE_COMPUTE_BIT, 1, nullptr)); // Planes
 		descLayout.add(new UBO(VK_SHADER_STAGE_COMPUTE_BIT, 1, nullptr)); // WorldData
+		descLayout.add(new DynamicUBO(VK_SHADER_STAGE_COMPUTE_BIT, 1, nullptr)); // Planes
 		descLayout.init();
 		this->descManagers[PIPELINE_FRUSTUM].addLayout(descLayout);
-		this->descManagers[PIPELINE_FRUSTUM].init(getSwapChain()->getNumImages());
+		this->descManagers[PIPELINE_FRUSTUM].init(1);
 	}
 
 	// Index compute: Set 0
@@ -230,6 +331,17 @@ void ProjectFinal::setupDescLayouts()
 		this->descManagers[PIPELINE_INDEX].init(1);
 	}
 
+	// Tree placement compute: Set 0
+	{
+		DescriptorLayout descLayout;
+		descLayout.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT, 1, nullptr)); // Terrain heights
+		descLayout.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT, 1, nullptr)); // Instances
+		descLayout.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT, 1, nullptr)); // Jobs
+		descLayout.init();
+		this->descManagers[PIPELINE_PLACEMENT].addLayout(descLayout);
+		this->descManagers[PIPELINE_PLACEMENT].init(1);
+	}
+
 }
 
 void ProjectFinal::setupGeneral()
@@ -237,11 +349,15 @@ void ProjectFinal::setupGeneral()
 	getShaders().resize(PIPELINE_COUNT);
 	getPipelines().resize(PIPELINE_COUNT);
 
+	// Pipelines are created in parallel on the dispatcher threads while the rest is set up
 	setupShaders();
 	setupGraphicsPipeline();
 	setupModelsPipeline();
+	setupImpostorsPipeline();
+	setupClustersPipeline();
 	setupFrustumPipeline();
 	setupIndexPipeline();
+	setupPlacementPipeline();
 
 	// Setup depth texture
 	{
@@ -271,32 +387,72 @@ void ProjectFinal::setupGeneral()
 	// Skybox
 	{
 		std::string pathToCubemap = "..\\assets\\Textures\\skybox\\";
-		this->skybox.init(500.0f, pathToCubemap, getSwapChain(), &this->graphicsPools[MAIN_THREAD], &this->renderPass);
+		this->skybox.init(pathToCubemap, getSwapChain(), &this->graphicsPools[MAIN_THREAD], &this->renderPass);
 	}
+
+	// Models are not needed for the first frames and keep compiling in the background
+	getPipeline(PIPELINE_GRAPHICS).wait();
+	getPipeline(PIPELINE_FRUSTUM).wait();
+	getPipeline(PIPELINE_INDEX).wait();
+	getPipeline(PIPELINE_PLACEMENT).wait();
 }
 
 void ProjectFinal::setupBuffers()
 {
 	// Graphics buffers
 	{
+		// Tree instances are placed and stay on the device, only the indices of the visible ones from the cull stage are written each frame
 		std::vector<uint32_t> queueIndices = { Instance::get().getGraphicsQueue().queueIndex };
-		this->buffers[BUFFER_CAMERA].init(sizeof(CameraData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, queueIndices);
-		this->buffers[BUFFER_CAMERA_STAGE].init(sizeof(CameraData), VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, { Instance::get().getTransferQueue().queueIndex });
-		this->buffers[BUFFER_MODEL_TRANSFORMS].init(sizeof(glm::mat4) * this->treeCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, queueIndices);
-		this->memories[MEMORY_DEVICE_LOCAL].bindBuffer(&this->buffers[BUFFER_CAMERA]);
-		this->memories[MEMORY_HOST_VISIBLE].bindBuffer(&this->buffers[BUFFER_CAMERA_STAGE]);
-		this->memories[MEMORY_HOST_VISIBLE].bindBuffer(&this->buffers[BUFFER_MODEL_TRANSFORMS]);
+		this->buffers[BUFFER_MODEL_INSTANCES].init(sizeof(PackedInstance) * this->treeCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, queueIndices);
+		this->memories[MEMORY_DEVICE_LOCAL].bindBuffer(&this->buffers[BUFFER_MODEL_INSTANCES]);
+		this->buffers[BUFFER_TERRAIN_HEIGHTS].init(sizeof(float) * this->heightmap.getVerticiesSize(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, queueIndices);
+		this->memories[MEMORY_DEVICE_LOCAL].bindBuffer(&this->buffers[BUFFER_TERRAIN_HEIGHTS]);
+		this->buffers[BUFFER_TREE_PLACEMENT_JOBS].init(sizeof(glm::uvec2) * this->treePageCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, queueIndices);
+		this->memories[MEMORY_HOST_VISIBLE].bindBuffer(&this->buffers[BUFFER_TREE_PLACEMENT_JOBS]);
+		this->buffers[BUFFER_TREE_READBACK].init(sizeof(PackedInstance) * this->treeCount, VK_BUFFER_USAGE_TRANSFER_DST_BIT, queueIndices);
+		this->memories[MEMORY_HOST_VISIBLE].bindBuffer(&this->buffers[BUFFER_TREE_READBACK]);
+		this->frameBuffers[BUFFER_MODEL_VISIBLE].init(getSwapChain()->getNumImages(), sizeof(uint32_t) * this->treeCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, queueIndices);
+		this->frameBuffers[BUFFER_MODEL_VISIBLE].bind(&this->memories[MEMORY_HOST_VISIBLE]);
+		this->frameBuffers[BUFFER_IMPOSTOR_VISIBLE].init(getSwapChain()->getNumImages(), sizeof(uint32_t) * this->treeCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, queueIndices);
+		this->frameBuffers[BUFFER_IMPOSTOR_VISIBLE].bind(&this->memories[MEMORY_HOST_VISIBLE]);
+
+		// Material table and parameters, indexed by the material index in the draw data
+		size_t materialCount = this->models[MODEL_TREE].materials.size();
+		this->buffers[BUFFER_MATERIALS].init(sizeof(Material::BindlessData) * materialCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, queueIndices);
+		this->memories[MEMORY_HOST_VISIBLE].bindBuffer(&this->buffers[BUFFER_MATERIALS]);
+		this->buffers[BUFFER_MATERIAL_PARAMS].init(sizeof(Material::PushData) * materialCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, queueIndices);
+		this->memories[MEMORY_HOST_VISIBLE].bindBuffer(&this->buffers[BUFFER_MATERIAL_PARAMS]);
+
+		// Tree draw list, node transforms and draw data indexed by draw id. The list is drawn once for each level of detail,
+		// the draws of the culled clusters follow in each frame's draw data and commands
+		size_t drawCount = this->treeDrawList.getDraws().size() * this->models[MODEL_TREE].lodCount;
+		size_t clusterDrawCount = this->clusterCulling ? CLUSTER_MAX_DRAWS : 0;
+		this->buffers[BUFFER_MODEL_NODE_TRANSFORMS].init(sizeof(glm::mat4) * this->treeDrawList.getTransforms().size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, queueIndices);
+		this->memories[MEMORY_HOST_VISIBLE].bindBuffer(&this->buffers[BUFFER_MODEL_NODE_TRANSFORMS]);
+		this->frameBuffers[BUFFER_MODEL_DRAW_DATA].init(getSwapChain()->getNumImages(), sizeof(DrawList::IndirectData) * (drawCount + clusterDrawCount), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, queueIndices);
+		this->frameBuffers[BUFFER_MODEL_DRAW_DATA].bind(&this->memories[MEMORY_HOST_VISIBLE]);
+		this->frameBuffers[BUFFER_MODEL_INDIRECT].init(getSwapChain()->getNumImages(), sizeof(ModelIndirectHeader) + sizeof(VkDrawIndexedIndirectCommand) * (drawCount + clusterDrawCount),
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, queueIndices);
+		this->frameBuffers[BUFFER_MODEL_INDIRECT].bind(&this->memories[MEMORY_HOST_VISIBLE]);
+		this->treeIndirectCommands.resize(drawCount);
+		if (this->clusterCulling) {
+			this->buffers[BUFFER_MODEL_CLUSTERS].init(sizeof(DrawList::IndirectCluster) * this->treeClusters.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, queueIndices);
+			this->memories[MEMORY_HOST_VISIBLE].bindBuffer(&this->buffers[BUFFER_MODEL_CLUSTERS]);
+		}
+	}
+
+	// Per frame uniforms, one region for each swap chain image
+	{
+		this->cameraRange = this->uniformArena.addRange(sizeof(CameraData));
+		this->planesRange = this->uniformArena.addRange(sizeof(Camera::Plane) * 6);
+		this->uniformArena.init(getSwapChain()->getNumImages(), { Instance::get().getGraphicsQueue().queueIndex, Instance::get().getComputeQueue().queueIndex });
 	}
 
 	// Frustum buffers
 	{
-		// Planes and world data
+		// World data
 		std::vector<uint32_t> queueIndices = { Instance::get().getComputeQueue().queueIndex };
-		this->buffers[BUFFER_PLANES].init(sizeof(Camera::Plane) * 6, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, queueIndices);
-		this->buffers[BUFFER_PLANES_STAGE].init(sizeof(Camera::Plane) * 6, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, { Instance::get().getTransferQueue().queueIndex });
 		this->buffers[BUFFER_WORLD_DATA].init(sizeof(WorldData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, queueIndices);
-		this->memories[MEMORY_DEVICE_LOCAL].bindBuffer(&this->buffers[BUFFER_PLANES]);
-		this->memories[MEMORY_HOST_VISIBLE].bindBuffer(&this->buffers[BUFFER_PLANES_STAGE]);
 		this->memories[MEMORY_HOST_VISIBLE].bindBuffer(&this->buffers[BUFFER_WORLD_DATA]);
 
 		// Indirect draw data
@@ -338,64 +494,75 @@ void ProjectFinal::setupMemories()
 
 void ProjectFinal::setupDescManagers()
 {
+	// Bindless, both vertex buffers are added once and selected by index
+	this->vertexHandles[0] = this->bindless.addBuffer(this->buffers[BUFFER_VERTICES].getBuffer(), 0, this->buffers[BUFFER_VERTICES].getSize());
+	this->vertexHandles[1] = this->bindless.addBuffer(this->buffers[BUFFER_VERTICES_2].getBuffer(), 0, this->buffers[BUFFER_VERTICES_2].getSize());
+	this->activeVertexBuffer = this->vertexHandles[0];
+
 	// Graphics
-	for (size_t i = 0; i < getSwapChain()->getNumImages(); i++) {
-		this->descManagers[PIPELINE_GRAPHICS].updateBufferDesc(0, 0, this->buffers[BUFFER_VERTICES].getBuffer(), 0, this->buffers[BUFFER_VERTICES].getSize());
-		this->descManagers[PIPELINE_GRAPHICS].updateBufferDesc(0, 1, this->buffers[BUFFER_CAMERA].getBuffer(), 0, this->buffers[BUFFER_CAMERA].getSize());
-		this->descManagers[PIPELINE_GRAPHICS].updateSets({ 0 }, i);
-	}
+	this->descManagers[PIPELINE_GRAPHICS].updateBufferDesc(0, 0, this->uniformArena.getBuffer()->getBuffer(), this->uniformArena.getRangeOffset(this->cameraRange), this->uniformArena.getRangeSize(this->cameraRange));
+	this->descManagers[PIPELINE_GRAPHICS].updateSets({ 0 }, 0);
 
 	// Models
 	for (uint32_t i = 0; i < static_cast<uint32_t>(getSwapChain()->getNumImages()); i++)
 	{
-		VkDeviceSize vertexBufferSize = this->models[MODEL_TREE].vertices.size() * sizeof(Vertex);
-		this->descManagers[PIPELINE_MODELS].updateBufferDesc(0, 0, this->models[MODEL_TREE].vertexBuffer.getBuffer(), 0, vertexBufferSize);
-		this->descManagers[PIPELINE_MODELS].updateBufferDesc(0, 1, this->buffers[BUFFER_MODEL_TRANSFORMS].getBuffer(), 0, this->buffers[BUFFER_MODEL_TRANSFORMS].getSize());
-		this->descManagers[PIPELINE_MODELS].updateBufferDesc(0, 2, this->buffers[BUFFER_CAMERA].getBuffer(), 0, sizeof(CameraData));
-		auto& materials = this->models[MODEL_TREE].materials;
-		std::vector<uint32_t> sets(1+ materials.size(), 0);
-		for (uint32_t j = 1; j <= (uint32_t)materials.size(); j++)
-		{
-			Material& material = materials[j - 1];
-			sets[j] = j;
-			this->descManagers[PIPELINE_MODELS].updateImageDesc(j, 0, material.baseColorTexture.texture->getImage().getLayout(), 
-				material.baseColorTexture.texture->getVkImageView(), material.baseColorTexture.sampler->getSampler());
-
-			this->descManagers[PIPELINE_MODELS].updateImageDesc(j, 1, material.metallicRoughnessTexture.texture->getImage().getLayout(),
-				material.metallicRoughnessTexture.texture->getVkImageView(), material.metallicRoughnessTexture.sampler->getSampler());
-
-			this->descManagers[PIPELINE_MODELS].updateImageDesc(j, 2, material.normalTexture.texture->getImage().getLayout(),
-				material.normalTexture.texture->getVkImageView(), material.normalTexture.sampler->getSampler());
+		Buffer& arenaVertices = this->geometryArena.getVertexBuffer();
+		this->descManagers[PIPELINE_MODELS].updateBufferDesc(0, 0, arenaVertices.getBuffer(), 0, arenaVertices.getSize());
+		this->descManagers[PIPELINE_MODELS].updateBufferDesc(0, 1, this->frameBuffers[BUFFER_MODEL_VISIBLE].get(i)->getBuffer(), 0, this->frameBuffers[BUFFER_MODEL_VISIBLE].getSize());
+		this->descManagers[PIPELINE_MODELS].updateBufferDesc(0, 2, this->uniformArena.getBuffer()->getBuffer(), this->uniformArena.getRangeOffset(this->cameraRange), this->uniformArena.getRangeSize(this->cameraRange));
+		this->descManagers[PIPELINE_MODELS].updateBufferDesc(0, 3, this->buffers[BUFFER_MATERIALS].getBuffer(), 0, this->buffers[BUFFER_MATERIALS].getSize());
+		this->descManagers[PIPELINE_MODELS].updateBufferDesc(0, 4, this->buffers[BUFFER_MODEL_NODE_TRANSFORMS].getBuffer(), 0, this->buffers[BUFFER_MODEL_NODE_TRANSFORMS].getSize());
+		this->descManagers[PIPELINE_MODELS].updateBufferDesc(0, 5, this->frameBuffers[BUFFER_MODEL_DRAW_DATA].get(i)->getBuffer(), 0, this->frameBuffers[BUFFER_MODEL_DRAW_DATA].getSize());
+		this->descManagers[PIPELINE_MODELS].updateBufferDesc(0, 6, this->buffers[BUFFER_MATERIAL_PARAMS].getBuffer(), 0, this->buffers[BUFFER_MATERIAL_PARAMS].getSize());
+		this->descManagers[PIPELINE_MODELS].updateBufferDesc(0, 7, this->buffers[BUFFER_MODEL_INSTANCES].getBuffer(), 0, this->buffers[BUFFER_MODEL_INSTANCES].getSize());
+		this->descManagers[PIPELINE_MODELS].updateSets({ 0 }, i);
+	}
 
-			this->descManagers[PIPELINE_MODELS].updateImageDesc(j, 3, material.occlusionTexture.texture->getImage().getLayout(),
-				material.occlusionTexture.texture->getVkImageView(), material.occlusionTexture.sampler->getSampler());
+	// Impostors
+	for (uint32_t i = 0; i < static_cast<uint32_t>(getSwapChain()->getNumImages()); i++)
+	{
+		this->descManagers[PIPELINE_IMPOSTORS].updateBufferDesc(0, 0, this->frameBuffers[BUFFER_IMPOSTOR_VISIBLE].get(i)->getBuffer(), 0, this->frameBuffers[BUFFER_IMPOSTOR_VISIBLE].getSize());
+		this->descManagers[PIPELINE_IMPOSTORS].updateBufferDesc(0, 1, this->uniformArena.getBuffer()->getBuffer(), this->uniformArena.getRangeOffset(this->cameraRange), this->uniformArena.getRangeSize(this->cameraRange));
+		this->descManagers[PIPELINE_IMPOSTORS].updateBufferDesc(0, 2, this->buffers[BUFFER_MODEL_INSTANCES].getBuffer(), 0, this->buffers[BUFFER_MODEL_INSTANCES].getSize());
+		this->descManagers[PIPELINE_IMPOSTORS].updateSets({ 0 }, i);
+	}
 
-			this->descManagers[PIPELINE_MODELS].updateImageDesc(j, 4, material.emissiveTexture.texture->getImage().getLayout(),
-				material.emissiveTexture.texture->getVkImageView(), material.emissiveTexture.sampler->getSampler());
-		}
-		this->descManagers[PIPELINE_MODELS].updateSets(sets, i);
+	// Cluster culling compute
+	for (uint32_t i = 0; i < static_cast<uint32_t>(getSwapChain()->getNumImages()) && this->clusterCulling; i++)
+	{
+		this->descManagers[PIPELINE_CLUSTERS].updateBufferDesc(0, 0, this->buffers[BUFFER_MODEL_CLUSTERS].getBuffer(), 0, this->buffers[BUFFER_MODEL_CLUSTERS].getSize());
+		this->descManagers[PIPELINE_CLUSTERS].updateBufferDesc(0, 1, this->frameBuffers[BUFFER_MODEL_VISIBLE].get(i)->getBuffer(), 0, this->frameBuffers[BUFFER_MODEL_VISIBLE].getSize());
+		this->descManagers[PIPELINE_CLUSTERS].updateBufferDesc(0, 2, this->buffers[BUFFER_MODEL_INSTANCES].getBuffer(), 0, this->buffers[BUFFER_MODEL_INSTANCES].getSize());
+		this->descManagers[PIPELINE_CLUSTERS].updateBufferDesc(0, 3, this->buffers[BUFFER_MODEL_NODE_TRANSFORMS].getBuffer(), 0, this->buffers[BUFFER_MODEL_NODE_TRANSFORMS].getSize());
+		this->descManagers[PIPELINE_CLUSTERS].updateBufferDesc(0, 4, this->frameBuffers[BUFFER_MODEL_DRAW_DATA].get(i)->getBuffer(), 0, this->frameBuffers[BUFFER_MODEL_DRAW_DATA].getSize());
+		this->descManagers[PIPELINE_CLUSTERS].updateBufferDesc(0, 5, this->frameBuffers[BUFFER_MODEL_INDIRECT].get(i)->getBuffer(), 0, this->frameBuffers[BUFFER_MODEL_INDIRECT].getSize());
+		this->descManagers[PIPELINE_CLUSTERS].updateBufferDesc(0, 6, this->uniformArena.getBuffer()->getBuffer(), this->uniformArena.getRangeOffset(this->cameraRange), this->uniformArena.getRangeSize(this->cameraRange));
+		this->descManagers[PIPELINE_CLUSTERS].updateBufferDesc(0, 7, this->uniformArena.getBuffer()->getBuffer(), this->uniformArena.getRangeOffset(this->planesRange), this->uniformArena.getRangeSize(this->planesRange));
+		this->descManagers[PIPELINE_CLUSTERS].updateSets({ 0 }, i);
 	}
 
 	// Frustum compute
-	for (size_t i = 0; i < getSwapChain()->getNumImages(); i++) {
-		this->descManagers[PIPELINE_FRUSTUM].updateBufferDesc(0, 0, this->buffers[BUFFER_INDIRECT_DRAW].getBuffer(), 0, this->buffers[BUFFER_INDIRECT_DRAW].getSize());
-		this->descManagers[PIPELINE_FRUSTUM].updateBufferDesc(0, 1, this->buffers[BUFFER_VERTICES].getBuffer(), 0, this->buffers[BUFFER_VERTICES].getSize());
-		this->descManagers[PIPELINE_FRUSTUM].updateBufferDesc(0, 2, this->buffers[BUFFER_WORLD_DATA].getBuffer(), 0, this->buffers[BUFFER_WORLD_DATA].getSize());
-		this->descManagers[PIPELINE_FRUSTUM].updateBufferDesc(0, 3, this->buffers[BUFFER_PLANES].getBuffer(), 0, this->buffers[BUFFER_PLANES].getSize());
-		this->descManagers[PIPELINE_FRUSTUM].updateSets({ 0 }, i);
-	}
+	this->descManagers[PIPELINE_FRUSTUM].updateBufferDesc(0, 0, this->buffers[BUFFER_INDIRECT_DRAW].getBuffer(), 0, this->buffers[BUFFER_INDIRECT_DRAW].getSize());
+	this->descManagers[PIPELINE_FRUSTUM].updateBufferDesc(0, 1, this->buffers[BUFFER_WORLD_DATA].getBuffer(), 0, this->buffers[BUFFER_WORLD_DATA].getSize());
+	this->descManagers[PIPELINE_FRUSTUM].updateBufferDesc(0, 2, this->uniformArena.getBuffer()->getBuffer(), this->uniformArena.getRangeOffset(this->planesRange), this->uniformArena.getRangeSize(this->planesRange));
+	this->descManagers[PIPELINE_FRUSTUM].updateSets({ 0 }, 0);
 
 	// Index compute
 	this->descManagers[PIPELINE_INDEX].updateBufferDesc(0, 0, this->buffers[BUFFER_INDEX].getBuffer(), 0, this->buffers[BUFFER_INDEX].getSize());
 	this->descManagers[PIPELINE_INDEX].updateBufferDesc(0, 1, this->buffers[BUFFER_CONFIG].getBuffer(), 0, this->buffers[BUFFER_CONFIG].getSize());
 	this->descManagers[PIPELINE_INDEX].updateSets({ 0 }, 0);
+
+	// Tree placement compute
+	this->descManagers[PIPELINE_PLACEMENT].updateBufferDesc(0, 0, this->buffers[BUFFER_TERRAIN_HEIGHTS].getBuffer(), 0, this->buffers[BUFFER_TERRAIN_HEIGHTS].getSize());
+	this->descManagers[PIPELINE_PLACEMENT].updateBufferDesc(0, 1, this->buffers[BUFFER_MODEL_INSTANCES].getBuffer(), 0, this->buffers[BUFFER_MODEL_INSTANCES].getSize());
+	this->descManagers[PIPELINE_PLACEMENT].updateBufferDesc(0, 2, this->buffers[BUFFER_TREE_PLACEMENT_JOBS].getBuffer(), 0, this->buffers[BUFFER_TREE_PLACEMENT_JOBS].getSize());
+	this->descManagers[PIPELINE_PLACEMENT].updateSets({ 0 }, 0);
 }
 
 void ProjectFinal::setupCommandBuffers()
 {
 	this->graphicsPrimary = this->graphicsPools[MAIN_THREAD].createCommandBuffers(getSwapChain()->getNumImages(), VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 	this->computePrimary = this->computePools[MAIN_THREAD].createCommandBuffers(getSwapChain()->getNumImages(), VK_COMMAND_BUFFER_LEVEL_PRIMARY);
-	this->transferPrimary = this->transferPools[MAIN_THREAD].createCommandBuffers(getSwapChain()->getNumImages(), VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 
 	for (size_t i = 0; i < getSwapChain()->getNumImages(); i++) {
 		for (size_t j = 0; j < FUNC_COUNT_GRAPHICS; j++)
@@ -406,11 +573,6 @@ void ProjectFinal::setupCommandBuffers()
 		for (size_t j = 0; j < FUNC_COUNT_COMPUTE ; j++)
 			this->computeSecondary[i].push_back(this->computePools[j % (ThreadManager::threadCount() - 1) + 1].createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_SECONDARY));
 	}
-
-	for (size_t i = 0; i < getSwapChain()->getNumImages(); i++) {
-		for (size_t j = 0; j < FUNC_COUNT_TRANSFER; j++)
-			this->transferSecondary[i].push_back(this->transferPools[j % (ThreadManager::threadCount() - 1) + 1].createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_SECONDARY));
-	}
 }
 
 void ProjectFinal::setupCommandPools()
@@ -425,8 +587,8 @@ void ProjectFinal::setupCommandPools()
 	for (auto& pool : this->computePools)
 		pool.init(CommandPool::Queue::COMPUTE, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 
-	// Transfer
-	this->transferPools.resize(std::min(1u + FUNC_COUNT_TRANSFER, ThreadManager::threadCount()));
+	// Transfer, per frame data is written directly so this is only used for streaming
+	this->transferPools.resize(1);
 	for (auto& pool : this->transferPools)
 		pool.init(CommandPool::Queue::TRANSFER, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 }
@@ -434,35 +596,69 @@ void ProjectFinal::setupCommandPools()
 void ProjectFinal::setupShaders()
 {
 	// Graphics
-	getShader(PIPELINE_GRAPHICS).addStage(Shader::Type::VERTEX, "ComputeTransferTest\\compTransferVert.spv");
+	getShader(PIPELINE_GRAPHICS).addStage(Shader::Type::VERTEX, "ComputeTransferTest\\compTransferBindlessVert.spv");
 	getShader(PIPELINE_GRAPHICS).addStage(Shader::Type::FRAGMENT, "ComputeTransferTest\\compTransferFrag.spv");
 	getShader(PIPELINE_GRAPHICS).init();
 
 	// Model
-	getShader(PIPELINE_MODELS).addStage(Shader::Type::VERTEX, "modelVertex.spv");
-	getShader(PIPELINE_MODELS).addStage(Shader::Type::FRAGMENT, "modelFragment.spv");
+	getShader(PIPELINE_MODELS).addStage(Shader::Type::VERTEX, "modelIndirectVertex.spv");
+	getShader(PIPELINE_MODELS).addStage(Shader::Type::FRAGMENT, "modelIndirectFragment.spv");
 	getShader(PIPELINE_MODELS).init();
 
+	// Impostors
+	getShader(PIPELINE_IMPOSTORS).addStage(Shader::Type::VERTEX, "impostorVertex.spv");
+	getShader(PIPELINE_IMPOSTORS).addStage(Shader::Type::FRAGMENT, "impostorFragment.spv");
+	getShader(PIPELINE_IMPOSTORS).init();
+
 	// Frustum compute
-	getShader(PIPELINE_FRUSTUM).addStage(Shader::Type::COMPUTE, "ComputeTransferTest\\compTransferComp.spv");
+	getShader(PIPELINE_FRUSTUM).addStage(Shader::Type::COMPUTE, "ComputeTransferTest\\compTransferBindlessComp.spv");
 	getShader(PIPELINE_FRUSTUM).init();
 
 	// Index compute
 	getShader(PIPELINE_INDEX).addStage(Shader::Type::COMPUTE, "ComputeTransferTest\\compTransferIndex.spv");
 	getShader(PIPELINE_INDEX).init();
+
+	// Tree placement compute
+	getShader(PIPELINE_PLACEMENT).addStage(Shader::Type::COMPUTE, "treePlacement.spv");
+	getShader(PIPELINE_PLACEMENT).init();
+
+	// Cluster culling compute
+	getShader(PIPELINE_CLUSTERS).addStage(Shader::Type::COMPUTE, "clusterCull.spv");
+	getShader(PIPELINE_CLUSTERS).init();
 }
 
 void ProjectFinal::setupFrustumPipeline()
 {
-
+	PushConstants pushConstants;
+	pushConstants.addLayout(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(BindlessTable::Handle), 0); // Vertex buffer
+	getPipeline(PIPELINE_FRUSTUM).setPushConstants(pushConstants);
+	getPipeline(PIPELINE_FRUSTUM).setDescriptorLayouts({ this->bindless.getLayout() });
 	getPipeline(PIPELINE_FRUSTUM).setDescriptorLayouts(this->descManagers[PIPELINE_FRUSTUM].getLayouts());
-	getPipeline(PIPELINE_FRUSTUM).init(Pipeline::Type::COMPUTE, &getShader(PIPELINE_FRUSTUM));
+	getPipeline(PIPELINE_FRUSTUM).initAsync(Pipeline::Type::COMPUTE, &getShader(PIPELINE_FRUSTUM));
 }
 
 void ProjectFinal::setupIndexPipeline()
 {
 	getPipeline(PIPELINE_INDEX).setDescriptorLayouts(this->descManagers[PIPELINE_INDEX].getLayouts());
-	getPipeline(PIPELINE_INDEX).init(Pipeline::Type::COMPUTE, &getShader(PIPELINE_INDEX));
+	getPipeline(PIPELINE_INDEX).initAsync(Pipeline::Type::COMPUTE, &getShader(PIPELINE_INDEX));
+}
+
+void ProjectFinal::setupPlacementPipeline()
+{
+	PushConstants pushConstants;
+	pushConstants.addLayout(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(TreePlacementConfig), 0);
+	getPipeline(PIPELINE_PLACEMENT).setPushConstants(pushConstants);
+	getPipeline(PIPELINE_PLACEMENT).setDescriptorLayouts(this->descManagers[PIPELINE_PLACEMENT].getLayouts());
+	getPipeline(PIPELINE_PLACEMENT).initAsync(Pipeline::Type::COMPUTE, &getShader(PIPELINE_PLACEMENT));
+}
+
+void ProjectFinal::setupClustersPipeline()
+{
+	PushConstants pushConstants;
+	pushConstants.addLayout(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(ClusterCullData), 0);
+	getPipeline(PIPELINE_CLUSTERS).setPushConstants(pushConstants);
+	getPipeline(PIPELINE_CLUSTERS).setDescriptorLayouts(this->descManagers[PIPELINE_CLUSTERS].getLayouts());
+	getPipeline(PIPELINE_CLUSTERS).initAsync(Pipeline::Type::COMPUTE, &getShader(PIPELINE_CLUSTERS));
 }
 
 void ProjectFinal::setupGraphicsPipeline()
@@ -485,20 +681,59 @@ void ProjectFinal::setupGraphicsPipeline()
 	this->renderPass.addSubpassDependency(subpassDependency);
 	this->renderPass.init();
 
+	PushConstants pushConstants;
+	pushConstants.addLayout(VK_SHADER_STAGE_VERTEX_BIT, sizeof(BindlessTable::Handle), 0); // Vertex buffer
+	getPipeline(PIPELINE_GRAPHICS).setPushConstants(pushConstants);
+	getPipeline(PIPELINE_GRAPHICS).setDescriptorLayouts({ this->bindless.getLayout() });
 	getPipeline(PIPELINE_GRAPHICS).setDescriptorLayouts(this->descManagers[PIPELINE_GRAPHICS].getLayouts());
 	getPipeline(PIPELINE_GRAPHICS).setGraphicsPipelineInfo(getSwapChain()->getExtent(), &this->renderPass);
 	getPipeline(PIPELINE_GRAPHICS).setWireframe(WIREFRAME);
-	getPipeline(PIPELINE_GRAPHICS).init(Pipeline::Type::GRAPHICS, &getShader(PIPELINE_GRAPHICS));
+	getPipeline(PIPELINE_GRAPHICS).initAsync(Pipeline::Type::GRAPHICS, &getShader(PIPELINE_GRAPHICS));
 }
 
 void ProjectFinal::setupModelsPipeline()
 {
-	PushConstants& pushConstants = ModelRenderer::get().getPushConstants();
-	getPipeline(PIPELINE_MODELS).setPushConstants(pushConstants);
+	getPipeline(PIPELINE_MODELS).setDescriptorLayouts({ this->bindless.getLayout() });
 	getPipeline(PIPELINE_MODELS).setDescriptorLayouts(this->descManagers[PIPELINE_MODELS].getLayouts());
 	getPipeline(PIPELINE_MODELS).setGraphicsPipelineInfo(getSwapChain()->getExtent(), &this->renderPass);
 	getPipeline(PIPELINE_MODELS).setWireframe(WIREFRAME);
-	getPipeline(PIPELINE_MODELS).init(Pipeline::Type::GRAPHICS, &getShader(PIPELINE_MODELS));
+	getPipeline(PIPELINE_MODELS).initAsync(Pipeline::Type::GRAPHICS, &getShader(PIPELINE_MODELS));
+
+	// The tree is flattened once and drawn with one indirect draw every frame
+	this->treeDrawList.add(&this->models[MODEL_TREE], glm::mat4(1.0f), &getPipeline(PIPELINE_MODELS));
+	this->treeDrawList.compile();
+	this->treeLodTriangles.fill(0);
+	for (const DrawList::Draw& draw : this->treeDrawList.getDraws())
+		for (uint32_t lod = 0; lod < MESH_LOD_COUNT; lod++)
+			this->treeLodTriangles[lod] += (draw.hasIndices ? draw.lods[lod].indexCount : draw.vertexCount) / 3;
+
+	// Without a GPU draw count the full detail trees are drawn whole
+	this->treeClusters = this->treeDrawList.getClusterData();
+	this->clusterCulling = CLUSTER_CULLING && Instance::get().getDrawIndexedIndirectCount() != nullptr && !this->treeClusters.empty();
+	this->clustersRecorded = false;
+	this->clusterInstances = 0;
+	JAS_INFO("Tree clusters: {} in {} draws, culling {}", this->treeClusters.size(), this->treeDrawList.getDraws().size(), this->clusterCulling ? "on the GPU" : "off");
+}
+
+void ProjectFinal::setupImpostorsPipeline()
+{
+	// One quad for each distant tree, turned to the camera in the vertex shader so both sides are front facing
+	PipelineInfo pipelineInfo;
+	pipelineInfo.rasterizer = {};
+	pipelineInfo.rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	pipelineInfo.rasterizer.polygonMode = WIREFRAME ? VK_POLYGON_MODE_LINE : VK_POLYGON_MODE_FILL;
+	pipelineInfo.rasterizer.lineWidth = 1.0f;
+	pipelineInfo.rasterizer.cullMode = VK_CULL_MODE_NONE;
+	pipelineInfo.rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	getPipeline(PIPELINE_IMPOSTORS).setPipelineInfo(PipelineInfoFlag::RASTERIZATION, pipelineInfo);
+
+	PushConstants pushConstants;
+	pushConstants.addLayout(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(Impostor::Desc), 0);
+	getPipeline(PIPELINE_IMPOSTORS).setPushConstants(pushConstants);
+	getPipeline(PIPELINE_IMPOSTORS).setDescriptorLayouts({ this->bindless.getLayout() });
+	getPipeline(PIPELINE_IMPOSTORS).setDescriptorLayouts(this->descManagers[PIPELINE_IMPOSTORS].getLayouts());
+	getPipeline(PIPELINE_IMPOSTORS).setGraphicsPipelineInfo(getSwapChain()->getExtent(), &this->renderPass);
+	getPipeline(PIPELINE_IMPOSTORS).initAsync(Pipeline::Type::GRAPHICS, &getShader(PIPELINE_IMPOSTORS));
 }
 
 void ProjectFinal::transferInitialData()
@@ -537,6 +772,35 @@ void ProjectFinal::transferInitialData()
 		stagingMemory.cleanup();
 	}
 
+	// Material table, the textures are added to the bindless table once and again when the streamer changes them
+	{
+		TextureStreamer::get().init(&this->transferPools[MAIN_THREAD], &this->bindless, TEXTURE_STREAMING_BUDGET);
+		writeMaterialTable();
+		std::vector<Material::PushData> materialParams;
+		for (const Material& material : this->models[MODEL_TREE].materials)
+			materialParams.push_back(material.pushData);
+		this->memories[MEMORY_HOST_VISIBLE].directTransfer(&this->buffers[BUFFER_MATERIAL_PARAMS], materialParams.data(), materialParams.size() * sizeof(Material::PushData), 0);
+	}
+
+	// Billboards of the tree, from the textures which are resident before any streaming
+	this->treeImpostor.bake(&this->models[MODEL_TREE], &this->geometryArena.getVertexBuffer(), &this->bindless, &this->graphicsPools[MAIN_THREAD]);
+
+	// Tree draw list
+	{
+		const std::vector<glm::mat4>& transforms = this->treeDrawList.getTransforms();
+		std::vector<DrawList::IndirectData> drawData = this->treeDrawList.getIndirectData();
+		// The commands of each level of detail follow each other, and so does their draw data
+		size_t levelDrawCount = drawData.size();
+		for (uint32_t lod = 1; lod < this->models[MODEL_TREE].lodCount; lod++)
+			drawData.insert(drawData.end(), drawData.begin(), drawData.begin() + levelDrawCount);
+		this->memories[MEMORY_HOST_VISIBLE].directTransfer(&this->buffers[BUFFER_MODEL_NODE_TRANSFORMS], transforms.data(), transforms.size() * sizeof(glm::mat4), 0);
+		// Each frame has its own draw data since the cluster culling writes draws after it
+		for (uint32_t i = 0; i < static_cast<uint32_t>(getSwapChain()->getNumImages()); i++)
+			this->memories[MEMORY_HOST_VISIBLE].directTransfer(this->frameBuffers[BUFFER_MODEL_DRAW_DATA].get(i), drawData.data(), drawData.size() * sizeof(DrawList::IndirectData), 0);
+		if (this->clusterCulling)
+			this->memories[MEMORY_HOST_VISIBLE].directTransfer(&this->buffers[BUFFER_MODEL_CLUSTERS], this->treeClusters.data(), this->treeClusters.size() * sizeof(DrawList::IndirectCluster), 0);
+	}
+
 	// Set world data
 	{
 		WorldData tempData;
@@ -553,24 +817,40 @@ void ProjectFinal::transferInitialData()
 		this->compVertInactiveBuffer = &this->buffers[BUFFER_VERTICES_2];
 	}
 
-	// Send transforms to GPU
+	// Terrain heights for the tree placement, 4 bytes for each vertex instead of a whole Heightmap::Vertex
 	{
-		std::srand((unsigned)std::time(0));
-		auto rnd11 = [](int precision = 10000) { return (float)(std::rand() % precision) / (float)precision; };
-		auto rnd = [rnd11](float min, float max) { return min + rnd11(RAND_MAX) * glm::abs(max - min); };
-		std::vector<glm::mat4> matrices;
-		matrices.resize(this->treeCount);
-		for (uint32_t i = 0; i < this->treeCount; i++)
-		{
-			float w = (float)this->heightmap.getWidth() * this->heightmap.getVertexDist();
-			float a = -w / 2;
-			float b = w / 2;
-			glm::vec3 pos(rnd(a, b), 0.f, rnd(a, b));
-			pos.y = this->heightmap.getTerrainHeight(pos.x, pos.z);
-			matrices[i] = glm::translate(glm::mat4(1.0), pos);
-			
-		}
-		this->memories[MEMORY_HOST_VISIBLE].directTransfer(&this->buffers[BUFFER_MODEL_TRANSFORMS], &matrices[0], matrices.size() * sizeof(glm::mat4), 0);
+		const std::vector<Heightmap::Vertex>& terrain = this->heightmap.getVerticies();
+		std::vector<float> heights(terrain.size());
+		for (size_t i = 0; i < terrain.size(); i++)
+			heights[i] = terrain[i].position.y;
+
+		Buffer stagingBuffer;
+		Memory stagingMemory;
+		stagingBuffer.init(this->buffers[BUFFER_TERRAIN_HEIGHTS].getSize(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, { Instance::get().getGraphicsQueue().queueIndex });
+		stagingMemory.bindBuffer(&stagingBuffer);
+		stagingMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		stagingMemory.directTransfer(&stagingBuffer, heights.data(), heights.size() * sizeof(float), 0);
+
+		CommandBuffer* cbuff = this->graphicsPools[MAIN_THREAD].beginSingleTimeCommand();
+		VkBufferCopy region = {};
+		region.size = heights.size() * sizeof(float);
+		cbuff->cmdCopyBuffer(stagingBuffer.getBuffer(), this->buffers[BUFFER_TERRAIN_HEIGHTS].getBuffer(), 1, &region);
+		this->graphicsPools[MAIN_THREAD].endSingleTimeCommand(cbuff);
+
+		stagingBuffer.cleanup();
+		stagingMemory.cleanup();
+	}
+
+	// Place the trees of the first terrain window
+	{
+		this->freeTreePages.clear();
+		for (uint32_t page = this->treePageCount; page > 0; page--)
+			this->freeTreePages.push_back(page - 1);
+		this->treeInstances.resize(this->treeCount);
+		this->treeWindow = this->lastRegionIndex;
+		this->treeWindowComplete = false;
+		this->treePlacementCommand = nullptr;
+		pageTrees(true);
 	}
 	
 	// Submit generate indicies work to GPU once
@@ -609,23 +889,25 @@ void ProjectFinal::transferInitialData()
 	}
 }
 
-void ProjectFinal::transferVertexData()
+void ProjectFinal::transferVertexData(const FramePacket& packet)
 {
 	JAS_PROFILER_SAMPLE_SCOPE("Transfer vertex data check");
-	glm::vec3 camPos = this->camera->getPosition();
-	glm::ivec2 currRegion = this->heightmap.getRegionFromPos(camPos);
-	glm::ivec2 diff = this->lastRegionIndex - currRegion;
-	if (abs(diff.x) > this->transferThreshold || abs(diff.y) > this->transferThreshold) {
-		if (ThreadDispatcher::finished()) {
-			this->lastRegionIndex = currRegion;
-			// Transfer proximity verticies to device
-			uint32_t id = ThreadDispatcher::dispatch([&, camPos]() {
-				this->heightmap.getProximityVerticies(camPos, this->vertices);
-				this->memories[MEMORY_VERT_STAGING].directTransfer(&this->buffers[BUFFER_VERT_STAGING], this->vertices.data(), this->vertices.size() * sizeof(Heightmap::Vertex), 0);
-			});
-
-			this->workIds.push(id);
-		}
+	if (packet.stream) {
+		this->streamPending = true;
+		this->streamPosition = packet.position;
+	}
+
+	// One streaming job at a time, the dispatcher is shared with the cull stage. The latest position wins
+	if (this->streamPending && this->workIds.empty()) {
+		this->streamPending = false;
+		glm::vec3 camPos = this->streamPosition;
+		// Transfer proximity verticies to device
+		uint32_t id = ThreadDispatcher::dispatch([&, camPos]() {
+			this->heightmap.getProximityVerticies(camPos, this->vertices);
+			this->memories[MEMORY_VERT_STAGING].directTransfer(&this->buffers[BUFFER_VERT_STAGING], this->vertices.data(), this->vertices.size() * sizeof(Heightmap::Vertex), 0);
+		});
+
+		this->workIds.push(id);
 	}
 	static CommandBuffer* cBuff = nullptr;
 
@@ -661,6 +943,173 @@ void ProjectFinal::transferVertexData()
 	}
 }
 
+void ProjectFinal::streamTextures(const FramePacket& packet)
+{
+	JAS_PROFILER_SAMPLE_FUNCTION();
+	// Every tree texture is assumed to cover the nearest visible tree, its bounding sphere gives the size in pixels
+	if (packet.visibleTreeCount > 0) {
+		float distance = std::max(packet.nearestTree, this->treeRadius);
+		float screenSize = this->treeRadius * std::abs(packet.proj[1][1]) * getSwapChain()->getExtent().height / distance;
+		for (const Material& material : this->models[MODEL_TREE].materials) {
+			const Material::Tex* texs[5] = { &material.baseColorTexture, &material.metallicRoughnessTexture, &material.normalTexture, &material.occlusionTexture, &material.emissiveTexture };
+			for (const Material::Tex* tex : texs)
+				TextureStreamer::get().requestFootprint(tex->texture, screenSize);
+		}
+	}
+
+	// Frames in flight may read either handle, the replaced image is kept until they are done
+	if (TextureStreamer::get().update(this->frameNumber))
+		writeMaterialTable();
+}
+
+void ProjectFinal::writeMaterialTable()
+{
+	std::vector<Material::BindlessData> materialData;
+	for (const Material& material : this->models[MODEL_TREE].materials)
+		materialData.push_back(material.addToBindless(this->bindless));
+	this->memories[MEMORY_HOST_VISIBLE].directTransfer(&this->buffers[BUFFER_MATERIALS], materialData.data(), materialData.size() * sizeof(Material::BindlessData), 0);
+}
+
+void ProjectFinal::pageTrees(bool wait)
+{
+	JAS_PROFILER_SAMPLE_FUNCTION();
+	if (this->treePlacementCommand) {
+		if (wait)
+			vkWaitForFences(Instance::get().getDevice(), 1, &this->treePlacementFence, VK_TRUE, UINT64_MAX);
+		if (vkGetFenceStatus(Instance::get().getDevice(), this->treePlacementFence) != VK_SUCCESS)
+			return;
+		finishTreePlacement();
+	}
+
+	// Pages are free once the packets culled before the region left and the frames drawing them are done
+	for (size_t i = 0; i < this->retiredTreePages.size();) {
+		if (this->retiredTreePages[i].second <= this->frameNumber) {
+			this->freeTreePages.push_back(this->retiredTreePages[i].first);
+			this->retiredTreePages[i] = this->retiredTreePages.back();
+			this->retiredTreePages.pop_back();
+		}
+		else
+			i++;
+	}
+
+	// The trees follow the region window of the terrain vertices, which moves with lastRegionIndex
+	glm::ivec2 center = this->lastRegionIndex;
+	if (center == this->treeWindow && this->treeWindowComplete)
+		return;
+	this->treeWindow = center;
+
+	int32_t regionWidthCount = this->heightmap.getRegionWidthCount();
+	glm::ivec2 windowMin = glm::max(center - PROXIMITY_SIZE, glm::ivec2(0));
+	glm::ivec2 windowMax = glm::min(center + PROXIMITY_SIZE, glm::ivec2(regionWidthCount - 1));
+	auto inWindow = [&](uint32_t region) {
+		glm::ivec2 r(region % regionWidthCount, region / regionWidthCount);
+		return r.x >= windowMin.x && r.y >= windowMin.y && r.x <= windowMax.x && r.y <= windowMax.y;
+	};
+
+	for (auto it = this->treeRegionPages.begin(); it != this->treeRegionPages.end();) {
+		if (!inWindow(it->first)) {
+			this->retiredTreePages.push_back({ it->second, this->frameNumber + FRAME_PACKET_COUNT + MAX_FRAMES_IN_FLIGHT });
+			it = this->treeRegionPages.erase(it);
+		}
+		else
+			++it;
+	}
+
+	this->treePlacementJobs.clear();
+	this->treeWindowComplete = true;
+	for (int32_t z = windowMin.y; z <= windowMax.y && this->treeWindowComplete; z++)
+		for (int32_t x = windowMin.x; x <= windowMax.x; x++) {
+			uint32_t region = (uint32_t)(x + z * regionWidthCount);
+			if (this->treeRegionPages.count(region))
+				continue;
+			// The rest of the window is placed when retired pages are free again
+			if (this->freeTreePages.empty()) {
+				this->treeWindowComplete = false;
+				break;
+			}
+			this->treePlacementJobs.push_back({ region, this->freeTreePages.back() });
+			this->freeTreePages.pop_back();
+		}
+
+	if (!this->treePlacementJobs.empty()) {
+		startTreePlacement();
+		if (wait)
+			pageTrees(true);
+	}
+}
+
+void ProjectFinal::startTreePlacement()
+{
+	uint32_t jobCount = (uint32_t)this->treePlacementJobs.size();
+	this->memories[MEMORY_HOST_VISIBLE].directTransfer(&this->buffers[BUFFER_TREE_PLACEMENT_JOBS], this->treePlacementJobs.data(), jobCount * sizeof(glm::uvec2), 0);
+
+	TreePlacementConfig config = {};
+	config.origin = glm::vec4(this->heightmap.getOrigin(), this->heightmap.getVertexDist());
+	config.heightmapWidth = (uint32_t)this->heightmap.getWidth();
+	config.regionWidthCount = (uint32_t)this->heightmap.getRegionWidthCount();
+	config.regionSize = (uint32_t)this->heightmap.getRegionSize();
+	config.slotsPerRegion = this->treeSlotsPerRegion;
+	config.heightRange = glm::vec2(TREE_MIN_HEIGHT, TREE_MAX_HEIGHT);
+	config.scaleRange = glm::vec2(TREE_MIN_SCALE, TREE_MAX_SCALE);
+	config.maxSlope = TREE_MAX_SLOPE;
+	config.seed = TREE_PLACEMENT_SEED;
+	config.jobCount = jobCount;
+
+	// The graphics queue owns the instance buffer and runs the compute pass. The pages were drawn by earlier submits
+	// on this queue, the placement waits for their vertex shaders before overwriting them
+	CommandBuffer* cbuff = this->graphicsPools[MAIN_THREAD].beginSingleTimeCommand();
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	cbuff->cmdMemoryBarrier(VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, { &barrier, 1 });
+
+	cbuff->cmdBindPipeline(&getPipeline(PIPELINE_PLACEMENT));
+	std::vector<VkDescriptorSet> sets = { this->descManagers[PIPELINE_PLACEMENT].getSet(0, 0) };
+	std::vector<uint32_t> offsets;
+	cbuff->cmdBindDescriptorSets(&getPipeline(PIPELINE_PLACEMENT), 0, sets, offsets);
+	cbuff->cmdPushConstants(&getPipeline(PIPELINE_PLACEMENT), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(TreePlacementConfig), &config);
+	cbuff->cmdDispatch((jobCount * this->treeSlotsPerRegion + 63) / 64, 1, 1);
+
+	// Only the placed pages are copied back for the cull stage
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+	cbuff->cmdMemoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, { &barrier, 1 });
+	std::vector<VkBufferCopy> regions(jobCount);
+	VkDeviceSize pageSize = sizeof(PackedInstance) * this->treeSlotsPerRegion;
+	for (uint32_t i = 0; i < jobCount; i++) {
+		regions[i].srcOffset = this->treePlacementJobs[i].y * pageSize;
+		regions[i].dstOffset = regions[i].srcOffset;
+		regions[i].size = pageSize;
+	}
+	cbuff->cmdCopyBuffer(this->buffers[BUFFER_MODEL_INSTANCES].getBuffer(), this->buffers[BUFFER_TREE_READBACK].getBuffer(), jobCount, regions.data());
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	cbuff->cmdMemoryBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, { &barrier, 1 });
+	this->graphicsPools[MAIN_THREAD].endSingleTimeCommand(cbuff, this->treePlacementFence);
+	this->treePlacementCommand = cbuff;
+}
+
+void ProjectFinal::finishTreePlacement()
+{
+	uint32_t placed = 0;
+	for (const glm::uvec2& job : this->treePlacementJobs) {
+		uint64_t offset = (uint64_t)job.y * this->treeSlotsPerRegion;
+		this->memories[MEMORY_HOST_VISIBLE].directRead(&this->buffers[BUFFER_TREE_READBACK], &this->treeInstances[offset], sizeof(PackedInstance) * this->treeSlotsPerRegion, offset * sizeof(PackedInstance));
+		for (uint32_t slot = 0; slot < this->treeSlotsPerRegion; slot++)
+			placed += this->treeInstances[offset + slot].getScale() > 0.0f ? 1 : 0;
+		this->treeRegionPages[job.x] = job.y;
+	}
+	JAS_INFO("Paged in {} tree regions with {} trees, {} regions resident", this->treePlacementJobs.size(), placed, this->treeRegionPages.size());
+	this->treePlacementJobs.clear();
+
+	VkCommandBuffer commandBuffer = this->treePlacementCommand->getCommandBuffer();
+	vkFreeCommandBuffers(Instance::get().getDevice(), this->graphicsPools[MAIN_THREAD].getCommandPool(), 1, &commandBuffer);
+	this->graphicsPools[MAIN_THREAD].removeCommandBuffer(this->treePlacementCommand);
+	this->treePlacementCommand = nullptr;
+	vkResetFences(Instance::get().getDevice(), 1, &this->treePlacementFence);
+}
+
 void ProjectFinal::transferToDevice(Buffer* buffer, Buffer* stagingBuffer, Memory* stagingMemory, void* data, uint32_t size)
 {
 	stagingMemory->directTransfer(stagingBuffer, data, size, 0);
@@ -683,22 +1132,6 @@ void ProjectFinal::verticesToDevice(Buffer* buffer, const std::vector<Heightmap:
 	transferToDevice(buffer, &this->buffers[BUFFER_VERT_STAGING], &this->memories[MEMORY_VERT_STAGING], vertices.data(), vertices.size() * sizeof(Heightmap::Vertex));
 }
 
-void ProjectFinal::secRecordTransfer(uint32_t frameIndex, CommandBuffer* buffer, VkCommandBufferInheritanceInfo inheritanceInfo, Buffer& stage, Buffer& Device, void* data)
-{
-	JAS_PROFILER_SAMPLE_FUNCTION();
-	buffer->begin(0, &inheritanceInfo);
-	vkCmdUpdateBuffer(buffer->getCommandBuffer(), stage.getBuffer(), 0, stage.getSize(), data);
-
-	// Copy vertex data.
-	VkBufferCopy region = {};
-	region.srcOffset = 0;
-	region.dstOffset = 0;
-	region.size = stage.getSize();
-	buffer->cmdCopyBuffer(stage.getBuffer(), Device.getBuffer(), 1, &region);
-
-	buffer->end();
-}
-
 void ProjectFinal::secRecordFrustum(uint32_t frameIndex, CommandBuffer* buffer, VkCommandBufferInheritanceInfo inheritanceInfo)
 {
 	JAS_PROFILER_SAMPLE_FUNCTION();
@@ -708,9 +1141,10 @@ void ProjectFinal::secRecordFrustum(uint32_t frameIndex, CommandBuffer* buffer,
 	std::this_thread::sleep_for(std::chrono::duration(std::chrono::microseconds(SIMULATED_JOB_SIZE)));
 #endif
 	buffer->cmdBindPipeline(&getPipeline(PIPELINE_FRUSTUM));
-	std::vector<VkDescriptorSet> sets = { this->descManagers[PIPELINE_FRUSTUM].getSet(frameIndex, 0) };
-	std::vector<uint32_t> offsets;
+	VkDescriptorSet sets[] = { this->bindless.getSet(), this->descManagers[PIPELINE_FRUSTUM].getSet(0, 0) };
+	uint32_t offsets[] = { this->uniformArena.getDynamicOffset(frameIndex) };
 	buffer->cmdBindDescriptorSets(&getPipeline(PIPELINE_FRUSTUM), 0, sets, offsets);
+	buffer->cmdPushConstants(&getPipeline(PIPELINE_FRUSTUM), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(BindlessTable::Handle), &this->activeVertexBuffer);
 	buffer->cmdDispatch((uint32_t)ceilf((float)this->regionCount / 16), 1, 1);
 	VulkanProfiler::get().endIndexedTimestamp("Frustum", buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frameIndex);
 	buffer->end();
@@ -738,16 +1172,17 @@ void ProjectFinal::secRecordHeightmap(uint32_t frameIndex, CommandBuffer* buffer
 	std::this_thread::sleep_for(std::chrono::duration(std::chrono::microseconds(SIMULATED_JOB_SIZE)));
 #endif
 	buffer->cmdBindPipeline(&getPipeline(PIPELINE_GRAPHICS));
-	std::vector<VkDescriptorSet> sets = { this->descManagers[PIPELINE_GRAPHICS].getSet(frameIndex, 0) };
-	std::vector<uint32_t> offsets;
+	VkDescriptorSet sets[] = { this->bindless.getSet(), this->descManagers[PIPELINE_GRAPHICS].getSet(0, 0) };
+	uint32_t offsets[] = { this->uniformArena.getDynamicOffset(frameIndex) };
 	buffer->cmdBindDescriptorSets(&getPipeline(PIPELINE_GRAPHICS), 0, sets, offsets);
+	buffer->cmdPushConstants(&getPipeline(PIPELINE_GRAPHICS), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(BindlessTable::Handle), &this->activeVertexBuffer);
 	buffer->cmdBindIndexBuffer(this->buffers[BUFFER_INDEX].getBuffer(), 0, VK_INDEX_TYPE_UINT32);
 	buffer->cmdDrawIndexedIndirect(this->buffers[BUFFER_INDIRECT_DRAW].getBuffer(), 0, this->regionCount, sizeof(VkDrawIndexedIndirectCommand));
 	VulkanProfiler::get().endIndexedTimestamp("Heightmap", buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frameIndex);
 	buffer->end();
 }
 
-void ProjectFinal::secRecordModels(uint32_t frameIndex, CommandBuffer* buffer, VkCommandBufferInheritanceInfo inheritanceInfo)
+void ProjectFinal::secRecordModels(uint32_t frameIndex, CommandBuffer* buffer, VkCommandBufferInheritanceInfo inheritanceInfo, uint32_t instanceCount)
 {
 	JAS_PROFILER_SAMPLE_FUNCTION();
 	buffer->begin(VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT, &inheritanceInfo);
@@ -755,17 +1190,231 @@ void ProjectFinal::secRecordModels(uint32_t frameIndex, CommandBuffer* buffer, V
 #if SIMULATED_JOB_SIZE > 0
 	std::this_thread::sleep_for(std::chrono::duration(std::chrono::microseconds(SIMULATED_JOB_SIZE)));
 #endif
-	buffer->cmdBindPipeline(&getPipeline(PIPELINE_MODELS));
-	std::vector<uint32_t> offsets;
-	std::vector<VkDescriptorSet> sets = { this->descManagers[PIPELINE_MODELS].getSet(frameIndex, 0) };
-	for (Material& material : this->models[MODEL_TREE].materials)
-		sets.push_back(this->descManagers[PIPELINE_MODELS].getSet(frameIndex, material.index+1));
-	ModelRenderer::get().record(&this->models[MODEL_TREE], glm::mat4(1.0), buffer, &getPipeline(PIPELINE_MODELS), sets, offsets, this->treeCount);
+	// Trees pop in once their pipeline has compiled
+	if (getPipeline(PIPELINE_MODELS).isReady())
+	{
+		uint32_t offsets[] = { this->uniformArena.getDynamicOffset(frameIndex) };
+		VkDescriptorSet sets[] = { this->bindless.getSet(), this->descManagers[PIPELINE_MODELS].getSet(frameIndex, 0) };
+		VkBuffer indirectBuffer = this->frameBuffers[BUFFER_MODEL_INDIRECT].get(frameIndex)->getBuffer();
+		uint32_t drawCount = static_cast<uint32_t>(this->treeIndirectCommands.size()) + (this->clusterCulling ? CLUSTER_MAX_DRAWS : 0);
+		// The draw count is read on the GPU when supported, so a culling pass can write it
+		VkBuffer countBuffer = Instance::get().getDrawIndexedIndirectCount() != nullptr ? indirectBuffer : VK_NULL_HANDLE;
+		if (instanceCount > 0)
+			ModelRenderer::get().recordIndirect(&this->models[MODEL_TREE], buffer, &getPipeline(PIPELINE_MODELS), sets, offsets,
+				indirectBuffer, sizeof(ModelIndirectHeader), drawCount, countBuffer, 0);
+	}
 	VulkanProfiler::get().endIndexedTimestamp("Models", buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frameIndex);
 	buffer->end();
 }
 
-void ProjectFinal::record(uint32_t frameIndex)
+void ProjectFinal::secRecordImpostors(uint32_t frameIndex, CommandBuffer* buffer, VkCommandBufferInheritanceInfo inheritanceInfo, uint32_t instanceCount)
+{
+	JAS_PROFILER_SAMPLE_FUNCTION();
+	buffer->begin(VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT, &inheritanceInfo);
+	VulkanProfiler::get().startIndexedTimestamp("Impostors", buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frameIndex);
+	if (getPipeline(PIPELINE_IMPOSTORS).isReady() && instanceCount > 0)
+	{
+		uint32_t offsets[] = { this->uniformArena.getDynamicOffset(frameIndex) };
+		VkDescriptorSet sets[] = { this->bindless.getSet(), this->descManagers[PIPELINE_IMPOSTORS].getSet(frameIndex, 0) };
+		buffer->cmdBindPipeline(&getPipeline(PIPELINE_IMPOSTORS));
+		buffer->cmdBindDescriptorSets(&getPipeline(PIPELINE_IMPOSTORS), 0, sets, offsets);
+		buffer->cmdPushConstants(&getPipeline(PIPELINE_IMPOSTORS), VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(Impostor::Desc), &this->treeImpostor.getDesc());
+		buffer->cmdDraw(6, instanceCount, 0, 0);
+	}
+	VulkanProfiler::get().endIndexedTimestamp("Impostors", buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frameIndex);
+	buffer->end();
+}
+
+void ProjectFinal::recordClusters(uint32_t frameIndex, CommandBuffer* buffer, uint32_t instanceCount)
+{
+	JAS_PROFILER_SAMPLE_FUNCTION();
+	VulkanProfiler::get().startIndexedTimestamp("Clusters", buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frameIndex);
+	if (this->clustersRecorded && instanceCount > 0)
+	{
+		ClusterCullData data;
+		data.visibleCount = instanceCount;
+		data.clusterCount = static_cast<uint32_t>(this->treeClusters.size());
+		data.firstDraw = static_cast<uint32_t>(this->treeIndirectCommands.size());
+		data.maxDraws = CLUSTER_MAX_DRAWS;
+
+		// The frame fence was waited on, the draws of this image's buffers are done and the CPU wrote them before submit
+		VkDescriptorSet sets[] = { this->descManagers[PIPELINE_CLUSTERS].getSet(frameIndex, 0) };
+		uint32_t offsets[] = { this->uniformArena.getDynamicOffset(frameIndex), this->uniformArena.getDynamicOffset(frameIndex) };
+		buffer->cmdBindPipeline(&getPipeline(PIPELINE_CLUSTERS));
+		buffer->cmdBindDescriptorSets(&getPipeline(PIPELINE_CLUSTERS), 0, sets, offsets);
+		buffer->cmdPushConstants(&getPipeline(PIPELINE_CLUSTERS), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ClusterCullData), &data);
+		buffer->cmdDispatch((instanceCount * data.clusterCount + 63) / 64, 1, 1);
+
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		buffer->cmdMemoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, { &barrier, 1 });
+	}
+	VulkanProfiler::get().endIndexedTimestamp("Clusters", buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frameIndex);
+}
+
+void ProjectFinal::simulate(FramePacket& packet, float dt)
+{
+	JAS_PROFILER_SAMPLE_FUNCTION();
+#if LATE_LATCH
+	// The camera is moved right before submit, the trees are culled with the camera of the last submitted frame and the frustum margin hides most of it
+	copyCamera(packet);
+#else
+	updateCamera(packet, dt);
+#endif
+
+	// Only dirty subtrees are recomputed, models that did not move cost a branch
+	for (auto& model : this->models)
+		model.second.sceneGraph.updateParallel(SCENE_GRAPH_JOB_SIZE);
+
+	// Streaming decision, the transfer is started when the packet is rendered
+	glm::ivec2 currRegion = this->heightmap.getRegionFromPos(packet.position);
+	glm::ivec2 diff = this->lastRegionIndex - currRegion;
+	packet.stream = abs(diff.x) > this->transferThreshold || abs(diff.y) > this->transferThreshold;
+	if (packet.stream)
+		this->lastRegionIndex = currRegion;
+}
+
+void ProjectFinal::updateCamera(FramePacket& packet, float dt)
+{
+	packet.inputTime = Instrumentation::getTime();
+	this->camera->update(dt, this->heightmap.getTerrainHeight(this->camera->getPosition().x, this->camera->getPosition().z));
+	copyCamera(packet);
+}
+
+void ProjectFinal::copyCamera(FramePacket& packet)
+{
+	packet.proj = this->camera->getProjection();
+	packet.view = this->camera->getView();
+	packet.position = this->camera->getPosition();
+	const std::vector<Camera::Plane>& planes = this->camera->getPlanes();
+	for (uint32_t i = 0; i < 6; i++)
+		packet.planes[i] = planes[i];
+}
+
+void ProjectFinal::cull(FramePacket& packet)
+{
+	JAS_PROFILER_SAMPLE_FUNCTION();
+	// Same planes as the frustum compute shader: near, far, left and right
+	for (std::vector<uint32_t>& trees : packet.visibleTrees)
+		trees.clear();
+	packet.impostorTrees.clear();
+	// Trees in the fade range go to both lists, the shaders dither between them
+	const float meshDistance = IMPOSTOR_DISTANCE * IMPOSTOR_DISTANCE;
+	const float impostorDistance = std::max(IMPOSTOR_DISTANCE - IMPOSTOR_CROSS_FADE, 0.0f) * std::max(IMPOSTOR_DISTANCE - IMPOSTOR_CROSS_FADE, 0.0f);
+	float nearest = FLT_MAX;
+	// Size of a tree's bounds as a share of the screen height picks its level of detail
+	const float projectionScale = std::abs(packet.proj[1][1]);
+	const uint32_t lodCount = this->models[MODEL_TREE].lodCount;
+	// Whole regions are culled first, their sphere holds every tree standing in them
+	float regionWorldSize = (this->heightmap.getRegionSize() - 1) * this->heightmap.getVertexDist();
+	float regionRadius = regionWorldSize * 0.7072f + (TREE_MAX_HEIGHT - TREE_MIN_HEIGHT) * 0.5f + this->treeRadius * TREE_MAX_SCALE;
+	uint32_t regionWidthCount = (uint32_t)this->heightmap.getRegionWidthCount();
+	for (const auto& regionPage : this->treeRegionPages)
+	{
+		glm::vec2 regionCoord((float)(regionPage.first % regionWidthCount) + 0.5f, (float)(regionPage.first / regionWidthCount) + 0.5f);
+		glm::vec3 regionCenter = this->heightmap.getOrigin() + glm::vec3(regionCoord.x * regionWorldSize, (TREE_MIN_HEIGHT + TREE_MAX_HEIGHT) * 0.5f, regionCoord.y * regionWorldSize);
+		bool regionVisible = true;
+		for (uint32_t i = 0; i < 4 && regionVisible; i++)
+			regionVisible = glm::dot(regionCenter - packet.planes[i].point, packet.planes[i].normal) >= -regionRadius;
+		if (!regionVisible)
+			continue;
+
+		uint32_t first = regionPage.second * this->treeSlotsPerRegion;
+		for (uint32_t t = first; t < first + this->treeSlotsPerRegion; t++)
+		{
+			const PackedInstance& instance = this->treeInstances[t];
+			float radius = this->treeRadius * instance.getScale();
+			bool visible = radius > 0.0f;
+			for (uint32_t i = 0; i < 4 && visible; i++)
+				visible = glm::dot(instance.position - packet.planes[i].point, packet.planes[i].normal) >= -radius;
+			if (!visible)
+				continue;
+			glm::vec3 offset = instance.position - packet.position;
+			float distance = glm::dot(offset, offset);
+			if (distance >= impostorDistance)
+				packet.impostorTrees.push_back(t);
+			if (distance < meshDistance) {
+				float screenSize = radius * projectionScale / std::max(std::sqrt(distance), radius);
+				uint32_t lod = 0;
+				for (float threshold = MESH_LOD_SCREEN_SIZE; lod + 1 < lodCount && screenSize < threshold; threshold *= 0.5f)
+					lod++;
+				packet.visibleTrees[lod].push_back(t);
+				nearest = std::min(nearest, distance);
+			}
+		}
+	}
+	packet.visibleTreeCount = 0;
+	for (const std::vector<uint32_t>& trees : packet.visibleTrees)
+		packet.visibleTreeCount += static_cast<uint32_t>(trees.size());
+	packet.nearestTree = std::sqrt(nearest);
+}
+
+void ProjectFinal::render(FramePacket& packet, float dt)
+{
+	// Transfer vertex data when proximity changes
+	transferVertexData(packet);
+	streamTextures(packet);
+
+	getFrame()->beginFrame(dt);
+	record(getFrame()->getCurrentImageIndex(), packet);
+
+#if LATE_LATCH
+	// Only the tree instance count recorded depends on the camera, sample input as late as possible and write it just before submit.
+	// With PIPELINED_FRAMES the packet was simulated two frames ago, only its camera is replaced
+	glfwPollEvents();
+	updateCamera(packet, dt);
+#endif
+
+	updateUniforms(getFrame()->getCurrentImageIndex(), packet);
+	getFrame()->setInputTime(packet.inputTime);
+	getFrame()->submitCompute(Instance::get().getComputeQueue().queue, this->computePrimary[getFrame()->getCurrentImageIndex()]);
+	getFrame()->submit(Instance::get().getGraphicsQueue().queue, this->graphicsPrimary.data());
+	JAS_PROFILER_SAMPLE_SPAN("Input to submit", packet.inputTime);
+	getFrame()->endFrame();
+}
+
+void ProjectFinal::updateUniforms(uint32_t frameIndex, const FramePacket& packet)
+{
+	JAS_PROFILER_SAMPLE_FUNCTION();
+	// The frame fence has been waited on, so this image's region is no longer read by the GPU
+	CameraData cameraData;
+	cameraData.vp = packet.proj * packet.view;
+	cameraData.eye = glm::vec4(packet.position, 1.0f);
+	cameraData.fadeRange = glm::vec4(std::max(IMPOSTOR_DISTANCE - IMPOSTOR_CROSS_FADE, 0.0f), IMPOSTOR_DISTANCE, 0.0f, 0.0f);
+	this->uniformArena.write(frameIndex, this->cameraRange, &cameraData, sizeof(CameraData));
+	this->uniformArena.write(frameIndex, this->planesRange, packet.planes, sizeof(Camera::Plane) * 6);
+	this->skybox.update(packet.proj, packet.view, frameIndex);
+
+	// Draw list from the cull stage, 4 bytes for each visible tree. Each level of detail is a run of instances drawn by its own commands
+	ModelIndirectHeader header = {};
+	header.drawCount = static_cast<uint32_t>(this->treeIndirectCommands.size());
+	uint32_t levelDrawCount = static_cast<uint32_t>(this->treeDrawList.getDraws().size());
+	uint32_t firstInstance = 0;
+	for (uint32_t lod = 0; lod < this->models[MODEL_TREE].lodCount; lod++)
+	{
+		const std::vector<uint32_t>& trees = packet.visibleTrees[lod];
+		if (!trees.empty())
+			this->memories[MEMORY_HOST_VISIBLE].directTransfer(this->frameBuffers[BUFFER_MODEL_VISIBLE].get(frameIndex), trees.data(), trees.size() * sizeof(uint32_t), firstInstance * sizeof(uint32_t));
+		// The first full detail trees are drawn by the cluster draws instead when their clusters are culled
+		uint32_t culledInstances = lod == 0 ? std::min(this->clusterInstances, static_cast<uint32_t>(trees.size())) : 0;
+		uint32_t commandInstances = static_cast<uint32_t>(trees.size()) - culledInstances;
+		this->treeDrawList.writeIndirectCommands(this->treeIndirectCommands.data() + lod * levelDrawCount, commandInstances, firstInstance + culledInstances, lod);
+		this->treeTriangleSum += trees.size() * this->treeLodTriangles[lod];
+		firstInstance += static_cast<uint32_t>(trees.size());
+	}
+	this->visibleTreeSum += packet.visibleTreeCount;
+	if (!packet.impostorTrees.empty())
+		this->memories[MEMORY_HOST_VISIBLE].directTransfer(this->frameBuffers[BUFFER_IMPOSTOR_VISIBLE].get(frameIndex), packet.impostorTrees.data(), packet.impostorTrees.size() * sizeof(uint32_t), 0);
+	this->impostorTreeSum += packet.impostorTrees.size();
+
+	Buffer* indirectBuffer = this->frameBuffers[BUFFER_MODEL_INDIRECT].get(frameIndex);
+	this->memories[MEMORY_HOST_VISIBLE].directTransfer(indirectBuffer, &header, sizeof(ModelIndirectHeader), 0);
+	this->memories[MEMORY_HOST_VISIBLE].directTransfer(indirectBuffer, this->treeIndirectCommands.data(), this->treeIndirectCommands.size() * sizeof(VkDrawIndexedIndirectCommand), sizeof(ModelIndirectHeader));
+}
+
+void ProjectFinal::record(uint32_t frameIndex, const FramePacket& packet)
 {
 	JAS_PROFILER_SAMPLE_FUNCTION();
 	{
@@ -774,6 +1423,15 @@ void ProjectFinal::record(uint32_t frameIndex)
 		buffer = this->computePrimary[frameIndex];
 		VulkanProfiler::get().getBufferTimestamps(buffer);
 	}
+	// The vertex buffers swap by index, no descriptor is rewritten
+	this->activeVertexBuffer = this->compVertInactiveBuffer == &this->buffers[BUFFER_VERTICES_2] ? this->vertexHandles[0] : this->vertexHandles[1];
+	// Read by updateUniforms for the same frame, the full detail commands depend on it
+	this->clustersRecorded = this->clusterCulling && getPipeline(PIPELINE_CLUSTERS).isReady();
+	// Every culled tree can write one draw for each cluster, the full detail trees past what fits are drawn whole instead
+	uint32_t fullDetailCount = static_cast<uint32_t>(packet.visibleTrees[0].size());
+	uint32_t treeClusterCount = static_cast<uint32_t>(this->treeClusters.size());
+	this->clusterInstances = this->clustersRecorded ? std::min(fullDetailCount, CLUSTER_MAX_DRAWS / treeClusterCount) : 0;
+
 	uint32_t threadIndex = 0;
 	uint32_t secondaryBuffer = 0;
 	auto nextThread = [&threadIndex]() -> uint32_t {
@@ -796,39 +1454,33 @@ void ProjectFinal::record(uint32_t frameIndex)
 	for (int i = 0; i < jobCount; i++)
 		ThreadManager::addWork(t, [=]() { secRecordFrustum(frameIndex, buffer, inheritInfo); });
 
-	// Transfer
-	secondaryBuffer = 0;
-
-	// Transfer camera vp
-	buffer = this->transferSecondary[frameIndex][secondaryBuffer++];
-	t = nextThread();
-	for (int i = 0; i < jobCount; i++)
-		ThreadManager::addWork(t, [=]() { secRecordTransfer(frameIndex, buffer, inheritInfo, this->buffers[BUFFER_CAMERA_STAGE], this->buffers[BUFFER_CAMERA], (void*)&this->camera->getMatrix()[0]); });
-
-	// Transfer camera vp
-	buffer = this->transferSecondary[frameIndex][secondaryBuffer++];
-	for (int i = 0; i < jobCount; i++)
-		ThreadManager::addWork(t, [=]() { secRecordTransfer(frameIndex, buffer, inheritInfo, this->buffers[BUFFER_PLANES_STAGE], this->buffers[BUFFER_PLANES], (void*)&this->camera->getPlanes()[0]); });
-
 	// Graphics
 	secondaryBuffer = 0;
 	inheritInfo.framebuffer = getFramebuffers()[frameIndex].getFramebuffer();
 	inheritInfo.renderPass = this->renderPass.getRenderPass();
 
-	// Skybox
-	t = nextThread();
-	buffer = this->graphicsSecondary[frameIndex][secondaryBuffer++];
-	for (int i = 0; i < jobCount; i++)
-		ThreadManager::addWork(t, [=]() { secRecordSkybox(frameIndex, buffer, inheritInfo); });
-
 	// Heightmap
 	buffer = this->graphicsSecondary[frameIndex][secondaryBuffer++];
 	t = nextThread();
 	ThreadManager::addWork(t, [=]() { secRecordHeightmap(frameIndex, buffer, inheritInfo); });
 
+	// Models
+	buffer = this->graphicsSecondary[frameIndex][secondaryBuffer++];
+	t = nextThread();
+	uint32_t instanceCount = packet.visibleTreeCount;
+	ThreadManager::addWork(t, [=]() { secRecordModels(frameIndex, buffer, inheritInfo, instanceCount); });
+
+	// Impostors, after the meshes so the billboards are depth tested against the near trees
 	buffer = this->graphicsSecondary[frameIndex][secondaryBuffer++];
 	t = nextThread();
-	ThreadManager::addWork(t, [=]() { secRecordModels(frameIndex, buffer, inheritInfo); });
+	uint32_t impostorCount = static_cast<uint32_t>(packet.impostorTrees.size());
+	ThreadManager::addWork(t, [=]() { secRecordImpostors(frameIndex, buffer, inheritInfo, impostorCount); });
+
+	// Skybox, last so it is only shaded where the terrain and trees left the depth cleared
+	t = nextThread();
+	buffer = this->graphicsSecondary[frameIndex][secondaryBuffer++];
+	for (int i = 0; i < jobCount; i++)
+		ThreadManager::addWork(t, [=]() { secRecordSkybox(frameIndex, buffer, inheritInfo); });
 
 	
 
@@ -843,26 +1495,16 @@ void ProjectFinal::record(uint32_t frameIndex)
 		VulkanProfiler::get().resetBufferTimestamps(buffer);
 		VulkanProfiler::get().startIndexedTimestamp("Graphics", buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frameIndex);
 
-		Skybox::CubemapUboData cubemapUboData;
-		cubemapUboData.proj = camera->getProjection();
-		cubemapUboData.view = camera->getView();
-		// Disable translation
-		cubemapUboData.view[3][0] = 0.0f;
-		cubemapUboData.view[3][1] = 0.0f;
-		cubemapUboData.view[3][2] = 0.0f;
-
-		vkCmdUpdateBuffer(buffer->getCommandBuffer(), this->skybox.getBuffer()->getBuffer(), 0, this->skybox.getBuffer()->getSize(), (void*)&cubemapUboData);
-
 		buffer->acquireBuffer(&this->buffers[BUFFER_INDIRECT_DRAW], VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
 			Instance::get().getComputeQueue().queueIndex, Instance::get().getGraphicsQueue().queueIndex,
 			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
 
-		std::vector<VkClearValue> clearValues = {};
-		VkClearValue value;
-		value.color = { 0.0f, 0.0f, 0.0f, 1.0f };
-		clearValues.push_back(value);
-		value.depthStencil = { 1.0f, 0 };
-		clearValues.push_back(value);
+		// Dispatches can not be recorded in the render pass
+		recordClusters(frameIndex, buffer, this->clusterInstances);
+
+		std::array<VkClearValue, 2> clearValues = {};
+		clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+		clearValues[1].depthStencil = { 1.0f, 0 };
 		buffer->cmdBeginRenderPass(&this->renderPass, getFramebuffers()[frameIndex].getFramebuffer(), getSwapChain()->getExtent(), clearValues, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 		for (size_t i = 0; i < this->graphicsSecondary[frameIndex].size(); i++)
 			vkCommands.push_back(this->graphicsSecondary[frameIndex][i]->getCommandBuffer());
@@ -879,20 +1521,6 @@ void ProjectFinal::record(uint32_t frameIndex)
 		buffer->end();
 	}
 
-	// Transfer
-	{
-		JAS_PROFILER_SAMPLE_SCOPE("Record primary transfer " + std::to_string(frameIndex));
-		buffer = this->transferPrimary[frameIndex];
-		buffer->begin(0, nullptr);
-
-		vkCommands.clear();
-		for (size_t i = 0; i < this->transferSecondary[frameIndex].size(); i++)
-			vkCommands.push_back(this->transferSecondary[frameIndex][i]->getCommandBuffer());
-		buffer->cmdExecuteCommands(vkCommands.size(), vkCommands.data());
-
-		buffer->end();
-	}
-
 	// Compute
 	{
 		JAS_PROFILER_SAMPLE_SCOPE("Record primary compute " + std::to_string(frameIndex));
@@ -920,22 +1548,3 @@ void ProjectFinal::record(uint32_t frameIndex)
 		buffer->end();
 	}
 }
-
-void ProjectFinal::updateDescManagers()
-{
-	Buffer* activeBuffer = nullptr;
-	if (this->compVertInactiveBuffer == &this->buffers[BUFFER_VERTICES_2])
-	{
-		activeBuffer = &this->buffers[BUFFER_VERTICES];
-	}
-	else
-	{
-		activeBuffer = &this->buffers[BUFFER_VERTICES_2];
-	}
-
-	this->descManagers[PIPELINE_GRAPHICS].updateBufferDesc(0, 0, activeBuffer->getBuffer(), 0, activeBuffer->getSize());
-	this->descManagers[PIPELINE_GRAPHICS].updateSets({ 0 }, getFrame()->getCurrentImageIndex());
-
-	this->descManagers[PIPELINE_FRUSTUM].updateBufferDesc(0, 1, activeBuffer->getBuffer(), 0, activeBuffer->getSize());
-	this->descManagers[PIPELINE_FRUSTUM].updateSets({ 0 }, getFrame()->getCurrentImageIndex());
-}
@@ -1,34 +1,50 @@
 #pragma once
 #include "VKSandboxBase.h"
 #include "jaspch.h"
+#include <array>
 #include "Vulkan/Buffers/Buffer.h"
 #include "Vulkan/Buffers/Memory.h"
+#include "Vulkan/Buffers/PerFrameBuffer.h"
+#include "Vulkan/Buffers/UniformArena.h"
+#include "Vulkan/Buffers/GeometryArena.h"
 #include "Core/Skybox.h"
+#include "Core/Camera.h"
 #include "Core/Heightmap/Heightmap.h"
 #include "Vulkan/Texture.h"
 #include "Vulkan/Pipeline/DescriptorManager.h"
+#include "Vulkan/Pipeline/BindlessTable.h"
 #include "Vulkan/Pipeline/RenderPass.h"
-
-class Camera;
+#include "Models/DrawList.h"
+#include "Models/Impostor.h"
 
 typedef uint32_t PrimaryIndex;
 
+// Packets in flight between the stages, one for each of simulate, cull and record
+#define FRAME_PACKET_COUNT 3
+
 class ProjectFinal : public VKSandboxBase
 {
 private:
 	enum BufferID {
-		BUFFER_PLANES,
-		BUFFER_PLANES_STAGE,
 		BUFFER_WORLD_DATA,
-		BUFFER_MODEL_TRANSFORMS,
+		BUFFER_MODEL_INSTANCES,
+		BUFFER_MODEL_VISIBLE,
 		BUFFER_INDIRECT_DRAW,
 		BUFFER_VERTICES,
 		BUFFER_VERTICES_2,
 		BUFFER_VERT_STAGING,
-		BUFFER_CAMERA,
-		BUFFER_CAMERA_STAGE,
 		BUFFER_INDEX,
-		BUFFER_CONFIG
+		BUFFER_CONFIG,
+		BUFFER_MATERIALS,
+		BUFFER_MATERIAL_PARAMS,
+		BUFFER_MODEL_NODE_TRANSFORMS,
+		BUFFER_MODEL_DRAW_DATA,
+		BUFFER_MODEL_INDIRECT,
+		BUFFER_TERRAIN_HEIGHTS,
+		BUFFER_TREE_PLACEMENT_JOBS,
+		BUFFER_TREE_READBACK,
+		BUFFER_IMPOSTOR_VISIBLE,
+		BUFFER_MODEL_CLUSTERS
 	};
 
 	enum MemoryType {
@@ -43,12 +59,16 @@ private:
 		PIPELINE_MODELS,
 		PIPELINE_FRUSTUM,
 		PIPELINE_INDEX,
+		PIPELINE_PLACEMENT,
+		PIPELINE_IMPOSTORS,
+		PIPELINE_CLUSTERS,
 		PIPELINE_COUNT
 	};
 
 	enum WorkFunctionGraphics {
 		FUNC_HEIGHTMAP = 0,
 		FUNC_MODELS,
+		FUNC_IMPOSTORS,
 		FUNC_SKYBOX,
 		FUNC_COUNT_GRAPHICS
 	};
@@ -58,12 +78,6 @@ private:
 		FUNC_COUNT_COMPUTE
 	};
 
-	enum WorkFunctionTransfer {
-		FUNC_TRANSFER_CAMERA = 0,
-		FUNC_TRANSFER_PLANES,
-		FUNC_COUNT_TRANSFER
-	};
-
 	enum ModelID {
 		MODEL_TREE = 0,
 		MODEL_COUNT
@@ -76,9 +90,57 @@ private:
 		uint32_t pad2;
 	};
 
+	// Push constants of the tree placement compute shader
+	struct TreePlacementConfig {
+		glm::vec4 origin;			// Heightmap origin, w is the vertex distance
+		uint32_t heightmapWidth;	// Vertices in each direction
+		uint32_t regionWidthCount;	// Regions in each direction
+		uint32_t regionSize;		// Vertices in each direction of a region
+		uint32_t slotsPerRegion;
+		glm::vec2 heightRange;
+		glm::vec2 scaleRange;
+		float maxSlope;
+		uint32_t seed;
+		uint32_t jobCount;			// Regions to place, one job is the region and the page it is placed in
+		uint32_t pad;
+	};
+
+	// Push constants of the cluster culling compute shader
+	struct ClusterCullData {
+		uint32_t visibleCount;	// Full detail trees culled by cluster, the start of the first run of the visible instances
+		uint32_t clusterCount;	// Clusters of the tree draw list
+		uint32_t firstDraw;		// Commands written by the CPU, the culled clusters are appended after them
+		uint32_t maxDraws;		// Room for cluster draws, visibleCount is limited so that every cluster fits
+	};
+
 	struct CameraData
 	{
 		glm::mat4 vp;
+		glm::vec4 eye;
+		glm::vec4 fadeRange; // Distances where tree meshes start to dither out and where only impostors are left
+	};
+
+	/*
+		Everything a frame needs from the stages before recording. Stage 1 (simulate) fills the
+		camera snapshot and streaming decision, stage 2 (cull) builds the draw list from it and
+		stage 3 (record and submit) only reads the packet. With LATE_LATCH stage 3 moves the camera itself right before submit
+		and replaces the packet's camera, the earlier stages copy the camera of the last submitted frame.
+	*/
+	struct FramePacket
+	{
+		// Simulate
+		glm::mat4 proj;
+		glm::mat4 view;
+		Camera::Plane planes[6];
+		glm::vec3 position;
+		bool stream{ false };	// Camera moved far enough to stream in new vertices
+		uint64_t inputTime{ 0 };	// When the camera was last moved with input, overwritten by the late latch
+
+		// Cull
+		std::array<std::vector<uint32_t>, MESH_LOD_COUNT> visibleTrees;	// Indices into treeInstances drawn with the mesh, by level of detail
+		uint32_t visibleTreeCount{ 0 };
+		std::vector<uint32_t> impostorTrees;	// Drawn as billboards, in both lists while they fade
+		float nearestTree{ 0.0f };	// Distance to the closest visible tree, drives the texture streaming
 	};
 
 	struct WorldData
@@ -110,44 +172,112 @@ private:
 	void setupShaders();
 	void setupFrustumPipeline();
 	void setupIndexPipeline();
+	void setupPlacementPipeline();
 	void setupGraphicsPipeline();
 	void setupModelsPipeline();
+	void setupImpostorsPipeline();
+	void setupClustersPipeline();
 
 	void transferInitialData();
-	void transferVertexData();
+	void transferVertexData(const FramePacket& packet);
+	void streamTextures(const FramePacket& packet);
+	void writeMaterialTable();
+	// Publishes finished tree placements and places the regions of the terrain window which are not resident yet.
+	// Must not run while a packet is culled, with wait the new regions are resident on return
+	void pageTrees(bool wait);
+	// Places the regions of the jobs on the GPU and reads them back into treeInstances for the cull stage
+	void startTreePlacement();
+	void finishTreePlacement();
 
 	void transferToDevice(Buffer* buffer, Buffer* stagingBuffer, Memory* stagingMemory, void* data, uint32_t size);
 	void verticesToDevice(Buffer* buffer, const std::vector<Heightmap::Vertex>& verticies);
 	
-	void secRecordTransfer(uint32_t frameIndex, CommandBuffer* buffer, VkCommandBufferInheritanceInfo inheritanceInfo, Buffer& stage, Buffer& Device, void* data);
-
 	void secRecordFrustum(uint32_t frameIndex, CommandBuffer* buffer, VkCommandBufferInheritanceInfo inheritanceInfo);
 	void secRecordSkybox(uint32_t frameIndex, CommandBuffer* buffer,VkCommandBufferInheritanceInfo inheritanceInfo);
 	void secRecordHeightmap(uint32_t frameIndex, CommandBuffer* buffer, VkCommandBufferInheritanceInfo inheritanceInfo);
-	void secRecordModels(uint32_t frameIndex, CommandBuffer* buffer, VkCommandBufferInheritanceInfo inheritanceInfo);
+	void secRecordModels(uint32_t frameIndex, CommandBuffer* buffer, VkCommandBufferInheritanceInfo inheritanceInfo, uint32_t instanceCount);
+	void secRecordImpostors(uint32_t frameIndex, CommandBuffer* buffer, VkCommandBufferInheritanceInfo inheritanceInfo, uint32_t instanceCount);
+	// Culls the clusters of the full detail trees into draws of the model indirect buffer, outside of the render pass
+	void recordClusters(uint32_t frameIndex, CommandBuffer* buffer, uint32_t instanceCount);
 
-	void record(uint32_t frameIndex);
+	void simulate(FramePacket& packet, float dt);
+	// Moves the camera with the input polled so far and writes it to the packet
+	void updateCamera(FramePacket& packet, float dt);
+	void copyCamera(FramePacket& packet);
+	void cull(FramePacket& packet);
+	void render(FramePacket& packet, float dt);
 
-	void updateDescManagers();
+	void updateUniforms(uint32_t frameIndex, const FramePacket& packet);
+	void record(uint32_t frameIndex, const FramePacket& packet);
 
 private:
-	uint32_t treeCount;
+	uint32_t treeCount;			// Resident instance capacity, treePageCount pages of treeSlotsPerRegion
+	uint32_t treeSlotsPerRegion;
+	std::vector<PackedInstance> treeInstances; // Indexed by page * treeSlotsPerRegion + slot. Slots left empty by the placement rules have scale 0
+
+	// Tree paging, each heightmap region in the terrain window has its trees in one page of the instance buffer.
+	// Pages of regions which left the window are reused when no packet or frame in flight can draw them anymore
+	uint32_t treePageCount;
+	std::unordered_map<uint32_t, uint32_t> treeRegionPages; // Resident region to page, read by the cull stage
+	std::vector<uint32_t> freeTreePages;
+	std::vector<std::pair<uint32_t, uint64_t>> retiredTreePages; // Page and the frame number it is free at
+	glm::ivec2 treeWindow;		// Center region of the placed window
+	bool treeWindowComplete;	// False when there were not enough free pages for every region in the window
+	std::vector<glm::uvec2> treePlacementJobs; // Region and page of the placement in flight
+	CommandBuffer* treePlacementCommand;
+	VkFence treePlacementFence;
+	uint64_t visibleTreeSum; // Visible trees of all frames, the average visible index traffic is reported
+	uint64_t impostorTreeSum;
+	uint64_t treeTriangleSum; // Mesh triangles of the trees in all frames
+	std::array<uint32_t, MESH_LOD_COUNT> treeLodTriangles; // Triangles of one tree in each level of detail
+	Impostor treeImpostor;
+	float treeRadius;
 	std::unordered_map<ModelID, Model> models;
+	// Vertices and indices of every model, bound once for all model draws
+	GeometryArena geometryArena;
+	DrawList treeDrawList;
+	// Draw count followed by one command per draw in the tree draw list, written each frame
+	struct ModelIndirectHeader
+	{
+		uint32_t drawCount;
+		uint32_t _padding[3];
+	};
+	std::vector<VkDrawIndexedIndirectCommand> treeIndirectCommands;
+	// Clusters of the tree draw list. When they are culled on the GPU the full detail commands skip the culled trees
+	// and the pass appends one draw for each cluster which is left, with its draw data after the draw list's
+	std::vector<DrawList::IndirectCluster> treeClusters;
+	bool clusterCulling;	// CLUSTER_CULLING, the draw count can be read on the GPU and the tree has clusters
+	bool clustersRecorded;	// The frame being recorded culls its clusters
+	uint32_t clusterInstances;	// Full detail trees culled by cluster in the frame being recorded, at most CLUSTER_MAX_DRAWS draws in total
+
+	// Frame pipeline
+	std::array<FramePacket, FRAME_PACKET_COUNT> packets;
+	uint64_t frameNumber;
+	uint32_t cullWork;
 
 	std::unordered_map<BufferID, Buffer> buffers;
+	std::unordered_map<BufferID, PerFrameBuffer> frameBuffers;
 	std::unordered_map<MemoryType, Memory> memories;
 	std::unordered_map<PipelineID, DescriptorManager> descManagers;
 
+	// Set 0 of every pipeline, the vertex buffers are swapped by pushing the active index
+	BindlessTable bindless;
+	BindlessTable::Handle vertexHandles[2];
+	BindlessTable::Handle activeVertexBuffer;
+
+	// Camera and frustum planes, written directly by the CPU each frame
+	UniformArena uniformArena;
+	UniformArena::RangeID cameraRange;
+	UniformArena::RangeID planesRange;
+
 	std::vector<CommandPool> graphicsPools;
 	std::vector<CommandPool> computePools;
-	std::vector<CommandPool> transferPools;
+	std::vector<CommandPool> transferPools; // Only used for streaming vertex data
 
 	std::vector<CommandBuffer*> graphicsPrimary;
 	std::unordered_map<PrimaryIndex, std::vector<CommandBuffer*>> graphicsSecondary;
 	std::vector<CommandBuffer*> computePrimary;
 	std::unordered_map<PrimaryIndex, std::vector<CommandBuffer*>> computeSecondary;
-	std::vector<CommandBuffer*> transferPrimary;
-	std::unordered_map<PrimaryIndex, std::vector<CommandBuffer*>> transferSecondary;
 
 	Skybox skybox;
 	Camera* camera;
@@ -160,6 +290,8 @@ private:
 	uint32_t	regionSize;
 
 	// Vertex transfer
+	bool streamPending;
+	glm::vec3 streamPosition;
 	std::queue<uint32_t> workIds;
 	Buffer* compVertInactiveBuffer;
 	VkFence transferFence;
@@ -92,6 +92,9 @@ void ProjectFinalNaive::cleanup()
 	for (auto& buffer : this->buffers)
 		buffer.second.cleanup();
 
+	for (auto& buffer : this->frameBuffers)
+		buffer.second.cleanup();
+
 	for (auto& memory : this->memories)
 		memory.second.cleanup();
 
@@ -262,7 +265,7 @@ void ProjectFinalNaive::setupGeneral()
 	// Skybox
 	{
 		std::string pathToCubemap = "..\\assets\\Textures\\skybox\\";
-		this->skybox.init(500.0f, pathToCubemap, getSwapChain(), &this->graphicsPools[MAIN_THREAD], &this->renderPass);
+		this->skybox.init(pathToCubemap, getSwapChain(), &this->graphicsPools[MAIN_THREAD], &this->renderPass);
 	}
 }
 
@@ -271,23 +274,23 @@ void ProjectFinalNaive::setupBuffers()
 	// Graphics buffers
 	{
 		std::vector<uint32_t> queueIndices = { Instance::get().getGraphicsQueue().queueIndex };
-		this->buffers[BUFFER_CAMERA].init(sizeof(CameraData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, queueIndices);
-		this->buffers[BUFFER_CAMERA_STAGE].init(sizeof(CameraData), VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, queueIndices);
-		this->buffers[BUFFER_MODEL_TRANSFORMS].init(sizeof(glm::mat4) * this->treeCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, queueIndices);
-		this->memories[MEMORY_DEVICE_LOCAL].bindBuffer(&this->buffers[BUFFER_CAMERA]);
-		this->memories[MEMORY_HOST_VISIBLE].bindBuffer(&this->buffers[BUFFER_CAMERA_STAGE]);
-		this->memories[MEMORY_HOST_VISIBLE].bindBuffer(&this->buffers[BUFFER_MODEL_TRANSFORMS]);
+		this->frameBuffers[BUFFER_CAMERA].init(getSwapChain()->getNumImages(), sizeof(CameraData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, queueIndices);
+		this->frameBuffers[BUFFER_CAMERA_STAGE].init(getSwapChain()->getNumImages(), sizeof(CameraData), VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, queueIndices);
+		this->buffers[BUFFER_MODEL_TRANSFORMS].init(sizeof(PackedInstance) * this->treeCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, queueIndices);
+		this->frameBuffers[BUFFER_CAMERA].bind(&this->memories[MEMORY_DEVICE_LOCAL]);
+		this->frameBuffers[BUFFER_CAMERA_STAGE].bind(&this->memories[MEMORY_HOST_VISIBLE]);
+		this->memories[MEMORY_DEVICE_LOCAL].bindBuffer(&this->buffers[BUFFER_MODEL_TRANSFORMS]);
 	}
 
 	// Frustum buffers
 	{
 		// Planes and world data
 		std::vector<uint32_t> queueIndices = { Instance::get().getGraphicsQueue().queueIndex };
-		this->buffers[BUFFER_PLANES].init(sizeof(Camera::Plane) * 6, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, queueIndices);
-		this->buffers[BUFFER_PLANES_STAGE].init(sizeof(Camera::Plane) * 6, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, queueIndices);
+		this->frameBuffers[BUFFER_PLANES].init(getSwapChain()->getNumImages(), sizeof(Camera::Plane) * 6, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, queueIndices);
+		this->frameBuffers[BUFFER_PLANES_STAGE].init(getSwapChain()->getNumImages(), sizeof(Camera::Plane) * 6, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, queueIndices);
 		this->buffers[BUFFER_WORLD_DATA].init(sizeof(WorldData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, queueIndices);
-		this->memories[MEMORY_DEVICE_LOCAL].bindBuffer(&this->buffers[BUFFER_PLANES]);
-		this->memories[MEMORY_HOST_VISIBLE].bindBuffer(&this->buffers[BUFFER_PLANES_STAGE]);
+		this->frameBuffers[BUFFER_PLANES].bind(&this->memories[MEMORY_DEVICE_LOCAL]);
+		this->frameBuffers[BUFFER_PLANES_STAGE].bind(&this->memories[MEMORY_HOST_VISIBLE]);
 		this->memories[MEMORY_HOST_VISIBLE].bindBuffer(&this->buffers[BUFFER_WORLD_DATA]);
 
 		// Indirect draw data
@@ -332,17 +335,17 @@ void ProjectFinalNaive::setupDescManagers()
 	// Graphics
 	for (size_t i = 0; i < getSwapChain()->getNumImages(); i++) {
 		this->descManagers[PIPELINE_GRAPHICS].updateBufferDesc(0, 0, this->buffers[BUFFER_VERTICES].getBuffer(), 0, this->buffers[BUFFER_VERTICES].getSize());
-		this->descManagers[PIPELINE_GRAPHICS].updateBufferDesc(0, 1, this->buffers[BUFFER_CAMERA].getBuffer(), 0, this->buffers[BUFFER_CAMERA].getSize());
+		this->descManagers[PIPELINE_GRAPHICS].updateBufferDesc(0, 1, this->frameBuffers[BUFFER_CAMERA].get(i)->getBuffer(), 0, this->frameBuffers[BUFFER_CAMERA].getSize());
 		this->descManagers[PIPELINE_GRAPHICS].updateSets({ 0 }, i);
 	}
 
 	// Models
 	for (uint32_t i = 0; i < static_cast<uint32_t>(getSwapChain()->getNumImages()); i++)
 	{
-		VkDeviceSize vertexBufferSize = this->models[MODEL_TREE].vertices.size() * sizeof(Vertex);
+		VkDeviceSize vertexBufferSize = this->models[MODEL_TREE].packedVertices.size() * sizeof(PackedVertex);
 		this->descManagers[PIPELINE_MODELS].updateBufferDesc(0, 0, this->models[MODEL_TREE].vertexBuffer.getBuffer(), 0, vertexBufferSize);
 		this->descManagers[PIPELINE_MODELS].updateBufferDesc(0, 1, this->buffers[BUFFER_MODEL_TRANSFORMS].getBuffer(), 0, this->buffers[BUFFER_MODEL_TRANSFORMS].getSize());
-		this->descManagers[PIPELINE_MODELS].updateBufferDesc(0, 2, this->buffers[BUFFER_CAMERA].getBuffer(), 0, sizeof(CameraData));
+		this->descManagers[PIPELINE_MODELS].updateBufferDesc(0, 2, this->frameBuffers[BUFFER_CAMERA].get(i)->getBuffer(), 0, sizeof(CameraData));
 		auto& materials = this->models[MODEL_TREE].materials;
 		std::vector<uint32_t> sets(1 + materials.size(), 0);
 		for (uint32_t j = 1; j <= (uint32_t)materials.size(); j++)
@@ -372,7 +375,7 @@ void ProjectFinalNaive::setupDescManagers()
 		this->descManagers[PIPELINE_FRUSTUM].updateBufferDesc(0, 0, this->buffers[BUFFER_INDIRECT_DRAW].getBuffer(), 0, this->buffers[BUFFER_INDIRECT_DRAW].getSize());
 		this->descManagers[PIPELINE_FRUSTUM].updateBufferDesc(0, 1, this->buffers[BUFFER_VERTICES].getBuffer(), 0, this->buffers[BUFFER_VERTICES].getSize());
 		this->descManagers[PIPELINE_FRUSTUM].updateBufferDesc(0, 2, this->buffers[BUFFER_WORLD_DATA].getBuffer(), 0, this->buffers[BUFFER_WORLD_DATA].getSize());
-		this->descManagers[PIPELINE_FRUSTUM].updateBufferDesc(0, 3, this->buffers[BUFFER_PLANES].getBuffer(), 0, this->buffers[BUFFER_PLANES].getSize());
+		this->descManagers[PIPELINE_FRUSTUM].updateBufferDesc(0, 3, this->frameBuffers[BUFFER_PLANES].get(i)->getBuffer(), 0, this->frameBuffers[BUFFER_PLANES].getSize());
 		this->descManagers[PIPELINE_FRUSTUM].updateSets({ 0 }, i);
 	}
 
@@ -529,13 +532,13 @@ void ProjectFinalNaive::transferInitalData()
 		this->memories[MEMORY_HOST_VISIBLE].directTransfer(&this->buffers[BUFFER_WORLD_DATA], &tempData, sizeof(WorldData), 0);
 	}
 
-	// Set model transform data
+	// Set model instance data
 	{
 		std::srand((unsigned)std::time(0));
 		auto rnd11 = [](int precision = 10000) { return (float)(std::rand() % precision) / (float)precision; };
 		auto rnd = [rnd11](float min, float max) { return min + rnd11(RAND_MAX) * glm::abs(max - min); };
 
-		std::vector<glm::mat4> matrices(this->treeCount);
+		std::vector<PackedInstance> instances(this->treeCount);
 		for (uint32_t i = 0; i < this->treeCount; i++)
 		{
 			float w = (float)this->heightmap.getWidth() * this->heightmap.getVertexDist();
@@ -543,9 +546,18 @@ void ProjectFinalNaive::transferInitalData()
 			float b = w / 2;
 			glm::vec3 pos(rnd(a, b), 0.f, rnd(a, b));
 			pos.y = this->heightmap.getTerrainHeight(pos.x, pos.z);
-			matrices[i] = glm::translate(glm::mat4(1.0), pos);
+			instances[i] = PackedInstance::pack(pos, rnd(0.f, glm::two_pi<float>()), rnd(0.8f, 1.2f));
 		}
-		this->memories[MEMORY_HOST_VISIBLE].directTransfer(&this->buffers[BUFFER_MODEL_TRANSFORMS], matrices.data(), this->buffers[BUFFER_MODEL_TRANSFORMS].getSize(), 0);
+
+		// The instances never change, they are copied to device local memory once
+		Buffer stagingBuffer;
+		Memory stagingMemory;
+		stagingBuffer.init(this->buffers[BUFFER_MODEL_TRANSFORMS].getSize(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, { Instance::get().getGraphicsQueue().queueIndex });
+		stagingMemory.bindBuffer(&stagingBuffer);
+		stagingMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		transferToDevice(&this->buffers[BUFFER_MODEL_TRANSFORMS], &stagingBuffer, &stagingMemory, instances.data(), (uint32_t)this->buffers[BUFFER_MODEL_TRANSFORMS].getSize());
+		stagingBuffer.cleanup();
+		stagingMemory.cleanup();
 	}
 
 	// Send inital data to GPU
@@ -775,11 +787,11 @@ void ProjectFinalNaive::record(uint32_t frameIndex)
 	secondaryBuffer = 0;
 	// Transfer camera vp
 	buffer = this->transferSecondary[frameIndex][secondaryBuffer++];
-	secRecordTransfer(frameIndex, buffer, inheritInfo, this->buffers[BUFFER_CAMERA_STAGE], this->buffers[BUFFER_CAMERA], (void*)&this->camera->getMatrix()[0]);
+	secRecordTransfer(frameIndex, buffer, inheritInfo, *this->frameBuffers[BUFFER_CAMERA_STAGE].get(frameIndex), *this->frameBuffers[BUFFER_CAMERA].get(frameIndex), (void*)&this->camera->getMatrix()[0]);
 
 	// Frustum planes
 	buffer = this->transferSecondary[frameIndex][secondaryBuffer++];
-	secRecordTransfer(frameIndex, buffer, inheritInfo, this->buffers[BUFFER_PLANES_STAGE], this->buffers[BUFFER_PLANES], (void*)&this->camera->getPlanes()[0]);
+	secRecordTransfer(frameIndex, buffer, inheritInfo, *this->frameBuffers[BUFFER_PLANES_STAGE].get(frameIndex), *this->frameBuffers[BUFFER_PLANES].get(frameIndex), (void*)&this->camera->getPlanes()[0]);
 
 
 	// Graphics
@@ -787,11 +799,6 @@ void ProjectFinalNaive::record(uint32_t frameIndex)
 	inheritInfo.framebuffer = getFramebuffers()[frameIndex].getFramebuffer();
 	inheritInfo.renderPass = this->renderPass.getRenderPass();
 
-	// Skybox
-	buffer = this->graphicsSecondary[frameIndex][secondaryBuffer++];
-	for (int i = 0; i < jobCount; i++)
-		secRecordSkybox(frameIndex, buffer, inheritInfo);
-
 	// Heightmap
 	buffer = this->graphicsSecondary[frameIndex][secondaryBuffer++];
 	for (int i = 0; i < jobCount; i++)
@@ -802,6 +809,11 @@ void ProjectFinalNaive::record(uint32_t frameIndex)
 	for (int i = 0; i < jobCount; i++)
 		secRecordModels(frameIndex, buffer, inheritInfo);
 
+	// Skybox
+	buffer = this->graphicsSecondary[frameIndex][secondaryBuffer++];
+	for (int i = 0; i < jobCount; i++)
+		secRecordSkybox(frameIndex, buffer, inheritInfo);
+
 	// Primary recording
 	// Graphics
 	buffer = this->graphicsPrimary[frameIndex];
@@ -809,15 +821,8 @@ void ProjectFinalNaive::record(uint32_t frameIndex)
 	VulkanProfiler::get().resetBufferTimestamps(buffer);
 	VulkanProfiler::get().startIndexedTimestamp("Graphics", buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frameIndex);
 
-	Skybox::CubemapUboData cubemapUboData;
-	cubemapUboData.proj = camera->getProjection();
-	cubemapUboData.view = camera->getView();
-	// Disable translation
-	cubemapUboData.view[3][0] = 0.0f;
-	cubemapUboData.view[3][1] = 0.0f;
-	cubemapUboData.view[3][2] = 0.0f;
-
-	vkCmdUpdateBuffer(buffer->getCommandBuffer(), this->skybox.getBuffer()->getBuffer(), 0, this->skybox.getBuffer()->getSize(), (void*)&cubemapUboData);
+	Skybox::CubemapUboData cubemapUboData = Skybox::getUboData(camera->getProjection(), camera->getView());
+	vkCmdUpdateBuffer(buffer->getCommandBuffer(), this->skybox.getBuffer(frameIndex)->getBuffer(), 0, this->skybox.getBuffer(frameIndex)->getSize(), (void*)&cubemapUboData);
 
 	std::vector<VkClearValue> clearValues = {};
 	VkClearValue value;
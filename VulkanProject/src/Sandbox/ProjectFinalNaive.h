@@ -3,6 +3,7 @@
 #include "jaspch.h"
 #include "Vulkan/Buffers/Buffer.h"
 #include "Vulkan/Buffers/Memory.h"
+#include "Vulkan/Buffers/PerFrameBuffer.h"
 #include "Core/Skybox.h"
 #include "Core/Heightmap/Heightmap.h"
 #include "Vulkan/Texture.h"
@@ -135,6 +136,7 @@ private:
 	std::unordered_map<ModelID, Model> models;
 
 	std::unordered_map<BufferID, Buffer> buffers;
+	std::unordered_map<BufferID, PerFrameBuffer> frameBuffers; // One copy per swap chain image
 	std::unordered_map<MemoryType, Memory> memories;
 	std::unordered_map<PipelineID, DescriptorManager> descManagers;
 
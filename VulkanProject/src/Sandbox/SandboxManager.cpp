@@ -3,8 +3,12 @@
 
 #include "VKSandboxBase.h"
 #include "Vulkan/Instance.h"
+#include "Vulkan/Pipeline/PipelineCache.h"
 #include "Core/Input.h"
+#include "Models/GLTFLoader.h"
+#include "Models/AssetCache.h"
 #include <GLFW/glfw3.h>
+#include <fstream>
 
 SandboxManager::SandboxManager() : running(true), sandbox(nullptr)
 {
@@ -23,9 +27,20 @@ void SandboxManager::init()
 {
 	Logger::init();
 
+#if DECODE_BENCHMARK
+	// Before the startup timer, it only needs the CPU
+	std::string decodeReport = GLTFLoader::benchmarkDecode(DECODE_BENCHMARK_MODEL, DECODE_BENCHMARK_ITERATIONS);
+	std::ofstream reportFile(FRAME_REPORT_FILE_NAME, std::ios::app);
+	if (reportFile.is_open() && !decodeReport.empty())
+		reportFile << decodeReport << std::endl;
+#endif
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
 	this->window.init(1280, 720, "Vulkan Project", FULLSCREEN);
 
 	Instance::get().init(&this->window);
+	PipelineCache::get().init(PIPELINE_CACHE_FILE_NAME);
 	this->swapChain.init(this->window.getWidth(), this->window.getHeight());
 	this->frame.init(&this->window, &this->swapChain);
 
@@ -33,6 +48,18 @@ void SandboxManager::init()
 	this->sandbox->setSwapChain(&this->swapChain);
 	this->sandbox->setFrame(&this->frame);
 	this->sandbox->selfInit();
+
+	// Pipelines compiled asynchronously after this point are not part of the startup time
+	double startupTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	std::stringstream ss;
+	ss << "Startup time: " << startupTime << " ms | " << PipelineCache::get().getReport() << " | " << AssetCache::get().getReport();
+	JAS_INFO(ss.str());
+
+	std::ofstream file(FRAME_REPORT_FILE_NAME, std::ios::app);
+	if (file.is_open())
+		file << ss.str() << std::endl;
+	else
+		JAS_WARN("Could not open {} for writing!", FRAME_REPORT_FILE_NAME);
 }
 
 void SandboxManager::run()
@@ -50,6 +77,10 @@ void SandboxManager::run()
 		if (glfwGetKey(this->window.getNativeWindow(), GLFW_KEY_ESCAPE) == GLFW_PRESS)
 			this->running = false;
 
+		for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+			if (Input::get().getKeyState(GLFW_KEY_F1 + i) == Input::KeyState::FIRST_RELEASED)
+				this->frame.setFramesInFlight(i + 1);
+
 		this->sandbox->selfLoop(dt);
 		Input::get().update();
 
@@ -72,6 +103,9 @@ void SandboxManager::cleanup()
 	this->sandbox->selfCleanup();
 	delete this->sandbox;
 	this->sandbox = nullptr;
+	AssetCache::get().cleanup();
+	PipelineCache::get().save();
+	PipelineCache::get().cleanup();
 	this->frame.cleanup();
 	this->swapChain.cleanup();
 	Instance::get().cleanup();
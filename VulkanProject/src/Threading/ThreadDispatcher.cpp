@@ -5,6 +5,7 @@ uint32_t ThreadDispatcher::worksInProgress = 0;
 std::vector<std::thread> ThreadDispatcher::threads;
 std::queue<std::pair<uint32_t, std::function<void(void)>>> ThreadDispatcher::workQueue;
 std::condition_variable ThreadDispatcher::condVar;
+std::condition_variable ThreadDispatcher::doneCondVar;
 std::mutex ThreadDispatcher::mutex;
 bool ThreadDispatcher::shouldQuit = false;
 std::list<uint32_t> ThreadDispatcher::workDone;
@@ -35,25 +36,23 @@ void ThreadDispatcher::wait()
 
 void ThreadDispatcher::wait(uint32_t id)
 {
-	while (true) {
-		auto it = std::find(workDone.begin(), workDone.end(), id);
-		if (it != workDone.end())
-			break;
-	}
-	// TODO: Mutex to remove safely?
+	// Sleep until the work is done instead of spinning, this is called every frame
+	std::unique_lock<std::mutex> lock(mutex);
+	doneCondVar.wait(lock, [id] {
+		return std::find(workDone.begin(), workDone.end(), id) != workDone.end();
+	});
 	workDone.remove(id);
 }
 
 void ThreadDispatcher::wait(const std::vector<uint32_t>& ids)
 {
-	for (size_t i = 0; i < ids.size(); i++) {
-		while (true) {
-			auto it = std::find(workDone.begin(), workDone.end(), ids[i]);
-			if (it != workDone.end())
-				break;
-		}
-		// TODO: Mutex to remove safely?
-		workDone.remove(ids[i]);
+	// The workers push to workDone under the mutex, sleep until every ID is in it
+	std::unique_lock<std::mutex> lock(mutex);
+	for (uint32_t id : ids) {
+		doneCondVar.wait(lock, [id] {
+			return std::find(workDone.begin(), workDone.end(), id) != workDone.end();
+		});
+		workDone.remove(id);
 	}
 }
 
@@ -67,6 +66,7 @@ bool ThreadDispatcher::finished()
 
 bool ThreadDispatcher::finished(uint32_t id)
 {
+	std::lock_guard<std::mutex> lock(mutex);
 	auto it = std::find(workDone.begin(), workDone.end(), id);
 	if (it != workDone.end())
 		return true;
@@ -75,6 +75,7 @@ bool ThreadDispatcher::finished(uint32_t id)
 
 bool ThreadDispatcher::finished(const std::vector<uint32_t>& ids)
 {
+	std::lock_guard<std::mutex> lock(mutex);
 	for (size_t i = 0; i < ids.size(); i++) {
 		auto it = std::find(workDone.begin(), workDone.end(), ids[i]);
 		if (it == workDone.end())
@@ -138,6 +139,7 @@ void ThreadDispatcher::threadLoop()
 			lock.lock();
 			workDone.push_back(op.first);
 			worksInProgress--;
+			doneCondVar.notify_all();
 		}
 	} while (!shouldQuit);
 }
@@ -44,6 +44,7 @@ private:
 	static std::vector<std::thread> threads;
 	static std::mutex mutex;
 	static std::condition_variable condVar;
+	static std::condition_variable doneCondVar;
 	static bool shouldQuit;
 	static std::list<uint32_t> workDone;
 	static uint32_t workID;
@@ -0,0 +1,169 @@
+#include "jaspch.h"
+#include "GeometryArena.h"
+#include "Vulkan/CommandPool.h"
+#include "Vulkan/CommandBuffer.h"
+
+GeometryArena::GeometryArena() : vertexStride(0)
+{
+}
+
+GeometryArena::~GeometryArena()
+{
+}
+
+void GeometryArena::init(uint32_t maxVertices, uint32_t maxIndices, uint32_t vertexStride, const std::vector<uint32_t>& queueFamilyIndices)
+{
+	this->vertexStride = vertexStride;
+	this->vertices.init(maxVertices);
+	this->indices.init(maxIndices);
+
+	VkBufferUsageFlags transferUsage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	this->vertexBuffer.init((VkDeviceSize)maxVertices * vertexStride, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | transferUsage, queueFamilyIndices);
+	this->indexBuffer.init((VkDeviceSize)maxIndices * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | transferUsage, queueFamilyIndices);
+	this->memory.bindBuffer(&this->vertexBuffer);
+	this->memory.bindBuffer(&this->indexBuffer);
+	this->memory.init(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	JAS_INFO("Geometry arena: {} vertices, {} indices ({} MB)", maxVertices, maxIndices,
+		(this->vertexBuffer.getSize() + this->indexBuffer.getSize()) / (1024 * 1024));
+}
+
+bool GeometryArena::allocate(uint32_t vertexCount, uint32_t indexCount, Handle& handle)
+{
+	Allocation allocation = {};
+	allocation.vertexCount = vertexCount;
+	allocation.indexCount = indexCount;
+	if (!this->vertices.allocate(vertexCount, allocation.firstVertex)) {
+		JAS_WARN("Geometry arena is out of vertex space! ({} requested, {}/{} used)", vertexCount, this->vertices.used, this->vertices.capacity);
+		return false;
+	}
+	if (!this->indices.allocate(indexCount, allocation.firstIndex)) {
+		JAS_WARN("Geometry arena is out of index space! ({} requested, {}/{} used)", indexCount, this->indices.used, this->indices.capacity);
+		this->vertices.free(allocation.firstVertex, vertexCount);
+		return false;
+	}
+
+	if (this->freeHandles.empty()) {
+		handle = static_cast<Handle>(this->allocations.size());
+		this->allocations.push_back(allocation);
+		this->alive.push_back(true);
+	}
+	else {
+		handle = this->freeHandles.back();
+		this->freeHandles.pop_back();
+		this->allocations[handle] = allocation;
+		this->alive[handle] = true;
+	}
+	return true;
+}
+
+void GeometryArena::free(Handle handle)
+{
+	JAS_ASSERT(handle < this->allocations.size() && this->alive[handle], "Freeing an invalid geometry handle!");
+	const Allocation& allocation = this->allocations[handle];
+	this->vertices.free(allocation.firstVertex, allocation.vertexCount);
+	this->indices.free(allocation.firstIndex, allocation.indexCount);
+	this->alive[handle] = false;
+	this->freeHandles.push_back(handle);
+}
+
+void GeometryArena::upload(CommandPool* pool, Handle handle, VkBuffer srcBuffer, VkDeviceSize vertexSrcOffset, VkDeviceSize indexSrcOffset)
+{
+	const Allocation& allocation = this->allocations[handle];
+	CommandBuffer* cbuff = pool->beginSingleTimeCommand();
+
+	if (allocation.indexCount > 0)
+	{
+		VkBufferCopy region = {};
+		region.srcOffset = indexSrcOffset;
+		region.dstOffset = (VkDeviceSize)allocation.firstIndex * sizeof(uint32_t);
+		region.size = (VkDeviceSize)allocation.indexCount * sizeof(uint32_t);
+		cbuff->cmdCopyBuffer(srcBuffer, this->indexBuffer.getBuffer(), 1, &region);
+	}
+
+	if (allocation.vertexCount > 0)
+	{
+		VkBufferCopy region = {};
+		region.srcOffset = vertexSrcOffset;
+		region.dstOffset = (VkDeviceSize)allocation.firstVertex * this->vertexStride;
+		region.size = (VkDeviceSize)allocation.vertexCount * this->vertexStride;
+		cbuff->cmdCopyBuffer(srcBuffer, this->vertexBuffer.getBuffer(), 1, &region);
+	}
+
+	pool->endSingleTimeCommand(cbuff);
+}
+
+const GeometryArena::Allocation& GeometryArena::getAllocation(Handle handle) const
+{
+	return this->allocations[handle];
+}
+
+void GeometryArena::cleanup()
+{
+	this->vertexBuffer.cleanup();
+	this->indexBuffer.cleanup();
+	this->memory.cleanup();
+	this->allocations.clear();
+	this->alive.clear();
+	this->freeHandles.clear();
+}
+
+void GeometryArena::RangeAllocator::init(uint32_t capacity)
+{
+	this->capacity = capacity;
+	reset(0);
+}
+
+bool GeometryArena::RangeAllocator::allocate(uint32_t size, uint32_t& offset)
+{
+	if (size == 0) {
+		offset = 0;
+		return true;
+	}
+
+	for (size_t i = 0; i < this->freeRanges.size(); i++)
+	{
+		Range& range = this->freeRanges[i];
+		if (range.size < size)
+			continue;
+
+		offset = range.offset;
+		range.offset += size;
+		range.size -= size;
+		if (range.size == 0)
+			this->freeRanges.erase(this->freeRanges.begin() + i);
+		this->used += size;
+		return true;
+	}
+	return false;
+}
+
+void GeometryArena::RangeAllocator::free(uint32_t offset, uint32_t size)
+{
+	if (size == 0)
+		return;
+	this->used -= size;
+
+	// Insert sorted and merge with the ranges on either side
+	size_t i = 0;
+	while (i < this->freeRanges.size() && this->freeRanges[i].offset < offset)
+		i++;
+	this->freeRanges.insert(this->freeRanges.begin() + i, { offset, size });
+
+	if (i + 1 < this->freeRanges.size() && this->freeRanges[i].offset + this->freeRanges[i].size == this->freeRanges[i + 1].offset) {
+		this->freeRanges[i].size += this->freeRanges[i + 1].size;
+		this->freeRanges.erase(this->freeRanges.begin() + i + 1);
+	}
+	if (i > 0 && this->freeRanges[i - 1].offset + this->freeRanges[i - 1].size == this->freeRanges[i].offset) {
+		this->freeRanges[i - 1].size += this->freeRanges[i].size;
+		this->freeRanges.erase(this->freeRanges.begin() + i);
+	}
+}
+
+void GeometryArena::RangeAllocator::reset(uint32_t used)
+{
+	this->used = used;
+	this->freeRanges.clear();
+	if (used < this->capacity)
+		this->freeRanges.push_back({ used, this->capacity - used });
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include "jaspch.h"
+
+#include "Buffer.h"
+#include "Memory.h"
+
+class CommandPool;
+
+/*
+	One vertex buffer (SSBO) and one index buffer which meshes are sub allocated from, so every model in it
+	is drawn with the same bound index buffer and vertex descriptor. Allocations are counted in vertices and indices,
+	draws use firstIndex and vertexOffset from the allocation. Indices stay local to the allocation.
+	Freed ranges are reused first fit and merged with their neighbours. Allocations are never moved, draw data baked
+	from their offsets stays valid until the handle is freed.
+*/
+class GeometryArena
+{
+public:
+	typedef uint32_t Handle;
+
+	struct Allocation
+	{
+		uint32_t firstVertex;
+		uint32_t vertexCount;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+	};
+
+public:
+	GeometryArena();
+	~GeometryArena();
+
+	void init(uint32_t maxVertices, uint32_t maxIndices, uint32_t vertexStride, const std::vector<uint32_t>& queueFamilyIndices);
+
+	// Returns false if there is no free range large enough
+	bool allocate(uint32_t vertexCount, uint32_t indexCount, Handle& handle);
+	void free(Handle handle);
+
+	// Copies vertices and indices from a transfer source buffer into the allocation
+	void upload(CommandPool* pool, Handle handle, VkBuffer srcBuffer, VkDeviceSize vertexSrcOffset, VkDeviceSize indexSrcOffset);
+
+	const Allocation& getAllocation(Handle handle) const;
+	Buffer& getVertexBuffer() { return this->vertexBuffer; }
+	Buffer& getIndexBuffer() { return this->indexBuffer; }
+	uint32_t getUsedVertices() const { return this->vertices.used; }
+	uint32_t getUsedIndices() const { return this->indices.used; }
+
+	void cleanup();
+
+private:
+	// First fit allocator over a range of elements
+	struct RangeAllocator
+	{
+		struct Range
+		{
+			uint32_t offset;
+			uint32_t size;
+		};
+
+		void init(uint32_t capacity);
+		bool allocate(uint32_t size, uint32_t& offset);
+		void free(uint32_t offset, uint32_t size);
+		void reset(uint32_t used);
+
+		std::vector<Range> freeRanges; // Sorted on offset
+		uint32_t capacity = 0;
+		uint32_t used = 0;
+	};
+
+	RangeAllocator vertices;
+	RangeAllocator indices;
+	std::vector<Allocation> allocations;
+	std::vector<bool> alive;
+	std::vector<Handle> freeHandles;
+
+	uint32_t vertexStride;
+	Buffer vertexBuffer;
+	Buffer indexBuffer;
+	Memory memory;
+};
@@ -5,7 +5,9 @@
 #include "Vulkan/CommandPool.h"
 #include "Buffer.h"
 
-Image::Image() : width(0), height(0), image(VK_NULL_HANDLE), layout(VK_IMAGE_LAYOUT_UNDEFINED)
+#include <algorithm>
+
+Image::Image() : width(0), height(0), arrayLayers(1), mipLevels(1), image(VK_NULL_HANDLE), layout(VK_IMAGE_LAYOUT_UNDEFINED)
 {
 }
 
@@ -13,10 +15,12 @@ Image::~Image()
 {
 }
 
-void Image::init(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, const std::vector<uint32_t>& queueFamilyIndices, VkImageCreateFlags flags, uint32_t arrayLayers)
+void Image::init(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, const std::vector<uint32_t>& queueFamilyIndices, VkImageCreateFlags flags, uint32_t arrayLayers, uint32_t mipLevels)
 {
 	this->width = width;
 	this->height = height;
+	this->arrayLayers = arrayLayers;
+	this->mipLevels = mipLevels;
 
 	VkImageCreateInfo imageInfo = {};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -24,7 +28,7 @@ void Image::init(uint32_t width, uint32_t height, VkFormat format, VkImageUsageF
 	imageInfo.extent.width = width;
 	imageInfo.extent.height = height;
 	imageInfo.extent.depth = 1;
-	imageInfo.mipLevels = 1;
+	imageInfo.mipLevels = mipLevels;
 	imageInfo.arrayLayers = arrayLayers;
 	imageInfo.format = format;
 	//If you want to be able to directly access texels in the memory of the image, then you must use VK_IMAGE_TILING_LINEAR
@@ -46,11 +50,32 @@ void Image::init(uint32_t width, uint32_t height, VkFormat format, VkImageUsageF
 	ERROR_CHECK(vkCreateImage(Instance::get().getDevice(), &imageInfo, nullptr, &this->image), "Failed to create image!");
 }
 
-void Image::transistionLayout(TransistionDesc& desc)
+uint32_t Image::getMipLevelCount(uint32_t width, uint32_t height)
 {
-	this->layout = desc.newLayout;
+	uint32_t levels = 1;
+	for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+		levels++;
+	return levels;
+}
+
+bool Image::supportsLinearBlit(VkFormat format)
+{
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(Instance::get().getPhysicalDevice(), format, &properties);
+	VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	return (properties.optimalTilingFeatures & required) == required;
+}
 
+void Image::transistionLayout(TransistionDesc& desc)
+{
 	CommandBuffer* buffer = desc.pool->beginSingleTimeCommand();
+	transistionLayout(buffer, desc);
+	desc.pool->endSingleTimeCommand(buffer);
+}
+
+void Image::transistionLayout(CommandBuffer* buffer, TransistionDesc& desc)
+{
+	this->layout = desc.newLayout;
 
 	VkImageMemoryBarrier barrier = {};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -73,8 +98,8 @@ void Image::transistionLayout(TransistionDesc& desc)
 		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	}
 
-	barrier.subresourceRange.baseMipLevel = 0;
-	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseMipLevel = desc.baseMipLevel;
+	barrier.subresourceRange.levelCount = desc.levelCount;
 	barrier.subresourceRange.baseArrayLayer = 0;
 	barrier.subresourceRange.layerCount = desc.layerCount;
 
@@ -93,10 +118,10 @@ void Image::transistionLayout(TransistionDesc& desc)
 	}
 	else if (desc.oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && desc.newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
 		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barrier.dstAccessMask = desc.dstStageMask == VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT ? 0 : VK_ACCESS_SHADER_READ_BIT;
 
 		sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		destinationStage = desc.dstStageMask;
 	}
 	else if (desc.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && desc.newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
 		barrier.srcAccessMask = 0;
@@ -110,8 +135,6 @@ void Image::transistionLayout(TransistionDesc& desc)
 	}
 
 	vkCmdPipelineBarrier(buffer->getCommandBuffer(), sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-	desc.pool->endSingleTimeCommand(buffer);
 }
 
 void Image::copyBufferToImage(Buffer* buffer, CommandPool* pool)
@@ -133,10 +156,70 @@ void Image::copyBufferToImage(Buffer* buffer, CommandPool* pool)
 void Image::copyBufferToImage(Buffer* buffer, CommandPool* pool, std::vector<VkBufferImageCopy> regions)
 {
 	CommandBuffer* commandBuffer = pool->beginSingleTimeCommand();
-	commandBuffer->cmdCopyBufferToImage(buffer->getBuffer(), this->image, this->layout, (uint32_t)regions.size(), regions.data());
+	copyBufferToImage(commandBuffer, buffer, regions);
 	pool->endSingleTimeCommand(commandBuffer);
 }
 
+void Image::copyBufferToImage(CommandBuffer* commandBuffer, Buffer* buffer, Span<VkBufferImageCopy> regions)
+{
+	commandBuffer->cmdCopyBufferToImage(buffer->getBuffer(), this->image, this->layout, regions.size(), regions.data());
+}
+
+void Image::generateMipmaps(CommandBuffer* commandBuffer)
+{
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = this->image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = this->arrayLayers;
+
+	int32_t levelWidth = (int32_t)this->width;
+	int32_t levelHeight = (int32_t)this->height;
+	for (uint32_t level = 1; level < this->mipLevels; level++)
+	{
+		// The previous level is written, make it the blit source
+		barrier.subresourceRange.baseMipLevel = level - 1;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		commandBuffer->cmdImageMemoryBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, { &barrier, 1 });
+
+		int32_t nextWidth = std::max(levelWidth / 2, 1);
+		int32_t nextHeight = std::max(levelHeight / 2, 1);
+		VkImageBlit blit = {};
+		blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, this->arrayLayers };
+		blit.srcOffsets[1] = { levelWidth, levelHeight, 1 };
+		blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, this->arrayLayers };
+		blit.dstOffsets[1] = { nextWidth, nextHeight, 1 };
+		commandBuffer->cmdBlitImage(this->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, this->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+		// The source is not read again
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		commandBuffer->cmdImageMemoryBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, { &barrier, 1 });
+
+		levelWidth = nextWidth;
+		levelHeight = nextHeight;
+	}
+
+	// The last level was only written to
+	barrier.subresourceRange.baseMipLevel = this->mipLevels - 1;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	commandBuffer->cmdImageMemoryBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, { &barrier, 1 });
+
+	this->layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
 VkImage Image::getImage() const
 {
 	return this->image;
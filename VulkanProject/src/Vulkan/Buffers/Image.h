@@ -2,8 +2,11 @@
 
 #include <vulkan/vulkan.h>
 
+#include "Core/Span.h"
+
 class Buffer;
 class CommandPool;
+class CommandBuffer;
 
 class Image
 {
@@ -15,27 +18,46 @@ public:
 		VkImageLayout newLayout;
 		CommandPool* pool;
 		uint32_t layerCount = 1;
+		uint32_t baseMipLevel = 0;
+		uint32_t levelCount = VK_REMAINING_MIP_LEVELS;
+		// Stage that waits for TRANSFER_DST to SHADER_READ_ONLY. Transfer queues have no shader stages, recorded there it is
+		// BOTTOM_OF_PIPE and the data is made visible by waiting on the submit
+		VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 	};
 
 public:
 	Image();
 	~Image();
 
-	void init(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, const std::vector<uint32_t>& queueFamilyIndices, VkImageCreateFlags flags, uint32_t arrayLayers);
+	void init(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, const std::vector<uint32_t>& queueFamilyIndices, VkImageCreateFlags flags, uint32_t arrayLayers, uint32_t mipLevels = 1);
+
+	// Levels of a full mip chain down to 1x1
+	static uint32_t getMipLevelCount(uint32_t width, uint32_t height);
+	// True if the format can be both source and destination of a linearly filtered blit, which generateMipmaps needs
+	static bool supportsLinearBlit(VkFormat format);
 
 	void transistionLayout(TransistionDesc& desc);
+	// Records into commandBuffer instead of submitting, desc.pool is not used. Lets several images share one submit
+	void transistionLayout(CommandBuffer* commandBuffer, TransistionDesc& desc);
 	void copyBufferToImage(Buffer* buffer, CommandPool* pool);
 	void copyBufferToImage(Buffer* buffer, CommandPool* pool, std::vector<VkBufferImageCopy> regions);
+	void copyBufferToImage(CommandBuffer* commandBuffer, Buffer* buffer, Span<VkBufferImageCopy> regions);
+	// Fills every level from level 0 by blitting each level into the next. All levels have to be in TRANSFER_DST_OPTIMAL,
+	// they are left in SHADER_READ_ONLY_OPTIMAL. The image needs TRANSFER_SRC usage when it has more than one level
+	void generateMipmaps(CommandBuffer* commandBuffer);
 
 	VkImage getImage() const;
 	VkImageLayout getLayout() const { return this->layout; }
+	uint32_t getMipLevels() const { return this->mipLevels; }
 
 	void cleanup();
 
 private:
-	VkImage image;
-	VkImageLayout layout;
-
 	uint32_t width;
 	uint32_t height;
+	uint32_t arrayLayers;
+	uint32_t mipLevels;
+
+	VkImage image;
+	VkImageLayout layout;
 };
\ No newline at end of file
@@ -8,7 +8,7 @@ public:
 	ImageView();
 	~ImageView();
 
-	void init(VkImage image, VkImageViewType type, VkFormat format, VkImageAspectFlags aspectMask, uint32_t layerCount);
+	void init(VkImage image, VkImageViewType type, VkFormat format, VkImageAspectFlags aspectMask, uint32_t layerCount, uint32_t levelCount = 1);
 
 	VkImageView getImageView() const { return this->imageView; }
 
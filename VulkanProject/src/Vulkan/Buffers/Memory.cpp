@@ -36,6 +36,16 @@ void Memory::directTransfer(Buffer* buffer, const void* data, uint64_t size, Off
 	vkUnmapMemory(Instance::get().getDevice(), this->memory);
 }
 
+void Memory::directRead(Buffer* buffer, void* data, uint64_t size, Offset bufferOffset)
+{
+	Offset offset = this->bufferOffsets[buffer];
+
+	void* ptrGpu;
+	ERROR_CHECK(vkMapMemory(Instance::get().getDevice(), this->memory, offset + bufferOffset, VK_WHOLE_SIZE, 0, &ptrGpu), "Failed to map memory for buffer!");
+	memcpy(data, ptrGpu, size);
+	vkUnmapMemory(Instance::get().getDevice(), this->memory);
+}
+
 void Memory::init(VkMemoryPropertyFlags memProp)
 {
 	JAS_ASSERT(this->currentOffset != 0, "No buffers/images bound before allocation of memory!");
@@ -18,6 +18,8 @@ public:
 	void bindBuffer(Buffer* buffer);
 	void bindTexture(Texture* texture);
 	void directTransfer(Buffer* buffer, const void* data, uint64_t size, Offset bufferOffset);
+	// Copies from a buffer in host visible and coherent memory, the GPU writes have to be finished
+	void directRead(Buffer* buffer, void* data, uint64_t size, Offset bufferOffset);
 
 	void init(VkMemoryPropertyFlags memProp);
 
@@ -0,0 +1,50 @@
+#include "jaspch.h"
+
+#include "PerFrameBuffer.h"
+#include "Memory.h"
+
+PerFrameBuffer::PerFrameBuffer()
+{
+}
+
+PerFrameBuffer::~PerFrameBuffer()
+{
+}
+
+void PerFrameBuffer::init(uint32_t copyCount, VkDeviceSize size, VkBufferUsageFlags usage, const std::vector<uint32_t>& queueFamilyIndices)
+{
+	JAS_ASSERT(copyCount > 0, "A per frame buffer needs at least one copy!");
+
+	this->buffers.resize(copyCount);
+	for (Buffer& buffer : this->buffers)
+		buffer.init(size, usage, queueFamilyIndices);
+}
+
+void PerFrameBuffer::bind(Memory* memory)
+{
+	for (Buffer& buffer : this->buffers)
+		memory->bindBuffer(&buffer);
+}
+
+Buffer* PerFrameBuffer::get(uint32_t frameIndex)
+{
+	JAS_ASSERT(frameIndex < this->buffers.size(), "Frame index out of range!");
+	return &this->buffers[frameIndex];
+}
+
+uint32_t PerFrameBuffer::getCopyCount() const
+{
+	return static_cast<uint32_t>(this->buffers.size());
+}
+
+VkDeviceSize PerFrameBuffer::getSize() const
+{
+	return this->buffers.empty() ? 0 : this->buffers[0].getSize();
+}
+
+void PerFrameBuffer::cleanup()
+{
+	for (Buffer& buffer : this->buffers)
+		buffer.cleanup();
+	this->buffers.clear();
+}
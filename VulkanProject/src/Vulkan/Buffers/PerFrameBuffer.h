@@ -0,0 +1,32 @@
+#pragma once
+#include "jaspch.h"
+
+#include "Buffer.h"
+
+class Memory;
+
+/*
+	A buffer which is versioned once per frame slot. Data written by the CPU for one frame
+	goes into its own copy, so it never overwrites a copy the GPU might still be reading.
+	Use one copy per swap chain image when the descriptor sets and command buffers are indexed by image.
+*/
+class PerFrameBuffer
+{
+public:
+	PerFrameBuffer();
+	~PerFrameBuffer();
+
+	void init(uint32_t copyCount, VkDeviceSize size, VkBufferUsageFlags usage, const std::vector<uint32_t>& queueFamilyIndices);
+
+	// Bind every copy to the memory, must be called before the memory is initialized.
+	void bind(Memory* memory);
+
+	Buffer* get(uint32_t frameIndex);
+	uint32_t getCopyCount() const;
+	VkDeviceSize getSize() const;
+
+	void cleanup();
+
+private:
+	std::vector<Buffer> buffers;
+};
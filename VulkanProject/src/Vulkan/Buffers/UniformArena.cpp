@@ -0,0 +1,86 @@
+#include "jaspch.h"
+
+#include "UniformArena.h"
+#include "Vulkan/Instance.h"
+
+UniformArena::UniformArena() : mappedData(nullptr), frameStride(0), copyCount(0)
+{
+}
+
+UniformArena::~UniformArena()
+{
+}
+
+UniformArena::RangeID UniformArena::addRange(VkDeviceSize size)
+{
+	JAS_ASSERT(this->mappedData == nullptr, "Ranges must be added before the arena is initialized!");
+
+	Range range;
+	range.offset = 0;
+	range.size = size;
+	this->ranges.push_back(range);
+	return static_cast<RangeID>(this->ranges.size() - 1);
+}
+
+void UniformArena::init(uint32_t copyCount, const std::vector<uint32_t>& queueFamilyIndices)
+{
+	JAS_ASSERT(!this->ranges.empty(), "No ranges added before initialization of the uniform arena!");
+
+	// Both the ranges and the dynamic offsets has to follow the uniform offset alignment
+	VkDeviceSize alignment = Instance::get().getPhysicalDeviceProperties().limits.minUniformBufferOffsetAlignment;
+	auto align = [alignment](VkDeviceSize size) { return (size + alignment - 1) & ~(alignment - 1); };
+
+	VkDeviceSize offset = 0;
+	for (Range& range : this->ranges) {
+		range.offset = offset;
+		offset += align(range.size);
+	}
+	this->frameStride = offset;
+	this->copyCount = copyCount;
+
+	this->buffer.init(this->frameStride * copyCount, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, queueFamilyIndices);
+	this->memory.bindBuffer(&this->buffer);
+	this->memory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	// Coherent memory, so it can stay mapped for the lifetime of the arena
+	void* data = nullptr;
+	ERROR_CHECK(vkMapMemory(Instance::get().getDevice(), this->memory.getMemory(), 0, VK_WHOLE_SIZE, 0, &data), "Failed to map uniform arena!");
+	this->mappedData = static_cast<uint8_t*>(data);
+}
+
+void UniformArena::write(uint32_t frameIndex, RangeID range, const void* data, VkDeviceSize size)
+{
+	JAS_ASSERT(frameIndex < this->copyCount, "Frame index out of range!");
+	JAS_ASSERT(size <= this->ranges[range].size, "Data does not fit in the uniform range!");
+	memcpy(this->mappedData + this->frameStride * frameIndex + this->ranges[range].offset, data, (size_t)size);
+}
+
+VkDeviceSize UniformArena::getRangeOffset(RangeID range) const
+{
+	return this->ranges[range].offset;
+}
+
+VkDeviceSize UniformArena::getRangeSize(RangeID range) const
+{
+	return this->ranges[range].size;
+}
+
+uint32_t UniformArena::getDynamicOffset(uint32_t frameIndex) const
+{
+	return static_cast<uint32_t>(this->frameStride * frameIndex);
+}
+
+Buffer* UniformArena::getBuffer()
+{
+	return &this->buffer;
+}
+
+void UniformArena::cleanup()
+{
+	if (this->mappedData != nullptr)
+		vkUnmapMemory(Instance::get().getDevice(), this->memory.getMemory());
+	this->mappedData = nullptr;
+	this->buffer.cleanup();
+	this->memory.cleanup();
+	this->ranges.clear();
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "jaspch.h"
+
+#include "Buffer.h"
+#include "Memory.h"
+
+/*
+	Host visible uniform buffer split into one region per frame slot, kept persistently mapped.
+	Ranges are laid out with addRange before init and are written directly by the CPU each frame.
+	Bind the ranges as DynamicUBO descriptors and select the frame with getDynamicOffset.
+*/
+class UniformArena
+{
+public:
+	typedef uint32_t RangeID;
+
+public:
+	UniformArena();
+	~UniformArena();
+
+	RangeID addRange(VkDeviceSize size);
+	void init(uint32_t copyCount, const std::vector<uint32_t>& queueFamilyIndices);
+
+	void write(uint32_t frameIndex, RangeID range, const void* data, VkDeviceSize size);
+
+	// Offset of the range inside a frame region, use this for the descriptor
+	VkDeviceSize getRangeOffset(RangeID range) const;
+	VkDeviceSize getRangeSize(RangeID range) const;
+	uint32_t getDynamicOffset(uint32_t frameIndex) const;
+
+	Buffer* getBuffer();
+
+	void cleanup();
+
+private:
+	struct Range
+	{
+		VkDeviceSize offset;
+		VkDeviceSize size;
+	};
+
+	Buffer buffer;
+	Memory memory;
+	uint8_t* mappedData;
+
+	std::vector<Range> ranges;
+	VkDeviceSize frameStride;
+	uint32_t copyCount;
+};
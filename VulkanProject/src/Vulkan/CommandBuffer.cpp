@@ -7,9 +7,13 @@
 #include "Pipeline/PushConstants.h"
 #include "Buffers/Buffer.h"
 
+std::atomic<uint64_t> CommandBuffer::totalIssued(0);
+std::atomic<uint64_t> CommandBuffer::totalElided(0);
+
 CommandBuffer::CommandBuffer() :
 	pool(VK_NULL_HANDLE), buffer(VK_NULL_HANDLE)
 {
+	invalidateState();
 }
 
 CommandBuffer::~CommandBuffer()
@@ -51,9 +55,10 @@ void CommandBuffer::begin(VkCommandBufferUsageFlags flags, VkCommandBufferInheri
 	beginInfo.pInheritanceInfo = instanceInfo; // Optional
 
 	ERROR_CHECK(vkBeginCommandBuffer(this->buffer, &beginInfo), "Failed to begin recording command buffer!");
+	invalidateState();
 }
 
-void CommandBuffer::cmdBeginRenderPass(RenderPass* renderPass, VkFramebuffer framebuffer, VkExtent2D extent, const std::vector<VkClearValue>& clearValues, VkSubpassContents subpassContents)
+void CommandBuffer::cmdBeginRenderPass(RenderPass* renderPass, VkFramebuffer framebuffer, VkExtent2D extent, Span<VkClearValue> clearValues, VkSubpassContents subpassContents)
 {	
 	VkRenderPassBeginInfo renderPassInfo = {};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -61,84 +66,145 @@ void CommandBuffer::cmdBeginRenderPass(RenderPass* renderPass, VkFramebuffer fra
 	renderPassInfo.framebuffer = framebuffer;
 	renderPassInfo.renderArea.offset = { 0, 0 };
 	renderPassInfo.renderArea.extent = extent;
-	renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+	renderPassInfo.clearValueCount = clearValues.size();
 	renderPassInfo.pClearValues = clearValues.data();
 	renderPassInfo.pNext = nullptr;
 
 	vkCmdBeginRenderPass(this->buffer, &renderPassInfo, subpassContents);
+	this->stats.issued++;
 }
 
 void CommandBuffer::cmdBindPipeline(Pipeline* pipeline)
 {
+	BindPointState& bindPoint = getBindPointState(pipeline);
+	if (bindPoint.pipeline == pipeline->getPipeline()) {
+		this->stats.elided++;
+		return;
+	}
+	bindPoint.pipeline = pipeline->getPipeline();
+
 	vkCmdBindPipeline(this->buffer, (VkPipelineBindPoint)pipeline->getType(), pipeline->getPipeline());
+	this->stats.issued++;
 }
 
 void CommandBuffer::cmdBindVertexBuffers(uint32_t firstBinding, uint32_t bindingCount, const VkBuffer* buffers, const VkDeviceSize* offsets)
 {
 	vkCmdBindVertexBuffers(this->buffer, firstBinding, bindingCount, buffers, offsets);
+	this->stats.issued++;
 }
 
 void CommandBuffer::cmdBindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType)
 {
+	if (this->state.indexBuffer == buffer && this->state.indexOffset == offset && this->state.indexType == indexType) {
+		this->stats.elided++;
+		return;
+	}
+	this->state.indexBuffer = buffer;
+	this->state.indexOffset = offset;
+	this->state.indexType = indexType;
+
 	vkCmdBindIndexBuffer(this->buffer, buffer, offset, indexType);
+	this->stats.issued++;
 }
 
 void CommandBuffer::cmdPushConstants(Pipeline* pipeline, const PushConstants* pushConstant)
 {
 	for (auto& range : pushConstant->getRangeMap())
-		vkCmdPushConstants(this->buffer, pipeline->getPipelineLayout(), range.first, range.second.offset, range.second.size, (void*)((char*)pushConstant->getData() + range.second.offset));
+		cmdPushConstants(pipeline, range.first, range.second.offset, range.second.size, (void*)((char*)pushConstant->getData() + range.second.offset));
 }
 
 void CommandBuffer::cmdPushConstants(Pipeline* pipeline, VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void* data)
 {
+	if (isPushConstantCached(pipeline->getPipelineLayout(), stageFlags, offset, size, data)) {
+		this->stats.elided++;
+		return;
+	}
+
 	vkCmdPushConstants(this->buffer, pipeline->getPipelineLayout(), stageFlags, offset, size, data);
+	this->stats.issued++;
 }
 
-void CommandBuffer::cmdBindDescriptorSets(Pipeline* pipeline, uint32_t firstSet, const std::vector<VkDescriptorSet>& sets, const std::vector<uint32_t>& offsets)
+void CommandBuffer::cmdBindDescriptorSets(Pipeline* pipeline, uint32_t firstSet, Span<VkDescriptorSet> sets, Span<uint32_t> offsets)
 {
+	// Only an identical call with the same layout is dropped, anything else replaces the cached binding
+	BindPointState& bindPoint = getBindPointState(pipeline);
+	bool cacheable = sets.size() <= CMD_MAX_BOUND_SETS && offsets.size() <= CMD_MAX_DYNAMIC_OFFSETS;
+	if (cacheable && bindPoint.layout == pipeline->getPipelineLayout() && bindPoint.firstSet == firstSet &&
+		bindPoint.setCount == sets.size() && bindPoint.offsetCount == offsets.size() &&
+		memcmp(bindPoint.sets, sets.data(), sets.size() * sizeof(VkDescriptorSet)) == 0 &&
+		memcmp(bindPoint.offsets, offsets.data(), offsets.size() * sizeof(uint32_t)) == 0) {
+		this->stats.elided++;
+		return;
+	}
+
+	if (cacheable) {
+		bindPoint.layout = pipeline->getPipelineLayout();
+		bindPoint.firstSet = firstSet;
+		bindPoint.setCount = sets.size();
+		bindPoint.offsetCount = offsets.size();
+		memcpy(bindPoint.sets, sets.data(), sets.size() * sizeof(VkDescriptorSet));
+		memcpy(bindPoint.offsets, offsets.data(), offsets.size() * sizeof(uint32_t));
+	}
+	else
+		bindPoint.layout = VK_NULL_HANDLE;
+
 	vkCmdBindDescriptorSets(this->buffer, (VkPipelineBindPoint)pipeline->getType(),
-		pipeline->getPipelineLayout(), 0, static_cast<uint32_t>(sets.size()), sets.data(), static_cast<uint32_t>(offsets.size()), offsets.data());
+		pipeline->getPipelineLayout(), firstSet, sets.size(), sets.data(), offsets.size(), offsets.data());
+	this->stats.issued++;
 }
 
 void CommandBuffer::cmdDraw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
 {
 	vkCmdDraw(this->buffer, vertexCount, instanceCount, firstVertex, firstInstance);
+	this->stats.issued++;
 }
 
 void CommandBuffer::cmdDrawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, uint32_t vertexOffset, uint32_t firstInstance)
 {
 	vkCmdDrawIndexed(this->buffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+	this->stats.issued++;
 }
 
 void CommandBuffer::cmdDrawIndexedIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
 {
 	vkCmdDrawIndexedIndirect(this->buffer, buffer, offset, drawCount, stride);
+	this->stats.issued++;
+}
+
+void CommandBuffer::cmdDrawIndexedIndirectCount(VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer, VkDeviceSize countOffset, uint32_t maxDrawCount, uint32_t stride)
+{
+	PFN_vkCmdDrawIndexedIndirectCountKHR drawIndexedIndirectCount = Instance::get().getDrawIndexedIndirectCount();
+	JAS_ASSERT(drawIndexedIndirectCount != nullptr, "VK_KHR_draw_indirect_count is not enabled!");
+	drawIndexedIndirectCount(this->buffer, buffer, offset, countBuffer, countOffset, maxDrawCount, stride);
+	this->stats.issued++;
 }
 
-void CommandBuffer::cmdMemoryBarrier(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlag, std::vector<VkMemoryBarrier> barriers)
+void CommandBuffer::cmdMemoryBarrier(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlag, Span<VkMemoryBarrier> barriers)
 {
 	vkCmdPipelineBarrier(
 		this->buffer,
 		srcStageMask,
 		dstStageMask,
 		dependencyFlag,
-		(uint32_t)barriers.size(), barriers.data(),
+		barriers.size(), barriers.data(),
 		0, nullptr,
 		0, nullptr);
+	this->stats.issued++;
 }
 
-void CommandBuffer::cmdBufferMemoryBarrier(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlag, std::vector<VkBufferMemoryBarrier>barriers)
+void CommandBuffer::cmdBufferMemoryBarrier(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlag, Span<VkBufferMemoryBarrier> barriers)
 {
 	vkCmdPipelineBarrier(this->buffer,
 		srcStageMask,
 		dstStageMask,
 		dependencyFlag,
 		0, nullptr,
-		(uint32_t)barriers.size(), barriers.data(),
+		barriers.size(), barriers.data(),
 		0, nullptr);
+	this->stats.issued++;
 }
 
-void CommandBuffer::cmdImageMemoryBarrier(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlag, std::vector<VkImageMemoryBarrier> barriers)
+void CommandBuffer::cmdImageMemoryBarrier(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlag, Span<VkImageMemoryBarrier> barriers)
 {
 	vkCmdPipelineBarrier(this->buffer,
 		srcStageMask,
@@ -146,57 +212,80 @@ void CommandBuffer::cmdImageMemoryBarrier(VkPipelineStageFlags srcStageMask, VkP
 		dependencyFlag,
 		0, nullptr,
 		0, nullptr,
-		(uint32_t)barriers.size(), barriers.data());
+		barriers.size(), barriers.data());
+	this->stats.issued++;
 }
 
 void CommandBuffer::cmdDispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
 {
 	vkCmdDispatch(this->buffer, groupCountX, groupCountY, groupCountZ);
+	this->stats.issued++;
 }
 
 void CommandBuffer::cmdExecuteCommands(uint32_t bufferCount, const VkCommandBuffer* secondaryBuffers)
 {
 	vkCmdExecuteCommands(this->buffer, bufferCount, secondaryBuffers);
+	this->stats.issued++;
+	// Bound state is undefined after executing secondary command buffers
+	invalidateState();
 }
 
 void CommandBuffer::cmdEndRenderPass()
 {
 	vkCmdEndRenderPass(this->buffer);
+	this->stats.issued++;
 }
 
 void CommandBuffer::end()
 {
 	ERROR_CHECK(vkEndCommandBuffer(this->buffer), "Failed to record command buffer!")
+
+	// Only add what was recorded since the last end
+	totalIssued += this->stats.issued - this->flushedStats.issued;
+	totalElided += this->stats.elided - this->flushedStats.elided;
+	this->flushedStats = this->stats;
 }
 
 void CommandBuffer::cmdCopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, uint32_t regionCount, const VkBufferCopy* pRegions)
 {
 	vkCmdCopyBuffer(this->buffer, srcBuffer, dstBuffer, regionCount, pRegions);
+	this->stats.issued++;
 }
 
 void CommandBuffer::cmdCopyBufferToImage(VkBuffer srcBuffer, VkImage dstImage, VkImageLayout dstImageLayout, uint32_t regionCount, const VkBufferImageCopy* pRegions)
 {
 	vkCmdCopyBufferToImage(this->buffer, srcBuffer, dstImage, dstImageLayout, regionCount, pRegions);
+	this->stats.issued++;
+}
+
+void CommandBuffer::cmdBlitImage(VkImage srcImage, VkImageLayout srcImageLayout, VkImage dstImage, VkImageLayout dstImageLayout, uint32_t regionCount, const VkImageBlit* pRegions, VkFilter filter)
+{
+	vkCmdBlitImage(this->buffer, srcImage, srcImageLayout, dstImage, dstImageLayout, regionCount, pRegions, filter);
+	this->stats.issued++;
 }
 
 void CommandBuffer::cmdWriteTimestamp(VkPipelineStageFlagBits pipelineStage, VkQueryPool queryPool, uint32_t query)
 {
 	vkCmdWriteTimestamp(this->buffer, pipelineStage, queryPool, query);
+	this->stats.issued++;
 }
 
 void CommandBuffer::cmdResetQueryPool(VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount)
 {
 	vkCmdResetQueryPool(this->buffer, queryPool, firstQuery, queryCount);
+	this->stats.issued++;
 }
 
 void CommandBuffer::cmdBeginQuery(VkQueryPool queryPool, uint32_t query, VkQueryControlFlags flags)
 {
 	vkCmdBeginQuery(this->buffer, queryPool, query, flags);
+	this->stats.issued++;
 }
 
 void CommandBuffer::cmdEndQuery(VkQueryPool queryPool, uint32_t query)
 {
 	vkCmdEndQuery(this->buffer, queryPool, query);
+	this->stats.issued++;
 }
 
 void CommandBuffer::acquireBuffer(Buffer* buffer, VkAccessFlags dstAccessMask, uint32_t srcQueue, uint32_t dstQueue, VkPipelineStageFlagBits srcStage, VkPipelineStageFlagBits dstStage)
@@ -210,7 +299,7 @@ void CommandBuffer::acquireBuffer(Buffer* buffer, VkAccessFlags dstAccessMask, u
 	bufferBarrier.srcQueueFamilyIndex = srcQueue;
 	bufferBarrier.dstQueueFamilyIndex = dstQueue;
 
-	cmdBufferMemoryBarrier(srcStage, dstStage, 0, { bufferBarrier });
+	cmdBufferMemoryBarrier(srcStage, dstStage, 0, Span<VkBufferMemoryBarrier>(&bufferBarrier, 1));
 }
 
 void CommandBuffer::releaseBuffer(Buffer* buffer, VkAccessFlags srcAccessMask, uint32_t srcQueue, uint32_t dstQueue, VkPipelineStageFlagBits srcStage, VkPipelineStageFlagBits dstStage)
@@ -224,5 +313,56 @@ void CommandBuffer::releaseBuffer(Buffer* buffer, VkAccessFlags srcAccessMask, u
 	bufferBarrier.srcQueueFamilyIndex = srcQueue;
 	bufferBarrier.dstQueueFamilyIndex = dstQueue;
 
-	cmdBufferMemoryBarrier(srcStage, dstStage, 0, { bufferBarrier });
+	cmdBufferMemoryBarrier(srcStage, dstStage, 0, Span<VkBufferMemoryBarrier>(&bufferBarrier, 1));
+}
+
+void CommandBuffer::invalidateState()
+{
+	this->state = {};
+}
+
+CommandBuffer::Stats CommandBuffer::getTotalStats()
+{
+	Stats stats;
+	stats.issued = totalIssued;
+	stats.elided = totalElided;
+	return stats;
+}
+
+void CommandBuffer::resetTotalStats()
+{
+	totalIssued = 0;
+	totalElided = 0;
+}
+
+CommandBuffer::BindPointState& CommandBuffer::getBindPointState(Pipeline* pipeline)
+{
+	return pipeline->getType() == Pipeline::Type::COMPUTE ? this->state.compute : this->state.graphics;
+}
+
+bool CommandBuffer::isPushConstantCached(VkPipelineLayout layout, VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void* data)
+{
+	// Ranges outside of the cache are always recorded and the cached words are dropped
+	if (offset + size > CMD_MAX_PUSH_CONSTANT_SIZE) {
+		this->state.pushLayout = VK_NULL_HANDLE;
+		return false;
+	}
+
+	if (this->state.pushLayout != layout) {
+		memset(this->state.pushStages, 0, sizeof(this->state.pushStages));
+		this->state.pushLayout = layout;
+	}
+
+	uint32_t first = offset / 4;
+	uint32_t count = size / 4;
+	bool cached = memcmp(&this->state.pushData[first], data, size) == 0;
+	for (uint32_t i = 0; i < count && cached; i++)
+		cached = this->state.pushStages[first + i] == stageFlags;
+
+	if (!cached) {
+		memcpy(&this->state.pushData[first], data, size);
+		for (uint32_t i = 0; i < count; i++)
+			this->state.pushStages[first + i] = stageFlags;
+	}
+	return cached;
 }
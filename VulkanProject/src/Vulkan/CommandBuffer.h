@@ -1,6 +1,12 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
+#include <atomic>
+#include "Core/Span.h"
+
+#define CMD_MAX_BOUND_SETS 8
+#define CMD_MAX_DYNAMIC_OFFSETS 8
+#define CMD_MAX_PUSH_CONSTANT_SIZE 128
 
 class PushConstants;
 class RenderPass;
@@ -8,8 +14,20 @@ class Pipeline;
 class Buffer;
 class CommandPool;
 
+/*
+	Wrapper of a VkCommandBuffer. Recording keeps a cache of the bound state (pipelines, descriptor sets,
+	index buffer and push constants) and drops binds which would not change it. The cache is reset in begin,
+	state bound on the VkCommandBuffer directly is not seen by it, call invalidateState after doing that.
+*/
 class CommandBuffer
 {
+public:
+	struct Stats
+	{
+		uint64_t issued = 0;	// Commands recorded to the command buffer
+		uint64_t elided = 0;	// Redundant binds which were dropped
+	};
+
 public:
 	CommandBuffer();
 	~CommandBuffer();
@@ -23,19 +41,21 @@ public:
 	
 	// Record command functions
 	void begin(VkCommandBufferUsageFlags flags, VkCommandBufferInheritanceInfo* instanceInfo);
-	void cmdBeginRenderPass(RenderPass* renderPass, VkFramebuffer framebuffer, VkExtent2D extent, const std::vector<VkClearValue>& clearValues, VkSubpassContents subpassContents);
+	void cmdBeginRenderPass(RenderPass* renderPass, VkFramebuffer framebuffer, VkExtent2D extent, Span<VkClearValue> clearValues, VkSubpassContents subpassContents);
 	void cmdBindPipeline(Pipeline* pipeline);
 	void cmdBindVertexBuffers(uint32_t firstBinding, uint32_t bindingCount, const VkBuffer* buffers, const VkDeviceSize* offsets);
 	void cmdBindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
 	void cmdPushConstants(Pipeline* pipeline, const PushConstants* pushConstant);
 	void cmdPushConstants(Pipeline* pipeline, VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void* data);
-	void cmdBindDescriptorSets(Pipeline* pipeline, uint32_t firstSet, const std::vector<VkDescriptorSet>& sets, const std::vector<uint32_t>& offsets);
+	void cmdBindDescriptorSets(Pipeline* pipeline, uint32_t firstSet, Span<VkDescriptorSet> sets, Span<uint32_t> offsets);
 	void cmdDraw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance);
 	void cmdDrawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, uint32_t vertexOffset, uint32_t firstInstance);
 	void cmdDrawIndexedIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride);
-	void cmdMemoryBarrier(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlag, std::vector<VkMemoryBarrier> barriers);
-	void cmdBufferMemoryBarrier(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlag, std::vector<VkBufferMemoryBarrier> barriers);
-	void cmdImageMemoryBarrier(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlag, std::vector<VkImageMemoryBarrier> barriers);
+	// Needs VK_KHR_draw_indirect_count, see Instance::getDrawIndexedIndirectCount
+	void cmdDrawIndexedIndirectCount(VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer, VkDeviceSize countOffset, uint32_t maxDrawCount, uint32_t stride);
+	void cmdMemoryBarrier(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlag, Span<VkMemoryBarrier> barriers);
+	void cmdBufferMemoryBarrier(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlag, Span<VkBufferMemoryBarrier> barriers);
+	void cmdImageMemoryBarrier(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlag, Span<VkImageMemoryBarrier> barriers);
 	void cmdExecuteCommands(uint32_t bufferCount, const VkCommandBuffer* secondaryBuffers);
 	void cmdEndRenderPass();
 	void end();
@@ -43,6 +63,8 @@ public:
 	// Copy commands (used for transfer queue)
 	void cmdCopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, uint32_t regionCount, const VkBufferCopy* pRegions);
 	void cmdCopyBufferToImage(VkBuffer srcBuffer, VkImage dstImage, VkImageLayout dstImageLayout, uint32_t regionCount, const VkBufferImageCopy* pRegions);
+	// Needs a graphics queue
+	void cmdBlitImage(VkImage srcImage, VkImageLayout srcImageLayout, VkImage dstImage, VkImageLayout dstImageLayout, uint32_t regionCount, const VkImageBlit* pRegions, VkFilter filter);
 
 	// Compute/dispatch commands (used for compute queue)
 	void cmdDispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ);
@@ -57,8 +79,49 @@ public:
 	void acquireBuffer(Buffer* buffer, VkAccessFlags dstAccessMask, uint32_t srcQueue, uint32_t dstQueue, VkPipelineStageFlagBits srcStage, VkPipelineStageFlagBits dstStage);
 	void releaseBuffer(Buffer* buffer, VkAccessFlags srcAccessMask, uint32_t srcQueue, uint32_t dstQueue, VkPipelineStageFlagBits srcStage, VkPipelineStageFlagBits dstStage);
 
+	// Forget all cached state, the next binds are always recorded
+	void invalidateState();
+
+	// Counted since the buffer was created
+	const Stats& getStats() const { return this->stats; }
+	// Sum of every command buffer, added to when a buffer ends recording
+	static Stats getTotalStats();
+	static void resetTotalStats();
+
 private:
+	struct BindPointState
+	{
+		VkPipeline pipeline;
+		VkPipelineLayout layout;
+		uint32_t firstSet;
+		uint32_t setCount;
+		VkDescriptorSet sets[CMD_MAX_BOUND_SETS];
+		uint32_t offsetCount;
+		uint32_t offsets[CMD_MAX_DYNAMIC_OFFSETS];
+	};
+
+	struct State
+	{
+		BindPointState graphics;
+		BindPointState compute;
+		VkBuffer indexBuffer;
+		VkDeviceSize indexOffset;
+		VkIndexType indexType;
+		// Push constants are tracked per 4 byte word, a word is only valid with the same layout and stages
+		VkPipelineLayout pushLayout;
+		uint32_t pushData[CMD_MAX_PUSH_CONSTANT_SIZE / 4];
+		VkShaderStageFlags pushStages[CMD_MAX_PUSH_CONSTANT_SIZE / 4];
+	};
+
+	BindPointState& getBindPointState(Pipeline* pipeline);
+	bool isPushConstantCached(VkPipelineLayout layout, VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void* data);
 
 	CommandPool* pool;
 	VkCommandBuffer buffer;
+
+	State state;
+	Stats stats;
+	Stats flushedStats;
+	static std::atomic<uint64_t> totalIssued;
+	static std::atomic<uint64_t> totalElided;
 };
\ No newline at end of file
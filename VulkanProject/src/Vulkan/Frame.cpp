@@ -9,6 +9,8 @@
 #include "VulkanProfiler.h"
 #include "Core/CPUProfiler.h"
 
+#include <fstream>
+
 Frame::Frame()
 	: window(nullptr), imgui(nullptr), swapChain(nullptr), numImages(0), framesInFlight(0),
 	currentFrame(0), imageIndex(0), dt(0.0f), queueFlags(VK_QUEUE_GRAPHICS_BIT)
@@ -24,7 +26,7 @@ void Frame::init(Window* window, SwapChain* swapChain)
 	this->swapChain = swapChain;
 	this->numImages = swapChain->getNumImages();
 	this->window = window;
-	this->framesInFlight = 3; // Unsure of purpose
+	this->framesInFlight = glm::clamp<uint32_t>(FRAMES_IN_FLIGHT, 1, MAX_FRAMES_IN_FLIGHT);
 	this->currentFrame = 0;
 	this->imageIndex = 0;
 
@@ -36,6 +38,7 @@ void Frame::init(Window* window, SwapChain* swapChain)
 
 void Frame::cleanup()
 {
+	writeReport();
 	destroySyncObjects();
 	this->imgui->cleanup();
 	delete this->imgui;
@@ -79,6 +82,12 @@ void Frame::submit(VkQueue queue, CommandBuffer** commandBuffers)
 
 	vkResetFences(Instance::get().getDevice(), 1, &this->inFlightFences[this->currentFrame]);
 	ERROR_CHECK(vkQueueSubmit(queue, 1, &submitInfo, this->inFlightFences[this->currentFrame]), "Failed to sumbit commandbuffer!");
+	this->submitTimes[this->currentFrame] = std::chrono::high_resolution_clock::now();
+	if (this->inputTime != 0) {
+		this->stats.inputLatency += (double)(Instrumentation::getTime() - this->inputTime) / 1000.0;
+		this->stats.inputLatencyCount++;
+		this->inputTime = 0;
+	}
 
 	//VulkanProfiler::get().getBufferTimestamps(commandBuffers[this->imageIndex]);
 
@@ -132,7 +141,18 @@ bool Frame::beginFrame(float dt)
 	JAS_PROFILER_SAMPLE_FUNCTION();
 	this->dt = dt;
 
+	auto beginTime = std::chrono::high_resolution_clock::now();
+	if (this->stats.frameCount > 0)
+		this->stats.frameTime += std::chrono::duration<double, std::milli>(beginTime - this->lastBeginTime).count();
+	this->lastBeginTime = beginTime;
+
 	vkWaitForFences(Instance::get().getDevice(), 1, &this->inFlightFences[this->currentFrame], VK_TRUE, UINT64_MAX);
+	auto fenceTime = std::chrono::high_resolution_clock::now();
+	if (this->submitTimes[this->currentFrame].time_since_epoch().count() != 0) {
+		this->stats.latency += std::chrono::duration<double, std::milli>(fenceTime - this->submitTimes[this->currentFrame]).count();
+		this->stats.latencyCount++;
+	}
+
 	VkResult result = vkAcquireNextImageKHR(Instance::get().getDevice(), this->swapChain->getSwapChain(), UINT64_MAX, this->imageAvailableSemaphores[this->currentFrame], VK_NULL_HANDLE, &this->imageIndex);
 
 	// Check if window has been resized
@@ -141,11 +161,14 @@ bool Frame::beginFrame(float dt)
 	}
 	JAS_ASSERT(result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR, "Failed to aquire swap chain image!");
 	
-	//// Check if a previous frame is using this image (Wait for this image to be free for use)
-	//if (this->imagesInFlight[this->imageIndex] != VK_NULL_HANDLE) {
-	//	vkWaitForFences(Instance::get().getDevice(), 1, &this->imagesInFlight[this->imageIndex], VK_TRUE, UINT64_MAX);
-	//}
-	
+	// Check if a previous frame is using this image (Wait for this image to be free for use)
+	// Resources indexed by the image index (command buffers, descriptor sets, per frame buffers) are only safe to reuse after this.
+	if (this->imagesInFlight[this->imageIndex] != VK_NULL_HANDLE) {
+		vkWaitForFences(Instance::get().getDevice(), 1, &this->imagesInFlight[this->imageIndex], VK_TRUE, UINT64_MAX);
+	}
+	this->stats.fenceWait += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - beginTime).count();
+	this->stats.frameCount++;
+
 	/*
 		Marked image as being used by this frame
 		This current frame will use the image with index imageIndex, mark this so that we now wen we can use this again. 
@@ -191,11 +214,47 @@ uint32_t Frame::getCurrentImageIndex() const
 	return this->imageIndex;
 }
 
+uint32_t Frame::getCurrentFrame() const
+{
+	return this->currentFrame;
+}
+
+void Frame::setFramesInFlight(uint32_t count)
+{
+	count = glm::clamp<uint32_t>(count, 1, MAX_FRAMES_IN_FLIGHT);
+	if (count == this->framesInFlight)
+		return;
+
+	// Sync objects are only created once init has been called
+	if (!this->inFlightFences.empty()) {
+		vkDeviceWaitIdle(Instance::get().getDevice());
+		writeReport();
+		destroySyncObjects();
+		this->framesInFlight = count;
+		this->currentFrame = 0;
+		createSyncObjects();
+	}
+	else
+		this->framesInFlight = count;
+
+	JAS_INFO("Frames in flight set to {}", this->framesInFlight);
+}
+
+uint32_t Frame::getFramesInFlight() const
+{
+	return this->framesInFlight;
+}
+
 void Frame::queueUsage(VkQueueFlags queueFlags)
 {
 	this->queueFlags = queueFlags;
 }
 
+void Frame::setInputTime(uint64_t time)
+{
+	this->inputTime = time;
+}
+
 void Frame::createSyncObjects()
 {
 	this->imageAvailableSemaphores.resize(this->framesInFlight);
@@ -203,7 +262,8 @@ void Frame::createSyncObjects()
 	this->computeSemaphores.resize(this->framesInFlight);
 	this->transferSemaphores.resize(this->framesInFlight);
 	this->inFlightFences.resize(this->framesInFlight);
-	this->imagesInFlight.resize(this->numImages, VK_NULL_HANDLE);
+	this->imagesInFlight.assign(this->numImages, VK_NULL_HANDLE);
+	this->submitTimes.assign(this->framesInFlight, {});
 
 	// Graphics
 	VkSemaphoreCreateInfo SemaCreateInfo = {};
@@ -234,4 +294,41 @@ void Frame::destroySyncObjects()
 		vkDestroyFence(Instance::get().getDevice(), this->inFlightFences[i], nullptr);
 	}
 	vkDestroyFence(Instance::get().getDevice(), this->computeFence, nullptr);
+	this->inFlightFences.clear();
+}
+
+void Frame::writeReport()
+{
+	if (this->stats.frameCount < 2) {
+		this->stats = Stats();
+		CommandBuffer::resetTotalStats();
+		return;
+	}
+
+	double frames = (double)this->stats.frameCount;
+	double frameTime = this->stats.frameTime / (frames - 1.0);
+	double fenceWait = this->stats.fenceWait / frames;
+	// The first frames of each slot have no submit to measure from
+	double latency = this->stats.latencyCount > 0 ? this->stats.latency / (double)this->stats.latencyCount : 0.0;
+	double inputLatency = this->stats.inputLatencyCount > 0 ? this->stats.inputLatency / (double)this->stats.inputLatencyCount : 0.0;
+
+	std::stringstream ss;
+	ss << "Frames in flight: " << this->framesInFlight
+		<< " | Frames: " << this->stats.frameCount
+		<< " | Avg frame time: " << frameTime << " ms (" << 1000.0 / frameTime << " FPS)"
+		<< " | Avg fence wait: " << fenceWait << " ms"
+		<< " | Avg submit to reuse latency: " << latency << " ms"
+		<< " | Avg input to submit latency: " << inputLatency << " ms";
+	CommandBuffer::Stats commandStats = CommandBuffer::getTotalStats();
+	ss << " | Commands per frame: " << commandStats.issued / frames << " issued, " << commandStats.elided / frames << " elided";
+	JAS_INFO(ss.str());
+
+	std::ofstream file(FRAME_REPORT_FILE_NAME, std::ios::app);
+	if (file.is_open())
+		file << ss.str() << std::endl;
+	else
+		JAS_WARN("Could not open {} for writing!", FRAME_REPORT_FILE_NAME);
+
+	this->stats = Stats();
+	CommandBuffer::resetTotalStats();
 }
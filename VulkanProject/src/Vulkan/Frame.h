@@ -8,6 +8,8 @@ class CommandBuffer;
 class VKImgui;
 class Window;
 
+#define MAX_FRAMES_IN_FLIGHT 4
+
 class Frame
 {
 public:
@@ -26,13 +28,47 @@ public:
 	bool endFrame();
 
 	uint32_t getCurrentImageIndex() const;
+	uint32_t getCurrentFrame() const;
+
+	/*
+		Number of frames the CPU is allowed to record ahead of the GPU, clamped to [1, MAX_FRAMES_IN_FLIGHT].
+		Can be changed while running, this waits for the device to idle and recreates the sync objects.
+	*/
+	void setFramesInFlight(uint32_t count);
+	uint32_t getFramesInFlight() const;
 
 	void queueUsage(VkQueueFlags queueFlags);
 
+	// Instrumentation::getTime() when the input of the frame being recorded was sampled, the report averages the time until its submit
+	void setInputTime(uint64_t time);
+
 private:
 	void createSyncObjects();
 	void destroySyncObjects();
 
+	// Appends the latency and throughput of the current frames in flight setting to the report file.
+	void writeReport();
+
+	struct Stats
+	{
+		uint64_t frameCount = 0;
+		double frameTime = 0.0;		// Time between two beginFrame calls (ms)
+		double fenceWait = 0.0;		// Time blocked on in flight fences (ms)
+		double latency = 0.0;		// Time from submit until the frame slot could be reused (ms)
+		uint64_t latencyCount = 0;	// Frames whose slot had a submit to measure from
+		double inputLatency = 0.0;	// Time from sampling input until submit (ms)
+		uint64_t inputLatencyCount = 0;	// Frames which set their input time
+	};
+
+	// Declared in the order of the constructor's initializer list
+	Window* window;
+	VKImgui* imgui;
+	SwapChain* swapChain;
+	uint32_t numImages;
+	uint32_t framesInFlight;
+	uint32_t currentFrame;
+	uint32_t imageIndex;
+	float dt;
 	VkQueueFlags queueFlags;
 
 	std::vector<VkSemaphore> imageAvailableSemaphores;
@@ -43,13 +79,9 @@ private:
 	VkFence computeFence;
 	std::vector<VkFence> inFlightFences;
 	std::vector<VkFence> imagesInFlight;
-	uint32_t framesInFlight;
-	uint32_t currentFrame;
-	uint32_t imageIndex;
-	uint32_t numImages;
-	float dt;
-	SwapChain* swapChain;
 
-	VKImgui* imgui;
-	Window* window;
+	Stats stats;
+	std::chrono::time_point<std::chrono::high_resolution_clock> lastBeginTime;
+	std::vector<std::chrono::time_point<std::chrono::high_resolution_clock>> submitTimes;
+	uint64_t inputTime = 0;
 };
\ No newline at end of file
@@ -10,11 +10,31 @@ std::vector<const char*> Instance::validationLayers = {
 };
 
 std::vector<const char*> Instance::deviceExtensions = {
-	VK_KHR_SWAPCHAIN_EXTENSION_NAME
+	VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+	VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME
+};
+
+std::vector<const char*> Instance::optionalDeviceExtensions = {
+	VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME,
+	VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME
 };
 
 VkPhysicalDeviceFeatures Instance::deviceFeatures = {};
 
+// Checked in every configuration, JAS_ASSERT is compiled out in release and the feature would be left disabled
+static void requireFeature(VkBool32 supported, const char* message)
+{
+	if (!supported) {
+		JAS_ERROR(message);
+		throw std::runtime_error(message);
+	}
+}
+
+bool Instance::isExtensionEnabled(const std::string& name) const
+{
+	return this->enabledExtensions.find(name) != this->enabledExtensions.end();
+}
+
 VkQueueFamilyProperties Instance::getQueueProperties(uint32_t queueIndex)
 {
 	uint32_t queueFamilyCount = 0;
@@ -35,7 +55,7 @@ VkPhysicalDeviceProperties Instance::getPhysicalDeviceProperties()
 
 Instance::Instance() :
 	debugMessenger(VK_NULL_HANDLE), device(VK_NULL_HANDLE), instance(VK_NULL_HANDLE),
-	physicalDevice(VK_NULL_HANDLE), surface(VK_NULL_HANDLE)
+	physicalDevice(VK_NULL_HANDLE), surface(VK_NULL_HANDLE), drawIndexedIndirectCount(nullptr)
 {
 
 }
@@ -174,7 +194,7 @@ void Instance::createInstance()
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = "No Engine";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	appInfo.apiVersion = VK_API_VERSION_1_1; // Descriptor indexing depends on maintenance3 and features2
 
 	VkInstanceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -260,9 +280,69 @@ void Instance::createLogicalDevice()
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
+	// Enable the optional extensions which the device supports
+	std::vector<const char*> extensions = deviceExtensions;
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(this->physicalDevice, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(this->physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+	for (const char* optional : optionalDeviceExtensions) {
+		for (const auto& extension : availableExtensions) {
+			if (std::string(optional) == extension.extensionName) {
+				extensions.push_back(optional);
+				break;
+			}
+		}
+	}
+	this->enabledExtensions = std::set<std::string>(extensions.begin(), extensions.end());
+
+	// Query the features beyond Vulkan 1.0 before enabling them
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT supportedIndexing = {};
+	supportedIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	VkPhysicalDeviceShaderDrawParametersFeatures supportedDrawParameters = {};
+	supportedDrawParameters.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_DRAW_PARAMETERS_FEATURES;
+	supportedIndexing.pNext = &supportedDrawParameters;
+	VkPhysicalDeviceFeatures2 supportedFeatures2 = {};
+	supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	supportedFeatures2.pNext = &supportedIndexing;
+	vkGetPhysicalDeviceFeatures2(this->physicalDevice, &supportedFeatures2);
+
+	// Descriptor indexing features used by BindlessTable
+	requireFeature(supportedFeatures2.features.shaderStorageBufferArrayDynamicIndexing, "Device does not support shaderStorageBufferArrayDynamicIndexing, needed by the bindless table!");
+	requireFeature(supportedFeatures2.features.shaderSampledImageArrayDynamicIndexing, "Device does not support shaderSampledImageArrayDynamicIndexing, needed by the bindless table!");
+	requireFeature(supportedIndexing.descriptorBindingPartiallyBound, "Device does not support descriptorBindingPartiallyBound, needed by the bindless table!");
+	requireFeature(supportedIndexing.descriptorBindingStorageBufferUpdateAfterBind, "Device does not support descriptorBindingStorageBufferUpdateAfterBind, needed by the bindless table!");
+	requireFeature(supportedIndexing.descriptorBindingSampledImageUpdateAfterBind, "Device does not support descriptorBindingSampledImageUpdateAfterBind, needed by the bindless table!");
+	requireFeature(supportedIndexing.descriptorBindingUpdateUnusedWhilePending, "Device does not support descriptorBindingUpdateUnusedWhilePending, needed by the bindless table!");
+	this->deviceFeatures.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+	this->deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+	indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+	indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+	createInfo.pNext = &indexingFeatures;
+
+	// gl_DrawIDARB, used to index per draw data in multi draw indirect
+	requireFeature(supportedDrawParameters.shaderDrawParameters, "Device does not support shaderDrawParameters, needed by the indirect model shaders!");
+	VkPhysicalDeviceShaderDrawParametersFeatures drawParametersFeatures = {};
+	drawParametersFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_DRAW_PARAMETERS_FEATURES;
+	drawParametersFeatures.shaderDrawParameters = VK_TRUE;
+	indexingFeatures.pNext = &drawParametersFeatures;
+
+	// Block compressed textures are optional, TextureCompressor keeps RGBA8 without them
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(this->physicalDevice, &supportedFeatures);
+	this->deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+
+	// Indirect commands draw their level of detail and cluster instances from a non zero firstInstance
+	requireFeature(supportedFeatures.drawIndirectFirstInstance, "Device does not support drawIndirectFirstInstance, needed by the tree draws!");
+	this->deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+
 	createInfo.pEnabledFeatures = &this->deviceFeatures;
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	createInfo.ppEnabledExtensionNames = extensions.data();
 
 	createInfo.enabledLayerCount = static_cast<uint32_t>(this->validationLayers.size());
 	createInfo.ppEnabledLayerNames = this->validationLayers.data();
@@ -275,6 +355,9 @@ void Instance::createLogicalDevice()
 	vkGetDeviceQueue(this->device, this->presentQueue.queueIndex, 0, &this->presentQueue.queue);
 	vkGetDeviceQueue(this->device, this->transferQueue.queueIndex, 0, &this->transferQueue.queue);
 	vkGetDeviceQueue(this->device, this->computeQueue.queueIndex, 0, &this->computeQueue.queue);
+
+	if (isExtensionEnabled(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME))
+		this->drawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(this->device, "vkCmdDrawIndexedIndirectCountKHR");
 }
 
 bool Instance::isDeviceSuitable(VkPhysicalDevice device)
@@ -32,8 +32,15 @@ public:
 	QueueVK getTransferQueue() const { return this->transferQueue; }
 	QueueVK getComputeQueue() const { return this->computeQueue; }
 
+	// True if the extension was enabled on the logical device, optional extensions are only enabled when supported
+	bool isExtensionEnabled(const std::string& name) const;
+
+	// nullptr when VK_KHR_draw_indirect_count is not supported
+	PFN_vkCmdDrawIndexedIndirectCountKHR getDrawIndexedIndirectCount() const { return this->drawIndexedIndirectCount; }
+
 	VkQueueFamilyProperties getQueueProperties(uint32_t queueIndex);
 	VkPhysicalDeviceProperties getPhysicalDeviceProperties();
+	const VkPhysicalDeviceFeatures& getEnabledFeatures() const { return this->deviceFeatures; }
 
 private:
 	Instance();
@@ -44,6 +51,8 @@ private:
 
 	static std::vector<const char*> validationLayers;
 	static std::vector<const char*> deviceExtensions;
+	static std::vector<const char*> optionalDeviceExtensions;
+	std::set<std::string> enabledExtensions;
 	static VkPhysicalDeviceFeatures deviceFeatures;
 
 	void createInstance();
@@ -67,6 +76,8 @@ private:
 	QueueVK transferQueue;
 	QueueVK computeQueue;
 
+	PFN_vkCmdDrawIndexedIndirectCountKHR drawIndexedIndirectCount;
+
 	#ifdef JAS_RELEASE
 		const bool enableValidationLayers = false;
 	#else
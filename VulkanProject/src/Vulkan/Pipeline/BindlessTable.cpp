@@ -0,0 +1,146 @@
+#include "jaspch.h"
+#include "BindlessTable.h"
+#include "../Instance.h"
+
+BindlessTable::BindlessTable() :
+	pool(VK_NULL_HANDLE), set(VK_NULL_HANDLE),
+	maxBuffers(0), maxImages(0), maxSamplers(0), bufferCount(0), imageCount(0)
+{
+}
+
+BindlessTable::~BindlessTable()
+{
+}
+
+void BindlessTable::init(uint32_t maxBuffers, uint32_t maxImages, uint32_t maxSamplers)
+{
+	this->maxBuffers = maxBuffers;
+	this->maxImages = maxImages;
+	this->maxSamplers = maxSamplers;
+
+	VkShaderStageFlags stages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+	this->layout.add(new SSBO(stages, maxBuffers, nullptr));
+	this->layout.add(new SampledIMG(stages, maxImages, nullptr));
+	this->layout.add(new SeparateSampler(stages, maxSamplers, nullptr));
+
+	// Not every element is written and elements can be added while the set is in use
+	VkDescriptorBindingFlagsEXT flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+		VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+	this->layout.init(VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT, { flags, flags, flags });
+
+	std::vector<VkDescriptorPoolSize> poolSizes = this->layout.getPoolSizes(1);
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = 1;
+	ERROR_CHECK(vkCreateDescriptorPool(Instance::get().getDevice(), &poolInfo, nullptr, &this->pool), "Failed to create bindless descriptor pool!");
+
+	VkDescriptorSetLayout setLayout = this->layout.getLayout();
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = this->pool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &setLayout;
+	ERROR_CHECK(vkAllocateDescriptorSets(Instance::get().getDevice(), &allocInfo, &this->set), "Failed to allocate bindless descriptor set!");
+}
+
+BindlessTable::Handle BindlessTable::addBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	JAS_ASSERT(this->bufferCount < this->maxBuffers, "Bindless table is out of buffer slots!");
+	Handle handle = this->bufferCount++;
+
+	VkDescriptorBufferInfo info = {};
+	info.buffer = buffer;
+	info.offset = offset;
+	info.range = range;
+	write(0, handle, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &info, nullptr);
+	return handle;
+}
+
+BindlessTable::Handle BindlessTable::addImage(VkImageView view, VkImageLayout layout)
+{
+	auto it = this->images.find(view);
+	if (it != this->images.end())
+		return it->second;
+
+	Handle handle;
+	if (!this->freeImages.empty()) {
+		handle = this->freeImages.back();
+		this->freeImages.pop_back();
+	}
+	else {
+		JAS_ASSERT(this->imageCount < this->maxImages, "Bindless table is out of image slots!");
+		handle = this->imageCount++;
+	}
+	this->images[view] = handle;
+
+	VkDescriptorImageInfo info = {};
+	info.imageView = view;
+	info.imageLayout = layout;
+	write(1, handle, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, nullptr, &info);
+	return handle;
+}
+
+void BindlessTable::removeImage(VkImageView view)
+{
+	auto it = this->images.find(view);
+	if (it == this->images.end())
+		return;
+
+	// The descriptor is left as it is, the slot is rewritten when it is handed out again
+	this->freeImages.push_back(it->second);
+	this->images.erase(it);
+}
+
+BindlessTable::Handle BindlessTable::addSampler(VkSampler sampler)
+{
+	auto it = this->samplers.find(sampler);
+	if (it != this->samplers.end())
+		return it->second;
+
+	JAS_ASSERT(this->samplers.size() < this->maxSamplers, "Bindless table is out of sampler slots!");
+	Handle handle = static_cast<Handle>(this->samplers.size());
+	this->samplers[sampler] = handle;
+
+	VkDescriptorImageInfo info = {};
+	info.sampler = sampler;
+	write(2, handle, VK_DESCRIPTOR_TYPE_SAMPLER, nullptr, &info);
+	return handle;
+}
+
+void BindlessTable::cleanup()
+{
+	vkDestroyDescriptorPool(Instance::get().getDevice(), this->pool, nullptr);
+	vkDestroyDescriptorSetLayout(Instance::get().getDevice(), this->layout.getLayout(), nullptr);
+	this->images.clear();
+	this->freeImages.clear();
+	this->samplers.clear();
+	this->bufferCount = 0;
+	this->imageCount = 0;
+}
+
+const DescriptorLayout& BindlessTable::getLayout() const
+{
+	return this->layout;
+}
+
+VkDescriptorSet BindlessTable::getSet() const
+{
+	return this->set;
+}
+
+void BindlessTable::write(uint32_t binding, Handle handle, VkDescriptorType type, const VkDescriptorBufferInfo* bufferInfo, const VkDescriptorImageInfo* imageInfo)
+{
+	VkWriteDescriptorSet desc = {};
+	desc.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	desc.dstSet = this->set;
+	desc.dstBinding = binding;
+	desc.dstArrayElement = handle;
+	desc.descriptorCount = 1;
+	desc.descriptorType = type;
+	desc.pBufferInfo = bufferInfo;
+	desc.pImageInfo = imageInfo;
+	vkUpdateDescriptorSets(Instance::get().getDevice(), 1, &desc, 0, nullptr);
+}
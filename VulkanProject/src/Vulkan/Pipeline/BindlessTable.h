@@ -0,0 +1,51 @@
+#pragma once
+#include "jaspch.h"
+
+#include "DescriptorLayout.h"
+
+/*
+	One descriptor set holding global arrays of storage buffers, sampled images and samplers.
+	Resources are added once and referenced by their index from push constants or other buffers,
+	so swapping a buffer or material only changes an index instead of rewriting descriptors.
+	The set is created with update after bind, new resources can be added while it is bound.
+	Binding 0: Storage buffers, binding 1: Sampled images, binding 2: Samplers.
+*/
+class BindlessTable
+{
+public:
+	typedef uint32_t Handle;
+
+public:
+	BindlessTable();
+	~BindlessTable();
+
+	void init(uint32_t maxBuffers, uint32_t maxImages, uint32_t maxSamplers);
+
+	Handle addBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+	// Images and samplers which already are in the table return their existing handle
+	Handle addImage(VkImageView view, VkImageLayout layout);
+	Handle addSampler(VkSampler sampler);
+	// Frees the slot of the view for later images. No command buffer which is pending may still use the handle
+	void removeImage(VkImageView view);
+
+	void cleanup();
+
+	const DescriptorLayout& getLayout() const;
+	VkDescriptorSet getSet() const;
+
+private:
+	void write(uint32_t binding, Handle handle, VkDescriptorType type, const VkDescriptorBufferInfo* bufferInfo, const VkDescriptorImageInfo* imageInfo);
+
+	DescriptorLayout layout;
+	VkDescriptorPool pool;
+	VkDescriptorSet set;
+
+	uint32_t maxBuffers;
+	uint32_t maxImages;
+	uint32_t maxSamplers;
+	uint32_t bufferCount;
+	uint32_t imageCount;
+	std::vector<Handle> freeImages;
+	std::unordered_map<VkImageView, Handle> images;
+	std::unordered_map<VkSampler, Handle> samplers;
+};
@@ -40,10 +40,18 @@ void DescriptorLayout::add(VkDescriptorSetLayoutBinding* descriptor)
 	delete descriptor;
 }
 
-void DescriptorLayout::init()
+void DescriptorLayout::init(VkDescriptorSetLayoutCreateFlags flags, const std::vector<VkDescriptorBindingFlagsEXT>& bindingFlags)
 {
+	JAS_ASSERT(bindingFlags.empty() || bindingFlags.size() == this->descriptors.size(), "Binding flags must be given for every binding!");
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+	bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
 	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
 	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = bindingFlags.empty() ? nullptr : &bindingFlagsInfo;
+	layoutInfo.flags = flags;
 	layoutInfo.bindingCount = static_cast<uint32_t>(this->descriptors.size());
 	layoutInfo.pBindings = this->descriptors.data();
 
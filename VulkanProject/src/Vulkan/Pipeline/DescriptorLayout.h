@@ -14,7 +14,8 @@ public:
 
 	void add(VkDescriptorSetLayoutBinding* descriptor);
 
-	void init();
+	// Binding flags are given per binding in the order they were added, leave empty for none
+	void init(VkDescriptorSetLayoutCreateFlags flags = 0, const std::vector<VkDescriptorBindingFlagsEXT>& bindingFlags = {});
 
 	VkDescriptorSetLayout getLayout() const;
 	std::vector<VkDescriptorPoolSize> getPoolSizes(uint32_t factor) const;
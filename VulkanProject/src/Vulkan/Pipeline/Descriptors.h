@@ -19,4 +19,6 @@ DESCRIPTOR(UBO, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
 DESCRIPTOR(DynamicUBO, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC)
 DESCRIPTOR(SSBO, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
 DESCRIPTOR(DynamicSSBO, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC)
-DESCRIPTOR(IMG, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)
\ No newline at end of file
+DESCRIPTOR(IMG, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)
+DESCRIPTOR(SampledIMG, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE)
+DESCRIPTOR(SeparateSampler, VK_DESCRIPTOR_TYPE_SAMPLER)
\ No newline at end of file
@@ -5,11 +5,13 @@
 #include "RenderPass.h"
 #include "DescriptorLayout.h"
 #include "PushConstants.h"
+#include "PipelineCache.h"
+#include "Threading/ThreadDispatcher.h"
 
 // TODO: Add support for addition of descriptors and push constants for both graphics and compute pipeline.
 
 Pipeline::Pipeline() :
-	pipeline(VK_NULL_HANDLE), polyMode(VK_POLYGON_MODE_FILL),
+	pipeline(VK_NULL_HANDLE), pipelineLayout(VK_NULL_HANDLE), polyMode(VK_POLYGON_MODE_FILL),
 	graphicsPipelineInfoFlags(PipelineInfoFlag::NONE)
 {
 }
@@ -29,6 +31,25 @@ void Pipeline::init(Type type, Shader* shader)
 		createComputePipeline();
 }
 
+void Pipeline::initAsync(Type type, Shader* shader)
+{
+	this->async = true;
+	this->asyncWork = ThreadDispatcher::dispatch([this, type, shader]() { init(type, shader); });
+}
+
+void Pipeline::wait()
+{
+	if (this->async) {
+		ThreadDispatcher::wait(this->asyncWork);
+		this->async = false;
+	}
+}
+
+bool Pipeline::isReady() const
+{
+	return !this->async || ThreadDispatcher::finished(this->asyncWork);
+}
+
 void Pipeline::cleanup()
 {
 	VkDevice device = Instance::get().getDevice();
@@ -261,7 +282,14 @@ void Pipeline::createGraphicsPipeline()
 	pipelineInfo.flags = 0;
 	pipelineInfo.basePipelineIndex = -1; // Optional
 
-	ERROR_CHECK(vkCreateGraphicsPipelines(Instance::get().getDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &this->pipeline), "Failed to create graphics pipeline!");
+	VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo;
+	VkPipelineCreationFeedbackEXT feedback;
+	std::vector<VkPipelineCreationFeedbackEXT> stageFeedbacks(infos.size());
+	pipelineInfo.pNext = PipelineCache::get().getFeedbackInfo(feedbackInfo, feedback, stageFeedbacks);
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	ERROR_CHECK(vkCreateGraphicsPipelines(Instance::get().getDevice(), PipelineCache::get().getCache(), 1, &pipelineInfo, nullptr, &this->pipeline), "Failed to create graphics pipeline!");
+	PipelineCache::get().addCreation(startTime, feedback);
 }
 
 void Pipeline::createComputePipeline()
@@ -284,5 +312,12 @@ void Pipeline::createComputePipeline()
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineInfo.basePipelineIndex = -1;
 
-	ERROR_CHECK(vkCreateComputePipelines(Instance::get().getDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &this->pipeline), "Failed to create graphics pipeline!");
+	VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo;
+	VkPipelineCreationFeedbackEXT feedback;
+	std::vector<VkPipelineCreationFeedbackEXT> stageFeedbacks(1);
+	pipelineInfo.pNext = PipelineCache::get().getFeedbackInfo(feedbackInfo, feedback, stageFeedbacks);
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	ERROR_CHECK(vkCreateComputePipelines(Instance::get().getDevice(), PipelineCache::get().getCache(), 1, &pipelineInfo, nullptr, &this->pipeline), "Failed to create graphics pipeline!");
+	PipelineCache::get().addCreation(startTime, feedback);
 }
\ No newline at end of file
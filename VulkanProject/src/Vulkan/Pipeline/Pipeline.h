@@ -21,6 +21,11 @@ public:
 
 	// Creates the pipeline with default values or the values that has been set before this call
 	void init(Type type, Shader* shader);
+	// Same as init but created on a ThreadDispatcher thread, check isReady before use
+	void initAsync(Type type, Shader* shader);
+	// Blocks until an asynchronous creation is done
+	void wait();
+	bool isReady() const;
 	void cleanup();
 
 	// Set the layouts which will be used
@@ -49,6 +54,8 @@ private:
 	VkExtent2D extent;
 	Type type;
 	bool graphicsPipelineInitilized = false;
+	bool async = false;
+	uint32_t asyncWork = 0;
 	std::vector<VkDescriptorSetLayout> layouts;
 	std::vector<VkPushConstantRange> pushConstantRanges;
 
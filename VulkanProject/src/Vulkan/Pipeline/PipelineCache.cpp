@@ -0,0 +1,154 @@
+#include "jaspch.h"
+#include "PipelineCache.h"
+#include "../Instance.h"
+
+#include <fstream>
+
+#define PIPELINE_CACHE_MAGIC 0x4A415350	// "JASP"
+#define PIPELINE_CACHE_VERSION 1
+
+PipelineCache::PipelineCache() :
+	cache(VK_NULL_HANDLE), loaded(false), hasFeedback(false),
+	pipelineCount(0), hitCount(0), creationTime(0.0)
+{
+}
+
+PipelineCache::~PipelineCache()
+{
+}
+
+PipelineCache& PipelineCache::get()
+{
+	static PipelineCache pipelineCache;
+	return pipelineCache;
+}
+
+void PipelineCache::init(const std::string& filePath)
+{
+	this->filePath = filePath;
+	this->hasFeedback = Instance::get().isExtensionEnabled(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+
+	std::vector<uint8_t> data = load();
+	this->loaded = !data.empty();
+
+	VkPipelineCacheCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.initialDataSize = data.size();
+	createInfo.pInitialData = data.empty() ? nullptr : data.data();
+	ERROR_CHECK(vkCreatePipelineCache(Instance::get().getDevice(), &createInfo, nullptr, &this->cache), "Failed to create pipeline cache!");
+}
+
+void PipelineCache::save()
+{
+	if (this->cache == VK_NULL_HANDLE)
+		return;
+
+	VkDevice device = Instance::get().getDevice();
+	size_t size = 0;
+	ERROR_CHECK(vkGetPipelineCacheData(device, this->cache, &size, nullptr), "Failed to get pipeline cache size!");
+	std::vector<uint8_t> data(size);
+	ERROR_CHECK(vkGetPipelineCacheData(device, this->cache, &size, data.data()), "Failed to get pipeline cache data!");
+
+	FileHeader header = getDeviceHeader();
+	header.dataSize = static_cast<uint32_t>(size);
+
+	std::ofstream file(this->filePath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		JAS_WARN("Could not open {} for writing, pipeline cache not saved!", this->filePath);
+		return;
+	}
+	file.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+	file.write(reinterpret_cast<const char*>(data.data()), size);
+	JAS_INFO("Saved pipeline cache: {} ({} bytes)", this->filePath, size);
+}
+
+void PipelineCache::cleanup()
+{
+	vkDestroyPipelineCache(Instance::get().getDevice(), this->cache, nullptr);
+	this->cache = VK_NULL_HANDLE;
+}
+
+const void* PipelineCache::getFeedbackInfo(VkPipelineCreationFeedbackCreateInfoEXT& info, VkPipelineCreationFeedbackEXT& feedback, std::vector<VkPipelineCreationFeedbackEXT>& stageFeedbacks)
+{
+	feedback = {};
+	if (!this->hasFeedback)
+		return nullptr;
+
+	info = {};
+	info.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+	info.pPipelineCreationFeedback = &feedback;
+	info.pipelineStageCreationFeedbackCount = static_cast<uint32_t>(stageFeedbacks.size());
+	info.pPipelineStageCreationFeedbacks = stageFeedbacks.data();
+	return &info;
+}
+
+void PipelineCache::addCreation(std::chrono::high_resolution_clock::time_point startTime, const VkPipelineCreationFeedbackEXT& feedback)
+{
+	double time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	bool hit = (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT) && (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT);
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->pipelineCount++;
+	this->hitCount += hit ? 1 : 0;
+	this->creationTime += time;
+}
+
+std::string PipelineCache::getReport()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	std::stringstream ss;
+	ss << "Pipelines: " << this->pipelineCount
+		<< " | Total creation time: " << this->creationTime << " ms"
+		<< " | Cache file: " << (this->loaded ? "loaded" : "missing or invalid");
+	if (this->hasFeedback)
+		ss << " | Cache hits: " << this->hitCount << "/" << this->pipelineCount;
+	else
+		ss << " | Cache hits: unknown (no creation feedback)";
+	return ss.str();
+}
+
+PipelineCache::FileHeader PipelineCache::getDeviceHeader()
+{
+	VkPhysicalDeviceProperties properties = Instance::get().getPhysicalDeviceProperties();
+
+	FileHeader header = {};
+	header.magic = PIPELINE_CACHE_MAGIC;
+	header.version = PIPELINE_CACHE_VERSION;
+	header.vendorID = properties.vendorID;
+	header.deviceID = properties.deviceID;
+	header.driverVersion = properties.driverVersion;
+	memcpy(header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+	return header;
+}
+
+std::vector<uint8_t> PipelineCache::load()
+{
+	std::ifstream file(this->filePath, std::ios::binary | std::ios::ate);
+	if (!file.is_open()) {
+		JAS_INFO("No pipeline cache at {}, pipelines will be compiled from scratch", this->filePath);
+		return {};
+	}
+
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	FileHeader header = {};
+	if (fileSize < sizeof(FileHeader)) {
+		JAS_WARN("Pipeline cache {} is too small, ignoring it", this->filePath);
+		return {};
+	}
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
+
+	// Cache data is only valid for the same device and driver
+	FileHeader device = getDeviceHeader();
+	if (header.magic != device.magic || header.version != device.version || header.vendorID != device.vendorID ||
+		header.deviceID != device.deviceID || header.driverVersion != device.driverVersion ||
+		memcmp(header.uuid, device.uuid, VK_UUID_SIZE) != 0 || header.dataSize != fileSize - sizeof(FileHeader)) {
+		JAS_WARN("Pipeline cache {} was made with another device or driver, ignoring it", this->filePath);
+		return {};
+	}
+
+	std::vector<uint8_t> data(header.dataSize);
+	file.read(reinterpret_cast<char*>(data.data()), header.dataSize);
+	JAS_INFO("Loaded pipeline cache: {} ({} bytes)", this->filePath, header.dataSize);
+	return data;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "jaspch.h"
+
+#include <mutex>
+
+/*
+	Pipeline cache shared by every pipeline, loaded from and saved to disk between runs.
+	The file starts with a header holding the device and driver it was made with, a file
+	from another device or driver version is ignored and rebuilt.
+	Creation time and cache hits are counted for every pipeline, hits need VK_EXT_pipeline_creation_feedback.
+*/
+class PipelineCache
+{
+public:
+	~PipelineCache();
+
+	static PipelineCache& get();
+
+	void init(const std::string& filePath);
+	void save();
+	void cleanup();
+
+	// Chain feedback into a pipeline create info, returns nullptr when the extension is not enabled
+	const void* getFeedbackInfo(VkPipelineCreationFeedbackCreateInfoEXT& info, VkPipelineCreationFeedbackEXT& feedback, std::vector<VkPipelineCreationFeedbackEXT>& stageFeedbacks);
+	// Register a created pipeline, thread safe
+	void addCreation(std::chrono::high_resolution_clock::time_point startTime, const VkPipelineCreationFeedbackEXT& feedback);
+
+	// Pipeline count, creation time and hit rate on one line
+	std::string getReport();
+
+	VkPipelineCache getCache() const { return this->cache; }
+
+private:
+	PipelineCache();
+	PipelineCache(PipelineCache& other) = delete;
+
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		uint32_t dataSize;
+		uint8_t uuid[VK_UUID_SIZE];
+	};
+
+	FileHeader getDeviceHeader();
+	std::vector<uint8_t> load();
+
+	VkPipelineCache cache;
+	std::string filePath;
+	bool loaded;
+	bool hasFeedback;
+
+	std::mutex mutex;
+	uint32_t pipelineCount;
+	uint32_t hitCount;
+	double creationTime;
+};
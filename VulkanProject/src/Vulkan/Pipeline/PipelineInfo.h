@@ -35,16 +35,8 @@ struct PipelineInfo
 	VkViewport viewport;
 	VkRect2D scissor;
 
-	PipelineInfo& PipelineInfo::operator =(const PipelineInfo& other)
-	{
-		this->vertexInputInfo = other.vertexInputInfo;
-		this->rasterizer = other.rasterizer;
-		this->multisampling = other.multisampling;
-		this->depthStencil = other.depthStencil;
-		this->colorBlendAttachment = other.colorBlendAttachment;
-		this->colorBlending = other.colorBlending;
-		this->inputAssembly = other.inputAssembly;
-		this->viewport = other.viewport;
-		this->scissor = other.scissor;
-	}
+	// Plain Vulkan structs, copied member by member. Declared together so neither is an implicitly generated, deprecated copy
+	PipelineInfo() = default;
+	PipelineInfo(const PipelineInfo& other) = default;
+	PipelineInfo& operator=(const PipelineInfo& other) = default;
 };
\ No newline at end of file
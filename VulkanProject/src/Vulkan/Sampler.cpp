@@ -2,7 +2,8 @@
 #include "Sampler.h"
 #include "Vulkan/Instance.h"
 
-Sampler::Sampler() : sampler(VK_NULL_HANDLE)
+Sampler::Sampler() : sampler(VK_NULL_HANDLE), minFilter(VK_FILTER_LINEAR), magFilter(VK_FILTER_LINEAR),
+	uWrap(VK_SAMPLER_ADDRESS_MODE_REPEAT), vWrap(VK_SAMPLER_ADDRESS_MODE_REPEAT)
 {
 }
 
@@ -12,6 +13,11 @@ Sampler::~Sampler()
 
 void Sampler::init(VkFilter minFilter, VkFilter magFilter, VkSamplerAddressMode uWrap, VkSamplerAddressMode vWrap)
 {
+	this->minFilter = minFilter;
+	this->magFilter = magFilter;
+	this->uWrap = uWrap;
+	this->vWrap = vWrap;
+
 	VkSamplerCreateInfo samplerInfo = {};
 	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
 	samplerInfo.magFilter = magFilter;
@@ -31,7 +37,7 @@ void Sampler::init(VkFilter minFilter, VkFilter magFilter, VkSamplerAddressMode
 	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	samplerInfo.mipLodBias = 0.0f;
 	samplerInfo.minLod = 0.0f;
-	samplerInfo.maxLod = 0.0f;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE; // The image view limits it to the levels the texture has
 
 	ERROR_CHECK(vkCreateSampler(Instance::get().getDevice(), &samplerInfo, nullptr, &this->sampler), "Failed to create texture sampler!")
 }
@@ -12,7 +12,15 @@ public:
 	void cleanup();
 
 	VkSampler getSampler() const { return this->sampler; }
+	VkFilter getMinFilter() const { return this->minFilter; }
+	VkFilter getMagFilter() const { return this->magFilter; }
+	VkSamplerAddressMode getWrapU() const { return this->uWrap; }
+	VkSamplerAddressMode getWrapV() const { return this->vWrap; }
 
 private:
 	VkSampler sampler;
+	VkFilter minFilter;
+	VkFilter magFilter;
+	VkSamplerAddressMode uWrap;
+	VkSamplerAddressMode vWrap;
 };
\ No newline at end of file
@@ -10,12 +10,12 @@ Texture::~Texture()
 {
 }
 
-void Texture::init(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, const std::vector<uint32_t>& queueFamilyIndices, VkImageCreateFlags flags, uint32_t arrayLayers)
+void Texture::init(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, const std::vector<uint32_t>& queueFamilyIndices, VkImageCreateFlags flags, uint32_t arrayLayers, uint32_t mipLevels)
 {
 	this->width = width;
 	this->height = height;
 	this->format = format;
-	this->image.init(width, height, format, usage, queueFamilyIndices, flags, arrayLayers);
+	this->image.init(width, height, format, usage, queueFamilyIndices, flags, arrayLayers, mipLevels);
 	//this->imageView.init(getVkImage(), VK_IMAGE_VIEW_TYPE_2D, format);
 }
 
@@ -63,6 +63,11 @@ uint32_t Texture::getHeight() const
 	return this->height;
 }
 
+uint32_t Texture::getMipLevels() const
+{
+	return this->image.getMipLevels();
+}
+
 ImageView& Texture::getImageView()
 {
 	return this->imageView;
@@ -10,7 +10,7 @@ public:
 	Texture();
 	~Texture();
 
-	void init(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, const std::vector<uint32_t>& queueFamilyIndices, VkImageCreateFlags flags, uint32_t arrayLayers);
+	void init(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, const std::vector<uint32_t>& queueFamilyIndices, VkImageCreateFlags flags, uint32_t arrayLayers, uint32_t mipLevels = 1);
 	void cleanup();
 
 	VkMemoryRequirements getMemReq() const;
@@ -22,6 +22,7 @@ public:
 	VkFormat getFormat() const;
 	uint32_t getWidth() const;
 	uint32_t getHeight() const;
+	uint32_t getMipLevels() const;
 
 private:
 	Image image;
@@ -94,8 +94,10 @@ void VKImgui::end()
 void VKImgui::render()
 {
 #ifdef USE_IMGUI
+	VkClearValue clearValue = {};
+	clearValue.color = { 0.0f, 0.0f, 0.0f, 1.0f };
 	this->commandBuffers[this->frameIndex]->begin(0, nullptr);
-	this->commandBuffers[this->frameIndex]->cmdBeginRenderPass(this->renderPass, this->framebuffers[this->frameIndex]->getFramebuffer(), this->swapChain->getExtent(), { {0.0f, 0.0f, 0.0f, 1.0f} }, VK_SUBPASS_CONTENTS_INLINE);
+	this->commandBuffers[this->frameIndex]->cmdBeginRenderPass(this->renderPass, this->framebuffers[this->frameIndex]->getFramebuffer(), this->swapChain->getExtent(), { &clearValue, 1 }, VK_SUBPASS_CONTENTS_INLINE);
 	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), this->commandBuffers[this->frameIndex]->getCommandBuffer());
 	this->commandBuffers[this->frameIndex]->cmdEndRenderPass();
 	this->commandBuffers[this->frameIndex]->end();
@@ -8,6 +8,7 @@
 
 #include <imgui.h>
 #include <fstream>
+#include <algorithm>
 
 VulkanProfiler& VulkanProfiler::get()
 {
@@ -44,6 +45,7 @@ void VulkanProfiler::cleanup()
 
 	this->plotResults.clear();
 	this->timestamps.clear();
+	this->totals.clear();
 	this->graphicsPipelineStat.clear();
 	this->graphicsPipelineStatNames.clear();
 	this->computePipelineStat.clear();
@@ -125,6 +127,22 @@ void VulkanProfiler::render(float dt)
 #endif
 }
 
+std::string VulkanProfiler::getReport()
+{
+	std::vector<std::string> names;
+	for (auto& total : this->totals)
+		names.push_back(total.first);
+	std::sort(names.begin(), names.end());
+
+	std::stringstream ss;
+	ss << "GPU timings:";
+	for (const std::string& name : names) {
+		const std::pair<uint64_t, uint64_t>& total = this->totals[name];
+		ss << " " << name << " " << (double)total.first / std::max(total.second, (uint64_t)1) << " " << getTimeUnitName();
+	}
+	return ss.str();
+}
+
 void VulkanProfiler::createTimestamps(uint32_t timestampPairCount)
 {
 	this->timestampCount = timestampPairCount * 2;
@@ -305,6 +323,10 @@ void VulkanProfiler::getBufferTimestamps(CommandBuffer* buffer)
 					this->results[timestamp.first][i].end = (((this->results[timestamp.first][i].end - this->startTimeGPU) * timestampPeriod) / (uint64_t)this->timeUnit);
 					this->results[timestamp.first][i].id = i;
 
+					std::pair<uint64_t, uint64_t>& total = this->totals[timestamp.first];
+					total.first += this->results[timestamp.first][i].end - this->results[timestamp.first][i].start;
+					total.second++;
+
 					if (Instrumentation::g_runProfilingSample)
 					{
 						if (this->timeResults[timestamp.first].size() == this->plotDataCount) {
@@ -41,6 +41,8 @@ public:
 
 	// Render results using ImGui
 	void render(float dt);
+	// Average of every timestamp read since init, one entry per name
+	std::string getReport();
 
 	// Specifies how many PAIRS of timestamps to create
 	void createTimestamps(uint32_t timestampPairCount);
@@ -98,6 +100,7 @@ private:
 	std::unordered_map<std::string, std::vector<Timestamp>> timestamps;
 	std::unordered_map<std::string, float> averages;
 	std::unordered_map<std::string, float> maxTime;
+	std::unordered_map<std::string, std::pair<uint64_t, uint64_t>> totals;	// Summed time and sample count
 
 	uint64_t startTimeCPU;
 	uint64_t startTimeGPU;
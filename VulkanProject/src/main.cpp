@@ -16,6 +16,7 @@
 			R:		Start frame profiling
 			C:		Toggle camera
 			F:		Toggle gravity
+			F1-F4:	Set frames in flight
 			ESC:	Exit
 
 		----------Implementation--------------
@@ -0,0 +1,34 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) out vec4 fragPos;
+layout(location = 1) out vec3 normal;
+
+struct Vertex
+{
+    vec4 position;
+    vec4 normal;
+};
+
+// Bindless table, size must match BINDLESS_MAX_BUFFERS in Config.h
+layout(set = 0, binding = 0, std430) readonly buffer Positions
+{
+    Vertex inPosition[];
+} vertexBuffers[64];
+
+layout(set = 1, binding = 0) uniform Camera
+{
+    mat4 vp;
+};
+
+layout(push_constant) uniform PushConstants
+{
+    uint vertexBuffer; // Active vertex buffer in the bindless table
+};
+
+void main() {
+    Vertex vertex = vertexBuffers[vertexBuffer].inPosition[gl_VertexIndex];
+    normal = normalize(vertex.normal.xyz);
+    fragPos = vec4(vertex.position.xyz, 1.0);
+    gl_Position = vp * fragPos;
+}
@@ -1,20 +1,17 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(set=0, binding = 0) readonly buffer VertexData
+layout(set=0, binding = 0) uniform Camera
 {
-    vec4 vertices[];
-};
-
-layout(set=0, binding = 1) uniform Camera
-{
-    mat4 proj;
-    mat4 view;
+    mat4 invViewProj;
 };
 
 layout(location = 0) out vec3 fragUV;
 
 void main() {
-    gl_Position = proj * view * vec4(vertices[gl_VertexIndex].xyz, 1.0);
-    fragUV = vertices[gl_VertexIndex].xyz;
+    // One triangle covering the screen, at far depth so it is only shaded where nothing else was drawn
+    vec2 uv = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(uv * 2.0 - 1.0, 1.0, 1.0);
+    vec4 direction = invViewProj * gl_Position;
+    fragUV = direction.xyz / direction.w;
 }
\ No newline at end of file
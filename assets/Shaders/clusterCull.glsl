@@ -0,0 +1,149 @@
+#version 450
+
+layout (local_size_x = 64, local_size_y = 1) in;
+
+// Matches DrawList::IndirectCluster, the bounds are in the quantized space of the positions
+struct Cluster
+{
+    vec4 sphere;
+    vec4 cone; // Average normal, w is the sine of the cone's spread and 1 when it can not be culled
+    uint firstIndex;
+    uint indexCount;
+    uint drawIndex;
+    int vertexOffset;
+};
+
+// Matches PackedInstance: position and yaw, scale as two half floats
+struct Instance
+{
+    vec3 position;
+    uint yawScale;
+};
+
+// Matches DrawList::IndirectData
+struct DrawData
+{
+    uint transformIndex;
+    uint materialIndex;
+};
+
+// Matches VkDrawIndexedIndirectCommand
+struct DrawCommand
+{
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+struct Plane
+{
+    vec4 normal;
+    vec4 point;
+};
+
+layout(set = 0, binding = 0, std430) readonly buffer Clusters
+{
+    Cluster clusters[];
+};
+
+// Full detail trees are the first run of the visible instances
+layout(set = 0, binding = 1, std430) readonly buffer VisibleData
+{
+    uint visibleInstances[];
+};
+
+layout(set = 0, binding = 2, std430) readonly buffer InstanceData
+{
+    Instance instances[];
+};
+
+layout(set = 0, binding = 3, std430) readonly buffer NodeTransformData
+{
+    mat4 nodeTransforms[];
+};
+
+// The draw data of the draw list is read at drawIndex, the draws written here follow it
+layout(set = 0, binding = 4, std430) buffer DrawDataTable
+{
+    DrawData draws[];
+};
+
+// Matches ProjectFinal::ModelIndirectHeader followed by the commands, the CPU writes the draw count of its own commands
+layout(set = 0, binding = 5, std430) buffer IndirectData
+{
+    uint drawCount;
+    uint pad0;
+    uint pad1;
+    uint pad2;
+    DrawCommand commands[];
+};
+
+layout(set = 0, binding = 6) uniform Camera
+{
+    mat4 vp;
+    vec4 eye;
+    vec4 fadeRange;
+};
+
+layout(set = 0, binding = 7) uniform Planes
+{
+    Plane planes[6]; // Normals point inwards
+};
+
+// Matches ProjectFinal::ClusterCullData
+layout(push_constant) uniform ClusterCullData
+{
+    uint visibleCount;  // Full detail instances culled by cluster, the first of them
+    uint clusterCount;  // Clusters of the draw list
+    uint firstDraw;     // Commands written by the CPU
+    uint maxDraws;      // visibleCount * clusterCount fits in it, the check only guards the buffer
+};
+
+mat4 decodeInstance(Instance instance)
+{
+    vec2 yawScale = unpackHalf2x16(instance.yawScale);
+    float c = cos(yawScale.x) * yawScale.y;
+    float s = sin(yawScale.x) * yawScale.y;
+    return mat4(vec4(c, 0.0, -s, 0.0), vec4(0.0, yawScale.y, 0.0, 0.0), vec4(s, 0.0, c, 0.0), vec4(instance.position, 1.0));
+}
+
+// One invocation for each cluster of each full detail instance
+void main()
+{
+    uint id = gl_GlobalInvocationID.x;
+    if (id >= visibleCount * clusterCount)
+        return;
+    uint slot = id / clusterCount;
+    Cluster cluster = clusters[id % clusterCount];
+    DrawData draw = draws[cluster.drawIndex];
+
+    mat4 transform = decodeInstance(instances[visibleInstances[slot]]) * nodeTransforms[draw.transformIndex];
+    vec3 center = (transform * vec4(cluster.sphere.xyz, 1.0)).xyz;
+    float scale = max(length(transform[0].xyz), max(length(transform[1].xyz), length(transform[2].xyz)));
+    float radius = cluster.sphere.w * scale;
+
+    // Near, far, left and right as the tree cull
+    for (uint i = 0; i < 4; i++)
+        if (dot(center - planes[i].point.xyz, planes[i].normal.xyz) < -radius)
+            return;
+
+    // Every triangle faces away when the eye is behind the cone moved back by the radius
+    if (cluster.cone.w < 1.0) {
+        vec3 axis = normalize(mat3(transform) * cluster.cone.xyz);
+        vec3 view = center - eye.xyz;
+        if (dot(view, axis) >= cluster.cone.w * length(view) + radius)
+            return;
+    }
+
+    uint index = atomicAdd(drawCount, 1);
+    if (index >= firstDraw + maxDraws)
+        return;
+    commands[index].indexCount = cluster.indexCount;
+    commands[index].instanceCount = 1;
+    commands[index].firstIndex = cluster.firstIndex;
+    commands[index].vertexOffset = cluster.vertexOffset;
+    commands[index].firstInstance = slot;
+    draws[index] = draw;
+}
@@ -3,6 +3,14 @@ C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=vertex testVertex.glsl -o
 
 C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=frag modelFragment.glsl -o modelFragment.spv
 C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=vertex modelVertex.glsl -o modelVertex.spv
+C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=frag modelIndirectFragment.glsl -o modelIndirectFragment.spv
+C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=vertex modelIndirectVertex.glsl -o modelIndirectVertex.spv
+C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=compute treePlacement.glsl -o treePlacement.spv
+C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=compute clusterCull.glsl -o clusterCull.spv
+C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=frag impostorBakeFragment.glsl -o impostorBakeFragment.spv
+C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=vertex impostorBakeVertex.glsl -o impostorBakeVertex.spv
+C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=frag impostorFragment.glsl -o impostorFragment.spv
+C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=vertex impostorVertex.glsl -o impostorVertex.spv
 
 C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=frag ComputeTest/particleFragment.glsl -o ComputeTest/particleFragment.spv
 C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=vertex ComputeTest/particleVertex.glsl -o ComputeTest/particleVertex.spv
@@ -26,4 +34,6 @@ C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=compute ComputeTransferTes
 C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=compute ComputeTransferTest/compTransferComp.glsl -o ComputeTransferTest/compTransferComp.spv
 C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=vertex ComputeTransferTest/compTransferVert.glsl -o ComputeTransferTest/compTransferVert.spv
 C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=frag ComputeTransferTest/compTransferFrag.glsl -o ComputeTransferTest/compTransferFrag.spv
+C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=compute ComputeTransferTest/compTransferBindlessComp.glsl -o ComputeTransferTest/compTransferBindlessComp.spv
+C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=vertex ComputeTransferTest/compTransferBindlessVert.glsl -o ComputeTransferTest/compTransferBindlessVert.spv
 pause
\ No newline at end of file
@@ -1,11 +1,10 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+// Matches PackedVertex
 struct Vertex
 {
-    vec4 inPosition;
-    vec4 inNormal;
-    vec4 inUv;
+    uvec4 data;
 };
 
 layout(set=0, binding = 0) readonly buffer VertexData
@@ -28,8 +27,25 @@ layout(set=0, binding = 1) uniform UboData
     mat4 vp;
 };
 
+// Positions are 16 bit unorm, the dequantization is part of the transform
+vec3 decodePosition(uvec4 data)
+{
+    return vec3(float(data.x & 0xFFFFu), float(data.x >> 16), float(data.y & 0xFFFFu));
+}
+
+// Octahedral normal, the lower hemisphere is folded over the diagonals
+vec3 decodeNormal(uvec4 data)
+{
+    vec2 oct = unpackSnorm2x16(data.w);
+    vec3 n = vec3(oct, 1.0 - abs(oct.x) - abs(oct.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
 void main() {
-    gl_Position = vp * world * transform * vec4(vertices[gl_VertexIndex].inPosition.xyz, 1.0);
-    fragNormal = normalize((world * transform * vec4(vertices[gl_VertexIndex].inNormal.xyz, 0.0)).xyz);
-    fragUv = vertices[gl_VertexIndex].inUv.xy;
+    uvec4 vertex = vertices[gl_VertexIndex].data;
+    gl_Position = vp * world * transform * vec4(decodePosition(vertex), 1.0);
+    fragNormal = normalize((world * transform * vec4(decodeNormal(vertex), 0.0)).xyz);
+    fragUv = unpackHalf2x16(vertex.z);
 }
\ No newline at end of file
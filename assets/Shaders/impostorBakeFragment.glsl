@@ -0,0 +1,51 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec3 fragNormal;
+layout(location = 1) in vec2 fragUv;
+
+// Alpha is the coverage of the view
+layout(location = 0) out vec4 outAlbedo;
+// Model space normal, lit when the billboard is drawn
+layout(location = 1) out vec4 outNormal;
+
+// Bindless table, sizes must match BINDLESS_MAX_IMAGES and BINDLESS_MAX_SAMPLERS in Config.h
+layout(set=0, binding=1) uniform texture2D textures[256];
+layout(set=0, binding=2) uniform sampler samplers[16];
+
+// Texture order: baseColor, metallicRoughness, normal, occlusion, emissive
+struct Material
+{
+    uint textures[5];
+    uint samplers[5];
+    uint padding[2];
+};
+
+layout(set=1, binding=1) readonly buffer MaterialTable
+{
+    Material materials[];
+};
+
+layout(push_constant) uniform PushConstantsFrag
+{
+    layout(offset = 64)  vec4 baseColorFactor;
+	layout(offset = 80)  vec4 emissiveFactor;
+	layout(offset = 96)  float metallicFactor;
+	layout(offset = 100) float roughnessFactor;
+	layout(offset = 104) int baseColorTextureCoord;
+	layout(offset = 108) int metallicRoughnessTextureCoord;
+	layout(offset = 112) int normalTextureCoord;
+	layout(offset = 116) int occlusionTextureCoord;
+	layout(offset = 120) int emissiveTextureCoord;
+    layout(offset = 124) int materialIndex;
+};
+
+void main() {
+    // Same color as modelIndirectFragment.glsl before lighting
+    Material material = materials[materialIndex];
+    vec3 baseColor = texture(sampler2D(textures[material.textures[0]], samplers[material.samplers[0]]), fragUv).rgb;
+    baseColor *= baseColorFactor.rgb;
+
+    outAlbedo = vec4(baseColor, 1.0);
+    outNormal = vec4(normalize(fragNormal) * 0.5 + 0.5, 1.0);
+}
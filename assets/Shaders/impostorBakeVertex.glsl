@@ -0,0 +1,62 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Matches PackedVertex
+struct Vertex
+{
+    uvec4 data;
+};
+
+layout(set=1, binding = 0) readonly buffer VertexData
+{
+    Vertex vertices[];
+};
+
+// Matches BakeView in Impostor::bake
+layout(set=1, binding = 2) uniform BakeView
+{
+    vec4 bounds; // Center of the views in model space, w is half the size of a view
+    uint viewCount;
+};
+
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) out vec2 fragUv;
+
+layout(push_constant) uniform PushConstantsVert
+{
+    layout(offset = 0) mat4 transform;
+};
+
+// Positions are 16 bit unorm, the dequantization is part of the transform
+vec3 decodePosition(uvec4 data)
+{
+    return vec3(float(data.x & 0xFFFFu), float(data.x >> 16), float(data.y & 0xFFFFu));
+}
+
+// Octahedral normal, the lower hemisphere is folded over the diagonals
+vec3 decodeNormal(uvec4 data)
+{
+    vec2 oct = unpackSnorm2x16(data.w);
+    vec3 n = vec3(oct, 1.0 - abs(oct.x) - abs(oct.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+void main() {
+    uvec4 vertex = vertices[gl_VertexIndex].data;
+    vec3 position = (transform * vec4(decodePosition(vertex), 1.0)).xyz - bounds.xyz;
+
+    // Each instance is one view, looking at the model from dir. impostorVertex.glsl picks the views with the same angles
+    float angle = 6.28318531 * float(gl_InstanceIndex) / float(viewCount);
+    vec3 dir = vec3(sin(angle), 0.0, cos(angle));
+    vec3 right = vec3(dir.z, 0.0, -dir.x);
+    vec2 view = vec2(dot(position, right), position.y) / bounds.w;
+    float depth = 0.5 - dot(position, dir) / (2.0 * bounds.w);
+
+    // Orthographic into the view's place in the row, up is at the top of the atlas
+    float x = (view.x * 0.5 + 0.5 + float(gl_InstanceIndex)) / float(viewCount);
+    gl_Position = vec4(x * 2.0 - 1.0, -view.y, depth, 1.0);
+    fragNormal = normalize((transform * vec4(decodeNormal(vertex), 0.0)).xyz);
+    fragUv = unpackHalf2x16(vertex.z);
+}
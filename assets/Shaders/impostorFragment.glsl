@@ -0,0 +1,44 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec2 fragUv;
+layout(location = 1) flat in vec2 fragYaw;
+layout(location = 2) flat in float fragMeshFade;
+
+layout(location = 0) out vec4 outColor;
+
+// Bindless table, sizes must match BINDLESS_MAX_IMAGES and BINDLESS_MAX_SAMPLERS in Config.h
+layout(set=0, binding=1) uniform texture2D textures[256];
+layout(set=0, binding=2) uniform sampler samplers[16];
+
+// Matches Impostor::Desc
+layout(push_constant) uniform ImpostorData
+{
+    vec4 bounds;
+    uint albedoAtlas;
+    uint normalAtlas;
+    uint atlasSampler;
+    uint viewCount;
+};
+
+// Screen space noise in [0, 1), the same pattern as the mesh so the two cover each pixel once
+float dither()
+{
+    return fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+}
+
+void main() {
+    vec4 albedo = texture(sampler2D(textures[albedoAtlas], samplers[atlasSampler]), fragUv);
+    if (albedo.a < 0.5 || dither() < fragMeshFade)
+        discard;
+
+    // Baked in model space, rotated with the instance
+    vec3 n = texture(sampler2D(textures[normalAtlas], samplers[atlasSampler]), fragUv).xyz * 2.0 - 1.0;
+    n = vec3(fragYaw.x * n.x + fragYaw.y * n.z, n.y, fragYaw.x * n.z - fragYaw.y * n.x);
+
+    // Light of modelIndirectFragment.glsl
+    vec3 lightDir = normalize(vec3(0.5, -2.0, 0.5));
+    float diffuse = max(dot(normalize(n), -lightDir), 0.0);
+
+    outColor = vec4(albedo.rgb * diffuse, 1.0);
+}
@@ -0,0 +1,79 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Matches PackedInstance: position and yaw, scale as two half floats
+struct Instance
+{
+    vec3 position;
+    uint yawScale;
+};
+
+// Indices of the instances drawn as billboards, written each frame by the cull stage
+layout(set=1, binding = 0) readonly buffer VisibleData
+{
+    uint visibleImpostors[];
+};
+
+layout(set=1, binding = 1) uniform Camera
+{
+    mat4 vp;
+    vec4 eye;
+    vec4 fadeRange; // x: meshes start to fade out, y: only billboards
+};
+
+layout(set=1, binding = 2) readonly buffer InstanceData
+{
+    Instance instances[];
+};
+
+// Matches Impostor::Desc
+layout(push_constant) uniform ImpostorData
+{
+    vec4 bounds;
+    uint albedoAtlas;
+    uint normalAtlas;
+    uint atlasSampler;
+    uint viewCount;
+};
+
+layout(location = 0) out vec2 fragUv;
+layout(location = 1) flat out vec2 fragYaw;
+layout(location = 2) flat out float fragMeshFade;
+
+const vec2 corners[6] = vec2[](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0));
+
+// Same as the mesh, the billboard covers what the mesh does not
+float meshFade(vec3 position)
+{
+    float dist = length(eye.xyz - position);
+    if (fadeRange.y <= fadeRange.x)
+        return dist < fadeRange.y ? 1.0 : 0.0;
+    return clamp((fadeRange.y - dist) / (fadeRange.y - fadeRange.x), 0.0, 1.0);
+}
+
+void main() {
+    Instance instance = instances[visibleImpostors[gl_InstanceIndex]];
+    vec2 yawScale = unpackHalf2x16(instance.yawScale);
+    float c = cos(yawScale.x);
+    float s = sin(yawScale.x);
+
+    // Rotation of decodeInstance in modelIndirectVertex.glsl
+    vec3 center = instance.position + vec3(c * bounds.x + s * bounds.z, bounds.y, c * bounds.z - s * bounds.x) * yawScale.y;
+    vec2 toEye = eye.xz - center.xz;
+    vec2 dir = length(toEye) > 0.0001 ? normalize(toEye) : vec2(0.0, 1.0);
+
+    // The baked view closest to the camera direction in model space
+    vec2 local = vec2(c * dir.x - s * dir.y, s * dir.x + c * dir.y);
+    float angle = mod(atan(local.x, local.y), 6.28318531);
+    uint view = uint(round(angle / 6.28318531 * float(viewCount))) % viewCount;
+
+    // Turned to the camera around the up axis, like the views were baked
+    vec2 corner = corners[gl_VertexIndex];
+    vec3 right = vec3(dir.y, 0.0, -dir.x);
+    vec3 position = center + (right * corner.x + vec3(0.0, corner.y, 0.0)) * bounds.w * yawScale.y;
+    gl_Position = vp * vec4(position, 1.0);
+
+    fragUv = vec2((corner.x * 0.5 + 0.5 + float(view)) / float(viewCount), 0.5 - corner.y * 0.5);
+    fragYaw = vec2(c, s);
+    fragMeshFade = meshFade(instance.position);
+}
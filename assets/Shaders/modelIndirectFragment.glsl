@@ -0,0 +1,67 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec3 fragNormal;
+layout(location = 1) in vec2 fragUv;
+layout(location = 2) flat in uint fragMaterialIndex;
+layout(location = 3) flat in float fragMeshFade;
+
+layout(location = 0) out vec4 outColor;
+
+// Bindless table, sizes must match BINDLESS_MAX_IMAGES and BINDLESS_MAX_SAMPLERS in Config.h
+layout(set=0, binding=1) uniform texture2D textures[256];
+layout(set=0, binding=2) uniform sampler samplers[16];
+
+// Texture order: baseColor, metallicRoughness, normal, occlusion, emissive
+struct Material
+{
+    uint textures[5];
+    uint samplers[5];
+    uint padding[2];
+};
+
+// Matches Material::PushData
+struct MaterialParams
+{
+    vec4 baseColorFactor;
+    vec4 emissiveFactor;
+    float metallicFactor;
+    float roughnessFactor;
+    int baseColorTextureCoord;
+    int metallicRoughnessTextureCoord;
+    int normalTextureCoord;
+    int occlusionTextureCoord;
+    int emissiveTextureCoord;
+    int materialIndex;
+};
+
+layout(set=1, binding=3) readonly buffer MaterialTable
+{
+    Material materials[];
+};
+
+layout(set=1, binding=6) readonly buffer MaterialParamsTable
+{
+    MaterialParams params[];
+};
+
+// Screen space noise in [0, 1), the same pattern as the billboards so the two cover each pixel once
+float dither()
+{
+    return fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+}
+
+void main() {
+    // Dithered into the billboard while the instance is in the fade range
+    if (dither() >= fragMeshFade)
+        discard;
+
+    Material material = materials[fragMaterialIndex];
+    vec3 baseColor = texture(sampler2D(textures[material.textures[0]], samplers[material.samplers[0]]), fragUv).rgb;
+    baseColor *= params[fragMaterialIndex].baseColorFactor.rgb;
+
+    vec3 lightDir = normalize(vec3(0.5, -2.0, 0.5));
+    float diffuse = max(dot(normalize(fragNormal), -lightDir), 0.0);
+    
+    outColor = vec4(baseColor*diffuse, 1.0);
+}
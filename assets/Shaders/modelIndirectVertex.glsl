@@ -0,0 +1,106 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shader_draw_parameters : enable
+
+// Matches PackedVertex
+struct Vertex
+{
+    uvec4 data;
+};
+
+// Matches PackedInstance: position and yaw, scale as two half floats
+struct Instance
+{
+    vec3 position;
+    uint yawScale;
+};
+
+mat4 decodeInstance(Instance instance)
+{
+    vec2 yawScale = unpackHalf2x16(instance.yawScale);
+    float c = cos(yawScale.x) * yawScale.y;
+    float s = sin(yawScale.x) * yawScale.y;
+    return mat4(vec4(c, 0.0, -s, 0.0), vec4(0.0, yawScale.y, 0.0, 0.0), vec4(s, 0.0, c, 0.0), vec4(instance.position, 1.0));
+}
+
+// Matches DrawList::IndirectData
+struct DrawData
+{
+    uint transformIndex;
+    uint materialIndex;
+};
+
+layout(set=1, binding = 0) readonly buffer VertexData
+{
+    Vertex vertices[];
+};
+
+// Indices of the visible instances, written each frame by the cull stage
+layout(set=1, binding = 1) readonly buffer VisibleData
+{
+    uint visibleInstances[];
+};
+
+layout(set=1, binding = 2) uniform Camera
+{
+    mat4 vp;
+    vec4 eye;
+    vec4 fadeRange; // x: meshes start to fade out, y: only billboards
+};
+
+layout(set=1, binding = 4) readonly buffer NodeTransformData
+{
+    mat4 nodeTransforms[];
+};
+
+layout(set=1, binding = 5) readonly buffer DrawDataTable
+{
+    DrawData draws[];
+};
+
+layout(set=1, binding = 7) readonly buffer InstanceData
+{
+    Instance instances[];
+};
+
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) out vec2 fragUv;
+layout(location = 2) flat out uint fragMaterialIndex;
+layout(location = 3) flat out float fragMeshFade;
+
+// Positions are 16 bit unorm, the dequantization is part of the transform
+vec3 decodePosition(uvec4 data)
+{
+    return vec3(float(data.x & 0xFFFFu), float(data.x >> 16), float(data.y & 0xFFFFu));
+}
+
+// Octahedral normal, the lower hemisphere is folded over the diagonals
+vec3 decodeNormal(uvec4 data)
+{
+    vec2 oct = unpackSnorm2x16(data.w);
+    vec3 n = vec3(oct, 1.0 - abs(oct.x) - abs(oct.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+// Instances past the fade range are drawn by impostorVertex.glsl
+float meshFade(vec3 position)
+{
+    float dist = length(eye.xyz - position);
+    if (fadeRange.y <= fadeRange.x)
+        return dist < fadeRange.y ? 1.0 : 0.0;
+    return clamp((fadeRange.y - dist) / (fadeRange.y - fadeRange.x), 0.0, 1.0);
+}
+
+void main() {
+    uvec4 vertex = vertices[gl_VertexIndex].data;
+    DrawData draw = draws[gl_DrawIDARB];
+    Instance instance = instances[visibleInstances[gl_InstanceIndex]];
+    mat4 transform = decodeInstance(instance) * nodeTransforms[draw.transformIndex];
+    gl_Position = vp * transform * vec4(decodePosition(vertex), 1.0);
+    fragNormal = normalize((transform * vec4(decodeNormal(vertex), 0.0)).xyz);
+    fragUv = unpackHalf2x16(vertex.z);
+    fragMaterialIndex = draw.materialIndex;
+    fragMeshFade = meshFade(instance.position);
+}
@@ -0,0 +1,124 @@
+#version 450
+
+layout (local_size_x = 64, local_size_y = 1) in;
+
+// Matches PackedInstance
+struct Instance
+{
+    vec3 position;
+    uint yawScale;
+};
+
+layout(set = 0, binding = 0, std430) readonly buffer TerrainHeights
+{
+    float heights[];
+};
+
+layout(set = 0, binding = 1, std430) writeonly buffer Instances
+{
+    Instance instances[];
+};
+
+// Region and the page of the instance buffer it is placed in
+layout(set = 0, binding = 2, std430) readonly buffer Jobs
+{
+    uvec2 jobs[];
+};
+
+// Matches ProjectFinal::TreePlacementConfig
+layout(push_constant) uniform PlacementConfig
+{
+    vec4 origin; // w is the vertex distance
+    uint heightmapWidth;
+    uint regionWidthCount;
+    uint regionSize;
+    uint slotsPerRegion;
+    vec2 heightRange;
+    vec2 scaleRange;
+    float maxSlope;
+    uint seed;
+    uint jobCount;
+};
+
+uint hash(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// Uniform in [0, 1), the state is advanced for the next number
+float random(inout uint state)
+{
+    state = hash(state);
+    return float(state >> 8) / 16777216.0;
+}
+
+float vertexHeight(ivec2 v)
+{
+    v = clamp(v, ivec2(0), ivec2(int(heightmapWidth) - 1));
+    return heights[v.x + v.y * int(heightmapWidth)];
+}
+
+float barycentricHeight(vec3 v1, vec3 v2, vec3 v3, vec2 xz)
+{
+    float det = (v2.z - v3.z) * (v1.x - v3.x) - (v2.x - v3.x) * (v1.z - v3.z);
+    float l1 = abs(((v2.z - v3.z) * (xz.x - v3.x) - (v2.x - v3.x) * (xz.y - v3.z)) / det);
+    float l2 = abs(((v1.z - v3.z) * (xz.x - v3.x) - (v1.x - v3.x) * (xz.y - v3.z)) / det);
+    float l3 = 1.0 - l1 - l2;
+    return l1 * v1.y + l2 * v2.y + l3 * v3.y;
+}
+
+// Same triangles as Heightmap::getTerrainHeight, so the trees stand where the camera walks
+float terrainHeight(vec2 xz)
+{
+    vec2 dist = xz - origin.xz;
+    ivec2 bl = ivec2(dist / origin.w);
+    float tl = vertexHeight(ivec2(bl.x, bl.y - 1));
+    float tr = vertexHeight(ivec2(bl.x + 1, bl.y - 1));
+    float br = vertexHeight(ivec2(bl.x + 1, bl.y));
+    float blHeight = vertexHeight(bl);
+
+    vec2 point = mod(dist, origin.w) / origin.w;
+    if (point.x <= 1.0 - point.y)
+        return barycentricHeight(vec3(0.0, tl, 0.0), vec3(1.0, tr, 0.0), vec3(0.0, blHeight, 1.0), point);
+    return barycentricHeight(vec3(1.0, tr, 0.0), vec3(1.0, br, 1.0), vec3(0.0, blHeight, 1.0), point);
+}
+
+// Rise over run from the neighbours of the closest vertex
+float terrainSlope(vec2 xz)
+{
+    ivec2 v = ivec2(round((xz - origin.xz) / origin.w));
+    float dx = vertexHeight(v + ivec2(1, 0)) - vertexHeight(v - ivec2(1, 0));
+    float dz = vertexHeight(v + ivec2(0, 1)) - vertexHeight(v - ivec2(0, 1));
+    return length(vec2(dx, dz)) / (2.0 * origin.w);
+}
+
+void main()
+{
+    uint job = gl_GlobalInvocationID.x / slotsPerRegion;
+    uint slot = gl_GlobalInvocationID.x % slotsPerRegion;
+    if (job >= jobCount)
+        return;
+
+    // The slot only depends on its index in the map and the seed, a region paged in again gets the same trees
+    uint region = jobs[job].x;
+    uint id = jobs[job].y * slotsPerRegion + slot;
+    uint state = hash((region * slotsPerRegion + slot) ^ hash(seed));
+    vec2 jitter = vec2(random(state), random(state));
+    float regionWorldSize = float(regionSize - 1) * origin.w;
+    vec2 xz = origin.xz + (vec2(region % regionWidthCount, region / regionWidthCount) + jitter) * regionWorldSize;
+
+    float height = terrainHeight(xz);
+    float yaw = random(state) * 6.28318531;
+    float scale = mix(scaleRange.x, scaleRange.y, random(state));
+    // Empty slots keep their position but have no size, the cull stage skips them
+    if (height < heightRange.x || height > heightRange.y || terrainSlope(xz) > maxSlope)
+        scale = 0.0;
+
+    instances[id].position = vec3(xz.x, height, xz.y);
+    instances[id].yawScale = packHalf2x16(vec2(yaw, scale));
+}
\ No newline at end of file